@@ -47,6 +47,13 @@ AppConfig::serialize(void)
   obj.set("disableHighRateWarning", this->disableHighRateWarning);
   obj.set("loFreq", this->loFreq);
   obj.set("bandwidth", this->bandwidth);
+  obj.set("wfHistory", this->wfHistory);
+  obj.set("wfHistorySize", this->wfHistorySize);
+  obj.set("detectChannels", this->detectChannels);
+  obj.set("cfarMethod", this->cfarMethod);
+  obj.set("cfarThreshold", this->cfarThreshold);
+  obj.set("cfarHysteresis", this->cfarHysteresis);
+  obj.set("cfarWindow", this->cfarWindow);
 
   obj.setField("source", profileObj);
   obj.setField("analyzerParams", this->analyzerParams.serialize());
@@ -112,6 +119,13 @@ AppConfig::deserialize(Suscan::Object const &conf)
     TRYSILENT(this->disableHighRateWarning = conf.get("disableHighRateWarning", this->disableHighRateWarning));
     TRYSILENT(this->loFreq     = conf.get("loFreq", this->loFreq));
     TRYSILENT(this->bandwidth  = conf.get("bandwidth", this->bandwidth));
+    TRYSILENT(this->wfHistory  = conf.get("wfHistory", this->wfHistory));
+    TRYSILENT(this->wfHistorySize = conf.get("wfHistorySize", this->wfHistorySize));
+    TRYSILENT(this->detectChannels = conf.get("detectChannels", this->detectChannels));
+    TRYSILENT(this->cfarMethod = conf.get("cfarMethod", this->cfarMethod));
+    TRYSILENT(this->cfarThreshold = conf.get("cfarThreshold", this->cfarThreshold));
+    TRYSILENT(this->cfarHysteresis = conf.get("cfarHysteresis", this->cfarHysteresis));
+    TRYSILENT(this->cfarWindow = conf.get("cfarWindow", this->cfarWindow));
 
     try {
       Suscan::Object set = conf.getField("bandPlans");
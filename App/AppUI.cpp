@@ -43,6 +43,9 @@ AppUI::AppUI(QMainWindow *owner)
   this->aboutDialog = new AboutDialog(owner);
   this->deviceDialog = new DeviceDialog(owner);
   this->panoramicDialog = new PanoramicDialog(owner);
+  this->latencyDialog = new LatencyDialog(owner);
+  this->historyDialog = new WaterfallHistoryDialog(owner);
+  this->channelDialog = new ChannelListDialog(owner);
 }
 
 void
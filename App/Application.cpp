@@ -19,8 +19,11 @@
 
 #include <Suscan/Library.h>
 #include <fcntl.h>
+#include <algorithm>
 
 #include "Application.h"
+#include "LatencyMonitor.h"
+#include "PowerDB.h"
 
 #include <QMessageBox>
 
@@ -91,10 +94,10 @@ Application::run(Suscan::Object const &config)
   this->show();
 }
 
-FileDataSaver *
-Application::getSaver(void) const
+SampleFanout *
+Application::getFanout(void) const
 {
-  return this->dataSaver.get();
+  return this->fanout.get();
 }
 
 SUPRIVATE SUBOOL
@@ -105,10 +108,11 @@ onBaseBandData(
     SUSCOUNT length)
 {
   Application *app = static_cast<Application *>(privdata);
-  FileDataSaver *saver;
+  SampleFanout *fanout;
 
-  if ((saver = app->getSaver()) != nullptr)
-    saver->write(samples, length);
+  // One copy, whatever the number of sinks
+  if ((fanout = app->getFanout()) != nullptr)
+    fanout->write(samples, length);
 
   return SU_TRUE;
 }
@@ -117,6 +121,66 @@ void
 Application::uninstallDataSaver()
 {
   this->dataSaver = nullptr;
+  this->metadataWriter = nullptr;
+}
+
+void
+Application::installBaseBandFilter(void)
+{
+  if (!this->filterInstalled) {
+    this->analyzer->registerBaseBandFilter(onBaseBandData, this);
+    this->filterInstalled = true;
+  }
+}
+
+//
+// Every baseband sink (capture file, channelizer, pre-trigger buffer)
+// reads from the same fanout. The time machine keeps at most half of
+// the pool, so that recordings always have room.
+//
+void
+Application::installFanout(void)
+{
+  unsigned int seconds = this->ui.sourcePanel->getRecordHistoryLength();
+  unsigned int rate = this->mediator->getProfile()->getDecimatedSampleRate();
+  size_t capacity;
+
+  this->timeMachine = nullptr;
+  this->fanout = std::make_shared<SampleFanout>(
+        SampleFanout::blockLength(rate));
+
+  if (seconds > 0) {
+    capacity = static_cast<size_t>(seconds) * rate;
+    capacity = std::min(capacity, TimeMachine::maxSamples());
+    capacity = std::min(
+          capacity,
+          this->fanout->getBlockLen() * (this->fanout->getMaxBlocks() / 2));
+
+    this->timeMachine = std::make_unique<TimeMachine>(
+          capacity,
+          this->fanout->getBlockLen());
+
+    // First sink of a brand new fanout, this cannot fail
+    (void) this->timeMachine->attach(this->fanout);
+    this->installBaseBandFilter();
+  }
+
+  this->mediator->setHistoryMemory(
+        this->timeMachine.get() == nullptr
+        ? 0
+        : this->timeMachine->getCapacity() * sizeof(SUCOMPLEX));
+}
+
+// Only once the analyzer is gone
+void
+Application::uninstallFanout(void)
+{
+  // The saver may still point to the time machine
+  this->uninstallDataSaver();
+  this->uninstallChannelizer();
+  this->timeMachine = nullptr;
+  this->fanout = nullptr;
+  this->mediator->setHistoryMemory(0);
 }
 
 void
@@ -140,11 +204,45 @@ Application::connectDataSaver()
         this,
         SLOT(onSaveRate(qreal)));
 
+  this->connect(
+        this->dataSaver.get(),
+        SIGNAL(headroom(qreal)),
+        this,
+        SLOT(onSaveHeadroom(qreal)));
+
   this->connect(
         this->dataSaver.get(),
         SIGNAL(commit()),
         this,
         SLOT(onCommit()));
+
+  this->connect(
+        this->dataSaver.get(),
+        SIGNAL(samplesDropped(quint64, quint64)),
+        this,
+        SLOT(onSaveDropped(quint64, quint64)));
+}
+
+void
+Application::connectChannelizer(void)
+{
+  this->connect(
+        this->channelizer.get(),
+        SIGNAL(stopped()),
+        this,
+        SLOT(onChannelizerError()));
+
+  this->connect(
+        this->channelizer.get(),
+        SIGNAL(commit()),
+        this,
+        SLOT(onChannelizerCommit()));
+
+  this->connect(
+        this->channelizer.get(),
+        SIGNAL(samplesDropped(quint64, quint64)),
+        this,
+        SLOT(onChannelizerDropped(quint64, quint64)));
 }
 
 void
@@ -176,21 +274,253 @@ Application::connectAudioFileSaver()
 }
 
 
+std::string
+Application::captureStem(unsigned int segment) const
+{
+  if (this->segmentSamples == 0)
+    return this->capturePath;
+
+  return FileDataSaver::segmentStem(this->capturePath, segment);
+}
+
+quint64
+Application::getSegmentSamples(void) const
+{
+  quint64 rate = this->mediator->getProfile()->getDecimatedSampleRate();
+
+  switch (this->ui.sourcePanel->getRecordRollover()) {
+    case DataSaverUI::ROLLOVER_SIZE:
+      return (static_cast<quint64>(
+                this->ui.sourcePanel->getRecordRolloverSize()) << 20)
+          / SampleConverter::sampleSize(this->captureFormat);
+
+    case DataSaverUI::ROLLOVER_TIME:
+      return rate * this->ui.sourcePanel->getRecordRolloverTime();
+
+    default:
+      return 0;
+  }
+}
+
+//
+// Segments have a fixed number of samples. The position of an event
+// tells which file it belongs to. If the capture moved to a new segment,
+// start its sidecar.
+//
+quint64
+Application::metadataPosition(quint64 position)
+{
+  if (this->segmentSamples > 0) {
+    unsigned int segment =
+        static_cast<unsigned int>(position / this->segmentSamples);
+
+    while (this->metadataWriter.get() != nullptr
+           && this->metadataSegment < segment)
+      this->installMetadataWriter(this->metadataSegment + 1);
+
+    position -= segment * this->segmentSamples;
+  }
+
+  return position;
+}
+
+void
+Application::installMetadataWriter(unsigned int segment)
+{
+  Suscan::Source::Config *profile = this->mediator->getProfile();
+  const Suscan::Source::Device &device = profile->getDevice();
+
+  // Flush the previous segment first
+  this->metadataWriter = nullptr;
+  this->metadataWriter = std::make_unique<SigMFMetadataWriter>(
+        QString::fromStdString(
+          this->captureStem(segment) + SIGDIGGER_SIGMF_META_EXTENSION),
+        this);
+  this->metadataSegment = segment;
+
+  this->metadataWriter->setGlobal(
+        this->captureFormat,
+        profile->getDecimatedSampleRate(),
+        QString::fromStdString(device.getDesc()),
+        QString::fromStdString(profile->label()));
+
+  this->metadataWriter->addCapture(
+        0,
+        profile->getFreq(),
+        segment * this->segmentSamples + this->droppedSamples);
+
+  for (auto p = device.getFirstGain(); p != device.getLastGain(); ++p)
+    this->metadataWriter->addAnnotation(
+          0,
+          0,
+          "gain",
+          QString::fromStdString(p->getName())
+          + " = "
+          + QString::number(
+            static_cast<double>(profile->getGain(p->getName())))
+          + " dB");
+
+  this->connect(
+        this->metadataWriter.get(),
+        SIGNAL(error(QString)),
+        this,
+        SLOT(onMetadataError(QString)));
+}
+
 void
 Application::installDataSaver(int fd)
 {
   if (this->dataSaver.get() == nullptr && this->analyzer.get() != nullptr) {
-    this->dataSaver = std::make_unique<FileDataSaver>(fd, this);
+    FileDataSaver::FileDataParams params;
+
+    params.fd = fd;
+    params.backend = this->ui.sourcePanel->getRecordBackend();
+    params.format = this->ui.sourcePanel->getRecordFormat();
+    params.fullScale = this->ui.sourcePanel->getRecordFullScale();
+    params.segmentSamples = this->segmentSamples;
+    params.retain = this->ui.sourcePanel->getRecordRetention();
+    params.stem = this->capturePath;
+    params.extension = SIGDIGGER_SIGMF_DATA_EXTENSION;
+    params.companions.push_back(SIGDIGGER_SIGMF_META_EXTENSION);
+    params.history = this->timeMachine.get();
+    params.sampleRate = this->mediator->getProfile()->getDecimatedSampleRate();
+    params.index = true;
+
+    this->dataSaver = std::make_unique<FileDataSaver>(params, this);
+    this->dataSaver->setMemoryBudget(
+          this->ui.sourcePanel->getRecordMemoryBudget());
     this->dataSaver->setSampleRate(
           this->mediator->getProfile()->getDecimatedSampleRate());
-    if (!this->filterInstalled) {
-      this->analyzer->registerBaseBandFilter(onBaseBandData, this);
-      this->filterInstalled = true;
-    }
+    this->dataSaver->setOverloadPolicy(
+          this->ui.sourcePanel->getRecordOverloadPolicy());
+
+    // Cannot fail either: the baseband fanout has two sinks at most
+    (void) this->dataSaver->attach(this->fanout);
+    this->droppedSamples = 0;
+    this->installMetadataWriter(0);
+    this->installBaseBandFilter();
     this->connectDataSaver();
   }
 }
 
+//
+// One file per channel, named like full-rate captures but after the
+// rate and frequency of the channel:
+// sigdigger_XXXXX_XXXXXXXXX_float32_iq.sigmf-data
+//
+bool
+Application::installChannelizer(std::vector<qreal> const &freqs)
+{
+  Suscan::Source::Config *profile = this->mediator->getProfile();
+  const Suscan::Source::Device &device = profile->getDevice();
+  SampleFormat format = this->ui.sourcePanel->getRecordFormat();
+  qreal rate = profile->getDecimatedSampleRate();
+  qreal center = profile->getFreq();
+  qreal spacing = this->ui.sourcePanel->getRecordChannelSpacing();
+  std::vector<qreal> offsets;
+  std::string stem;
+  char baseName[96];
+  unsigned int i;
+  int fd;
+
+  if (this->channelizer.get() != nullptr || this->analyzer.get() == nullptr)
+    return false;
+
+  // Only channels that fit in the baseband
+  for (auto f : freqs)
+    if (std::fabs(f - center) + .5 * spacing <= .5 * rate)
+      offsets.push_back(f - center);
+
+  if (offsets.empty()) {
+    QMessageBox::warning(
+              this,
+              "SigDigger error",
+              "None of the selected channels is within the current band",
+              QMessageBox::Ok);
+    return false;
+  }
+
+  this->channelConverter = std::make_unique<SampleConverter>(
+        format,
+        this->ui.sourcePanel->getRecordFullScale());
+  this->channelizer = std::make_unique<Channelizer>(rate, spacing, offsets);
+  this->channelOffsets = offsets;
+  this->channelDropped = 0;
+
+  for (i = 0; i < offsets.size(); ++i) {
+    snprintf(
+          baseName,
+          sizeof(baseName),
+          "sigdigger_%.0lf_%.0lf_%s_iq",
+          this->channelizer->getChannelRate(),
+          center + offsets[i],
+          SampleConverter::formatName(format).c_str());
+
+    stem = this->ui.sourcePanel->getRecordSavePath() + "/" + baseName;
+
+    if ((fd = creat(
+           (stem + SIGDIGGER_SIGMF_DATA_EXTENSION).c_str(),
+           0600)) == -1) {
+      QMessageBox::warning(
+                this,
+                "SigDigger error",
+                "Failed to open channel file for writing: " +
+                QString(strerror(errno)),
+                QMessageBox::Ok);
+      this->uninstallChannelizer();
+      return false;
+    }
+
+    // Hundreds of direct I/O writers would take gigabytes of buffers
+    this->channelizer->setWriter(
+          i,
+          FileDataSaver::makeFileWriter(fd, *this->channelConverter));
+
+    this->channelMetadata.push_back(
+          std::make_unique<SigMFMetadataWriter>(
+            QString::fromStdString(stem + SIGDIGGER_SIGMF_META_EXTENSION),
+            this));
+
+    this->channelMetadata.back()->setGlobal(
+          format,
+          this->channelizer->getChannelRate(),
+          QString::fromStdString(device.getDesc()),
+          QString::fromStdString(profile->label()));
+    this->channelMetadata.back()->addCapture(0, center + offsets[i], 0);
+
+    this->connect(
+          this->channelMetadata.back().get(),
+          SIGNAL(error(QString)),
+          this,
+          SLOT(onChannelMetadataError(QString)));
+  }
+
+  if (!this->channelizer->start(this->fanout)) {
+    QMessageBox::warning(
+              this,
+              "SigDigger error",
+              "Failed to start channelizer: "
+              + QString::fromStdString(this->channelizer->getError()),
+              QMessageBox::Ok);
+    this->uninstallChannelizer();
+    return false;
+  }
+
+  this->installBaseBandFilter();
+  this->connectChannelizer();
+
+  return true;
+}
+
+void
+Application::uninstallChannelizer(void)
+{
+  this->channelizer = nullptr;
+  this->channelMetadata.clear();
+  this->channelConverter = nullptr;
+  this->channelOffsets.clear();
+}
+
 void
 Application::setAudioInspectorParams(
     unsigned int rate,
@@ -230,7 +560,8 @@ Application::openAudioFileSaver(void)
         this->ui.spectrum->getCenterFreq() + this->ui.spectrum->getLoFreq();
     params.modulation = this->ui.audioPanel->getDemod();
 
-    this->audioFileSaver = std::make_unique<AudioFileSaver>(params, nullptr);
+    this->setAudioFileSaver(
+          std::make_unique<AudioFileSaver>(params, nullptr));
     this->connectAudioFileSaver();
     opened = true;
   }
@@ -242,12 +573,52 @@ void
 Application::closeAudioFileSaver(void)
 {
   if (this->audioFileSaver != nullptr)
-    this->audioFileSaver = nullptr;
+    this->setAudioFileSaver(nullptr);
 
   this->mediator->setAudioRecordSize(0);
   this->mediator->setAudioRecordState(false);
 }
 
+// The old one is destroyed out of the lock: nobody else can see it by then
+void
+Application::setAudioFileSaver(std::unique_ptr<AudioFileSaver> saver)
+{
+  {
+    std::lock_guard<std::mutex> guard(this->audioMutex);
+    this->audioFileSaver.swap(saver);
+  }
+}
+
+void
+Application::setPlayBack(std::unique_ptr<AudioPlayback> playBack)
+{
+  {
+    std::lock_guard<std::mutex> guard(this->audioMutex);
+    this->playBack.swap(playBack);
+  }
+}
+
+// Runs in the analyzer async thread. readTime: when the batch left the
+// analyzer MQ.
+void
+Application::feedAudio(
+    const SUCOMPLEX *samples,
+    SUSCOUNT count,
+    qint64 readTime)
+{
+  std::lock_guard<std::mutex> guard(this->audioMutex);
+
+  if (this->playBack != nullptr) {
+    this->playBack->write(samples, count);
+    LatencyMonitor::instance()->recordSince(
+          LATENCY_STAGE_AUDIO_DELIVERY,
+          readTime);
+  }
+
+  if (this->audioFileSaver != nullptr)
+    this->audioFileSaver->write(samples, count);
+}
+
 bool
 Application::openAudio(unsigned int rate)
 {
@@ -263,7 +634,7 @@ Application::openAudio(unsigned int rate)
         if (rate > bw)
           rate = static_cast<unsigned int>(floor(bw));
 
-        this->playBack = std::make_unique<AudioPlayback>("default", rate);
+        this->setPlayBack(std::make_unique<AudioPlayback>("default", rate));
         this->audioSampleRate = this->playBack->getSampleRate();
         this->lastAudioLo = this->getAudioInspectorLo();
 
@@ -299,7 +670,7 @@ Application::openAudio(unsigned int rate)
                   "Failed to open inspector. Error was:<p /><pre>"
                   + QString(e.what()) + "</pre>",
                   QMessageBox::Ok);
-        this->playBack = nullptr;
+        this->setPlayBack(nullptr);
       } catch (std::runtime_error const &e) {
         QMessageBox::warning(
                   this,
@@ -324,7 +695,7 @@ Application::closeAudio(void)
   this->audioInspectorOpened = false;
   this->audioSampleRate = 0;
   this->audioInspHandle = 0;
-  this->playBack = nullptr;
+  this->setPlayBack(nullptr);
   this->audioConfigured = false;
 }
 
@@ -729,6 +1100,18 @@ Application::startCapture(void)
 
       // All set, move to application
       this->analyzer = std::move(analyzer);
+      this->installFanout();
+
+      // Audio must not wait for the GUI thread
+      this->analyzer->subscribeSamples(
+            SIGDIGGER_AUDIO_INSPECTOR_MAGIC_ID,
+            [this] (
+                Suscan::InspectorId,
+                const SUCOMPLEX *data,
+                SUSCOUNT len,
+                qint64 readTime) {
+              this->feedAudio(data, len, readTime);
+            });
 
       // If there is a capture file configured, install data saver
       if (this->ui.sourcePanel->getRecordState()) {
@@ -780,7 +1163,7 @@ Application::onAnalyzerHalted(void)
   bool restart = this->mediator->getState() == UIMediator::RESTARTING;
 
   this->analyzer = nullptr;
-  this->uninstallDataSaver();
+  this->uninstallFanout();
   this->mediator->setState(UIMediator::HALTED);
   this->mediator->detachAllInspectors();
   this->closeAudio();
@@ -807,7 +1190,7 @@ Application::onAnalyzerEos(void)
   this->mediator->detachAllInspectors();
   this->analyzer = nullptr;
   this->closeAudio();
-  this->uninstallDataSaver();
+  this->uninstallFanout();
 }
 
 void
@@ -816,19 +1199,25 @@ Application::onPSDMessage(const Suscan::PSDMessage &msg)
   this->mediator->setProcessRate(
         static_cast<unsigned int>(this->analyzer->getMeasuredSampleRate()));
   this->mediator->feedPSD(msg);
+
+  if (this->ui.latencyDialog->isVisible())
+    this->ui.latencyDialog->setDroppedPSD(this->analyzer->getDroppedPSDCount());
 }
 
 void
 Application::onInspectorSamples(const Suscan::SamplesMessage &msg)
 {
+  LatencyMonitor *monitor = LatencyMonitor::instance();
   Inspector *insp;
 
+  monitor->record(
+        LATENCY_STAGE_SAMPLES_QUEUE,
+        msg.getDispatchTime() - msg.getReadTime());
+
   switch (msg.getInspectorId()) {
+    // Normally delivered in the async thread, see startCapture()
     case SIGDIGGER_AUDIO_INSPECTOR_MAGIC_ID:
-      if (this->playBack != nullptr)
-        this->playBack->write(msg.getSamples(), msg.getCount());
-      if (this->audioFileSaver != nullptr)
-        this->audioFileSaver->write(msg.getSamples(), msg.getCount());
+      this->feedAudio(msg.getSamples(), msg.getCount(), msg.getReadTime());
       break;
 
     case SIGDIGGER_RAW_INSPECTOR_MAGIC_ID:
@@ -837,8 +1226,12 @@ Application::onInspectorSamples(const Suscan::SamplesMessage &msg)
 
     default:
       if ((insp = this->mediator->lookupInspector(msg.getInspectorId()))
-                   != nullptr)
+                   != nullptr) {
           insp->feed(msg.getSamples(), msg.getCount());
+          monitor->recordSince(
+                LATENCY_STAGE_SAMPLES_FEED,
+                msg.getDispatchTime());
+      }
   }
 }
 
@@ -848,9 +1241,12 @@ Application::onInspectorMessage(const Suscan::InspectorMessage &msg)
 {
   Inspector *insp = nullptr;
   SUFLOAT *data;
-  SUSCOUNT len, p;
+  SUSCOUNT len;
   Suscan::InspectorId oId;
-  float x;
+
+  LatencyMonitor::instance()->record(
+        LATENCY_STAGE_INSPECTOR_QUEUE,
+        msg.getDispatchTime() - msg.getReadTime());
 
   switch (msg.getKind()) {
     case SUSCAN_ANALYZER_INSPECTOR_MSGKIND_OPEN:
@@ -909,19 +1305,7 @@ Application::onInspectorMessage(const Suscan::InspectorMessage &msg)
        if ((insp = this->mediator->lookupInspector(msg.getInspectorId())) != nullptr) {
          data = msg.getSpectrumData();
          len = msg.getSpectrumLength();
-         p = len / 2;
-
-         for (auto i = 0u; i < len; ++i)
-           data[i] = SU_POWER_DB(data[i]);
-
-         for (auto i = 0u; i < len / 2; ++i) {
-           x = data[i];
-           data[i] = data[p];
-           data[p] = x;
-
-           if (++p == len)
-             p = 0;
-         }
+         fftShiftPowerDB(data, len);
          insp->feedSpectrum(data, len, msg.getSpectrumRate());
        }
       break;
@@ -962,7 +1346,7 @@ Application::onAnalyzerReadError(void)
         QMessageBox::Ok);
   this->mediator->setState(UIMediator::HALTED);
   this->analyzer = nullptr;
-  this->uninstallDataSaver();
+  this->uninstallFanout();
 }
 
 Application::~Application()
@@ -973,10 +1357,13 @@ Application::~Application()
   if (this->scanner != nullptr)
     delete this->scanner;
 
-  this->playBack = nullptr;
   this->analyzer = nullptr;
+  this->setPlayBack(nullptr);
   this->uninstallDataSaver();
-  this->audioFileSaver = nullptr;
+  this->uninstallChannelizer();
+  this->timeMachine = nullptr;
+  this->fanout = nullptr;
+  this->setAudioFileSaver(nullptr);
 
   this->deviceDetectThread->quit();
   this->deviceDetectThread->deleteLater();
@@ -1028,6 +1415,13 @@ Application::onGainChanged(QString name, float val)
   if (this->mediator->getState() == UIMediator::RUNNING) {
     this->mediator->getProfile()->setGain(name.toStdString(), val);
     this->analyzer->setGain(name.toStdString(), val);
+
+    if (this->metadataWriter.get() != nullptr)
+      this->metadataWriter->addAnnotation(
+            this->metadataPosition(this->dataSaver->getPosition()),
+            0,
+            "gain",
+            name + " = " + QString::number(static_cast<double>(val)) + " dB");
   }
 }
 
@@ -1039,6 +1433,20 @@ Application::onFrequencyChanged(qint64 freq, qint64 lnb)
 
   if (this->mediator->getState() == UIMediator::RUNNING)
     this->analyzer->setFrequency(freq, lnb);
+
+  if (this->metadataWriter.get() != nullptr)
+    this->metadataWriter->addCapture(
+          this->metadataPosition(this->dataSaver->getPosition()),
+          static_cast<qreal>(freq),
+          this->dataSaver->getPosition() + this->droppedSamples);
+
+  // Channels stay at the same offset from the center
+  if (this->channelizer.get() != nullptr)
+    for (unsigned int i = 0; i < this->channelMetadata.size(); ++i)
+      this->channelMetadata[i]->addCapture(
+            this->channelizer->getSize(),
+            static_cast<qreal>(freq) + this->channelOffsets[i],
+            this->channelizer->getSize() + this->channelDropped);
 }
 
 void
@@ -1136,23 +1544,32 @@ Application::onThrottleConfigChanged(void)
 }
 
 //
-// sigdigger_XXXXXXXXXX_XXXXXXXXXXXXXXXXXXXX_float32_iq.raw
+// sigdigger_XXXXXXXXXX_XXXXXXXXXXXXXXXXXXXX_float32_iq.sigmf-data
+//
+// With rollover enabled, a 4-digit segment index follows the stem:
+// sigdigger_XXXXXXXXXX_XXXXXXXXXXXXXXXXXXXX_float32_iq-NNNN.sigmf-data
 //
 int
 Application::openCaptureFile(void)
 {
   int fd = -1;
-  char baseName[64];
+  char baseName[96];
 
   snprintf(
         baseName,
-        64,
-        "sigdigger_%d_%.0lf_float32_iq.raw",
+        sizeof(baseName),
+        "sigdigger_%d_%.0lf_%s_iq",
         this->mediator->getProfile()->getDecimatedSampleRate(),
-        this->mediator->getProfile()->getFreq());
+        this->mediator->getProfile()->getFreq(),
+        SampleConverter::formatName(
+          this->ui.sourcePanel->getRecordFormat()).c_str());
 
-  std::string fullPath =
+  this->capturePath =
       this->ui.sourcePanel->getRecordSavePath() + "/" + baseName;
+  this->captureFormat = this->ui.sourcePanel->getRecordFormat();
+  this->segmentSamples = this->getSegmentSamples();
+
+  std::string fullPath = this->captureStem(0) + SIGDIGGER_SIGMF_DATA_EXTENSION;
 
   if ((fd = creat(fullPath.c_str(), 0600)) == -1) {
     QMessageBox::warning(
@@ -1171,15 +1588,31 @@ Application::onToggleRecord(void)
 {
   if (this->ui.sourcePanel->getRecordState()) {
     if (this->mediator->getState() == UIMediator::RUNNING) {
-      int fd = this->openCaptureFile();
-      if (fd != -1)
-        this->installDataSaver(fd);
+      std::vector<qreal> channels;
+      bool recording = false;
+
+      if (!this->ui.sourcePanel->getRecordChannels(channels)) {
+        QMessageBox::warning(
+                  this,
+                  "SigDigger error",
+                  "Invalid channel list",
+                  QMessageBox::Ok);
+      } else if (!channels.empty()) {
+        recording = this->installChannelizer(channels);
+      } else {
+        int fd = this->openCaptureFile();
+        if (fd != -1)
+          this->installDataSaver(fd);
+        recording = fd != -1;
+      }
 
-      this->ui.sourcePanel->setRecordState(fd != -1);
+      this->ui.sourcePanel->setRecordState(recording);
     }
   } else {
     this->uninstallDataSaver();
+    this->uninstallChannelizer();
     this->mediator->setCaptureSize(0);
+    this->mediator->setClipCount(0);
     this->ui.sourcePanel->setRecordState(false);
   }
 }
@@ -1222,10 +1655,117 @@ Application::onSaveRate(qreal rate)
   this->mediator->setIORate(rate);
 }
 
+void
+Application::onSaveHeadroom(qreal seconds)
+{
+  if (this->dataSaver.get() != nullptr)
+    this->mediator->setCaptureHeadroom(
+          seconds,
+          this->dataSaver->getMemoryUsage());
+}
+
 void
 Application::onCommit(void)
 {
   this->mediator->setCaptureSize(this->dataSaver->getSize());
+  this->mediator->setClipCount(this->dataSaver->getClipCount());
+
+  if (this->metadataWriter.get() != nullptr)
+    (void) this->metadataPosition(this->dataSaver->getPosition());
+}
+
+void
+Application::onSaveDropped(quint64 position, quint64 count)
+{
+  quint64 sample;
+
+  this->droppedSamples += count;
+
+  // A new capture segment records where the stream resumes
+  if (this->metadataWriter.get() != nullptr) {
+    sample = this->metadataPosition(position);
+
+    this->metadataWriter->addCapture(
+          sample,
+          this->mediator->getProfile()->getFreq(),
+          position + this->droppedSamples);
+
+    this->metadataWriter->addGap(sample, count);
+  }
+}
+
+void
+Application::onMetadataError(QString error)
+{
+  if (this->metadataWriter.get() != nullptr) {
+    // Keep recording. Samples are more valuable than their metadata.
+    this->metadataWriter = nullptr;
+
+    QMessageBox::warning(
+          this,
+          "SigDigger error",
+          "Failed to write capture metadata: " + error,
+          QMessageBox::Ok);
+  }
+}
+
+void
+Application::onChannelizerError(void)
+{
+  if (this->channelizer.get() != nullptr) {
+    QString error = QString::fromStdString(this->channelizer->getError());
+
+    this->uninstallChannelizer();
+
+    QMessageBox::warning(
+              this,
+              "SigDigger error",
+              "Channel file write error: " + error,
+              QMessageBox::Ok);
+
+    this->mediator->setRecordState(false);
+  }
+}
+
+void
+Application::onChannelizerCommit(void)
+{
+  if (this->channelizer.get() != nullptr) {
+    this->mediator->setCaptureSize(
+          this->channelizer->getSize()
+          * this->channelizer->getChannelCount());
+    this->mediator->setClipCount(this->channelConverter->getClipCount());
+  }
+}
+
+void
+Application::onChannelizerDropped(quint64 position, quint64 count)
+{
+  this->channelDropped += count;
+
+  for (unsigned int i = 0; i < this->channelMetadata.size(); ++i) {
+    this->channelMetadata[i]->addCapture(
+          position,
+          this->mediator->getProfile()->getFreq() + this->channelOffsets[i],
+          position + this->channelDropped);
+
+    this->channelMetadata[i]->addGap(position, count);
+  }
+}
+
+void
+Application::onChannelMetadataError(QString error)
+{
+  if (!this->channelMetadata.empty()) {
+    // As with full-rate captures, keep the samples
+    this->channelMetadata.clear();
+
+    QMessageBox::warning(
+          this,
+          "SigDigger error",
+          "Failed to write channel metadata: " + error,
+          QMessageBox::Ok);
+  }
 }
 
 void
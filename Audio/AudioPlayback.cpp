@@ -19,6 +19,7 @@
 
 #include <iostream>
 #include "AudioPlayback.h"
+#include "LatencyMonitor.h"
 #include <stdexcept>
 #include <sys/mman.h>
 
@@ -119,12 +120,14 @@ AudioBufferList::AudioBufferList(unsigned int num)
 void
 AudioBufferList::reset(void)
 {
-  QMutexLocker(&this->listMutex);
+  QMutexLocker locker(&this->listMutex);
 
   if (this->current != nullptr) {
     AudioBuffer *buffer = this->current;
     this->current = nullptr;
 
+    buffer->time = LatencyMonitor::now();
+
     buffer->next = this->freeList;
     this->freeList = buffer;
   }
@@ -153,7 +156,7 @@ AudioBufferList::reset(void)
 float *
 AudioBufferList::reserve(void)
 {
-  QMutexLocker(&this->listMutex);
+  QMutexLocker locker(&this->listMutex);
 
   // You cannot reserve a buffer before committing int
   if (this->current != nullptr) {
@@ -174,7 +177,7 @@ AudioBufferList::reserve(void)
 void
 AudioBufferList::commit(void)
 {
-  QMutexLocker(&this->listMutex);
+  QMutexLocker locker(&this->listMutex);
 
   // You cannot commit if the current buffer is null
   if (this->current == nullptr) {
@@ -183,6 +186,8 @@ AudioBufferList::commit(void)
     AudioBuffer *buffer = this->current;
     this->current = nullptr;
 
+    buffer->time = LatencyMonitor::now();
+
     buffer->prev = nullptr;
     buffer->next = this->playListHead;
     if (this->playListHead != nullptr)
@@ -199,7 +204,7 @@ AudioBufferList::commit(void)
 float *
 AudioBufferList::next(void)
 {
-  QMutexLocker(&this->listMutex);
+  QMutexLocker locker(&this->listMutex);
 
   if (this->playBuffer != nullptr) {
     std::cerr << "Invalid next(), please call release() first!" << std::endl;
@@ -217,6 +222,10 @@ AudioBufferList::next(void)
       this->playListHead = nullptr;
     --this->playListLen;
 
+    LatencyMonitor::instance()->recordSince(
+          LATENCY_STAGE_AUDIO_QUEUE,
+          buffer->time);
+
     return buffer->data;
   }
 }
@@ -224,7 +233,7 @@ AudioBufferList::next(void)
 void
 AudioBufferList::release(void)
 {
-  QMutexLocker(&this->listMutex);
+  QMutexLocker locker(&this->listMutex);
 
   if (this->playBuffer == nullptr) {
     std::cerr << "Invalid release(), please call next() first!" << std::endl;
@@ -322,13 +331,28 @@ AudioPlayback::onError(void)
 void
 AudioPlayback::onStarving(void)
 {
-  if (this->bufferList.getPlayListLen() < SIGDIGGER_AUDIO_BUFFERING_WATERMARK) {
-    this->completed = 0;
-    this->buffering = true;
+  bool play = false;
+  bool rebuffer = false;
+
+  {
+    QMutexLocker locker(&this->stateMutex);
+
+    // While buffering, write() restarts the worker when there is enough
+    if (!this->buffering) {
+      if (this->bufferList.getPlayListLen() < SIGDIGGER_AUDIO_BUFFERING_WATERMARK) {
+        this->completed = 0;
+        this->buffering = true;
+        rebuffer = true;
+      } else {
+        play = true;
+      }
+    }
+  }
+
+  if (rebuffer)
     std::cout << "AudioPlayback: reached watermark, buffering again..." << std::endl;
-  } else {
+  else if (play)
     emit restart();
-  }
 }
 
 AudioPlayback::~AudioPlayback()
@@ -385,17 +409,26 @@ AudioPlayback::write(const SUCOMPLEX *samples, SUSCOUNT size)
 
     // Buffer full, send to playback thread.
     if (this->ptr == SIGDIGGER_AUDIO_BUFFER_SIZE) {
+      bool play = false;
+
       this->current_buffer = nullptr;
-      this->bufferList.commit();
 
-      // If buffering, we wait until we have SIGDIGGER_AUDIO_BUFFER_MIN
-      // buffers full. When that happens, we restart the thread.
-      if (this->buffering) {
-        if (++this->completed == SIGDIGGER_AUDIO_BUFFER_MIN) {
-          emit restart();
+      {
+        QMutexLocker locker(&this->stateMutex);
+
+        this->bufferList.commit();
+
+        // If buffering, we wait until we have SIGDIGGER_AUDIO_BUFFER_MIN
+        // buffers full. When that happens, we restart the thread.
+        if (this->buffering
+            && ++this->completed == SIGDIGGER_AUDIO_BUFFER_MIN) {
           this->buffering = false;
+          play = true;
         }
       }
+
+      if (play)
+        emit restart();
     }
   }
 }
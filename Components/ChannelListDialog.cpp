@@ -0,0 +1,268 @@
+//
+//    ChannelListDialog.cpp: Channels found by the CFAR detector
+//    Copyright (C) 2020 Gonzalo José Carracedo Carballal
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as
+//    published by the Free Software Foundation, either version 3 of the
+//    License, or (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful, but
+//    WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public
+//    License along with this program.  If not, see
+//    <http://www.gnu.org/licenses/>
+//
+
+#include "ChannelListDialog.h"
+#include <QDateTime>
+#include <SuWidgetsHelpers.h>
+#include "ui_ChannelListDialog.h"
+
+using namespace SigDigger;
+
+ChannelListDialog::ChannelListDialog(QWidget *parent) :
+  QDialog(parent),
+  ui(new Ui::ChannelListDialog)
+{
+  ui->setupUi(this);
+
+  this->timer.setInterval(SIGDIGGER_CHANNEL_LIST_REFRESH_MS);
+  this->setParams(this->params);
+
+  this->connectAll();
+}
+
+ChannelListDialog::~ChannelListDialog()
+{
+  delete ui;
+}
+
+void
+ChannelListDialog::connectAll(void)
+{
+  connect(
+        &this->timer,
+        SIGNAL(timeout(void)),
+        this,
+        SLOT(onTimeout(void)));
+
+  connect(
+        this->ui->detectCheck,
+        SIGNAL(toggled(bool)),
+        this,
+        SLOT(onConfigChanged(void)));
+
+  connect(
+        this->ui->methodCombo,
+        SIGNAL(activated(int)),
+        this,
+        SLOT(onConfigChanged(void)));
+
+  connect(
+        this->ui->thresholdSpin,
+        SIGNAL(editingFinished(void)),
+        this,
+        SLOT(onConfigChanged(void)));
+
+  connect(
+        this->ui->hysteresisSpin,
+        SIGNAL(editingFinished(void)),
+        this,
+        SLOT(onConfigChanged(void)));
+
+  connect(
+        this->ui->windowSpin,
+        SIGNAL(editingFinished(void)),
+        this,
+        SLOT(onConfigChanged(void)));
+
+  connect(
+        this->ui->channelTable,
+        SIGNAL(cellDoubleClicked(int, int)),
+        this,
+        SLOT(onInspect(void)));
+
+  connect(
+        this->ui->inspectButton,
+        SIGNAL(clicked(bool)),
+        this,
+        SLOT(onInspect(void)));
+
+  connect(
+        this->ui->closeButton,
+        SIGNAL(clicked(bool)),
+        this,
+        SLOT(accept(void)));
+}
+
+void
+ChannelListDialog::setDetecting(bool detecting)
+{
+  bool blocked = this->ui->detectCheck->blockSignals(true);
+  this->ui->detectCheck->setChecked(detecting);
+  this->ui->detectCheck->blockSignals(blocked);
+
+  if (!detecting)
+    this->ui->statsLabel->setText("Not detecting");
+}
+
+// Whatever the dialog does not show is kept as it came
+void
+ChannelListDialog::setParams(CFARParams const &params)
+{
+  this->params = params;
+
+  this->ui->methodCombo->setCurrentIndex(
+        params.method == CFAR_ORDERED_STATISTIC ? 1 : 0);
+  this->ui->thresholdSpin->setValue(static_cast<qreal>(params.threshold));
+  this->ui->hysteresisSpin->setValue(static_cast<qreal>(params.hysteresis));
+  this->ui->windowSpin->setValue(static_cast<int>(params.referenceCells));
+}
+
+void
+ChannelListDialog::setChannels(
+    std::vector<DetectedChannel> const &channels,
+    qreal shift)
+{
+  this->channels = channels;
+  this->shift = shift;
+}
+
+void
+ChannelListDialog::setStats(qreal cost, quint64 processed, quint64 dropped)
+{
+  this->stats =
+      QString::number(cost / 1e3, 'f', 2)
+      + " ms per frame, "
+      + QString::number(processed)
+      + " frames, "
+      + QString::number(dropped)
+      + " skipped";
+}
+
+bool
+ChannelListDialog::getDetecting(void) const
+{
+  return this->ui->detectCheck->isChecked();
+}
+
+CFARParams
+ChannelListDialog::getParams(void) const
+{
+  CFARParams params = this->params;
+
+  params.method = this->ui->methodCombo->currentIndex() == 1
+      ? CFAR_ORDERED_STATISTIC
+      : CFAR_CELL_AVERAGING;
+  params.threshold = static_cast<float>(this->ui->thresholdSpin->value());
+  params.hysteresis = static_cast<float>(this->ui->hysteresisSpin->value());
+  params.referenceCells =
+      static_cast<unsigned int>(this->ui->windowSpin->value());
+
+  return params;
+}
+
+// Rebuilt as a whole, keeping the selected channel selected
+void
+ChannelListDialog::refresh(void)
+{
+  QTableWidget *table = this->ui->channelTable;
+  QTableWidgetItem *item;
+  quint32 selected = 0;
+  int row;
+
+  item = table->item(table->currentRow(), 0);
+  if (item != nullptr)
+    selected = item->data(Qt::UserRole).toUInt();
+
+  table->setRowCount(static_cast<int>(this->channels.size()));
+
+  for (row = 0; row < table->rowCount(); ++row) {
+    DetectedChannel const &ch = this->channels[static_cast<size_t>(row)];
+
+    item = new QTableWidgetItem(
+          SuWidgetsHelpers::formatQuantity(ch.frequency + this->shift, "Hz"));
+    item->setData(Qt::UserRole, ch.id);
+    table->setItem(row, 0, item);
+
+    table->setItem(
+          row,
+          1,
+          new QTableWidgetItem(
+            SuWidgetsHelpers::formatQuantity(ch.bandwidth, "Hz")));
+    table->setItem(
+          row,
+          2,
+          new QTableWidgetItem(
+            QString::number(static_cast<qreal>(ch.snr), 'f', 1) + " dB"));
+    table->setItem(
+          row,
+          3,
+          new QTableWidgetItem(
+            QDateTime::fromMSecsSinceEpoch(ch.firstSeen / 1000).toString(
+              "HH:mm:ss")));
+    table->setItem(
+          row,
+          4,
+          new QTableWidgetItem(
+            ch.present
+            ? QString("Now")
+            : QDateTime::fromMSecsSinceEpoch(ch.lastSeen / 1000).toString(
+                "HH:mm:ss")));
+
+    if (ch.id == selected)
+      table->setCurrentCell(row, 0);
+  }
+
+  if (this->getDetecting())
+    this->ui->statsLabel->setText(
+          QString::number(this->channels.size())
+          + " channels. "
+          + this->stats);
+}
+
+void
+ChannelListDialog::showEvent(QShowEvent *)
+{
+  this->refresh();
+  this->timer.start();
+}
+
+void
+ChannelListDialog::hideEvent(QHideEvent *)
+{
+  this->timer.stop();
+}
+
+////////////////////////////////// Slots //////////////////////////////////////
+void
+ChannelListDialog::onTimeout(void)
+{
+  this->refresh();
+}
+
+void
+ChannelListDialog::onConfigChanged(void)
+{
+  if (!this->getDetecting()) {
+    this->channels.clear();
+    this->ui->statsLabel->setText("Not detecting");
+  }
+
+  emit configChanged();
+}
+
+void
+ChannelListDialog::onInspect(void)
+{
+  QTableWidgetItem *item = this->ui->channelTable->item(
+        this->ui->channelTable->currentRow(),
+        0);
+
+  if (item != nullptr)
+    emit openChannel(item->data(Qt::UserRole).toUInt());
+}
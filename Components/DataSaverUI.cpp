@@ -20,7 +20,9 @@
 #include <QFileDialog>
 #include <SuWidgetsHelpers.h>
 #include "DataSaverUI.h"
+#include "Channelizer.h"
 #include "ui_DataSaverUI.h"
+#include <algorithm>
 
 using namespace SigDigger;
 
@@ -33,6 +35,18 @@ void
 DataSaverConfig::deserialize(Suscan::Object const &conf)
 {
   LOAD(path);
+  LOAD(directIO);
+  LOAD(format);
+  LOAD(fullScale);
+  LOAD(rollover);
+  LOAD(rolloverSize);
+  LOAD(rolloverTime);
+  LOAD(retain);
+  LOAD(historyLength);
+  LOAD(bufferBudget);
+  LOAD(overload);
+  LOAD(channels);
+  LOAD(channelSpacing);
 }
 
 Suscan::Object &&
@@ -43,11 +57,129 @@ DataSaverConfig::serialize(void)
   obj.setClass("DataSaverConfig");
 
   STORE(path);
+  STORE(directIO);
+  STORE(format);
+  STORE(fullScale);
+  STORE(rollover);
+  STORE(rolloverSize);
+  STORE(rolloverTime);
+  STORE(retain);
+  STORE(historyLength);
+  STORE(bufferBudget);
+  STORE(overload);
+  STORE(channels);
+  STORE(channelSpacing);
 
   return this->persist(obj);
 }
 
 ////////////////////////////// DataSaverUI /////////////////////////////////////
+std::string
+DataSaverUI::rolloverToStr(Rollover rollover)
+{
+  switch (rollover) {
+    case ROLLOVER_SIZE:
+      return "size";
+
+    case ROLLOVER_TIME:
+      return "time";
+
+    default:
+      return "never";
+  }
+}
+
+DataSaverUI::Rollover
+DataSaverUI::strToRollover(std::string const &str)
+{
+  if (str == "size")
+    return ROLLOVER_SIZE;
+  else if (str == "time")
+    return ROLLOVER_TIME;
+
+  return ROLLOVER_NEVER;
+}
+
+std::string
+DataSaverUI::overloadToStr(GenericDataSaver::OverloadPolicy policy)
+{
+  switch (policy) {
+    case GenericDataSaver::OVERLOAD_DROP_AND_MARK:
+      return "drop";
+
+    case GenericDataSaver::OVERLOAD_BLOCK:
+      return "block";
+
+    default:
+      return "abort";
+  }
+}
+
+GenericDataSaver::OverloadPolicy
+DataSaverUI::strToOverload(std::string const &str)
+{
+  if (str == "drop")
+    return GenericDataSaver::OVERLOAD_DROP_AND_MARK;
+  else if (str == "block")
+    return GenericDataSaver::OVERLOAD_BLOCK;
+
+  return GenericDataSaver::OVERLOAD_ABORT;
+}
+
+//
+// A comma-separated list of frequencies in MHz. An entry like A-B expands
+// to every channel from A to B, both included, spaced by the channel
+// spacing. The result is in Hz, sorted and without repetitions.
+//
+bool
+DataSaverUI::parseChannelPlan(
+    std::string const &plan,
+    qreal spacing,
+    std::vector<qreal> &freqs)
+{
+  QStringList entries = QString::fromStdString(plan).split(
+        ",",
+        QString::SkipEmptyParts);
+  QStringList range;
+  qreal first, last;
+  bool ok = true;
+  int i, count;
+
+  freqs.clear();
+
+  for (auto &entry : entries) {
+    range = entry.trimmed().split("-");
+
+    if (range.size() > 2 || spacing <= 0)
+      return false;
+
+    first = range[0].trimmed().toDouble(&ok) * 1e6;
+    if (!ok)
+      return false;
+
+    last = first;
+    if (range.size() == 2) {
+      last = range[1].trimmed().toDouble(&ok) * 1e6;
+      if (!ok || last < first)
+        return false;
+    }
+
+    // Tolerate rounding errors in the upper limit
+    count = static_cast<int>(std::floor((last - first) / spacing + 1e-6)) + 1;
+    if (static_cast<size_t>(count) + freqs.size()
+        > SIGDIGGER_CHANNELIZER_MAX_CHANNELS)
+      return false;
+
+    for (i = 0; i < count; ++i)
+      freqs.push_back(first + i * spacing);
+  }
+
+  std::sort(freqs.begin(), freqs.end());
+  freqs.erase(std::unique(freqs.begin(), freqs.end()), freqs.end());
+
+  return true;
+}
+
 void
 DataSaverUI::connectAll(void)
 {
@@ -62,6 +194,124 @@ DataSaverUI::connectAll(void)
         SIGNAL(clicked(bool)),
         this,
         SLOT(onRecordStartStop(void)));
+
+  connect(
+        this->ui->backendCombo,
+        SIGNAL(activated(int)),
+        this,
+        SLOT(onBackendChanged(void)));
+
+  connect(
+        this->ui->formatCombo,
+        SIGNAL(activated(int)),
+        this,
+        SLOT(onFormatChanged(void)));
+
+  connect(
+        this->ui->fullScaleSpin,
+        SIGNAL(valueChanged(double)),
+        this,
+        SLOT(onFullScaleChanged(void)));
+
+  connect(
+        this->ui->rolloverCombo,
+        SIGNAL(activated(int)),
+        this,
+        SLOT(onRolloverChanged(void)));
+
+  connect(
+        this->ui->rolloverSpin,
+        SIGNAL(valueChanged(int)),
+        this,
+        SLOT(onRolloverValueChanged(void)));
+
+  connect(
+        this->ui->retainSpin,
+        SIGNAL(valueChanged(int)),
+        this,
+        SLOT(onRetentionChanged(void)));
+
+  connect(
+        this->ui->historySpin,
+        SIGNAL(valueChanged(int)),
+        this,
+        SLOT(onHistoryLengthChanged(void)));
+
+  connect(
+        this->ui->bufferSpin,
+        SIGNAL(valueChanged(int)),
+        this,
+        SLOT(onBufferBudgetChanged(void)));
+
+  connect(
+        this->ui->overloadCombo,
+        SIGNAL(activated(int)),
+        this,
+        SLOT(onOverloadChanged(void)));
+
+  connect(
+        this->ui->channelsEdit,
+        SIGNAL(textChanged(QString)),
+        this,
+        SLOT(onChannelsChanged(void)));
+
+  connect(
+        this->ui->channelWidthSpin,
+        SIGNAL(valueChanged(double)),
+        this,
+        SLOT(onChannelsChanged(void)));
+}
+
+// The spin box shows either the size or the time limit
+void
+DataSaverUI::refreshRolloverUi(void)
+{
+  bool recording = this->ui->recordStartStopButton->isChecked();
+  bool rotating = this->getRollover() != ROLLOVER_NEVER;
+
+  this->ui->rolloverSpin->blockSignals(true);
+  switch (this->getRollover()) {
+    case ROLLOVER_SIZE:
+      this->ui->rolloverSpin->setSuffix(" MiB");
+      this->ui->rolloverSpin->setValue(
+            static_cast<int>(this->rolloverSize));
+      break;
+
+    case ROLLOVER_TIME:
+      this->ui->rolloverSpin->setSuffix(" s");
+      this->ui->rolloverSpin->setValue(
+            static_cast<int>(this->rolloverTime));
+      break;
+
+    default:
+      this->ui->rolloverSpin->setSuffix("");
+  }
+  this->ui->rolloverSpin->blockSignals(false);
+
+  this->ui->rolloverCombo->setEnabled(!recording);
+  this->ui->rolloverSpin->setEnabled(!recording && rotating);
+  this->ui->retainSpin->setEnabled(!recording && rotating);
+}
+
+void
+DataSaverUI::refreshChannelsUi(void)
+{
+  std::vector<qreal> freqs;
+  bool recording = this->ui->recordStartStopButton->isChecked();
+
+  if (this->getChannelPlan().empty())
+    this->ui->channelCountLabel->setText("Off");
+  else if (!parseChannelPlan(
+             this->getChannelPlan(),
+             this->getChannelSpacing(),
+             freqs))
+    this->ui->channelCountLabel->setText("Invalid");
+  else
+    this->ui->channelCountLabel->setText(
+        QString::number(freqs.size()) + " ch");
+
+  this->ui->channelsEdit->setEnabled(!recording);
+  this->ui->channelWidthSpin->setEnabled(!recording);
 }
 
 // Setters
@@ -86,7 +336,14 @@ DataSaverUI::setCaptureSize(quint64 size)
 {
   this->ui->captureSizeLabel->setText(
         SuWidgetsHelpers::formatBinaryQuantity(
-          static_cast<qint64>(size * sizeof(SUFLOAT))));
+          static_cast<qint64>(
+            size * SampleConverter::sampleSize(this->getFormat()))));
+}
+
+void
+DataSaverUI::setClipCount(quint64 count)
+{
+  this->ui->clippedLabel->setText(QString::number(count));
 }
 
 void
@@ -114,9 +371,164 @@ DataSaverUI::setRecordState(bool state)
   this->ui->recordStartStopButton->setChecked(state);
 
   this->ui->recordStartStopButton->setText(state ? "Stop" : "Record");
-
-  if (!state)
+  this->ui->backendCombo->setEnabled(!state);
+  this->ui->formatCombo->setEnabled(!state);
+  this->ui->bufferSpin->setEnabled(!state);
+  this->ui->overloadCombo->setEnabled(!state);
+  this->ui->fullScaleSpin->setEnabled(
+        !state && this->getFormat() != SAMPLE_FORMAT_CF32);
+  this->refreshRolloverUi();
+  this->refreshChannelsUi();
+
+  if (!state) {
     this->ui->ioBwProgress->setValue(0);
+    this->ui->headroomLabel->setText("N/A");
+  }
+}
+
+void
+DataSaverUI::setBackend(FileDataSaver::Backend backend)
+{
+  this->ui->backendCombo->setCurrentIndex(
+        backend == FileDataSaver::DIRECT_IO ? 1 : 0);
+}
+
+void
+DataSaverUI::setFormat(SampleFormat format)
+{
+  this->ui->formatCombo->setCurrentIndex(static_cast<int>(format));
+  this->ui->fullScaleSpin->setEnabled(
+        format != SAMPLE_FORMAT_CF32
+        && !this->ui->recordStartStopButton->isChecked());
+}
+
+void
+DataSaverUI::setFullScale(SUFLOAT fullScale)
+{
+  this->ui->fullScaleSpin->setValue(static_cast<double>(fullScale));
+}
+
+void
+DataSaverUI::setRollover(Rollover rollover)
+{
+  this->ui->rolloverCombo->setCurrentIndex(static_cast<int>(rollover));
+  this->refreshRolloverUi();
+}
+
+void
+DataSaverUI::setRolloverSize(unsigned int size)
+{
+  this->rolloverSize = size;
+  this->refreshRolloverUi();
+}
+
+void
+DataSaverUI::setRolloverTime(unsigned int time)
+{
+  this->rolloverTime = time;
+  this->refreshRolloverUi();
+}
+
+void
+DataSaverUI::setRetention(unsigned int retain)
+{
+  this->ui->retainSpin->setValue(static_cast<int>(retain));
+}
+
+void
+DataSaverUI::setRolloverAvailable(bool available)
+{
+  if (!available)
+    this->setRollover(ROLLOVER_NEVER);
+
+  this->ui->label_rollover->setVisible(available);
+  this->ui->rolloverCombo->setVisible(available);
+  this->ui->rolloverSpin->setVisible(available);
+  this->ui->label_retain->setVisible(available);
+  this->ui->retainSpin->setVisible(available);
+}
+
+void
+DataSaverUI::setHistoryLength(unsigned int length)
+{
+  this->ui->historySpin->setValue(static_cast<int>(length));
+}
+
+// Memory actually taken by the pre-trigger buffer. Zero if none.
+void
+DataSaverUI::setHistoryMemory(quint64 bytes)
+{
+  this->ui->historySizeLabel->setText(
+        bytes == 0
+        ? QString("Off")
+        : SuWidgetsHelpers::formatBinaryQuantity(static_cast<qint64>(bytes)));
+}
+
+void
+DataSaverUI::setHistoryAvailable(bool available)
+{
+  if (!available)
+    this->setHistoryLength(0);
+
+  this->ui->label_history->setVisible(available);
+  this->ui->historySpin->setVisible(available);
+  this->ui->historySizeLabel->setVisible(available);
+}
+
+// In MiB
+void
+DataSaverUI::setBufferBudget(unsigned int budget)
+{
+  this->ui->bufferSpin->setValue(static_cast<int>(budget));
+}
+
+void
+DataSaverUI::setHeadroom(qreal seconds, quint64 memory)
+{
+  this->ui->headroomLabel->setText(
+        QString::number(seconds, 'f', 1)
+        + " s ("
+        + SuWidgetsHelpers::formatBinaryQuantity(static_cast<qint64>(memory))
+        + ")");
+}
+
+void
+DataSaverUI::setOverloadPolicy(GenericDataSaver::OverloadPolicy policy)
+{
+  this->ui->overloadCombo->setCurrentIndex(static_cast<int>(policy));
+}
+
+void
+DataSaverUI::setChannelPlan(std::string const &plan)
+{
+  // The two halves of the plan are stored together, see onChannelsChanged
+  this->ui->channelsEdit->blockSignals(true);
+  this->ui->channelsEdit->setText(QString::fromStdString(plan));
+  this->ui->channelsEdit->blockSignals(false);
+  this->refreshChannelsUi();
+}
+
+// In Hz
+void
+DataSaverUI::setChannelSpacing(qreal spacing)
+{
+  this->ui->channelWidthSpin->blockSignals(true);
+  this->ui->channelWidthSpin->setValue(spacing * 1e-3);
+  this->ui->channelWidthSpin->blockSignals(false);
+  this->refreshChannelsUi();
+}
+
+void
+DataSaverUI::setChannelsAvailable(bool available)
+{
+  if (!available)
+    this->setChannelPlan("");
+
+  this->ui->label_channels->setVisible(available);
+  this->ui->channelsEdit->setVisible(available);
+  this->ui->label_channelWidth->setVisible(available);
+  this->ui->channelWidthSpin->setVisible(available);
+  this->ui->channelCountLabel->setVisible(available);
 }
 
 // Getters
@@ -132,6 +544,95 @@ DataSaverUI::getRecordSavePath(void) const
   return this->ui->savePath->text().toStdString();
 }
 
+FileDataSaver::Backend
+DataSaverUI::getBackend(void) const
+{
+  return this->ui->backendCombo->currentIndex() == 1
+      ? FileDataSaver::DIRECT_IO
+      : FileDataSaver::BUFFERED;
+}
+
+SampleFormat
+DataSaverUI::getFormat(void) const
+{
+  return static_cast<SampleFormat>(this->ui->formatCombo->currentIndex());
+}
+
+SUFLOAT
+DataSaverUI::getFullScale(void) const
+{
+  return static_cast<SUFLOAT>(this->ui->fullScaleSpin->value());
+}
+
+DataSaverUI::Rollover
+DataSaverUI::getRollover(void) const
+{
+  return static_cast<Rollover>(this->ui->rolloverCombo->currentIndex());
+}
+
+// In MiB
+unsigned int
+DataSaverUI::getRolloverSize(void) const
+{
+  return this->rolloverSize;
+}
+
+// In seconds
+unsigned int
+DataSaverUI::getRolloverTime(void) const
+{
+  return this->rolloverTime;
+}
+
+unsigned int
+DataSaverUI::getRetention(void) const
+{
+  return static_cast<unsigned int>(this->ui->retainSpin->value());
+}
+
+// In seconds
+unsigned int
+DataSaverUI::getHistoryLength(void) const
+{
+  return static_cast<unsigned int>(this->ui->historySpin->value());
+}
+
+// In bytes
+quint64
+DataSaverUI::getMemoryBudget(void) const
+{
+  return static_cast<quint64>(this->ui->bufferSpin->value()) << 20;
+}
+
+GenericDataSaver::OverloadPolicy
+DataSaverUI::getOverloadPolicy(void) const
+{
+  return static_cast<GenericDataSaver::OverloadPolicy>(
+        this->ui->overloadCombo->currentIndex());
+}
+
+std::string
+DataSaverUI::getChannelPlan(void) const
+{
+  return this->ui->channelsEdit->text().trimmed().toStdString();
+}
+
+// In Hz
+qreal
+DataSaverUI::getChannelSpacing(void) const
+{
+  return this->ui->channelWidthSpin->value() * 1e3;
+}
+
+// Absolute frequencies in Hz. An empty plan means the full baseband.
+bool
+DataSaverUI::getChannels(std::vector<qreal> &freqs) const
+{
+  return parseChannelPlan(
+        this->getChannelPlan(),
+        this->getChannelSpacing(),
+        freqs);
+}
 
 DataSaverUI::DataSaverUI(QWidget *parent) :
   GenericDataSaverUI(parent),
@@ -140,6 +641,8 @@ DataSaverUI::DataSaverUI(QWidget *parent) :
   ui->setupUi(this);
 
   this->setRecordSavePath(QDir::currentPath().toStdString());
+  this->refreshRolloverUi();
+  this->refreshChannelsUi();
 
   this->connectAll();
 }
@@ -162,6 +665,22 @@ DataSaverUI::applyConfig(void)
 {
   if (this->config->path.size() > 0)
     this->setRecordSavePath(this->config->path);
+
+  this->setBackend(
+        this->config->directIO
+        ? FileDataSaver::DIRECT_IO
+        : FileDataSaver::BUFFERED);
+  this->setFormat(SampleConverter::formatFromName(this->config->format));
+  this->setFullScale(this->config->fullScale);
+  this->setRolloverSize(this->config->rolloverSize);
+  this->setRolloverTime(this->config->rolloverTime);
+  this->setRetention(this->config->retain);
+  this->setHistoryLength(this->config->historyLength);
+  this->setBufferBudget(this->config->bufferBudget);
+  this->setOverloadPolicy(strToOverload(this->config->overload));
+  this->setChannelSpacing(this->config->channelSpacing);
+  this->setChannelPlan(this->config->channels);
+  this->setRollover(strToRollover(this->config->rollover));
 }
 
 ///////////////////////////////// Slots ////////////////////////////////////////
@@ -186,10 +705,96 @@ DataSaverUI::onChangeSavePath(void)
 void
 DataSaverUI::onRecordStartStop(void)
 {
-  this->ui->recordStartStopButton->setText(
-        this->ui->recordStartStopButton->isChecked()
-        ? "Stop"
-        : "Record");
+  this->setRecordState(this->ui->recordStartStopButton->isChecked());
 
   emit recordStateChanged(this->ui->recordStartStopButton->isChecked());
 }
+
+void
+DataSaverUI::onBackendChanged(void)
+{
+  if (this->config != nullptr)
+    this->config->directIO = this->getBackend() == FileDataSaver::DIRECT_IO;
+}
+
+void
+DataSaverUI::onFormatChanged(void)
+{
+  this->setFormat(this->getFormat());
+
+  if (this->config != nullptr)
+    this->config->format = SampleConverter::formatName(this->getFormat());
+}
+
+void
+DataSaverUI::onFullScaleChanged(void)
+{
+  if (this->config != nullptr)
+    this->config->fullScale = this->getFullScale();
+}
+
+void
+DataSaverUI::onRolloverChanged(void)
+{
+  this->refreshRolloverUi();
+
+  if (this->config != nullptr)
+    this->config->rollover = rolloverToStr(this->getRollover());
+}
+
+void
+DataSaverUI::onRolloverValueChanged(void)
+{
+  unsigned int value =
+      static_cast<unsigned int>(this->ui->rolloverSpin->value());
+
+  if (this->getRollover() == ROLLOVER_SIZE)
+    this->rolloverSize = value;
+  else if (this->getRollover() == ROLLOVER_TIME)
+    this->rolloverTime = value;
+
+  if (this->config != nullptr) {
+    this->config->rolloverSize = this->rolloverSize;
+    this->config->rolloverTime = this->rolloverTime;
+  }
+}
+
+void
+DataSaverUI::onRetentionChanged(void)
+{
+  if (this->config != nullptr)
+    this->config->retain = this->getRetention();
+}
+
+void
+DataSaverUI::onHistoryLengthChanged(void)
+{
+  if (this->config != nullptr)
+    this->config->historyLength = this->getHistoryLength();
+}
+
+void
+DataSaverUI::onBufferBudgetChanged(void)
+{
+  if (this->config != nullptr)
+    this->config->bufferBudget =
+        static_cast<unsigned int>(this->ui->bufferSpin->value());
+}
+
+void
+DataSaverUI::onOverloadChanged(void)
+{
+  if (this->config != nullptr)
+    this->config->overload = overloadToStr(this->getOverloadPolicy());
+}
+
+void
+DataSaverUI::onChannelsChanged(void)
+{
+  this->refreshChannelsUi();
+
+  if (this->config != nullptr) {
+    this->config->channels = this->getChannelPlan();
+    this->config->channelSpacing = this->getChannelSpacing();
+  }
+}
@@ -20,6 +20,7 @@
 #include "FftPanel.h"
 #include "ui_FftPanel.h"
 #include "SigDiggerHelpers.h"
+#include <cmath>
 
 using namespace SigDigger;
 
@@ -35,6 +36,14 @@ FftPanelConfig::deserialize(Suscan::Object const &conf)
   LOAD(panWfRatio);
   LOAD(peakDetect);
   LOAD(peakHold);
+  LOAD(maxHoldTrace);
+  LOAD(minHoldTrace);
+  LOAD(meanTrace);
+  LOAD(floorTrace);
+  LOAD(meanWindow);
+  LOAD(floorPercentile);
+  LOAD(detector);
+  LOAD(displayRate);
   LOAD(panRangeMin);
   LOAD(panRangeMax);
   LOAD(wfRangeMin);
@@ -56,6 +65,14 @@ FftPanelConfig::serialize(void)
   STORE(panWfRatio);
   STORE(peakDetect);
   STORE(peakHold);
+  STORE(maxHoldTrace);
+  STORE(minHoldTrace);
+  STORE(meanTrace);
+  STORE(floorTrace);
+  STORE(meanWindow);
+  STORE(floorPercentile);
+  STORE(detector);
+  STORE(displayRate);
   STORE(panRangeMin);
   STORE(panRangeMax);
   STORE(wfRangeMin);
@@ -90,6 +107,14 @@ FftPanel::applyConfig(void)
   this->setFreqZoom(savedConfig.zoom);
   this->setPeakHold(savedConfig.peakHold);
   this->setPeakDetect(savedConfig.peakDetect);
+  this->setMaxHoldTrace(savedConfig.maxHoldTrace);
+  this->setMinHoldTrace(savedConfig.minHoldTrace);
+  this->setMeanTrace(savedConfig.meanTrace);
+  this->setFloorTrace(savedConfig.floorTrace);
+  this->setMeanWindow(savedConfig.meanWindow);
+  this->setFloorPercentile(savedConfig.floorPercentile);
+  this->setDetector(static_cast<PSDDetector>(savedConfig.detector));
+  this->setDisplayRate(savedConfig.displayRate);
   this->setRangeLock(savedConfig.rangeLock);
   this->setTimeSpan(savedConfig.timeSpan);
 }
@@ -146,6 +171,12 @@ FftPanel::connectAll(void)
         this,
         SLOT(onRefreshRateChanged(void)));
 
+  connect(
+        this->ui->displayRateCombo,
+        SIGNAL(activated(int)),
+        this,
+        SLOT(onDisplayRateChanged(void)));
+
   connect(
         this->ui->timeSpanCombo,
         SIGNAL(activated(int)),
@@ -175,6 +206,54 @@ FftPanel::connectAll(void)
         SIGNAL(activated(int)),
         this,
         SLOT(onWindowFunctionChanged(void)));
+
+  connect(
+        this->ui->maxHoldButton,
+        SIGNAL(clicked(bool)),
+        this,
+        SLOT(onTracesChanged(void)));
+
+  connect(
+        this->ui->minHoldButton,
+        SIGNAL(clicked(bool)),
+        this,
+        SLOT(onTracesChanged(void)));
+
+  connect(
+        this->ui->meanButton,
+        SIGNAL(clicked(bool)),
+        this,
+        SLOT(onTracesChanged(void)));
+
+  connect(
+        this->ui->floorButton,
+        SIGNAL(clicked(bool)),
+        this,
+        SLOT(onTracesChanged(void)));
+
+  connect(
+        this->ui->meanWindowSpin,
+        SIGNAL(valueChanged(int)),
+        this,
+        SLOT(onTracesChanged(void)));
+
+  connect(
+        this->ui->floorPercentileSpin,
+        SIGNAL(valueChanged(int)),
+        this,
+        SLOT(onTracesChanged(void)));
+
+  connect(
+        this->ui->detectorCombo,
+        SIGNAL(activated(int)),
+        this,
+        SLOT(onDetectorChanged(void)));
+
+  connect(
+        this->ui->resetTracesButton,
+        SIGNAL(clicked(bool)),
+        this,
+        SLOT(onResetTraces(void)));
 }
 
 FftPanel::FftPanel(QWidget *parent) :
@@ -201,6 +280,16 @@ FftPanel::FftPanel(QWidget *parent) :
   this->addRefreshRate(30);
   this->addRefreshRate(50);
   this->addRefreshRate(60);
+  this->addRefreshRate(100);
+  this->addRefreshRate(200);
+
+  // Drawing is capped apart from the FFT rate
+  this->addDisplayRate(0);
+  this->addDisplayRate(10);
+  this->addDisplayRate(25);
+  this->addDisplayRate(30);
+  this->addDisplayRate(60);
+  this->addDisplayRate(120);
 
   // Add Gqrx time spans
   this->addTimeSpan(0);
@@ -250,6 +339,14 @@ FftPanel::updateFftSizes(void)
   }
 }
 
+void
+FftPanel::addDisplayRate(unsigned int rate)
+{
+  this->displayRates.push_back(rate);
+  this->ui->displayRateCombo->addItem(
+        rate == 0 ? QString("Screen") : QString::number(rate) + " fps");
+}
+
 void
 FftPanel::updateRefreshRates(void)
 {
@@ -427,6 +524,12 @@ FftPanel::getRefreshRate(void) const
   return this->refreshRate;
 }
 
+unsigned int
+FftPanel::getDisplayRate(void) const
+{
+  return this->panelConfig->displayRate;
+}
+
 bool
 FftPanel::getPeakDetect(void) const
 {
@@ -445,6 +548,48 @@ FftPanel::getRangeLock(void) const
   return this->ui->lockButton->isChecked();
 }
 
+bool
+FftPanel::getMaxHoldTrace(void) const
+{
+  return this->ui->maxHoldButton->isChecked();
+}
+
+bool
+FftPanel::getMinHoldTrace(void) const
+{
+  return this->ui->minHoldButton->isChecked();
+}
+
+bool
+FftPanel::getMeanTrace(void) const
+{
+  return this->ui->meanButton->isChecked();
+}
+
+bool
+FftPanel::getFloorTrace(void) const
+{
+  return this->ui->floorButton->isChecked();
+}
+
+unsigned int
+FftPanel::getMeanWindow(void) const
+{
+  return static_cast<unsigned int>(this->ui->meanWindowSpin->value());
+}
+
+float
+FftPanel::getFloorPercentile(void) const
+{
+  return this->ui->floorPercentileSpin->value() / 100.f;
+}
+
+PSDDetector
+FftPanel::getDetector(void) const
+{
+  return static_cast<PSDDetector>(this->ui->detectorCombo->currentIndex());
+}
+
 enum Suscan::AnalyzerParams::WindowFunction
 FftPanel::getWindowFunction(void) const
 {
@@ -550,6 +695,33 @@ FftPanel::setRefreshRate(unsigned int rate)
   this->updateRefreshRates();
 }
 
+void
+FftPanel::setDisplayRate(unsigned int rate)
+{
+  unsigned int i;
+
+  for (i = 0; i < this->displayRates.size(); ++i)
+    if (this->displayRates[i] == rate) {
+      this->ui->displayRateCombo->setCurrentIndex(static_cast<int>(i));
+      this->panelConfig->displayRate = rate;
+      return;
+    }
+
+  this->ui->displayRateCombo->setCurrentIndex(0);
+  this->panelConfig->displayRate = this->displayRates[0];
+}
+
+void
+FftPanel::setDisplayStats(qreal fps, qreal skipped)
+{
+  this->ui->fpsLabel->setText(
+        "Drawn: "
+        + QString::number(fps, 'f', 1)
+        + " fps, skipped "
+        + QString::number(skipped, 'f', 0)
+        + "/s");
+}
+
 void
 FftPanel::setTimeSpan(unsigned int span)
 {
@@ -590,6 +762,59 @@ FftPanel::setRangeLock(bool lock)
   this->panelConfig->rangeLock = lock;
 }
 
+void
+FftPanel::setMaxHoldTrace(bool enabled)
+{
+  this->ui->maxHoldButton->setChecked(enabled);
+  this->panelConfig->maxHoldTrace = enabled;
+}
+
+void
+FftPanel::setMinHoldTrace(bool enabled)
+{
+  this->ui->minHoldButton->setChecked(enabled);
+  this->panelConfig->minHoldTrace = enabled;
+}
+
+void
+FftPanel::setMeanTrace(bool enabled)
+{
+  this->ui->meanButton->setChecked(enabled);
+  this->panelConfig->meanTrace = enabled;
+}
+
+void
+FftPanel::setFloorTrace(bool enabled)
+{
+  this->ui->floorButton->setChecked(enabled);
+  this->panelConfig->floorTrace = enabled;
+}
+
+void
+FftPanel::setMeanWindow(unsigned int frames)
+{
+  this->ui->meanWindowSpin->setValue(static_cast<int>(frames));
+  this->panelConfig->meanWindow = frames;
+}
+
+void
+FftPanel::setFloorPercentile(float percentile)
+{
+  this->ui->floorPercentileSpin->setValue(
+        static_cast<int>(std::round(percentile * 100.f)));
+  this->panelConfig->floorPercentile = percentile;
+}
+
+void
+FftPanel::setDetector(PSDDetector detector)
+{
+  if (detector < 0 || detector >= PSD_DETECTOR_COUNT)
+    detector = PSD_DETECTOR_PEAK;
+
+  this->ui->detectorCombo->setCurrentIndex(static_cast<int>(detector));
+  this->panelConfig->detector = detector;
+}
+
 void
 FftPanel::setWindowFunction(enum Suscan::AnalyzerParams::WindowFunction func)
 {
@@ -671,6 +896,16 @@ FftPanel::onFftSizeChanged(void)
   emit fftSizeChanged();
 }
 
+void
+FftPanel::onDisplayRateChanged(void)
+{
+  this->setDisplayRate(
+        this->displayRates[
+          static_cast<unsigned>(this->ui->displayRateCombo->currentIndex())]);
+
+  emit displayRateChanged();
+}
+
 void
 FftPanel::onRefreshRateChanged(void)
 {
@@ -714,3 +949,30 @@ FftPanel::onWindowFunctionChanged(void)
 {
   emit windowFunctionChanged();
 }
+
+void
+FftPanel::onTracesChanged(void)
+{
+  this->setMaxHoldTrace(this->getMaxHoldTrace());
+  this->setMinHoldTrace(this->getMinHoldTrace());
+  this->setMeanTrace(this->getMeanTrace());
+  this->setFloorTrace(this->getFloorTrace());
+  this->setMeanWindow(this->getMeanWindow());
+  this->setFloorPercentile(this->getFloorPercentile());
+
+  emit averagerChanged();
+}
+
+void
+FftPanel::onResetTraces(void)
+{
+  emit tracesReset();
+}
+
+void
+FftPanel::onDetectorChanged(void)
+{
+  this->setDetector(this->getDetector());
+
+  emit averagerChanged();
+}
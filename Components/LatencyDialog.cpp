@@ -0,0 +1,180 @@
+//
+//    LatencyDialog.cpp: Pipeline latency statistics
+//    Copyright (C) 2020 Gonzalo José Carracedo Carballal
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as
+//    published by the Free Software Foundation, either version 3 of the
+//    License, or (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful, but
+//    WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public
+//    License along with this program.  If not, see
+//    <http://www.gnu.org/licenses/>
+//
+#include <LatencyDialog.h>
+#include <LatencyMonitor.h>
+#include <QFileDialog>
+#include <QMessageBox>
+#include <cerrno>
+#include <cstring>
+#include "ui_LatencyDialog.h"
+
+using namespace SigDigger;
+
+LatencyDialog::LatencyDialog(QWidget *parent) :
+  QDialog(parent),
+  ui(new Ui::LatencyDialog)
+{
+  ui->setupUi(this);
+
+  this->ui->latencyTable->setRowCount(LATENCY_STAGE_COUNT);
+  this->timer.setInterval(SIGDIGGER_LATENCY_DIALOG_REFRESH_MS);
+
+  this->connectAll();
+}
+
+LatencyDialog::~LatencyDialog()
+{
+  delete ui;
+}
+
+void
+LatencyDialog::connectAll(void)
+{
+  connect(
+        &this->timer,
+        SIGNAL(timeout(void)),
+        this,
+        SLOT(onTimeout(void)));
+
+  connect(
+        this->ui->resetButton,
+        SIGNAL(clicked(bool)),
+        this,
+        SLOT(onReset(void)));
+
+  connect(
+        this->ui->saveButton,
+        SIGNAL(clicked(bool)),
+        this,
+        SLOT(onSave(void)));
+
+  connect(
+        this->ui->closeButton,
+        SIGNAL(clicked(bool)),
+        this,
+        SLOT(accept(void)));
+}
+
+static QString
+formatUsec(qreal usec)
+{
+  if (usec < 1e3)
+    return QString::number(usec, 'f', 0) + " µs";
+  else if (usec < 1e6)
+    return QString::number(usec * 1e-3, 'f', 2) + " ms";
+
+  return QString::number(usec * 1e-6, 'f', 2) + " s";
+}
+
+void
+LatencyDialog::setDroppedPSD(quint64 count)
+{
+  this->droppedPSD = count;
+}
+
+void
+LatencyDialog::refresh(void)
+{
+  LatencyMonitor *monitor = LatencyMonitor::instance();
+  int i;
+
+  for (i = 0; i < LATENCY_STAGE_COUNT; ++i) {
+    LatencyStage stage = static_cast<LatencyStage>(i);
+    LatencyStats stats = monitor->getStats(stage);
+    QStringList cells;
+    int j;
+
+    cells << LatencyMonitor::stageName(stage) << QString::number(stats.count);
+
+    if (stats.count > 0)
+      cells
+          << formatUsec(stats.mean)
+          << formatUsec(stats.p50)
+          << formatUsec(stats.p90)
+          << formatUsec(stats.p99)
+          << formatUsec(stats.max);
+    else
+      for (j = 0; j < 5; ++j)
+        cells << "-";
+
+    for (j = 0; j < cells.size(); ++j) {
+      QTableWidgetItem *item = this->ui->latencyTable->item(i, j);
+
+      if (item == nullptr) {
+        item = new QTableWidgetItem();
+        if (j > 0)
+          item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+        this->ui->latencyTable->setItem(i, j, item);
+      }
+
+      item->setText(cells[j]);
+    }
+  }
+
+  this->ui->droppedLabel->setText(QString::number(this->droppedPSD));
+}
+
+void
+LatencyDialog::showEvent(QShowEvent *)
+{
+  this->refresh();
+  this->ui->latencyTable->resizeColumnsToContents();
+  this->timer.start();
+}
+
+void
+LatencyDialog::hideEvent(QHideEvent *)
+{
+  this->timer.stop();
+}
+
+////////////////////////////////// Slots //////////////////////////////////////
+void
+LatencyDialog::onTimeout(void)
+{
+  this->refresh();
+}
+
+void
+LatencyDialog::onReset(void)
+{
+  LatencyMonitor::instance()->reset();
+  this->refresh();
+}
+
+void
+LatencyDialog::onSave(void)
+{
+  QString path = QFileDialog::getSaveFileName(
+        this,
+        "Save latency histograms",
+        "sigdigger-latency.csv",
+        "CSV files (*.csv);;All files (*)");
+
+  if (path.isEmpty())
+    return;
+
+  if (!LatencyMonitor::instance()->dump(path.toStdString()))
+    QMessageBox::warning(
+          this,
+          "Save latency histograms",
+          "Cannot write histograms to " + path + ": "
+          + QString(strerror(errno)),
+          QMessageBox::Ok);
+}
@@ -28,6 +28,7 @@ MainSpectrum::MainSpectrum(QWidget *parent) :
   ui(new Ui::MainSpectrum)
 {
   ui->setupUi(this);
+  this->overlay = new SpectrumOverlay(this->ui->mainSpectrum);
   this->connectAll();
   this->setCenterFreq(0);
   this->setShowFATs(true);
@@ -91,6 +92,12 @@ MainSpectrum::connectAll(void)
         SIGNAL(newZoomLevel(float)),
         this,
         SLOT(onNewZoomLevel(float)));
+
+  connect(
+        this->overlay,
+        SIGNAL(channelClicked(quint32)),
+        this,
+        SLOT(onChannelClicked(quint32)));
 }
 
 void
@@ -99,6 +106,65 @@ MainSpectrum::feed(float *data, int size)
   this->ui->mainSpectrum->setNewFftData(data, size);
 }
 
+// Bins are centered around the center frequency, the pandapter shows
+// span Hz around center + FFT center
+void
+MainSpectrum::feedTrace(AveragerTrace trace, const float *data, int size)
+{
+  qreal span, offset, binsPerHz;
+  int width = this->overlay->width();
+
+  if (data == nullptr || size == 0 || this->cachedRate == 0 || width == 0) {
+    this->overlay->clearTrace(trace);
+    return;
+  }
+
+  span   = static_cast<qreal>(this->ui->mainSpectrum->getSpanFreq());
+  offset = static_cast<qreal>(this->ui->mainSpectrum->getFftCenterFreq());
+  binsPerHz = size / static_cast<qreal>(this->cachedRate);
+
+  this->overlay->setTrace(
+        trace,
+        data,
+        size,
+        (offset - .5 * span + .5 * this->cachedRate) * binsPerHz,
+        span * binsPerHz / width);
+}
+
+// Same mapping as feedTrace, in Hz
+void
+MainSpectrum::setDetectedChannels(
+    std::vector<DetectedChannel> const &channels,
+    qreal frequency)
+{
+  qreal span, left, pixelsPerHz, offset;
+  int width = this->overlay->width();
+  ChannelMarker marker;
+
+  this->markers.clear();
+
+  span = static_cast<qreal>(this->ui->mainSpectrum->getSpanFreq());
+
+  if (span > 0 && width > 0) {
+    left = static_cast<qreal>(this->ui->mainSpectrum->getFftCenterFreq())
+        - .5 * span;
+    pixelsPerHz = width / span;
+
+    for (auto &ch : channels) {
+      offset = ch.frequency - frequency - left;
+      marker.id = ch.id;
+      marker.left = (offset - .5 * ch.bandwidth) * pixelsPerHz;
+      marker.right = (offset + .5 * ch.bandwidth) * pixelsPerHz;
+      marker.snr = ch.snr;
+      marker.present = ch.present;
+
+      if (marker.right >= 0 && marker.left < width)
+        this->markers.push_back(marker);
+    }
+  }
+
+  this->overlay->setChannels(this->markers);
+}
 
 void
 MainSpectrum::updateLimits(void)
@@ -236,6 +302,7 @@ void
 MainSpectrum::setPandapterRange(float min, float max)
 {
   this->ui->mainSpectrum->setPandapterRange(min, max);
+  this->overlay->setPandapterRange(min, max);
 }
 
 void
@@ -248,6 +315,7 @@ void
 MainSpectrum::setPanWfRatio(float ratio)
 {
   this->ui->mainSpectrum->setPercent2DScreen(static_cast<int>(ratio * 100));
+  this->overlay->setPercent2DScreen(static_cast<int>(ratio * 100));
 }
 
 void
@@ -490,6 +558,21 @@ MainSpectrum::getBandwidth(void) const
   return this->bandwidth;
 }
 
+// Bins over the whole band that cover the visible span with a few of them
+// per pixel. 0 if unknown, which means full resolution.
+size_t
+MainSpectrum::getDisplayBins(void) const
+{
+  qreal span = static_cast<qreal>(this->ui->mainSpectrum->getSpanFreq());
+  int width = this->ui->mainSpectrum->width();
+
+  if (span <= 0 || width <= 0 || this->cachedRate == 0)
+    return 0;
+
+  return static_cast<size_t>(
+        SIGDIGGER_MAIN_SPECTRUM_OVERSAMPLING * width * this->cachedRate / span);
+}
+
 //////////////////////////////// Slots /////////////////////////////////////////
 void
 MainSpectrum::onWfBandwidthChanged(int min, int max)
@@ -541,6 +624,7 @@ MainSpectrum::onLoChanged(void)
 void
 MainSpectrum::onRangeChanged(float min, float max)
 {
+  this->overlay->setPandapterRange(min, max);
   emit rangeChanged(min, max);
 }
 
@@ -549,3 +633,9 @@ MainSpectrum::onNewZoomLevel(float level)
 {
   emit zoomChanged(level);
 }
+
+void
+MainSpectrum::onChannelClicked(quint32 id)
+{
+  emit detectedChannelClicked(id);
+}
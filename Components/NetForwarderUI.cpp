@@ -30,6 +30,12 @@ NetForwarderUI::connectAll(void)
         SIGNAL(clicked(bool)),
         this,
         SLOT(onForwardStartStop(void)));
+
+  connect(
+        this->ui->formatCombo,
+        SIGNAL(activated(int)),
+        this,
+        SLOT(onFormatChanged(void)));
 }
 
 NetForwarderUI::NetForwarderUI(QWidget *parent) :
@@ -92,11 +98,18 @@ NetForwarderUI::setForwardState(bool state)
 
   this->ui->hostEdit->setEnabled(!state);
   this->ui->portSpin->setEnabled(!state);
+  this->ui->socketTypeCombo->setEnabled(!state);
   this->ui->frameLen->setEnabled(!state);
+  this->ui->framingCheck->setEnabled(!state);
+  this->ui->formatCombo->setEnabled(!state);
+  this->ui->fullScaleSpin->setEnabled(
+        !state && this->getFormat() != SAMPLE_FORMAT_CF32);
+  this->ui->outputRateSpin->setEnabled(!state);
 
   this->ui->udpStartStopButton->setText(state ? "Stop" : "Forward");
 
   if (!state) {
+    this->setClientCount(-1);
     this->ui->ioBwProgress->setValue(0);
     this->setPreparing(false);
   }
@@ -124,17 +137,64 @@ formatCaptureSize(quint64 size)
   return QString::number(size >> 30) + " GiB";
 }
 
+void
+NetForwarderUI::refreshCaptureSize(void)
+{
+  QString text = formatCaptureSize(this->captureSize * sizeof(float _Complex));
+
+  if (this->clients == 1)
+    text += ", 1 client";
+  else if (this->clients >= 0)
+    text += ", " + QString::number(this->clients) + " clients";
+
+  this->ui->txLenLabel->setText(text);
+}
+
 void
 NetForwarderUI::setCaptureSize(quint64 size)
 {
-  this->ui->txLenLabel->setText(
-        formatCaptureSize(size * sizeof(float _Complex)));
+  this->captureSize = size;
+  this->refreshCaptureSize();
 }
 
 void
-NetForwarderUI::setTcp(bool tcp)
+NetForwarderUI::setClientCount(int clients)
 {
-  this->ui->socketTypeCombo->setCurrentIndex(tcp ? 1 : 0);
+  this->clients = clients;
+  this->refreshCaptureSize();
+}
+
+// Combo entries follow SocketForwarder::Mode
+void
+NetForwarderUI::setMode(SocketForwarder::Mode mode)
+{
+  this->ui->socketTypeCombo->setCurrentIndex(static_cast<int>(mode));
+}
+
+void
+NetForwarderUI::setFraming(bool framing)
+{
+  this->ui->framingCheck->setChecked(framing);
+}
+
+// Combo entries follow SampleFormat
+void
+NetForwarderUI::setFormat(SampleFormat format)
+{
+  this->ui->formatCombo->setCurrentIndex(static_cast<int>(format));
+  this->onFormatChanged();
+}
+
+void
+NetForwarderUI::setFullScale(SUFLOAT fullScale)
+{
+  this->ui->fullScaleSpin->setValue(static_cast<qreal>(fullScale));
+}
+
+void
+NetForwarderUI::setOutputRate(qreal rate)
+{
+  this->ui->outputRateSpin->setValue(rate);
 }
 
 std::string
@@ -161,10 +221,35 @@ NetForwarderUI::getForwardState(void) const
   return this->ui->udpStartStopButton->isChecked();
 }
 
+SocketForwarder::Mode
+NetForwarderUI::getMode(void) const
+{
+  return static_cast<SocketForwarder::Mode>(
+        this->ui->socketTypeCombo->currentIndex());
+}
+
 bool
-NetForwarderUI::getTcp(void) const
+NetForwarderUI::getFraming(void) const
+{
+  return this->ui->framingCheck->isChecked();
+}
+
+SampleFormat
+NetForwarderUI::getFormat(void) const
+{
+  return static_cast<SampleFormat>(this->ui->formatCombo->currentIndex());
+}
+
+SUFLOAT
+NetForwarderUI::getFullScale(void) const
 {
-  return this->ui->socketTypeCombo->currentIndex() == 1;
+  return static_cast<SUFLOAT>(this->ui->fullScaleSpin->value());
+}
+
+qreal
+NetForwarderUI::getOutputRate(void) const
+{
+  return this->ui->outputRateSpin->value();
 }
 
 ///////////////////////////////// Slots ///////////////////////////////////////
@@ -178,3 +263,11 @@ NetForwarderUI::onForwardStartStop(void)
 
   emit forwardStateChanged(this->ui->udpStartStopButton->isChecked());
 }
+
+void
+NetForwarderUI::onFormatChanged(void)
+{
+  this->ui->fullScaleSpin->setEnabled(
+        this->ui->formatCombo->isEnabled()
+        && this->getFormat() != SAMPLE_FORMAT_CF32);
+}
@@ -455,6 +455,24 @@ SourcePanel::setCaptureSize(quint64 size)
   this->saverUI->setCaptureSize(size);
 }
 
+void
+SourcePanel::setClipCount(quint64 count)
+{
+  this->saverUI->setClipCount(count);
+}
+
+void
+SourcePanel::setHistoryMemory(quint64 bytes)
+{
+  this->saverUI->setHistoryMemory(bytes);
+}
+
+void
+SourcePanel::setCaptureHeadroom(qreal seconds, quint64 memory)
+{
+  this->saverUI->setHeadroom(seconds, memory);
+}
+
 void
 SourcePanel::setIORate(qreal rate)
 {
@@ -0,0 +1,228 @@
+//
+//    SpectrumOverlay.cpp: Extra traces drawn over the main spectrum
+//    Copyright (C) 2020 Gonzalo José Carracedo Carballal
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as
+//    published by the Free Software Foundation, either version 3 of the
+//    License, or (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful, but
+//    WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public
+//    License along with this program.  If not, see
+//    <http://www.gnu.org/licenses/>
+//
+
+#include "SpectrumOverlay.h"
+#include <QEvent>
+#include <QMouseEvent>
+#include <QPainter>
+#include <QPolygonF>
+#include <algorithm>
+#include <cmath>
+
+using namespace SigDigger;
+
+SpectrumOverlay::SpectrumOverlay(QWidget *plotter) : QWidget(plotter)
+{
+  this->setAttribute(Qt::WA_TransparentForMouseEvents);
+  this->setAttribute(Qt::WA_NoSystemBackground);
+  this->setGeometry(plotter->rect());
+
+  this->traces[AVERAGER_TRACE_MAX_HOLD].color    = QColor(255, 96, 96);
+  this->traces[AVERAGER_TRACE_MIN_HOLD].color    = QColor(96, 160, 255);
+  this->traces[AVERAGER_TRACE_WINDOW_MEAN].color = QColor(255, 224, 96);
+  this->traces[AVERAGER_TRACE_PERCENTILE].color  = QColor(128, 255, 128);
+
+  plotter->installEventFilter(this);
+}
+
+bool
+SpectrumOverlay::eventFilter(QObject *obj, QEvent *event)
+{
+  QMouseEvent *mouse;
+  qreal height;
+
+  if (obj != this->parentWidget())
+    return false;
+
+  if (event->type() == QEvent::Resize) {
+    this->setGeometry(this->parentWidget()->rect());
+    this->raise();
+  } else if (event->type() == QEvent::MouseButtonPress) {
+    mouse = static_cast<QMouseEvent *>(event);
+    height = this->height() * this->percent2D / 100.;
+
+    if (mouse->button() != Qt::LeftButton
+        || !(mouse->modifiers() & Qt::ControlModifier)
+        || mouse->pos().y() >= height)
+      return false;
+
+    for (auto &ch : this->channels)
+      if (mouse->pos().x() >= ch.left - 1 && mouse->pos().x() <= ch.right + 1) {
+        emit channelClicked(ch.id);
+        return true;
+      }
+  }
+
+  return false;
+}
+
+void
+SpectrumOverlay::setPandapterRange(float min, float max)
+{
+  this->panMin = min;
+  this->panMax = max;
+  this->update();
+}
+
+void
+SpectrumOverlay::setPercent2DScreen(int percent)
+{
+  this->percent2D = percent;
+  this->update();
+}
+
+void
+SpectrumOverlay::setTraceColor(AveragerTrace trace, QColor const &color)
+{
+  this->traces[trace].color = color;
+  this->update();
+}
+
+void
+SpectrumOverlay::setTrace(
+    AveragerTrace trace,
+    const float *data,
+    int size,
+    qreal firstBin,
+    qreal binsPerPixel)
+{
+  std::vector<float> &columns = this->traces[trace].columns;
+  bool lowest =
+      trace == AVERAGER_TRACE_MIN_HOLD || trace == AVERAGER_TRACE_PERCENTILE;
+  int width = this->width();
+  int x, i, start, end;
+  float value;
+
+  columns.resize(static_cast<size_t>(std::max(width, 0)));
+
+  // Keep the extremes of every column: max for traces that show peaks,
+  // min for those that show the floor.
+  for (x = 0; x < width; ++x) {
+    start = static_cast<int>(std::floor(firstBin + x * binsPerPixel));
+    end   = static_cast<int>(std::floor(firstBin + (x + 1) * binsPerPixel));
+
+    if (end <= start)
+      end = start + 1;
+
+    start = std::max(start, 0);
+    end   = std::min(end, size);
+
+    if (start >= end) {
+      columns[static_cast<size_t>(x)] = NAN;
+      continue;
+    }
+
+    value = data[start];
+    for (i = start + 1; i < end; ++i)
+      value = lowest ? std::min(value, data[i]) : std::max(value, data[i]);
+
+    columns[static_cast<size_t>(x)] = value;
+  }
+
+  this->update();
+}
+
+void
+SpectrumOverlay::clearTrace(AveragerTrace trace)
+{
+  if (!this->traces[trace].columns.empty()) {
+    this->traces[trace].columns.clear();
+    this->update();
+  }
+}
+
+void
+SpectrumOverlay::setChannels(std::vector<ChannelMarker> const &channels)
+{
+  if (!channels.empty() || !this->channels.empty()) {
+    this->channels = channels;
+    this->update();
+  }
+}
+
+void
+SpectrumOverlay::setChannelColor(QColor const &color)
+{
+  this->channelColor = color;
+  this->update();
+}
+
+void
+SpectrumOverlay::paintEvent(QPaintEvent *)
+{
+  QPainter painter(this);
+  QPolygonF line;
+  QColor fill;
+  qreal height = this->height() * this->percent2D / 100.;
+  qreal dBPerPixel, labelEnd;
+  size_t x;
+
+  if (height <= 0 || this->panMax <= this->panMin)
+    return;
+
+  dBPerPixel = (this->panMax - this->panMin) / height;
+
+  painter.setClipRect(QRectF(0, 0, this->width(), height));
+
+  // Labels only where they do not run into the previous one
+  fill = this->channelColor;
+  fill.setAlpha(48);
+  labelEnd = -1;
+
+  for (auto &ch : this->channels) {
+    QRectF box(ch.left, 0, std::max(ch.right - ch.left, 1.), height);
+    QString label =
+        QString::number(static_cast<qreal>(ch.snr), 'f', 1) + " dB";
+
+    painter.fillRect(box, fill);
+    painter.setPen(
+          QPen(
+            this->channelColor,
+            1,
+            ch.present ? Qt::SolidLine : Qt::DashLine));
+    painter.drawRect(box);
+
+    if (box.left() > labelEnd) {
+      painter.drawText(
+            QPointF(box.left() + 2, painter.fontMetrics().ascent() + 2),
+            label);
+      labelEnd = box.left()
+          + painter.fontMetrics().boundingRect(label).width() + 4;
+    }
+  }
+
+  for (auto &trace : this->traces) {
+    if (trace.columns.empty())
+      continue;
+
+    painter.setPen(trace.color);
+
+    for (x = 0; x <= trace.columns.size(); ++x) {
+      if (x < trace.columns.size() && !std::isnan(trace.columns[x])) {
+        line.append(
+              QPointF(
+                x,
+                (this->panMax - trace.columns[x]) / dBPerPixel));
+      } else if (!line.isEmpty()) {
+        painter.drawPolyline(line);
+        line.clear();
+      }
+    }
+  }
+}
@@ -0,0 +1,298 @@
+//
+//    WaterfallHistoryDialog.cpp: Scroll back through the waterfall history
+//    Copyright (C) 2020 Gonzalo José Carracedo Carballal
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as
+//    published by the Free Software Foundation, either version 3 of the
+//    License, or (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful, but
+//    WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public
+//    License along with this program.  If not, see
+//    <http://www.gnu.org/licenses/>
+//
+
+#include "WaterfallHistoryDialog.h"
+#include <QDateTime>
+#include <SuWidgetsHelpers.h>
+#include <algorithm>
+#include <climits>
+#include "ui_WaterfallHistoryDialog.h"
+
+using namespace SigDigger;
+
+WaterfallHistoryDialog::WaterfallHistoryDialog(QWidget *parent) :
+  QDialog(parent),
+  ui(new Ui::WaterfallHistoryDialog)
+{
+  ui->setupUi(this);
+
+  this->ui->sizeSpin->setRange(
+        SIGDIGGER_WF_HISTORY_MIN_SIZE,
+        SIGDIGGER_WF_HISTORY_MAX_SIZE);
+
+  this->view = new WaterfallHistoryView(this);
+  this->ui->viewLayout->insertWidget(0, this->view, 1);
+  this->ui->timeEdit->setDateTime(QDateTime::currentDateTime());
+  this->timer.setInterval(SIGDIGGER_WF_HISTORY_DIALOG_REFRESH_MS);
+
+  this->connectAll();
+}
+
+WaterfallHistoryDialog::~WaterfallHistoryDialog()
+{
+  delete ui;
+}
+
+void
+WaterfallHistoryDialog::connectAll(void)
+{
+  connect(
+        &this->timer,
+        SIGNAL(timeout(void)),
+        this,
+        SLOT(onTimeout(void)));
+
+  connect(
+        this->ui->scrollBar,
+        SIGNAL(valueChanged(int)),
+        this,
+        SLOT(onScroll(int)));
+
+  connect(
+        this->view,
+        SIGNAL(scrolled(int)),
+        this,
+        SLOT(onWheel(int)));
+
+  connect(
+        this->view,
+        SIGNAL(hovered(quint64, qreal)),
+        this,
+        SLOT(onHover(quint64, qreal)));
+
+  connect(
+        this->ui->recordCheck,
+        SIGNAL(toggled(bool)),
+        this,
+        SLOT(onConfigChanged(void)));
+
+  connect(
+        this->ui->sizeSpin,
+        SIGNAL(editingFinished(void)),
+        this,
+        SLOT(onConfigChanged(void)));
+
+  connect(
+        this->ui->goButton,
+        SIGNAL(clicked(bool)),
+        this,
+        SLOT(onGoToTime(void)));
+
+  connect(
+        this->ui->latestButton,
+        SIGNAL(clicked(bool)),
+        this,
+        SLOT(onLatest(void)));
+
+  connect(
+        this->ui->closeButton,
+        SIGNAL(clicked(bool)),
+        this,
+        SLOT(accept(void)));
+}
+
+void
+WaterfallHistoryDialog::setHistory(WaterfallHistory *history)
+{
+  this->history = history;
+  this->lastEnd = 0;
+  this->view->setHistory(history);
+}
+
+void
+WaterfallHistoryDialog::setPaletteGradient(const QColor *gradient)
+{
+  this->view->setPaletteGradient(gradient);
+}
+
+void
+WaterfallHistoryDialog::setRange(float min, float max)
+{
+  this->view->setRange(min, max);
+}
+
+void
+WaterfallHistoryDialog::setRecording(bool recording)
+{
+  bool blocked = this->ui->recordCheck->blockSignals(true);
+  this->ui->recordCheck->setChecked(recording);
+  this->ui->recordCheck->blockSignals(blocked);
+}
+
+void
+WaterfallHistoryDialog::setHistorySize(unsigned int size)
+{
+  this->ui->sizeSpin->setValue(static_cast<int>(size));
+}
+
+bool
+WaterfallHistoryDialog::getRecording(void) const
+{
+  return this->ui->recordCheck->isChecked();
+}
+
+unsigned int
+WaterfallHistoryDialog::getHistorySize(void) const
+{
+  return static_cast<unsigned int>(this->ui->sizeSpin->value());
+}
+
+// Keeps the rows on screen where they are as new ones come in, unless
+// the view is following the latest row.
+void
+WaterfallHistoryDialog::refresh(void)
+{
+  QScrollBar *bar = this->ui->scrollBar;
+  quint64 first, end, added;
+  int max, value;
+
+  if (this->history == nullptr || !this->history->isOpen()) {
+    bar->setRange(0, 0);
+    this->ui->usageLabel->setText("Not recording");
+    this->view->update();
+    return;
+  }
+
+  first = this->history->getFirstRow();
+  end = this->history->getEndRow();
+  added = end >= this->lastEnd ? end - this->lastEnd : 0;
+  this->lastEnd = end;
+
+  max = static_cast<int>(std::min<quint64>(
+        end > first ? end - first - 1 : 0,
+        INT_MAX));
+  value = bar->value();
+  if (value > 0)
+    value = static_cast<int>(std::min<quint64>(value + added, INT_MAX));
+
+  bar->setPageStep(std::max(this->view->height(), 1));
+  bar->setMaximum(max);
+  bar->setValue(std::min(value, max));
+
+  this->ui->usageLabel->setText(
+        QString::number(end - first)
+        + " rows since "
+        + QDateTime::fromMSecsSinceEpoch(
+          this->history->getFirstTime() / 1000).toString(
+          "yyyy-MM-dd HH:mm:ss")
+        + ", "
+        + QString::number(
+          this->history->getDiskUsage() / 1048576.,
+          'f',
+          1)
+        + " of "
+        + QString::number(this->getHistorySize())
+        + " MiB");
+
+  this->view->update();
+}
+
+void
+WaterfallHistoryDialog::showEvent(QShowEvent *)
+{
+  this->refresh();
+  this->timer.start();
+}
+
+void
+WaterfallHistoryDialog::hideEvent(QHideEvent *)
+{
+  this->timer.stop();
+}
+
+////////////////////////////////// Slots //////////////////////////////////////
+void
+WaterfallHistoryDialog::onTimeout(void)
+{
+  this->refresh();
+}
+
+void
+WaterfallHistoryDialog::onScroll(int value)
+{
+  this->view->setOffset(static_cast<quint64>(value));
+}
+
+void
+WaterfallHistoryDialog::onWheel(int rows)
+{
+  this->ui->scrollBar->setValue(this->ui->scrollBar->value() + rows);
+}
+
+void
+WaterfallHistoryDialog::onHover(quint64 index, qreal position)
+{
+  WaterfallHistoryRow row;
+  unsigned int bin;
+
+  if (this->history == nullptr || !this->history->getRow(index, row)) {
+    this->ui->cursorLabel->clear();
+    return;
+  }
+
+  bin = std::min(
+        static_cast<unsigned int>(position * row.bins),
+        row.bins - 1);
+
+  this->ui->cursorLabel->setText(
+        QDateTime::fromMSecsSinceEpoch(row.time / 1000).toString(
+          "yyyy-MM-dd HH:mm:ss.zzz")
+        + "  "
+        + SuWidgetsHelpers::formatQuantity(
+          row.frequency + (position - .5) * row.sampleRate,
+          "Hz")
+        + "  "
+        + QString::number(
+          static_cast<qreal>(
+            row.peak - row.codes[bin] * SIGDIGGER_WF_HISTORY_DB_STEP),
+          'f',
+          1)
+        + " dB");
+}
+
+void
+WaterfallHistoryDialog::onGoToTime(void)
+{
+  qint64 time = this->ui->timeEdit->dateTime().toMSecsSinceEpoch() * 1000;
+  quint64 row, end;
+
+  if (this->history == nullptr || !this->history->isOpen())
+    return;
+
+  end = this->history->getEndRow();
+  row = this->history->findRow(time);
+
+  // Target on the top line. Past the end: the latest row.
+  this->ui->scrollBar->setValue(
+        static_cast<int>(std::min<quint64>(
+          row < end ? end - row - 1 : 0,
+          INT_MAX)));
+}
+
+void
+WaterfallHistoryDialog::onLatest(void)
+{
+  this->ui->scrollBar->setValue(0);
+}
+
+void
+WaterfallHistoryDialog::onConfigChanged(void)
+{
+  emit configChanged();
+}
@@ -0,0 +1,160 @@
+//
+//    WaterfallHistoryView.cpp: Paints rows of the waterfall history
+//    Copyright (C) 2020 Gonzalo José Carracedo Carballal
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as
+//    published by the Free Software Foundation, either version 3 of the
+//    License, or (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful, but
+//    WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public
+//    License along with this program.  If not, see
+//    <http://www.gnu.org/licenses/>
+//
+
+#include "WaterfallHistoryView.h"
+#include <QImage>
+#include <QMouseEvent>
+#include <QPainter>
+#include <QWheelEvent>
+#include <algorithm>
+
+using namespace SigDigger;
+
+WaterfallHistoryView::WaterfallHistoryView(QWidget *parent) : QWidget(parent)
+{
+  unsigned int i;
+
+  for (i = 0; i < 256; ++i)
+    this->colors[i] = qRgb(
+          static_cast<int>(i),
+          static_cast<int>(i),
+          static_cast<int>(i));
+
+  this->setAttribute(Qt::WA_OpaquePaintEvent);
+  this->setMouseTracking(true);
+  this->setMinimumSize(256, 128);
+}
+
+void
+WaterfallHistoryView::setHistory(WaterfallHistory *history)
+{
+  this->history = history;
+  this->update();
+}
+
+void
+WaterfallHistoryView::setOffset(quint64 offset)
+{
+  this->offset = offset;
+  this->update();
+}
+
+void
+WaterfallHistoryView::setPaletteGradient(const QColor *gradient)
+{
+  unsigned int i;
+
+  for (i = 0; i < 256; ++i)
+    this->colors[i] = gradient[i].rgb();
+
+  this->update();
+}
+
+void
+WaterfallHistoryView::setRange(float min, float max)
+{
+  this->wfMin = min;
+  this->wfMax = max;
+  this->update();
+}
+
+quint64
+WaterfallHistoryView::rowAt(int y) const
+{
+  quint64 end, back;
+
+  if (this->history == nullptr || y < 0)
+    return 0;
+
+  end = this->history->getEndRow();
+  back = this->offset + static_cast<quint64>(y) + 1;
+
+  if (back > end - this->history->getFirstRow())
+    return end;
+
+  return end - back;
+}
+
+void
+WaterfallHistoryView::paintEvent(QPaintEvent *)
+{
+  QPainter painter(this);
+  QImage image(this->width(), this->height(), QImage::Format_RGB32);
+  WaterfallHistoryRow row;
+  quint64 index, end;
+  unsigned int x, width, first, last, bin;
+  uint8_t code;
+  float db, scale;
+  QRgb *line;
+  int y, color;
+
+  image.fill(Qt::black);
+
+  width = static_cast<unsigned int>(this->width());
+  scale = this->wfMax > this->wfMin ? 255.f / (this->wfMax - this->wfMin) : 0;
+
+  if (this->history != nullptr && width > 0) {
+    end = this->history->getEndRow();
+
+    for (y = 0; y < this->height(); ++y) {
+      if ((index = this->rowAt(y)) == end
+          || !this->history->getRow(index, row)
+          || row.bins == 0)
+        break;
+
+      line = reinterpret_cast<QRgb *>(image.scanLine(y));
+
+      for (x = 0; x < width; ++x) {
+        first = static_cast<unsigned int>(
+              static_cast<quint64>(x) * row.bins / width);
+        last = static_cast<unsigned int>(
+              static_cast<quint64>(x + 1) * row.bins / width);
+        last = std::max(last, first + 1);
+
+        // Lowest code, strongest bin
+        code = row.codes[first];
+        for (bin = first + 1; bin < last; ++bin)
+          code = std::min(code, row.codes[bin]);
+
+        db = row.peak - code * SIGDIGGER_WF_HISTORY_DB_STEP;
+        color = static_cast<int>((db - this->wfMin) * scale);
+        line[x] = this->colors[std::min(std::max(color, 0), 255)];
+      }
+    }
+  }
+
+  painter.drawImage(0, 0, image);
+}
+
+void
+WaterfallHistoryView::mouseMoveEvent(QMouseEvent *event)
+{
+  if (this->history != nullptr && this->width() > 0)
+    emit hovered(
+        this->rowAt(event->pos().y()),
+        event->pos().x() / static_cast<qreal>(this->width()));
+}
+
+void
+WaterfallHistoryView::wheelEvent(QWheelEvent *event)
+{
+  // 120 per notch, 3 rows
+  emit scrolled(-event->angleDelta().y() / 40);
+  event->accept();
+}
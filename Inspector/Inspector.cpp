@@ -38,6 +38,8 @@ Inspector::Inspector(
   this->ui->setSampleRate(msg.getEquivSampleRate());
   this->ui->setBandwidth(static_cast<unsigned int>(msg.getBandwidth()));
   this->ui->setLo(static_cast<int>(msg.getLo()));
+  this->ui->setFrequency(
+        static_cast<qreal>(msg.getChannel().fc + msg.getChannel().ft));
 
   this->connect(
         this->ui.get(),
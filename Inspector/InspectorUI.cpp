@@ -182,6 +182,12 @@ InspectorUI::setLo(int lo)
   this->ui->loLcd->setValue(lo);
 }
 
+void
+InspectorUI::setFrequency(qreal frequency)
+{
+  this->frequency = frequency;
+}
+
 void
 InspectorUI::refreshInspectorCtls(void)
 {
@@ -201,6 +207,12 @@ InspectorUI::getLo(void) const
   return static_cast<int>(this->ui->loLcd->getValue());
 }
 
+qreal
+InspectorUI::getFrequency(void) const
+{
+  return this->frequency + this->getLo();
+}
+
 bool
 InspectorUI::setPalette(std::string const &str)
 {
@@ -462,6 +474,12 @@ InspectorUI::connectDataSaver()
         this,
         SLOT(onSaveRate(qreal)));
 
+  connect(
+        this->dataSaver,
+        SIGNAL(headroom(qreal)),
+        this,
+        SLOT(onSaveHeadroom(qreal)));
+
   connect(
         this->dataSaver,
         SIGNAL(commit(void)),
@@ -520,6 +538,8 @@ InspectorUI::captureFileName(void) const
        << std::setw(4)
        << std::setfill('0')
        << ++i
+       << "-"
+       << SampleConverter::formatName(this->saverUI->getFormat())
        << ".raw";
     path = this->saverUI->getRecordSavePath() + "/" + os.str();
   } while (access(path.c_str(), F_OK) != -1);
@@ -527,18 +547,46 @@ InspectorUI::captureFileName(void) const
   return path;
 }
 
+// Blocks follow the recording rate, but only while nobody reads from
+// the fanout: feed() writes to this one alone, and a sink left on an
+// older fanout would stop getting samples.
+void
+InspectorUI::assertFanout(void)
+{
+  size_t blockLen = SampleFanout::blockLength(this->recordingRate);
+
+  if (this->fanout != nullptr && this->fanout->getSinkCount() > 0)
+    return;
+
+  if (this->fanout == nullptr || this->fanout->getBlockLen() != blockLen)
+    this->fanout = std::make_shared<SampleFanout>(blockLen);
+}
+
 bool
 InspectorUI::installNetForwarder(void)
 {
   if (this->socketForwarder == nullptr) {
+    NetStreamParams params;
+
+    this->recordingRate = this->getBaudRate();
+
+    params.frameLen   = this->netForwarderUI->getFrameLen();
+    params.framed     = this->netForwarderUI->getFraming();
+    params.sampleRate = this->recordingRate;
+    params.outputRate = this->netForwarderUI->getOutputRate();
+    params.format     = this->netForwarderUI->getFormat();
+    params.fullScale  = this->netForwarderUI->getFullScale();
+
     this->socketForwarder = new SocketForwarder(
           this->netForwarderUI->getHost(),
           this->netForwarderUI->getPort(),
-          this->netForwarderUI->getFrameLen(),
-          this->netForwarderUI->getTcp(),
+          this->netForwarderUI->getMode(),
+          params,
           this);
-    this->recordingRate = this->getBaudRate();
     this->socketForwarder->setSampleRate(recordingRate);
+    this->socketForwarder->setFrequency(this->getFrequency());
+    this->assertFanout();
+    (void) this->socketForwarder->attach(this->fanout);
     connectNetForwarder();
 
     return true;
@@ -550,8 +598,11 @@ InspectorUI::installNetForwarder(void)
 void
 InspectorUI::uninstallNetForwarder(void)
 {
-  if (this->socketForwarder)
+  if (this->socketForwarder) {
+    // Stop taking blocks right now, not when the event loop deletes it
+    this->socketForwarder->detach();
     this->socketForwarder->deleteLater();
+  }
   this->socketForwarder = nullptr;
 }
 
@@ -578,9 +629,20 @@ InspectorUI::installDataSaver(void)
       return false;
     }
 
-    this->dataSaver = new FileDataSaver(this->fd, this);
+    FileDataSaver::FileDataParams params;
+
+    params.fd = this->fd;
+    params.backend = this->saverUI->getBackend();
+    params.format = this->saverUI->getFormat();
+    params.fullScale = this->saverUI->getFullScale();
+
+    this->dataSaver = new FileDataSaver(params, this);
+    this->dataSaver->setMemoryBudget(this->saverUI->getMemoryBudget());
     this->recordingRate = this->getBaudRate();
     this->dataSaver->setSampleRate(recordingRate);
+    this->dataSaver->setOverloadPolicy(this->saverUI->getOverloadPolicy());
+    this->assertFanout();
+    (void) this->dataSaver->attach(this->fanout);
     connectDataSaver();
 
     return true;
@@ -592,8 +654,10 @@ InspectorUI::installDataSaver(void)
 void
 InspectorUI::uninstallDataSaver(void)
 {
-  if (this->dataSaver != nullptr)
+  if (this->dataSaver != nullptr) {
+    this->dataSaver->detach();
     this->dataSaver->deleteLater();
+  }
   this->dataSaver = nullptr;
 
   if (this->fd != -1) {
@@ -752,13 +816,10 @@ InspectorUI::feed(const SUCOMPLEX *data, unsigned int size)
     }
   }
 
-  if (this->recording || this->forwarding) {
+  // Both the recorder and the forwarder read from the fanout
+  if ((this->recording || this->forwarding) && this->fanout != nullptr) {
     if (this->decider.getDecisionMode() == Decider::MODULUS) {
-      if (this->recording)
-        this->dataSaver->write(data, size);
-
-      if (this->forwarding)
-        this->socketForwarder->write(data, size);
+      this->fanout->write(data, size);
     } else {
       if (this->buffer.size() < size)
         this->buffer.resize(size);
@@ -766,10 +827,7 @@ InspectorUI::feed(const SUCOMPLEX *data, unsigned int size)
       for (unsigned i = 0; i < size; ++i)
         this->buffer[i] = SU_C_ARG(I * data[i]) / PI;
 
-      if (this->recording)
-        this->dataSaver->write(this->buffer.data(), size);
-      if (this->forwarding)
-        this->socketForwarder->write(this->buffer.data(), size);
+      this->fanout->write(this->buffer.data(), size);
     }
   }
 }
@@ -866,6 +924,9 @@ InspectorUI::populate(void)
   // Add data forwarder objects
 
   this->saverUI = new DataSaverUI(this->owner);
+  this->saverUI->setRolloverAvailable(false);
+  this->saverUI->setHistoryAvailable(false);
+  this->saverUI->setChannelsAvailable(false);
 
   this->ui->forwarderGrid->addWidget(this->saverUI, 0, 0, Qt::AlignTop);
 
@@ -1305,10 +1366,18 @@ InspectorUI::onSaveRate(qreal rate)
   this->saverUI->setIORate(rate);
 }
 
+void
+InspectorUI::onSaveHeadroom(qreal seconds)
+{
+  if (this->dataSaver != nullptr)
+    this->saverUI->setHeadroom(seconds, this->dataSaver->getMemoryUsage());
+}
+
 void
 InspectorUI::onCommit(void)
 {
   this->saverUI->setCaptureSize(this->dataSaver->getSize());
+  this->saverUI->setClipCount(this->dataSaver->getClipCount());
 }
 
 // Net Forwarder
@@ -1380,11 +1449,18 @@ void
 InspectorUI::onNetCommit(void)
 {
   this->netForwarderUI->setCaptureSize(this->socketForwarder->getSize());
+
+  if (this->netForwarderUI->getMode() == SocketForwarder::MODE_TCP_SERVER)
+    this->netForwarderUI->setClientCount(
+          static_cast<int>(this->socketForwarder->getClientCount()));
 }
 
 void
 InspectorUI::onChangeLo(void)
 {
+  if (this->socketForwarder != nullptr)
+    this->socketForwarder->setFrequency(this->getFrequency());
+
   emit loChanged();
 }
 
@@ -0,0 +1,58 @@
+//
+//    AlignedBuffer.cpp: Reusable SIMD-aligned float buffer
+//    Copyright (C) 2020 Gonzalo José Carracedo Carballal
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as
+//    published by the Free Software Foundation, either version 3 of the
+//    License, or (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful, but
+//    WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public
+//    License along with this program.  If not, see
+//    <http://www.gnu.org/licenses/>
+//
+
+#include "AlignedBuffer.h"
+#include <cstdint>
+
+using namespace SigDigger;
+
+size_t
+AlignedBuffer::stride(size_t size)
+{
+  const size_t floats = SIGDIGGER_ALIGNED_BUFFER_ALIGNMENT / sizeof(float);
+
+  return (size + floats - 1) / floats * floats;
+}
+
+void
+AlignedBuffer::reserve(size_t size)
+{
+  uintptr_t addr;
+
+  if (size <= this->capacity)
+    return;
+
+  this->storage.reset(
+        new char[size * sizeof(float) + SIGDIGGER_ALIGNED_BUFFER_ALIGNMENT - 1]);
+
+  addr = reinterpret_cast<uintptr_t>(this->storage.get());
+  addr = (addr + SIGDIGGER_ALIGNED_BUFFER_ALIGNMENT - 1)
+      & ~static_cast<uintptr_t>(SIGDIGGER_ALIGNED_BUFFER_ALIGNMENT - 1);
+
+  this->data = reinterpret_cast<float *>(addr);
+  this->capacity = size;
+}
+
+void
+AlignedBuffer::release(void)
+{
+  this->storage.reset();
+  this->data = nullptr;
+  this->capacity = 0;
+}
@@ -18,34 +18,324 @@
 //
 
 #include "Averager.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__)
+#  include <emmintrin.h>
+#  define SIGDIGGER_AVERAGER_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#  include <arm_neon.h>
+#  define SIGDIGGER_AVERAGER_NEON
+#endif
 
 using namespace SigDigger;
 
+//////////////////////////////// Kernels //////////////////////////////////////
+// Own buffers are aligned, the incoming frame x may not be.
+
+// acc += alpha * (x - acc)
+static void
+blendKernel(float *acc, const float *x, float alpha, size_t len)
+{
+  size_t i = 0;
+
+#if defined(SIGDIGGER_AVERAGER_SSE2)
+  const __m128 a = _mm_set1_ps(alpha);
+
+  for (; i + 4 <= len; i += 4) {
+    __m128 y = _mm_load_ps(acc + i);
+    y = _mm_add_ps(y, _mm_mul_ps(a, _mm_sub_ps(_mm_loadu_ps(x + i), y)));
+    _mm_store_ps(acc + i, y);
+  }
+#elif defined(SIGDIGGER_AVERAGER_NEON)
+  for (; i + 4 <= len; i += 4) {
+    float32x4_t y = vld1q_f32(acc + i);
+    y = vfmaq_n_f32(y, vsubq_f32(vld1q_f32(x + i), y), alpha);
+    vst1q_f32(acc + i, y);
+  }
+#endif
+
+  for (; i < len; ++i)
+    acc[i] += alpha * (x[i] - acc[i]);
+}
+
+static void
+maxKernel(float *acc, const float *x, size_t len)
+{
+  size_t i = 0;
+
+#if defined(SIGDIGGER_AVERAGER_SSE2)
+  for (; i + 4 <= len; i += 4)
+    _mm_store_ps(
+          acc + i,
+          _mm_max_ps(_mm_load_ps(acc + i), _mm_loadu_ps(x + i)));
+#elif defined(SIGDIGGER_AVERAGER_NEON)
+  for (; i + 4 <= len; i += 4)
+    vst1q_f32(acc + i, vmaxq_f32(vld1q_f32(acc + i), vld1q_f32(x + i)));
+#endif
+
+  for (; i < len; ++i)
+    acc[i] = std::max(acc[i], x[i]);
+}
+
+static void
+minKernel(float *acc, const float *x, size_t len)
+{
+  size_t i = 0;
+
+#if defined(SIGDIGGER_AVERAGER_SSE2)
+  for (; i + 4 <= len; i += 4)
+    _mm_store_ps(
+          acc + i,
+          _mm_min_ps(_mm_load_ps(acc + i), _mm_loadu_ps(x + i)));
+#elif defined(SIGDIGGER_AVERAGER_NEON)
+  for (; i + 4 <= len; i += 4)
+    vst1q_f32(acc + i, vminq_f32(vld1q_f32(acc + i), vld1q_f32(x + i)));
+#endif
+
+  for (; i < len; ++i)
+    acc[i] = std::min(acc[i], x[i]);
+}
+
+// sum += x - old, old = x, out = sum * scale
+static void
+windowKernel(
+    float *sum,
+    float *old,
+    const float *x,
+    float *out,
+    float scale,
+    size_t len)
+{
+  size_t i = 0;
+
+#if defined(SIGDIGGER_AVERAGER_SSE2)
+  const __m128 k = _mm_set1_ps(scale);
+
+  for (; i + 4 <= len; i += 4) {
+    __m128 v = _mm_loadu_ps(x + i);
+    __m128 s = _mm_add_ps(
+          _mm_load_ps(sum + i),
+          _mm_sub_ps(v, _mm_load_ps(old + i)));
+    _mm_store_ps(sum + i, s);
+    _mm_store_ps(old + i, v);
+    _mm_store_ps(out + i, _mm_mul_ps(s, k));
+  }
+#elif defined(SIGDIGGER_AVERAGER_NEON)
+  for (; i + 4 <= len; i += 4) {
+    float32x4_t v = vld1q_f32(x + i);
+    float32x4_t s = vaddq_f32(
+          vld1q_f32(sum + i),
+          vsubq_f32(v, vld1q_f32(old + i)));
+    vst1q_f32(sum + i, s);
+    vst1q_f32(old + i, v);
+    vst1q_f32(out + i, vmulq_n_f32(s, scale));
+  }
+#endif
+
+  for (; i < len; ++i) {
+    sum[i] += x[i] - old[i];
+    old[i]  = x[i];
+    out[i]  = sum[i] * scale;
+  }
+}
+
+// sum += x, both ours
+static void
+accumulateKernel(float *sum, const float *x, size_t len)
+{
+  size_t i = 0;
+
+#if defined(SIGDIGGER_AVERAGER_SSE2)
+  for (; i + 4 <= len; i += 4)
+    _mm_store_ps(
+          sum + i,
+          _mm_add_ps(_mm_load_ps(sum + i), _mm_load_ps(x + i)));
+#elif defined(SIGDIGGER_AVERAGER_NEON)
+  for (; i + 4 <= len; i += 4)
+    vst1q_f32(sum + i, vaddq_f32(vld1q_f32(sum + i), vld1q_f32(x + i)));
+#endif
+
+  for (; i < len; ++i)
+    sum[i] += x[i];
+}
+
+//
+// Stochastic quantile estimate: q goes up by up when x is above it and
+// down by down otherwise. It settles where
+// P(x > q) * up = P(x <= q) * down, i.e. at the up / (up + down)
+// quantile, within a step or so.
+//
+static void
+percentileKernel(float *q, const float *x, float up, float down, size_t len)
+{
+  size_t i = 0;
+
+#if defined(SIGDIGGER_AVERAGER_SSE2)
+  const __m128 u = _mm_set1_ps(up);
+  const __m128 d = _mm_set1_ps(-down);
+
+  for (; i + 4 <= len; i += 4) {
+    __m128 y = _mm_load_ps(q + i);
+    __m128 above = _mm_cmpgt_ps(_mm_loadu_ps(x + i), y);
+    __m128 step = _mm_or_ps(_mm_and_ps(above, u), _mm_andnot_ps(above, d));
+    _mm_store_ps(q + i, _mm_add_ps(y, step));
+  }
+#elif defined(SIGDIGGER_AVERAGER_NEON)
+  const float32x4_t u = vdupq_n_f32(up);
+  const float32x4_t d = vdupq_n_f32(-down);
+
+  for (; i + 4 <= len; i += 4) {
+    float32x4_t y = vld1q_f32(q + i);
+    uint32x4_t above = vcgtq_f32(vld1q_f32(x + i), y);
+    vst1q_f32(q + i, vaddq_f32(y, vbslq_f32(above, u, d)));
+  }
+#endif
+
+  for (; i < len; ++i)
+    q[i] += x[i] > q[i] ? up : -down;
+}
+
+//////////////////////////////// Averager /////////////////////////////////////
+// History is capped in bins, so huge FFTs get shorter windows
+unsigned int
+Averager::effectiveWindow(void) const
+{
+  unsigned long maxFrames = SIGDIGGER_AVERAGER_MAX_WINDOW_BINS;
+
+  if (this->bufsiz > 0)
+    maxFrames /= this->bufsiz;
+
+  return static_cast<unsigned int>(
+        std::max(
+          2ul,
+          std::min<unsigned long>(this->windowLength, maxFrames)));
+}
+
 void
-Averager::feed(Suscan::PSDMessage const &m)
+Averager::resetWindow(void)
+{
+  this->windowFill = 0;
+  this->windowPos  = 0;
+  this->valid[AVERAGER_TRACE_WINDOW_MEAN] = false;
+}
+
+void
+Averager::resetTraces(void)
+{
+  for (auto &v : this->valid)
+    v = false;
+
+  this->resetWindow();
+}
+
+void
+Averager::feedTrace(AveragerTrace trace, const float *data)
+{
+  size_t stride = AlignedBuffer::stride(this->bufsiz);
+  unsigned int window = 0;
+  float *out, *sum, *slot;
+  unsigned int i;
+
+  try {
+    this->traces[trace].reserve(this->bufsiz);
+    if (trace == AVERAGER_TRACE_WINDOW_MEAN) {
+      window = this->effectiveWindow();
+      this->history.reserve(window * stride);
+      this->windowSum.reserve(this->bufsiz);
+    }
+  } catch (std::bad_alloc &) {
+    throw Suscan::Exception("Failed to allocate PSD trace buffer");
+  }
+
+  out = this->traces[trace].get();
+
+  if (trace == AVERAGER_TRACE_WINDOW_MEAN) {
+    sum  = this->windowSum.get();
+    slot = this->history.get() + this->windowPos * stride;
+
+    // Until the window fills up, the slot being replaced holds nothing
+    if (this->windowFill < window) {
+      if (this->windowFill++ == 0)
+        memset(sum, 0, this->bufsiz * sizeof(float));
+      memset(slot, 0, this->bufsiz * sizeof(float));
+    }
+
+    windowKernel(sum, slot, data, out, 1.f / this->windowFill, this->bufsiz);
+
+    // Running sums drift. Recompute them from scratch once per window.
+    if (++this->windowPos == window) {
+      this->windowPos = 0;
+      memcpy(sum, this->history.get(), this->bufsiz * sizeof(float));
+      for (i = 1; i < window; ++i)
+        accumulateKernel(
+              sum,
+              this->history.get() + i * stride,
+              this->bufsiz);
+    }
+  } else if (!this->valid[trace]) {
+    memcpy(out, data, this->bufsiz * sizeof(float));
+  } else {
+    switch (trace) {
+      case AVERAGER_TRACE_MAX_HOLD:
+        maxKernel(out, data, this->bufsiz);
+        break;
+
+      case AVERAGER_TRACE_MIN_HOLD:
+        minKernel(out, data, this->bufsiz);
+        break;
+
+      case AVERAGER_TRACE_PERCENTILE:
+        percentileKernel(
+              out,
+              data,
+              SIGDIGGER_AVERAGER_PERCENTILE_STEP * this->percentile,
+              SIGDIGGER_AVERAGER_PERCENTILE_STEP * (1 - this->percentile),
+              this->bufsiz);
+        break;
+
+      default:
+        break;
+    }
+  }
+
+  this->valid[trace] = true;
+}
+
+void
+Averager::feed(const float *data, unsigned long size)
 {
   bool blend = this->alpha != 1.f;
+  unsigned int i;
 
-  if (this->last == nullptr || m.size() != this->bufsiz) {
+  if (size != this->bufsiz) {
     try {
-      float *buf = new float[m.size()];
-      if (this->last != nullptr)
-        delete [] this->last;
-      this->last = buf;
-      this->bufsiz = m.size();
-      blend = false;
+      this->average.reserve(size);
     } catch (std::bad_alloc &) {
       throw Suscan::Exception("Failed to allocate PSD buffer");
     }
-  }
 
-  if (blend) {
-    const SUFLOAT *original = m.get();
-    for (unsigned long i = 0; i < this->bufsiz; ++i)
-      this->last[i] += this->alpha * (original[i] - this->last[i]);
-  } else {
-    memcpy(this->last, m.get(), m.size() * sizeof(float));
+    this->bufsiz = size;
+    this->resetTraces();
+    blend = false;
   }
+
+  if (blend)
+    blendKernel(this->average.get(), data, this->alpha, size);
+  else
+    memcpy(this->average.get(), data, size * sizeof(float));
+
+  for (i = 0; i < AVERAGER_TRACE_COUNT; ++i)
+    if (this->enabled[i])
+      this->feedTrace(static_cast<AveragerTrace>(i), data);
+}
+
+void
+Averager::feed(Suscan::PSDMessage const &m)
+{
+  this->feed(m.get(), m.size());
 }
 
 void
@@ -54,8 +344,37 @@ Averager::setAlpha(float alpha)
   this->alpha = alpha;
 }
 
-Averager::~Averager(void)
+void
+Averager::setTraceEnabled(AveragerTrace trace, bool enabled)
+{
+  if (this->enabled[trace] == enabled)
+    return;
+
+  this->enabled[trace] = enabled;
+  this->valid[trace] = false;
+
+  if (trace == AVERAGER_TRACE_WINDOW_MEAN) {
+    this->resetWindow();
+
+    // The only buffer that can get big
+    if (!enabled)
+      this->history.release();
+  }
+}
+
+void
+Averager::setWindowLength(unsigned int frames)
 {
-  this->reset();
+  frames = std::max(2u, std::min<unsigned int>(frames, SIGDIGGER_AVERAGER_MAX_WINDOW));
+
+  if (frames != this->windowLength) {
+    this->windowLength = frames;
+    this->resetWindow();
+  }
 }
 
+void
+Averager::setPercentile(float percentile)
+{
+  this->percentile = std::max(.01f, std::min(percentile, .99f));
+}
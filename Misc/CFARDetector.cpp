@@ -0,0 +1,642 @@
+//
+//    CFARDetector.cpp: Finds and tracks carriers in PSD frames
+//    Copyright (C) 2020 Gonzalo José Carracedo Carballal
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as
+//    published by the Free Software Foundation, either version 3 of the
+//    License, or (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful, but
+//    WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public
+//    License along with this program.  If not, see
+//    <http://www.gnu.org/licenses/>
+//
+
+#include "CFARDetector.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__)
+#  include <emmintrin.h>
+#  define SIGDIGGER_CFAR_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#  include <arm_neon.h>
+#  define SIGDIGGER_CFAR_NEON
+#endif
+
+// How fast tracks follow their detections
+#define SIGDIGGER_CFAR_TRACK_ALPHA .25
+
+#define LN10_10 .2302585093 // ln(10) / 10
+
+using namespace SigDigger;
+
+//////////////////////////////// Kernels //////////////////////////////////////
+// level += alpha * (in - level). in may be unaligned (the message buffer).
+static void
+integrate(const float *in, float *level, float alpha, size_t len)
+{
+  size_t i = 0;
+
+#if defined(SIGDIGGER_CFAR_SSE2)
+  const __m128 a = _mm_set1_ps(alpha);
+
+  for (; i + 4 <= len; i += 4) {
+    __m128 x = _mm_loadu_ps(in + i);
+    __m128 y = _mm_load_ps(level + i);
+
+    _mm_store_ps(level + i, _mm_add_ps(y, _mm_mul_ps(a, _mm_sub_ps(x, y))));
+  }
+#elif defined(SIGDIGGER_CFAR_NEON)
+  for (; i + 4 <= len; i += 4) {
+    float32x4_t x = vld1q_f32(in + i);
+    float32x4_t y = vld1q_f32(level + i);
+
+    vst1q_f32(level + i, vmlaq_n_f32(y, vsubq_f32(x, y), alpha));
+  }
+#endif
+
+  for (; i < len; ++i)
+    level[i] += alpha * (in[i] - level[i]);
+}
+
+// Mean of the cells [i - g - r, i - g) and (i + g, i + g + r], for every i
+// in [from, to), into out[i]. Both windows must be inside the frame.
+// prefix[j] is the sum of the first j cells.
+static void
+slidingMean(
+    const double *prefix,
+    float *out,
+    size_t g,
+    size_t r,
+    size_t from,
+    size_t to)
+{
+  const double k = 1. / (2 * r);
+  const double *lo = prefix + from - g - r; // Left window starts
+  const double *li = prefix + from - g;     // Left window ends
+  const double *ri = prefix + from + g + 1; // Right window starts
+  const double *ro = prefix + from + g + r + 1;
+  size_t len = to - from;
+  size_t i = 0;
+
+  out += from;
+
+#if defined(SIGDIGGER_CFAR_SSE2)
+  const __m128d kk = _mm_set1_pd(k);
+
+  for (; i + 4 <= len; i += 4) {
+    __m128d a = _mm_mul_pd(
+          kk,
+          _mm_add_pd(
+            _mm_sub_pd(_mm_loadu_pd(li + i), _mm_loadu_pd(lo + i)),
+            _mm_sub_pd(_mm_loadu_pd(ro + i), _mm_loadu_pd(ri + i))));
+    __m128d b = _mm_mul_pd(
+          kk,
+          _mm_add_pd(
+            _mm_sub_pd(_mm_loadu_pd(li + i + 2), _mm_loadu_pd(lo + i + 2)),
+            _mm_sub_pd(_mm_loadu_pd(ro + i + 2), _mm_loadu_pd(ri + i + 2))));
+
+    _mm_storeu_ps(out + i, _mm_movelh_ps(_mm_cvtpd_ps(a), _mm_cvtpd_ps(b)));
+  }
+#elif defined(SIGDIGGER_CFAR_NEON)
+  for (; i + 4 <= len; i += 4) {
+    float64x2_t a = vmulq_n_f64(
+          vaddq_f64(
+            vsubq_f64(vld1q_f64(li + i), vld1q_f64(lo + i)),
+            vsubq_f64(vld1q_f64(ro + i), vld1q_f64(ri + i))),
+          k);
+    float64x2_t b = vmulq_n_f64(
+          vaddq_f64(
+            vsubq_f64(vld1q_f64(li + i + 2), vld1q_f64(lo + i + 2)),
+            vsubq_f64(vld1q_f64(ro + i + 2), vld1q_f64(ri + i + 2))),
+          k);
+
+    vst1q_f32(out + i, vcombine_f32(vcvt_f32_f64(a), vcvt_f32_f64(b)));
+  }
+#endif
+
+  for (; i < len; ++i)
+    out[i] = static_cast<float>(k * (li[i] - lo[i] + ro[i] - ri[i]));
+}
+
+// 2 over on, 1 over off, 0 otherwise. Bins in active go from 1 to 2.
+static void
+classify(
+    const float *level,
+    const float *noise,
+    const uint8_t *active,
+    uint8_t *codes,
+    float on,
+    float off,
+    size_t len)
+{
+  size_t i = 0;
+
+#if defined(SIGDIGGER_CFAR_SSE2)
+  const __m128 vOn  = _mm_set1_ps(on);
+  const __m128 vOff = _mm_set1_ps(off);
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i one  = _mm_set1_epi8(1);
+
+  for (; i + 16 <= len; i += 16) {
+    __m128i c[4];
+    __m128i code;
+    unsigned int j;
+
+    // Masks are -1: 0 - (strong + weak) is the code
+    for (j = 0; j < 4; ++j) {
+      __m128 d = _mm_sub_ps(
+            _mm_load_ps(level + i + 4 * j),
+            _mm_load_ps(noise + i + 4 * j));
+
+      c[j] = _mm_sub_epi32(
+            zero,
+            _mm_add_epi32(
+              _mm_castps_si128(_mm_cmpge_ps(d, vOn)),
+              _mm_castps_si128(_mm_cmpge_ps(d, vOff))));
+    }
+
+    code = _mm_packs_epi16(
+          _mm_packs_epi32(c[0], c[1]),
+          _mm_packs_epi32(c[2], c[3]));
+    code = _mm_add_epi8(
+          code,
+          _mm_and_si128(
+            _mm_cmpeq_epi8(code, one),
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(active + i))));
+
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(codes + i), code);
+  }
+#elif defined(SIGDIGGER_CFAR_NEON)
+  const float32x4_t vOn  = vdupq_n_f32(on);
+  const float32x4_t vOff = vdupq_n_f32(off);
+  const uint32x4_t zero  = vdupq_n_u32(0);
+
+  for (; i + 16 <= len; i += 16) {
+    uint16x8_t h[2];
+    uint8x16_t code;
+    unsigned int j;
+
+    for (j = 0; j < 2; ++j) {
+      float32x4_t d0 = vsubq_f32(
+            vld1q_f32(level + i + 8 * j),
+            vld1q_f32(noise + i + 8 * j));
+      float32x4_t d1 = vsubq_f32(
+            vld1q_f32(level + i + 8 * j + 4),
+            vld1q_f32(noise + i + 8 * j + 4));
+      uint32x4_t c0 = vsubq_u32(
+            zero,
+            vaddq_u32(vcgeq_f32(d0, vOn), vcgeq_f32(d0, vOff)));
+      uint32x4_t c1 = vsubq_u32(
+            zero,
+            vaddq_u32(vcgeq_f32(d1, vOn), vcgeq_f32(d1, vOff)));
+
+      h[j] = vcombine_u16(vmovn_u32(c0), vmovn_u32(c1));
+    }
+
+    code = vcombine_u8(vmovn_u16(h[0]), vmovn_u16(h[1]));
+    code = vaddq_u8(
+          code,
+          vandq_u8(vceqq_u8(code, vdupq_n_u8(1)), vld1q_u8(active + i)));
+
+    vst1q_u8(codes + i, code);
+  }
+#endif
+
+  for (; i < len; ++i) {
+    float d = level[i] - noise[i];
+
+    if (d >= on)
+      codes[i] = 2;
+    else if (d >= off)
+      codes[i] = static_cast<uint8_t>(1 + active[i]);
+    else
+      codes[i] = 0;
+  }
+}
+
+// Levels to histogram cells, from min, scale cells per dB
+static void
+quantize(const float *in, uint16_t *out, float min, float scale, size_t len)
+{
+  const float top = SIGDIGGER_CFAR_OS_HISTOGRAM - 1;
+  size_t i = 0;
+
+#if defined(SIGDIGGER_CFAR_SSE2)
+  const __m128 vMin = _mm_set1_ps(min);
+  const __m128 vScale = _mm_set1_ps(scale);
+  const __m128 vTop = _mm_set1_ps(top);
+  const __m128 zero = _mm_setzero_ps();
+
+  for (; i + 8 <= len; i += 8) {
+    __m128 a = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(in + i), vMin), vScale);
+    __m128 b = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(in + i + 4), vMin), vScale);
+
+    a = _mm_min_ps(_mm_max_ps(a, zero), vTop);
+    b = _mm_min_ps(_mm_max_ps(b, zero), vTop);
+
+    _mm_storeu_si128(
+          reinterpret_cast<__m128i *>(out + i),
+          _mm_packs_epi32(_mm_cvttps_epi32(a), _mm_cvttps_epi32(b)));
+  }
+#elif defined(SIGDIGGER_CFAR_NEON)
+  const float32x4_t vMin = vdupq_n_f32(min);
+  const float32x4_t vTop = vdupq_n_f32(top);
+  const float32x4_t zero = vdupq_n_f32(0);
+
+  for (; i + 8 <= len; i += 8) {
+    float32x4_t a = vmulq_n_f32(vsubq_f32(vld1q_f32(in + i), vMin), scale);
+    float32x4_t b = vmulq_n_f32(vsubq_f32(vld1q_f32(in + i + 4), vMin), scale);
+
+    a = vminq_f32(vmaxq_f32(a, zero), vTop);
+    b = vminq_f32(vmaxq_f32(b, zero), vTop);
+
+    vst1q_u16(
+          out + i,
+          vcombine_u16(
+            vmovn_u32(vcvtq_u32_f32(a)),
+            vmovn_u32(vcvtq_u32_f32(b))));
+  }
+#endif
+
+  for (; i < len; ++i)
+    out[i] = static_cast<uint16_t>(
+          std::min(std::max((in[i] - min) * scale, 0.f), top));
+}
+
+///////////////////////////// CFARDetector ////////////////////////////////////
+void
+CFARDetector::setParams(CFARParams const &params)
+{
+  this->params = params;
+
+  this->params.referenceCells = std::max(this->params.referenceCells, 1u);
+  this->params.rank = std::min(std::max(this->params.rank, 0.f), 1.f);
+  this->params.hysteresis = std::max(this->params.hysteresis, 0.f);
+  this->params.confirm = std::max(this->params.confirm, 1u);
+
+  if (!(this->params.integration > 0 && this->params.integration <= 1))
+    this->params.integration = 1;
+}
+
+void
+CFARDetector::reset(void)
+{
+  this->size = 0;
+  this->tracks.clear();
+}
+
+// Windows are clipped at the edges of the frame
+void
+CFARDetector::estimateCellAveraging(void)
+{
+  const float *x = this->level.get();
+  float *n = this->noise.get();
+  double *p = this->prefix.data();
+  size_t g = this->params.guardCells;
+  size_t r = this->params.referenceCells;
+  size_t i, lo, hi, count, from, to;
+  double sum;
+
+  p[0] = 0;
+  for (i = 0; i < this->size; ++i)
+    p[i + 1] = p[i] + x[i];
+
+  from = std::min(g + r, this->size);
+  to = this->size > g + r ? this->size - g - r : 0;
+  if (to < from)
+    to = from;
+  else
+    slidingMean(p, n, g, r, from, to);
+
+  for (i = 0; i < this->size; ++i) {
+    if (i == from)
+      i = to;
+    if (i == this->size)
+      break;
+
+    sum = 0;
+    count = 0;
+
+    if (i > g) {
+      lo = i > g + r ? i - g - r : 0;
+      sum += p[i - g] - p[lo];
+      count += i - g - lo;
+    }
+
+    if (i + g + 1 < this->size) {
+      hi = std::min(i + g + r + 1, this->size);
+      sum += p[hi] - p[i + g + 1];
+      count += hi - i - g - 1;
+    }
+
+    n[i] = count > 0 ? static_cast<float>(sum / count) : x[i];
+  }
+}
+
+// Exact rank of every window, on a histogram of the quantized levels. The
+// window moves by one cell each way per bin, and so does the rank, give
+// or take a few quanta: the histogram is walked from where it was left.
+void
+CFARDetector::estimateOrderedStatistic(void)
+{
+  const float *x = this->level.get();
+  float *n = this->noise.get();
+  const uint16_t *q;
+  unsigned int *hist;
+  long size = static_cast<long>(this->size);
+  long g = this->params.guardCells;
+  long r = this->params.referenceCells;
+  long i, j;
+  size_t count = 0, below = 0, k, ptr = 0;
+  float min, max, quantum;
+
+  auto bounds = std::minmax_element(x, x + this->size);
+  min = *bounds.first;
+  max = *bounds.second;
+  quantum = std::max(
+        SIGDIGGER_CFAR_OS_QUANTUM,
+        (max - min) / (SIGDIGGER_CFAR_OS_HISTOGRAM - 1));
+
+  this->quantized.resize(this->size);
+  this->histogram.assign(SIGDIGGER_CFAR_OS_HISTOGRAM, 0);
+  q = this->quantized.data();
+  hist = this->histogram.data();
+
+  quantize(x, this->quantized.data(), min, 1 / quantum, this->size);
+
+  auto add = [&] (long cell) {
+    if (cell >= 0 && cell < size) {
+      ++hist[q[cell]];
+      ++count;
+      if (q[cell] < ptr)
+        ++below;
+    }
+  };
+
+  auto remove = [&] (long cell) {
+    if (cell >= 0 && cell < size) {
+      --hist[q[cell]];
+      --count;
+      if (q[cell] < ptr)
+        --below;
+    }
+  };
+
+  // Right window of bin 0. Its left window is empty.
+  for (j = g + 1; j <= g + r; ++j)
+    add(j);
+
+  for (i = 0; i < size; ++i) {
+    if (i > 0) {
+      add(i - 1 - g);
+      remove(i - 1 - g - r);
+      remove(i + g);
+      add(i + g + r);
+    }
+
+    if (count == 0) {
+      n[i] = x[i];
+      continue;
+    }
+
+    k = std::min(static_cast<size_t>(this->params.rank * count), count - 1);
+
+    while (below > k)
+      below -= hist[--ptr];
+    while (below + hist[ptr] <= k)
+      below += hist[ptr++];
+
+    n[i] = min + (ptr + .5f) * quantum;
+  }
+}
+
+void
+CFARDetector::findRegions(void)
+{
+  const uint8_t *code = this->codes.data();
+  size_t n = this->size;
+  size_t i = 0, start, regionStart = 0, regionEnd = 0;
+  bool strong, have = false;
+  uint64_t word;
+
+  this->detections.clear();
+  std::fill(this->active.begin(), this->active.end(), 0);
+
+  while (i < n) {
+    // Most of the frame is noise: skip it 8 bins at a time
+    while (i + 8 <= n) {
+      memcpy(&word, code + i, sizeof(word));
+      if (word != 0)
+        break;
+      i += 8;
+    }
+
+    if (i == n)
+      break;
+
+    if (code[i] == 0) {
+      ++i;
+      continue;
+    }
+
+    start = i;
+    strong = false;
+    for (; i < n && code[i] != 0; ++i)
+      if (code[i] == 2)
+        strong = true;
+
+    if (!strong)
+      continue;
+
+    if (have && start - regionEnd <= this->params.mergeGap) {
+      regionEnd = i;
+    } else {
+      if (have)
+        this->measure(regionStart, regionEnd);
+      regionStart = start;
+      regionEnd = i;
+      have = true;
+    }
+  }
+
+  if (have)
+    this->measure(regionStart, regionEnd);
+}
+
+// Center from the power over the noise, so a sloped floor does not pull it
+void
+CFARDetector::measure(size_t start, size_t end)
+{
+  const float *x = this->level.get();
+  const float *n = this->noise.get();
+  qreal binWidth = this->sampleRate / this->size;
+  DetectedChannel det;
+  double ratio, excess, power = 0, weights = 0, moment = 0;
+  qreal center;
+  float peak = x[start];
+  size_t i;
+
+  if (this->detections.size() >= SIGDIGGER_CFAR_MAX_DETECTIONS)
+    return;
+
+  for (i = start; i < end; ++i) {
+    ratio = std::exp(LN10_10 * (x[i] - n[i]));
+    excess = std::max(ratio - 1, 0.);
+    power += ratio;
+    weights += excess;
+    moment += excess * i;
+    peak = std::max(peak, x[i]);
+  }
+
+  center = weights > 0 ? moment / weights : .5 * (start + end - 1);
+
+  det.frequency =
+      this->frequency + (center - .5 * this->size) * binWidth;
+  det.bandwidth = (end - start) * binWidth;
+  det.snr = static_cast<float>(10 * std::log10(power / (end - start)));
+  det.peak = peak;
+
+  this->detections.push_back(det);
+  std::fill(this->active.begin() + static_cast<long>(start),
+            this->active.begin() + static_cast<long>(end),
+            1);
+}
+
+// Detections and tracks, both by frequency, are walked together. A
+// detection takes over the first track it overlaps. If it overlaps
+// more (they merged), the rest are left to expire.
+void
+CFARDetector::track(qint64 time)
+{
+  qreal alpha = SIGDIGGER_CFAR_TRACK_ALPHA;
+  size_t t = 0;
+
+  this->merged.clear();
+
+  auto carry = [&] (DetectedChannel &track) {
+    track.present = false;
+    if (track.hits >= this->params.confirm
+        && time - track.lastSeen <= this->params.holdTime)
+      this->merged.push_back(track);
+  };
+
+  for (auto &det : this->detections) {
+    while (t < this->tracks.size()
+           && this->tracks[t].frequency + .5 * this->tracks[t].bandwidth
+           < det.frequency - .5 * det.bandwidth)
+      carry(this->tracks[t++]);
+
+    if (t < this->tracks.size()
+        && this->tracks[t].frequency - .5 * this->tracks[t].bandwidth
+        <= det.frequency + .5 * det.bandwidth) {
+      DetectedChannel &track = this->tracks[t++];
+
+      track.frequency += alpha * (det.frequency - track.frequency);
+      track.bandwidth += alpha * (det.bandwidth - track.bandwidth);
+      track.snr += static_cast<float>(alpha) * (det.snr - track.snr);
+      track.peak = det.peak;
+      track.lastSeen = time;
+      track.present = true;
+      ++track.hits;
+
+      this->merged.push_back(track);
+    } else {
+      det.id = ++this->lastId;
+      det.firstSeen = det.lastSeen = time;
+      det.hits = 1;
+      det.present = true;
+
+      this->merged.push_back(det);
+    }
+  }
+
+  while (t < this->tracks.size())
+    carry(this->tracks[t++]);
+
+  std::sort(
+        this->merged.begin(),
+        this->merged.end(),
+        [] (DetectedChannel const &a, DetectedChannel const &b) {
+          return a.frequency < b.frequency;
+        });
+
+  this->tracks.swap(this->merged);
+}
+
+void
+CFARDetector::feed(
+    const float *data,
+    size_t size,
+    qreal frequency,
+    qreal sampleRate,
+    qint64 time)
+{
+  float on = this->params.threshold;
+  float off = this->params.threshold - this->params.hysteresis;
+
+  if (size == 0 || sampleRate <= 0)
+    return;
+
+  // Retuned: integration starts over. Tracks are kept, they are in Hz.
+  if (size != this->size
+      || frequency != this->frequency
+      || sampleRate != this->sampleRate) {
+    this->size = size;
+    this->frequency = frequency;
+    this->sampleRate = sampleRate;
+
+    this->level.reserve(size);
+    this->noise.reserve(size);
+    this->prefix.resize(size + 1);
+    this->codes.resize(size);
+    this->active.assign(size, 0);
+
+    std::copy(data, data + size, this->level.get());
+    this->frames = 1;
+  } else {
+    integrate(data, this->level.get(), this->params.integration, size);
+    ++this->frames;
+  }
+
+  // Raw frames are too noisy to compare against the threshold
+  if (this->frames * this->params.integration < 1) {
+    this->detections.clear();
+    this->track(time);
+    return;
+  }
+
+  if (this->params.method == CFAR_ORDERED_STATISTIC)
+    this->estimateOrderedStatistic();
+  else
+    this->estimateCellAveraging();
+
+  classify(
+        this->level.get(),
+        this->noise.get(),
+        this->active.data(),
+        this->codes.data(),
+        on,
+        off,
+        size);
+
+  this->findRegions();
+  this->track(time);
+}
+
+void
+CFARDetector::getChannels(std::vector<DetectedChannel> &channels) const
+{
+  channels.clear();
+
+  for (auto &track : this->tracks)
+    if (track.hits >= this->params.confirm)
+      channels.push_back(track);
+}
@@ -0,0 +1,396 @@
+//
+//    CaptureIndexWriter.cpp: Seek index and power summary of a capture
+//    Copyright (C) 2020 Gonzalo José Carracedo Carballal
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as
+//    published by the Free Software Foundation, either version 3 of the
+//    License, or (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful, but
+//    WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public
+//    License along with this program.  If not, see
+//    <http://www.gnu.org/licenses/>
+//
+
+#include "CaptureIndexWriter.h"
+#include "RotatingFileDataWriter.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+using namespace SigDigger;
+
+static inline SUFLOAT
+toDb(qreal power)
+{
+  return static_cast<SUFLOAT>(10 * std::log10(std::max(power, 1e-30)));
+}
+
+static bool
+writeAll(int fd, const void *data, size_t size)
+{
+  const uint8_t *bytes = static_cast<const uint8_t *>(data);
+  ssize_t result;
+
+  while (size > 0) {
+    result = ::write(fd, bytes, size);
+
+    if (result == -1 && errno == EINTR)
+      continue;
+
+    if (result < 1)
+      return false;
+
+    bytes += result;
+    size  -= static_cast<size_t>(result);
+  }
+
+  return true;
+}
+
+CaptureIndexWriter::CaptureIndexWriter(
+    GenericDataWriter *writer,
+    Params const &params)
+{
+  unsigned int i, bins;
+  quint64 windowsPerRecord;
+
+  this->writer = writer;
+  this->params = params;
+
+  bins = this->params.bins = std::max(this->params.bins, 2u);
+  this->params.recordSamples =
+      std::max<quint64>((this->params.recordSamples + bins - 1) / bins, 1)
+      * bins;
+
+  windowsPerRecord = this->params.recordSamples / bins;
+  this->stride = static_cast<unsigned int>(
+        std::max<quint64>(
+          windowsPerRecord / SIGDIGGER_CAPTURE_INDEX_MAX_SPECTRA,
+          1));
+
+  this->window.resize(bins);
+  this->psd.resize(bins);
+  this->record.resize(sizeof(CaptureIndexRecord) + bins);
+
+  this->taper.resize(bins);
+  for (i = 0; i < bins; ++i)
+    this->taper[i] = static_cast<SUFLOAT>(
+          .5 - .5 * std::cos(2 * PI * i / (bins - 1)));
+
+  // FFTW planning is not thread-safe, and suscan plans in its own
+  // threads too. Nothing serializes this plan against those: keep it an
+  // estimate, so that it is quick and does not measure anything.
+  this->fftBuffer = static_cast<SU_FFTW(_complex) *>(
+        SU_FFTW(_malloc)(bins * sizeof(SUCOMPLEX)));
+
+  if (this->fftBuffer != nullptr)
+    this->plan = SU_FFTW(_plan_dft_1d)(
+          static_cast<int>(bins),
+          this->fftBuffer,
+          this->fftBuffer,
+          FFTW_FORWARD,
+          FFTW_ESTIMATE);
+}
+
+CaptureIndexWriter::~CaptureIndexWriter()
+{
+  this->close();
+
+  if (this->plan != nullptr)
+    SU_FFTW(_destroy_plan)(this->plan);
+
+  if (this->fftBuffer != nullptr)
+    SU_FFTW(_free)(this->fftBuffer);
+
+  delete this->writer;
+}
+
+void
+CaptureIndexWriter::disable(void)
+{
+  if (this->fd != -1) {
+    ::close(this->fd);
+    this->fd = -1;
+  }
+
+  this->stopped = true;
+}
+
+std::string
+CaptureIndexWriter::indexPath(void) const
+{
+  if (this->params.segmentSamples == 0)
+    return this->params.stem + SIGDIGGER_CAPTURE_INDEX_EXTENSION;
+
+  return RotatingFileDataWriter::segmentStem(this->params.stem, this->segment)
+      + SIGDIGGER_CAPTURE_INDEX_EXTENSION;
+}
+
+// Starts the sidecar of the current segment
+bool
+CaptureIndexWriter::openIndex(void)
+{
+  CaptureIndexHeader header;
+
+  memset(&header, 0, sizeof(CaptureIndexHeader));
+  strncpy(header.magic, SIGDIGGER_CAPTURE_INDEX_MAGIC, sizeof(header.magic));
+  header.version        = SIGDIGGER_CAPTURE_INDEX_VERSION;
+  header.bins           = this->params.bins;
+  header.recordSamples  = this->params.recordSamples;
+  header.sampleRate     = this->params.sampleRate;
+  header.segmentSamples = this->params.segmentSamples;
+  header.startTime      = this->timeAt(this->position);
+  header.recordSize     = static_cast<uint32_t>(this->record.size());
+
+  this->fd = open(
+        this->indexPath().c_str(),
+        O_CREAT | O_TRUNC | O_WRONLY,
+        0600);
+
+  if (this->fd == -1 || !writeAll(this->fd, &header, sizeof(header))) {
+    this->disable();
+    return false;
+  }
+
+  return true;
+}
+
+// Without timestamps, assume the samples keep coming at their rate
+qint64
+CaptureIndexWriter::timeAt(quint64 position) const
+{
+  qreal delta = static_cast<qreal>(position)
+      - static_cast<qreal>(this->refPosition);
+
+  if (this->params.sampleRate <= 0)
+    return this->refTime;
+
+  return this->refTime
+      + static_cast<qint64>(std::round(1e6 * delta / this->params.sampleRate));
+}
+
+void
+CaptureIndexWriter::setTimestamp(qint64 usec)
+{
+  this->refPosition = this->position;
+  this->refTime = usec;
+
+  this->writer->setTimestamp(usec);
+}
+
+void
+CaptureIndexWriter::setStreamPosition(quint64 position)
+{
+  this->writer->setStreamPosition(position);
+}
+
+void
+CaptureIndexWriter::processWindow(size_t len)
+{
+  SUCOMPLEX *fft = reinterpret_cast<SUCOMPLEX *>(this->fftBuffer);
+  unsigned int i, bins = this->params.bins;
+  SUFLOAT power = 0;
+  qreal sum = 0;
+
+  for (i = 0; i < len; ++i)
+    sum += static_cast<qreal>(std::norm(this->window[i]));
+
+  this->powerSum += sum;
+  power = static_cast<SUFLOAT>(sum / len);
+
+  if (this->windows == 0 || power < this->minPower)
+    this->minPower = power;
+  if (this->windows == 0 || power > this->maxPower)
+    this->maxPower = power;
+
+  // Partial windows only happen at the very end. Leave them out.
+  if (len == bins
+      && this->plan != nullptr
+      && this->windows % this->stride == 0) {
+    for (i = 0; i < bins; ++i)
+      fft[i] = this->taper[i] * this->window[i];
+
+    SU_FFTW(_execute)(this->plan);
+
+    for (i = 0; i < bins; ++i)
+      this->psd[i] += std::norm(fft[i]);
+
+    ++this->spectra;
+  }
+
+  ++this->windows;
+}
+
+void
+CaptureIndexWriter::flushRecord(void)
+{
+  CaptureIndexRecord *header =
+      reinterpret_cast<CaptureIndexRecord *>(this->record.data());
+  uint8_t *spectrum = this->record.data() + sizeof(CaptureIndexRecord);
+  unsigned int i, bins = this->params.bins;
+  qreal gain = 0, db;
+
+  if (this->windowPtr > 0) {
+    this->processWindow(this->windowPtr);
+    this->windowPtr = 0;
+  }
+
+  if (this->recordCount == 0)
+    return;
+
+  // A full-scale tone in the center of a bin reads 0 dBFS
+  for (auto p : this->taper)
+    gain += static_cast<qreal>(p);
+  gain = 1. / (gain * gain * std::max(this->spectra, 1u));
+
+  header->position  = this->recordStart;
+  header->time      = this->timeAt(this->recordStart);
+  header->count     = static_cast<uint32_t>(this->recordCount);
+  header->minPower  = toDb(static_cast<qreal>(this->minPower));
+  header->meanPower = toDb(this->powerSum / this->recordCount);
+  header->maxPower  = toDb(static_cast<qreal>(this->maxPower));
+
+  for (i = 0; i < bins; ++i) {
+    db = static_cast<qreal>(
+          toDb(gain * static_cast<qreal>(this->psd[(i + bins / 2) % bins])));
+    spectrum[i] = static_cast<uint8_t>(
+          qBound(
+            0.,
+            std::round(2 * (db - SIGDIGGER_CAPTURE_INDEX_FLOOR_DB)),
+            255.));
+  }
+
+  if (this->fd != -1
+      && !writeAll(this->fd, this->record.data(), this->record.size()))
+    this->disable();
+
+  this->recordStart += this->recordCount;
+  this->recordCount  = 0;
+  this->powerSum     = 0;
+  this->windows      = 0;
+  this->spectra      = 0;
+  std::fill(this->psd.begin(), this->psd.end(), 0);
+}
+
+// Records and windows are aligned: a record is a whole number of windows.
+// The sidecar of a segment is opened with its first sample, and closed
+// with its last one.
+void
+CaptureIndexWriter::feed(const SUCOMPLEX *data, size_t len)
+{
+  quint64 segmentSamples = this->params.segmentSamples;
+  size_t chunk;
+  quint64 left;
+
+  while (len > 0) {
+    if (this->fd == -1 && !this->openIndex())
+      return;
+
+    chunk = this->params.bins - this->windowPtr;
+    left  = this->params.recordSamples - this->recordCount;
+
+    if (segmentSamples > 0)
+      left = std::min(left, segmentSamples - this->position % segmentSamples);
+
+    if (chunk > len)
+      chunk = len;
+    if (chunk > left)
+      chunk = static_cast<size_t>(left);
+
+    std::copy(
+          data,
+          data + chunk,
+          this->window.begin() + static_cast<ssize_t>(this->windowPtr));
+
+    this->windowPtr   += chunk;
+    this->recordCount += chunk;
+    this->position    += chunk;
+    data += chunk;
+    len  -= chunk;
+
+    if (this->windowPtr == this->params.bins) {
+      this->processWindow(this->params.bins);
+      this->windowPtr = 0;
+    }
+
+    if (segmentSamples > 0 && this->position % segmentSamples == 0) {
+      this->flushRecord();
+
+      if (this->fd != -1) {
+        ::close(this->fd);
+        this->fd = -1;
+        ++this->segment;
+      }
+    } else if (this->recordCount == this->params.recordSamples) {
+      this->flushRecord();
+    }
+
+    if (this->stopped)
+      return;
+  }
+}
+
+bool
+CaptureIndexWriter::prepare(void)
+{
+  struct timeval tv;
+
+  if (!this->writer->prepare())
+    return false;
+
+  if (this->prepared)
+    return true;
+
+  this->prepared = true;
+
+  gettimeofday(&tv, nullptr);
+  this->refTime = tv.tv_sec * 1000000ll + tv.tv_usec;
+
+  (void) this->openIndex();
+
+  return true;
+}
+
+bool
+CaptureIndexWriter::canWrite(void) const
+{
+  return this->writer->canWrite();
+}
+
+std::string
+CaptureIndexWriter::getError(void) const
+{
+  return this->writer->getError();
+}
+
+ssize_t
+CaptureIndexWriter::write(const SUCOMPLEX *data, size_t len)
+{
+  ssize_t result = this->writer->write(data, len);
+
+  // Nothing to summarize if the sidecar is gone
+  if (result > 0 && !this->stopped)
+    this->feed(data, static_cast<size_t>(result));
+
+  return result;
+}
+
+bool
+CaptureIndexWriter::close(void)
+{
+  if (this->fd != -1)
+    this->flushRecord();
+
+  this->disable();
+
+  return this->writer->close();
+}
@@ -0,0 +1,225 @@
+//
+//    ChannelDetector.cpp: Runs the CFAR detector in its own thread
+//    Copyright (C) 2020 Gonzalo José Carracedo Carballal
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as
+//    published by the Free Software Foundation, either version 3 of the
+//    License, or (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful, but
+//    WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public
+//    License along with this program.  If not, see
+//    <http://www.gnu.org/licenses/>
+//
+
+#include "ChannelDetector.h"
+#include "LatencyMonitor.h"
+
+using namespace SigDigger;
+
+///////////////////////////// ChannelDetectorWorker ///////////////////////////
+ChannelDetectorWorker::ChannelDetectorWorker(ChannelDetector *owner)
+{
+  this->owner = owner;
+}
+
+// Goes on until there are no frames left, so that frameReady is posted
+// once per burst of frames.
+void
+ChannelDetectorWorker::process(void)
+{
+  ChannelDetector *owner = this->owner;
+  Suscan::PSDMessage msg;
+  qint64 time, start, elapsed;
+  bool notify;
+
+  for (;;) {
+    {
+      std::lock_guard<std::mutex> guard(owner->mutex);
+
+      if (owner->paramsChanged) {
+        this->detector.setParams(owner->params);
+        owner->paramsChanged = false;
+      }
+
+      if (owner->resetRequested) {
+        this->detector.reset();
+        owner->resetRequested = false;
+      }
+
+      if (!owner->havePending) {
+        owner->framePosted = false;
+        return;
+      }
+
+      msg = owner->pending;
+      time = owner->pendingTime;
+      owner->pending = Suscan::PSDMessage();
+      owner->havePending = false;
+    }
+
+    start = LatencyMonitor::now();
+    this->detector.feed(
+          msg.get(),
+          msg.size(),
+          msg.getFrequency(),
+          msg.getSampleRate(),
+          time);
+    this->detector.getChannels(this->channels);
+    elapsed = LatencyMonitor::now() - start;
+
+    // Let go of the buffer before waiting for the next one
+    msg = Suscan::PSDMessage();
+
+    {
+      std::lock_guard<std::mutex> guard(owner->mutex);
+
+      owner->results.swap(this->channels);
+      if (owner->processed++ == 0)
+        owner->cost = elapsed;
+      else
+        owner->cost += .1 * (elapsed - owner->cost);
+
+      notify = !owner->resultsPosted;
+      owner->resultsPosted = true;
+    }
+
+    if (notify)
+      emit resultsReady();
+  }
+}
+
+//////////////////////////////// ChannelDetector //////////////////////////////
+ChannelDetector::ChannelDetector(QObject *parent) : QObject(parent)
+{
+  this->worker = new ChannelDetectorWorker(this);
+  this->workerThread = new QThread();
+
+  this->worker->moveToThread(this->workerThread);
+
+  connect(
+        this,
+        SIGNAL(frameReady(void)),
+        this->worker,
+        SLOT(process(void)));
+
+  connect(
+        this->worker,
+        SIGNAL(resultsReady(void)),
+        this,
+        SLOT(onResultsReady(void)));
+
+  this->workerThread->start();
+}
+
+ChannelDetector::~ChannelDetector()
+{
+  this->workerThread->quit();
+  this->workerThread->wait();
+
+  delete this->workerThread;
+  delete this->worker;
+}
+
+void
+ChannelDetector::setParams(CFARParams const &params)
+{
+  std::lock_guard<std::mutex> guard(this->mutex);
+
+  this->params = params;
+  this->paramsChanged = true;
+}
+
+void
+ChannelDetector::reset(void)
+{
+  {
+    std::lock_guard<std::mutex> guard(this->mutex);
+
+    this->pending = Suscan::PSDMessage();
+    this->havePending = false;
+    this->resetRequested = true;
+    this->results.clear();
+  }
+
+  this->channels.clear();
+  emit channelsChanged();
+}
+
+void
+ChannelDetector::feed(Suscan::PSDMessage const &msg, qint64 time)
+{
+  bool post;
+
+  {
+    std::lock_guard<std::mutex> guard(this->mutex);
+
+    if (this->havePending)
+      ++this->dropped;
+
+    this->pending = msg;
+    this->pendingTime = time;
+    this->havePending = true;
+
+    post = !this->framePosted;
+    this->framePosted = true;
+  }
+
+  if (post)
+    emit frameReady();
+}
+
+bool
+ChannelDetector::findChannel(quint32 id, DetectedChannel &channel) const
+{
+  for (auto &p : this->channels)
+    if (p.id == id) {
+      channel = p;
+      return true;
+    }
+
+  return false;
+}
+
+qreal
+ChannelDetector::getCost(void)
+{
+  std::lock_guard<std::mutex> guard(this->mutex);
+
+  return this->cost;
+}
+
+quint64
+ChannelDetector::getProcessedCount(void)
+{
+  std::lock_guard<std::mutex> guard(this->mutex);
+
+  return this->processed;
+}
+
+quint64
+ChannelDetector::getDroppedCount(void)
+{
+  std::lock_guard<std::mutex> guard(this->mutex);
+
+  return this->dropped;
+}
+
+//////////////////////////////// Slots ////////////////////////////////////////
+void
+ChannelDetector::onResultsReady(void)
+{
+  {
+    std::lock_guard<std::mutex> guard(this->mutex);
+
+    this->channels.swap(this->results);
+    this->resultsPosted = false;
+  }
+
+  emit channelsChanged();
+}
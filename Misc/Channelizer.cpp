@@ -0,0 +1,570 @@
+//
+//    Channelizer.cpp: Record many narrowband channels of the baseband
+//    Copyright (C) 2020 Gonzalo José Carracedo Carballal
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as
+//    published by the Free Software Foundation, either version 3 of the
+//    License, or (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful, but
+//    WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public
+//    License along with this program.  If not, see
+//    <http://www.gnu.org/licenses/>
+//
+
+#include "Channelizer.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace SigDigger;
+
+static inline qreal
+residual(qreal offset, qreal bin)
+{
+  return offset - std::round(offset / bin) * bin;
+}
+
+//
+// The widest bins that are no narrower than the spacing and keep every
+// channel inside the alias-free part of its bin. If the sample rate is
+// a multiple of the spacing and the channels are on its grid, this is
+// just rate / spacing. Otherwise, bins get wider until the channels fit.
+//
+unsigned int
+Channelizer::branchesFor(
+    qreal sampleRate,
+    qreal spacing,
+    std::vector<qreal> const &offsets)
+{
+  unsigned int branches;
+  qreal bin;
+  bool fits;
+
+  if (spacing <= 0 || sampleRate <= 0)
+    return 2;
+
+  branches = 2 * static_cast<unsigned int>(
+        std::min<qreal>(
+          std::floor(.5 * sampleRate / spacing),
+          .5 * SIGDIGGER_CHANNELIZER_MAX_BRANCHES));
+
+  for (; branches > 2; branches -= 2) {
+    bin = sampleRate / branches;
+    fits = std::all_of(
+          offsets.begin(),
+          offsets.end(),
+          [bin, spacing] (qreal offset) {
+            return std::fabs(residual(offset, bin)) + .5 * spacing
+                <= SIGDIGGER_CHANNELIZER_PASSBAND * bin;
+          });
+
+    if (fits)
+      break;
+  }
+
+  return std::max(branches, 2u);
+}
+
+Channelizer::Channelizer(
+    qreal sampleRate,
+    qreal spacing,
+    std::vector<qreal> const &offsets,
+    unsigned int threads,
+    QObject *parent) :
+  QObject(parent),
+  SampleFanoutSink(SIGDIGGER_CHANNELIZER_QUEUE_BLOCKS, OVERFLOW_DROP_NEWEST)
+{
+  qreal bin;
+  int index;
+  unsigned int i;
+
+  this->sampleRate = sampleRate;
+  this->branches   = branchesFor(sampleRate, spacing, offsets);
+  this->hop        = this->branches / 2;
+  bin              = sampleRate / this->branches;
+
+  // Leave some cores to the source and the GUI
+  if (threads == 0)
+    threads = std::thread::hardware_concurrency() / 2;
+
+  this->threads = std::max(
+        1u,
+        std::min(threads, static_cast<unsigned int>(
+                   SIGDIGGER_CHANNELIZER_MAX_THREADS)));
+
+  this->channels.resize(offsets.size());
+
+  for (i = 0; i < offsets.size(); ++i) {
+    index = static_cast<int>(std::round(offsets[i] / bin));
+
+    this->channels[i].bin = static_cast<unsigned int>(
+          (index % static_cast<int>(this->branches) + this->branches)
+          % this->branches);
+    this->channels[i].cycles =
+        residual(offsets[i], bin) / this->getChannelRate();
+    this->channels[i].step = std::polar(
+          1.f,
+          static_cast<SUFLOAT>(-2 * PI * this->channels[i].cycles));
+  }
+
+  this->designPrototype();
+}
+
+Channelizer::~Channelizer()
+{
+  this->finish();
+
+  if (this->plan != nullptr)
+    SU_FFTW(_destroy_plan)(this->plan);
+
+  for (auto &p : this->lanes) {
+    if (p.fold != nullptr)
+      SU_FFTW(_free)(p.fold);
+    if (p.spectrum != nullptr)
+      SU_FFTW(_free)(p.spectrum);
+  }
+}
+
+//
+// Blackman-windowed sinc, cut at one bin from the center. The transition
+// band of 12 taps per branch spans about half a bin on each side, which
+// leaves 3/4 of the bin flat and everything that folds onto it (beyond
+// 5/4 of a bin at twice the bin rate) in the stopband.
+//
+void
+Channelizer::designPrototype(void)
+{
+  unsigned int i, len = this->branches * this->taps;
+  qreal center = .5 * (len - 1);
+  qreal fc = 1. / this->branches;
+  qreal x, window, sum = 0;
+
+  this->prototype.resize(len);
+
+  for (i = 0; i < len; ++i) {
+    x = i - center;
+    window = .42
+        - .5 * std::cos(2 * PI * i / (len - 1))
+        + .08 * std::cos(4 * PI * i / (len - 1));
+
+    this->prototype[i] = static_cast<SUFLOAT>(
+          window * (std::fabs(x) < 1e-9 ? 2 * fc : std::sin(2 * PI * fc * x)
+                    / (PI * x)));
+    sum += static_cast<qreal>(this->prototype[i]);
+  }
+
+  // Unity gain at the center of every bin
+  for (auto &p : this->prototype)
+    p = static_cast<SUFLOAT>(p / sum);
+}
+
+qreal
+Channelizer::getChannelRate(void) const
+{
+  return this->sampleRate / this->hop;
+}
+
+unsigned int
+Channelizer::getChannelCount(void) const
+{
+  return static_cast<unsigned int>(this->channels.size());
+}
+
+unsigned int
+Channelizer::getBranches(void) const
+{
+  return this->branches;
+}
+
+// Samples written to every channel file
+quint64
+Channelizer::getSize(void) const
+{
+  return this->produced;
+}
+
+std::string
+Channelizer::getError(void) const
+{
+  std::lock_guard<std::mutex> lock(this->stageMutex);
+
+  return this->lastError;
+}
+
+void
+Channelizer::setError(std::string const &error)
+{
+  std::lock_guard<std::mutex> lock(this->stageMutex);
+
+  if (this->lastError.empty())
+    this->lastError = error;
+
+  this->failed = true;
+}
+
+void
+Channelizer::setWriter(unsigned int channel, GenericDataWriter *writer)
+{
+  if (channel < this->channels.size()) {
+    delete this->channels[channel].writer;
+    this->channels[channel].writer = writer;
+  } else {
+    delete writer;
+  }
+}
+
+//
+// Frame f starts at input[f * hop] and spans the whole prototype. The
+// polyphase sum folds it into M samples and the FFT mixes every bin
+// down to DC at once. Frames start M / 2 samples apart, so the phase of
+// bin k advances by pi * k from one frame to the next: odd bins flip
+// sign on odd frames.
+//
+void
+Channelizer::analyze(unsigned int lane, size_t first, size_t last)
+{
+  Lane &l = this->lanes[lane];
+  SUCOMPLEX *fold = reinterpret_cast<SUCOMPLEX *>(l.fold);
+  const SUCOMPLEX *spectrum = reinterpret_cast<const SUCOMPLEX *>(l.spectrum);
+  const SUFLOAT *h;
+  const SUCOMPLEX *x;
+  size_t count = this->channels.size();
+  size_t f, c;
+  unsigned int m, p;
+  quint64 t = this->frameCount + first;
+  qreal phase;
+  SUCOMPLEX z;
+
+  for (c = 0; c < count; ++c) {
+    phase = this->channels[c].cycles * static_cast<qreal>(t);
+    phase -= std::floor(phase);
+    l.phasor[c] = std::polar(1.f, static_cast<SUFLOAT>(-2 * PI * phase));
+  }
+
+  for (f = first; f < last; ++f, ++t) {
+    x = this->input.data() + f * this->hop;
+    h = this->prototype.data();
+
+    for (m = 0; m < this->branches; ++m)
+      fold[m] = h[m] * x[m];
+
+    for (p = 1; p < this->taps; ++p) {
+      h += this->branches;
+      x += this->branches;
+      for (m = 0; m < this->branches; ++m)
+        fold[m] += h[m] * x[m];
+    }
+
+    SU_FFTW(_execute_dft)(this->plan, l.fold, l.spectrum);
+
+    for (c = 0; c < count; ++c) {
+      z = spectrum[this->channels[c].bin];
+      if ((t & 1) && (this->channels[c].bin & 1))
+        z = -z;
+
+      this->output[c * this->frames + f] = z * l.phasor[c];
+      l.phasor[c] *= this->channels[c].step;
+    }
+  }
+}
+
+void
+Channelizer::store(unsigned int lane)
+{
+  size_t c, count = this->channels.size();
+  GenericDataWriter *writer;
+
+  for (c = lane; c < count && !this->failed; c += this->threads) {
+    if ((writer = this->channels[c].writer) == nullptr)
+      continue;
+
+    if (writer->write(
+          this->output.data() + c * this->frames,
+          this->frames) != static_cast<ssize_t>(this->frames))
+      this->setError(writer->getError());
+  }
+}
+
+void
+Channelizer::runStage(unsigned int lane, Stage stage)
+{
+  switch (stage) {
+    case STAGE_ANALYZE:
+      this->analyze(
+            lane,
+            this->frames * lane / this->threads,
+            this->frames * (lane + 1) / this->threads);
+      break;
+
+    case STAGE_STORE:
+      this->store(lane);
+      break;
+
+    default:
+      break;
+  }
+}
+
+// The dispatcher is lane 0
+void
+Channelizer::parallel(Stage stage)
+{
+  {
+    std::lock_guard<std::mutex> lock(this->stageMutex);
+    this->stage = stage;
+    this->busy  = static_cast<unsigned int>(this->helpers.size());
+    ++this->generation;
+  }
+
+  this->startCond.notify_all();
+
+  this->runStage(0, stage);
+
+  std::unique_lock<std::mutex> lock(this->stageMutex);
+  this->doneCond.wait(lock, [this] () { return this->busy == 0; });
+}
+
+void
+Channelizer::helperLoop(unsigned int lane)
+{
+  unsigned int generation = 0;
+  Stage stage;
+
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(this->stageMutex);
+
+      this->startCond.wait(
+            lock,
+            [this, generation] () { return this->generation != generation; });
+
+      generation = this->generation;
+      stage = this->stage;
+    }
+
+    if (stage == STAGE_EXIT)
+      return;
+
+    this->runStage(lane, stage);
+
+    {
+      std::lock_guard<std::mutex> lock(this->stageMutex);
+      --this->busy;
+    }
+
+    this->doneCond.notify_one();
+  }
+}
+
+void
+Channelizer::process(const SampleBlock *block)
+{
+  size_t len = this->branches * this->taps;
+  size_t skip;
+  quint64 start;
+  quint64 lost;
+  quint64 dropped = 0;
+
+  // Frames cannot span a gap. Start over after it, on the same grid:
+  // input begins where the next frame does, and the first frame after
+  // the gap is the first one that begins past it. Every frame in between
+  // (those that would have read the cleared input, the gap, or the
+  // samples skipped to get back on the grid) is reported as dropped.
+  // Frames are placed by where they begin, so priming the filterbank
+  // again does not shift them.
+  if (this->primed && block->position != this->next) {
+    start = this->next + this->skip - this->input.size();
+
+    if (block->position > start) {
+      lost = block->position - start;
+      dropped = (lost + this->hop - 1) / this->hop;
+      this->skip = dropped * this->hop - lost;
+    } else {
+      // Still skipping from the previous gap
+      this->skip = start - block->position;
+    }
+
+    this->input.clear();
+
+    if (dropped > 0)
+      emit samplesDropped(this->frameCount, dropped);
+  }
+
+  this->primed = true;
+  this->next = block->position + block->len;
+
+  skip = std::min<size_t>(this->skip, block->len);
+  this->skip -= skip;
+
+  this->input.insert(
+        this->input.end(),
+        block->data.begin() + static_cast<ssize_t>(skip),
+        block->data.begin() + static_cast<ssize_t>(block->len));
+
+  if (this->input.size() < len)
+    return;
+
+  this->frames = (this->input.size() - len) / this->hop + 1;
+  if (this->output.size() < this->frames * this->channels.size())
+    this->output.resize(this->frames * this->channels.size());
+
+  this->parallel(STAGE_ANALYZE);
+  this->parallel(STAGE_STORE);
+
+  this->frameCount += this->frames;
+  this->produced = this->frameCount;
+
+  this->input.erase(
+        this->input.begin(),
+        this->input.begin() + static_cast<ssize_t>(this->frames * this->hop));
+}
+
+void
+Channelizer::dispatcherLoop(void)
+{
+  SampleBlock *block;
+  bool exiting;
+
+  do {
+    {
+      std::unique_lock<std::mutex> lock(this->blockMutex);
+
+      this->blockCond.wait(
+            lock,
+            [this] () { return this->exiting || this->pending; });
+
+      this->pending = false;
+      exiting = this->exiting;
+    }
+
+    // Nothing arrives after detach(), so this ends
+    while ((block = this->pop()) != nullptr) {
+      if (!this->failed)
+        this->process(block);
+      this->release(block);
+    }
+
+    if (!this->failed) {
+      emit commit();
+    } else if (!this->reported) {
+      this->reported = true;
+      emit stopped();
+    }
+  } while (!exiting);
+}
+
+// Producer side
+void
+Channelizer::notify(void)
+{
+  {
+    std::lock_guard<std::mutex> lock(this->blockMutex);
+    this->pending = true;
+  }
+
+  this->blockCond.notify_one();
+}
+
+bool
+Channelizer::start(std::shared_ptr<SampleFanout> const &fanout)
+{
+  unsigned int i;
+
+  if (this->dispatcher.joinable())
+    return true;
+
+  for (auto &p : this->channels)
+    if (p.writer != nullptr && !p.writer->prepare()) {
+      this->setError(p.writer->getError());
+      return false;
+    }
+
+  this->lanes.resize(this->threads);
+
+  for (auto &p : this->lanes) {
+    p.fold = static_cast<SU_FFTW(_complex) *>(
+          SU_FFTW(_malloc)(this->branches * sizeof(SUCOMPLEX)));
+    p.spectrum = static_cast<SU_FFTW(_complex) *>(
+          SU_FFTW(_malloc)(this->branches * sizeof(SUCOMPLEX)));
+
+    if (p.fold == nullptr || p.spectrum == nullptr) {
+      this->setError("Failed to allocate FFT buffers");
+      return false;
+    }
+
+    p.phasor.resize(this->channels.size());
+  }
+
+  // Planning is not thread-safe. Every lane executes this plan on its
+  // own buffers, which FFTW allows as long as they are equally aligned.
+  if ((this->plan = SU_FFTW(_plan_dft_1d)(
+         static_cast<int>(this->branches),
+         this->lanes[0].fold,
+         this->lanes[0].spectrum,
+         FFTW_FORWARD,
+         FFTW_ESTIMATE)) == nullptr) {
+    this->setError("Failed to initialize FFT plan");
+    return false;
+  }
+
+  this->dispatcher = std::thread(&Channelizer::dispatcherLoop, this);
+
+  for (i = 1; i < this->threads; ++i)
+    this->helpers.push_back(std::thread(&Channelizer::helperLoop, this, i));
+
+  if (!this->attach(fanout)) {
+    this->setError("Too many consumers of the baseband stream");
+    this->finish();
+    return false;
+  }
+
+  return true;
+}
+
+void
+Channelizer::finish(void)
+{
+  this->detach();
+
+  if (this->dispatcher.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(this->blockMutex);
+      this->exiting = true;
+    }
+
+    this->blockCond.notify_one();
+    this->dispatcher.join();
+  }
+
+  // Helpers only leave between two stages
+  if (!this->helpers.empty()) {
+    {
+      std::lock_guard<std::mutex> lock(this->stageMutex);
+      this->stage = STAGE_EXIT;
+      ++this->generation;
+    }
+
+    this->startCond.notify_all();
+
+    for (auto &p : this->helpers)
+      p.join();
+
+    this->helpers.clear();
+  }
+
+  this->clear();
+
+  for (auto &p : this->channels) {
+    if (p.writer != nullptr) {
+      if (!p.writer->close())
+        this->setError(p.writer->getError());
+      delete p.writer;
+      p.writer = nullptr;
+    }
+  }
+}
@@ -0,0 +1,502 @@
+//
+//    DirectFileDataWriter.cpp: O_DIRECT file writer with deep async queues
+//    Copyright (C) 2020 Gonzalo José Carracedo Carballal
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as
+//    published by the Free Software Foundation, either version 3 of the
+//    License, or (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful, but
+//    WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public
+//    License along with this program.  If not, see
+//    <http://www.gnu.org/licenses/>
+//
+
+#include "DirectFileDataWriter.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+
+using namespace SigDigger;
+
+static bool
+pwriteAll(
+    int fd,
+    const uint8_t *data,
+    size_t size,
+    off_t offset,
+    std::string &error)
+{
+  ssize_t result;
+
+  while (size > 0) {
+    result = pwrite(fd, data, size, offset);
+
+    if (result == -1 && errno == EINTR)
+      continue;
+
+    if (result < 1) {
+      error = "pwrite() failed: " + std::string(strerror(errno));
+      return false;
+    }
+
+    data   += result;
+    size   -= static_cast<size_t>(result);
+    offset += result;
+  }
+
+  return true;
+}
+
+DirectFileDataWriter::DirectFileDataWriter(
+    int fd,
+    SampleConverter &converter,
+    unsigned int depth,
+    size_t bufferSize) : converter(converter)
+{
+  this->fd = fd;
+  this->depth = depth < 2 ? 2 : depth;
+  this->bufferSize =
+      (bufferSize + SIGDIGGER_DIRECTIO_ALIGNMENT - 1)
+      & ~static_cast<size_t>(SIGDIGGER_DIRECTIO_ALIGNMENT - 1);
+}
+
+void
+DirectFileDataWriter::setError(std::string const &error)
+{
+  this->lastError = error;
+  this->failed = true;
+}
+
+std::string
+DirectFileDataWriter::getError(void) const
+{
+  return this->lastError;
+}
+
+bool
+DirectFileDataWriter::canWrite(void) const
+{
+  return this->fd != -1;
+}
+
+bool
+DirectFileDataWriter::prepare(void)
+{
+  off_t pos;
+
+  if (this->prepared)
+    return true;
+
+  if (this->fd == -1) {
+    this->setError("Invalid file descriptor");
+    return false;
+  }
+
+#ifdef O_DIRECT
+  int flags;
+
+  // Filesystems like tmpfs refuse O_DIRECT. We still get the deep
+  // queue in that case, just not the page cache bypass.
+  if ((flags = fcntl(this->fd, F_GETFL)) != -1)
+    this->direct = fcntl(this->fd, F_SETFL, flags | O_DIRECT) != -1;
+#endif // O_DIRECT
+
+  if ((pos = lseek(this->fd, 0, SEEK_CUR)) == -1)
+    pos = 0;
+
+  if (this->direct && (pos % SIGDIGGER_DIRECTIO_ALIGNMENT) != 0) {
+    this->setError("File offset is not suitable for direct I/O");
+    return false;
+  }
+
+  this->offset = pos;
+
+  this->buffers.resize(this->depth);
+  for (unsigned int i = 0; i < this->depth; ++i) {
+    void *ptr = nullptr;
+
+    if (posix_memalign(
+          &ptr,
+          SIGDIGGER_DIRECTIO_ALIGNMENT,
+          this->bufferSize) != 0) {
+      this->setError("Failed to allocate direct I/O buffers");
+      return false;
+    }
+
+    this->buffers[i].data = static_cast<uint8_t *>(ptr);
+    this->freeList.push_back(i);
+  }
+
+#ifdef SIGDIGGER_HAVE_IO_URING
+  int ret;
+
+  if ((ret = io_uring_queue_init(this->depth, &this->ring, 0)) < 0) {
+    this->setError(
+          "Failed to initialize io_uring: " + std::string(strerror(-ret)));
+    return false;
+  }
+
+  this->ringInit = true;
+#else
+  for (unsigned int i = 0; i < this->depth; ++i)
+    this->pool.push_back(std::thread(&DirectFileDataWriter::poolWorker, this));
+#endif // SIGDIGGER_HAVE_IO_URING
+
+  this->prepared = true;
+
+  return true;
+}
+
+#ifdef SIGDIGGER_HAVE_IO_URING
+bool
+DirectFileDataWriter::submit(unsigned int index)
+{
+  struct io_uring_sqe *sqe;
+  Buffer &buf = this->buffers[index];
+  int ret;
+
+  // There are as many entries as buffers, this should never happen
+  if ((sqe = io_uring_get_sqe(&this->ring)) == nullptr) {
+    this->setError("io_uring submission queue is full");
+    return false;
+  }
+
+  io_uring_prep_write(sqe, this->fd, buf.data, buf.size, buf.offset);
+  io_uring_sqe_set_data(
+        sqe,
+        reinterpret_cast<void *>(static_cast<uintptr_t>(index)));
+
+  if ((ret = io_uring_submit(&this->ring)) < 0) {
+    this->setError("io_uring_submit() failed: " + std::string(strerror(-ret)));
+    return false;
+  }
+
+  ++this->inFlight;
+
+  return true;
+}
+
+bool
+DirectFileDataWriter::reap(bool wait)
+{
+  struct io_uring_cqe *cqe;
+  unsigned int index;
+  std::string error;
+  int ret, res;
+
+  while (this->inFlight > 0) {
+    ret = wait
+        ? io_uring_wait_cqe(&this->ring, &cqe)
+        : io_uring_peek_cqe(&this->ring, &cqe);
+
+    if (ret == -EAGAIN)
+      break;
+
+    if (ret == -EINTR)
+      continue;
+
+    if (ret < 0) {
+      this->setError(
+            "Failed to wait for completion: " + std::string(strerror(-ret)));
+      return false;
+    }
+
+    index = static_cast<unsigned int>(
+          reinterpret_cast<uintptr_t>(io_uring_cqe_get_data(cqe)));
+    res = cqe->res;
+    io_uring_cqe_seen(&this->ring, cqe);
+    --this->inFlight;
+
+    if (res < 0) {
+      this->setError("write() failed: " + std::string(strerror(-res)));
+      return false;
+    }
+
+    // Short writes are rare. Finish them synchronously.
+    if (static_cast<size_t>(res) < this->buffers[index].size) {
+      Buffer &buf = this->buffers[index];
+      if (!pwriteAll(
+            this->fd,
+            buf.data + res,
+            buf.size - static_cast<size_t>(res),
+            buf.offset + res,
+            error)) {
+        this->setError(error);
+        return false;
+      }
+    }
+
+    this->freeList.push_back(index);
+
+    // We got what we were waiting for. Collect the rest only if ready.
+    wait = false;
+  }
+
+  return true;
+}
+#else
+void
+DirectFileDataWriter::poolWorker(void)
+{
+  unsigned int index;
+  std::string error;
+  bool ok;
+
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(this->queueMutex);
+
+      this->queueCond.wait(
+            lock,
+            [this] () { return this->exiting || !this->pending.empty(); });
+
+      if (this->pending.empty())
+        return;
+
+      index = this->pending.front();
+      this->pending.pop_front();
+    }
+
+    ok = pwriteAll(
+          this->fd,
+          this->buffers[index].data,
+          this->buffers[index].size,
+          this->buffers[index].offset,
+          error);
+
+    {
+      std::lock_guard<std::mutex> lock(this->queueMutex);
+
+      if (!ok && !this->poolFailed) {
+        this->poolFailed = true;
+        this->poolError  = error;
+      }
+
+      this->freeList.push_back(index);
+      --this->inFlight;
+    }
+
+    this->doneCond.notify_all();
+  }
+}
+
+bool
+DirectFileDataWriter::submit(unsigned int index)
+{
+  {
+    std::lock_guard<std::mutex> lock(this->queueMutex);
+    this->pending.push_back(index);
+    ++this->inFlight;
+  }
+
+  this->queueCond.notify_one();
+
+  return true;
+}
+
+bool
+DirectFileDataWriter::reap(bool wait)
+{
+  std::unique_lock<std::mutex> lock(this->queueMutex);
+
+  if (wait)
+    this->doneCond.wait(
+          lock,
+          [this] () {
+            return this->poolFailed
+                || !this->freeList.empty()
+                || this->inFlight == 0;
+          });
+
+  if (this->poolFailed) {
+    this->setError(this->poolError);
+    return false;
+  }
+
+  return true;
+}
+#endif // SIGDIGGER_HAVE_IO_URING
+
+bool
+DirectFileDataWriter::acquire(void)
+{
+  // Collect finished requests without blocking
+  if (!this->reap(false))
+    return false;
+
+  for (;;) {
+    {
+#ifndef SIGDIGGER_HAVE_IO_URING
+      std::lock_guard<std::mutex> lock(this->queueMutex);
+#endif // SIGDIGGER_HAVE_IO_URING
+      if (!this->freeList.empty()) {
+        this->current = this->freeList.back();
+        this->freeList.pop_back();
+        break;
+      }
+    }
+
+    // All buffers are in flight. Wait for the device.
+    if (!this->reap(true))
+      return false;
+  }
+
+  this->buffers[this->current].size = 0;
+  this->haveCurrent = true;
+
+  return true;
+}
+
+bool
+DirectFileDataWriter::drain(void)
+{
+#ifdef SIGDIGGER_HAVE_IO_URING
+  while (this->inFlight > 0)
+    if (!this->reap(true))
+      return false;
+
+  return true;
+#else
+  // reap(true) returns as soon as one buffer is free, which is not enough
+  // here: wait for the last one.
+  std::unique_lock<std::mutex> lock(this->queueMutex);
+
+  this->doneCond.wait(
+        lock,
+        [this] () {
+          return this->poolFailed || this->inFlight == 0;
+        });
+
+  if (this->poolFailed) {
+    this->setError(this->poolError);
+    return false;
+  }
+
+  return true;
+#endif // SIGDIGGER_HAVE_IO_URING
+}
+
+ssize_t
+DirectFileDataWriter::write(const SUCOMPLEX *data, size_t len)
+{
+  size_t sampleSize = this->converter.getSampleSize();
+  size_t remaining = len;
+  size_t chunk;
+
+  if (this->fd == -1 || this->failed)
+    return -1;
+
+  while (remaining > 0) {
+    if (!this->haveCurrent && !this->acquire())
+      return -1;
+
+    Buffer &buf = this->buffers[this->current];
+
+    // Buffer sizes are multiples of the alignment, and therefore of
+    // every sample size. Samples never straddle two buffers.
+    chunk = (this->bufferSize - buf.size) / sampleSize;
+    if (chunk > remaining)
+      chunk = remaining;
+
+    this->converter.convert(buf.data + buf.size, data, chunk);
+
+    buf.size  += chunk * sampleSize;
+    data      += chunk;
+    remaining -= chunk;
+
+    if (buf.size == this->bufferSize) {
+      buf.offset = this->offset;
+      this->offset += static_cast<off_t>(buf.size);
+      this->haveCurrent = false;
+
+      if (!this->submit(this->current))
+        return -1;
+    }
+  }
+
+  return static_cast<ssize_t>(len);
+}
+
+bool
+DirectFileDataWriter::close(void)
+{
+  bool ok = true;
+
+  if (this->fd != -1) {
+    if (this->prepared && !this->failed) {
+      off_t size = this->offset;
+
+      // O_DIRECT only accepts whole blocks. Pad the last one with zeroes
+      // and truncate the file to its actual size afterwards.
+      if (this->haveCurrent && this->buffers[this->current].size > 0) {
+        Buffer &buf = this->buffers[this->current];
+        size_t padded = buf.size;
+
+        size += static_cast<off_t>(buf.size);
+
+        if (this->direct) {
+          padded =
+              (buf.size + SIGDIGGER_DIRECTIO_ALIGNMENT - 1)
+              & ~static_cast<size_t>(SIGDIGGER_DIRECTIO_ALIGNMENT - 1);
+          memset(buf.data + buf.size, 0, padded - buf.size);
+        }
+
+        buf.size = padded;
+        buf.offset = this->offset;
+        this->offset += static_cast<off_t>(padded);
+        this->haveCurrent = false;
+
+        ok = this->submit(this->current);
+      }
+
+      ok = this->drain() && ok;
+
+      if (this->direct && ftruncate(this->fd, size) == -1)
+        ok = false;
+    }
+
+#ifdef SIGDIGGER_HAVE_IO_URING
+    if (this->ringInit) {
+      io_uring_queue_exit(&this->ring);
+      this->ringInit = false;
+    }
+#else
+    {
+      std::lock_guard<std::mutex> lock(this->queueMutex);
+      this->exiting = true;
+    }
+
+    this->queueCond.notify_all();
+
+    for (auto &p : this->pool)
+      p.join();
+
+    this->pool.clear();
+#endif // SIGDIGGER_HAVE_IO_URING
+
+    ok = ::close(this->fd) == 0 && ok;
+    this->fd = -1;
+  }
+
+  for (auto &p : this->buffers)
+    if (p.data != nullptr)
+      free(p.data);
+
+  this->buffers.clear();
+  this->freeList.clear();
+
+  return ok;
+}
+
+DirectFileDataWriter::~DirectFileDataWriter(void)
+{
+  this->close();
+}
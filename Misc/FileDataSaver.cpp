@@ -18,7 +18,11 @@
 //
 
 #include "FileDataSaver.h"
+#include "DirectFileDataWriter.h"
+#include "RotatingFileDataWriter.h"
+#include "CaptureIndexWriter.h"
 #include <unistd.h>
+#include <cerrno>
 
 using namespace SigDigger;
 
@@ -26,9 +30,11 @@ namespace SigDigger {
   class FileDataWriter : public GenericDataWriter {
     int fd = -1;
     std::string lastError;
+    SampleConverter &converter;
+    std::vector<uint8_t> staging;
 
   public:
-    FileDataWriter(int fd);
+    FileDataWriter(int fd, SampleConverter &converter);
 
     bool prepare(void);
     bool canWrite(void) const;
@@ -51,7 +57,9 @@ FileDataWriter::prepare(void)
   return true;
 }
 
-FileDataWriter::FileDataWriter(int fd)
+FileDataWriter::FileDataWriter(
+    int fd,
+    SampleConverter &converter) : converter(converter)
 {
   this->fd = fd;
 }
@@ -65,17 +73,41 @@ FileDataWriter::canWrite(void) const
 ssize_t
 FileDataWriter::write(const SUCOMPLEX *data, size_t len)
 {
+  const uint8_t *bytes = reinterpret_cast<const uint8_t *>(data);
+  size_t size = len * this->converter.getSampleSize();
   ssize_t result;
 
   if (this->fd == -1)
     return 0;
 
-  result = ::write(this->fd, data, len * sizeof(*data));
+  // Native samples go straight to disk. The rest are packed here, in the
+  // writer thread, so the producer never pays for the conversion.
+  if (this->converter.getFormat() != SAMPLE_FORMAT_CF32) {
+    if (this->staging.size() < size)
+      this->staging.resize(size);
 
-  if (result < 1)
-    lastError = "write() failed: " + std::string(strerror(errno));
+    this->converter.convert(this->staging.data(), data, len);
+    bytes = this->staging.data();
+  }
+
+  // A partially written sample cannot be reported back. Finish the whole
+  // block here.
+  while (size > 0) {
+    result = ::write(this->fd, bytes, size);
+
+    if (result == -1 && errno == EINTR)
+      continue;
+
+    if (result < 1) {
+      lastError = "write() failed: " + std::string(strerror(errno));
+      return -1;
+    }
 
-  return result / static_cast<ssize_t>(sizeof(*data));
+    bytes += result;
+    size  -= static_cast<size_t>(result);
+  }
+
+  return static_cast<ssize_t>(len);
 }
 
 bool
@@ -97,14 +129,95 @@ FileDataWriter::~FileDataWriter(void)
 }
 
 //////////////////////////// FileDataSaver /////////////////////////////////////
-FileDataSaver::FileDataSaver(int fd, QObject *parent) :
-  GenericDataSaver(this->writer = new FileDataWriter(fd), parent)
+std::string
+FileDataSaver::segmentStem(std::string const &stem, unsigned int index)
+{
+  return RotatingFileDataWriter::segmentStem(stem, index);
+}
+
+GenericDataWriter *
+FileDataSaver::makeFileWriter(int fd, SampleConverter &converter)
+{
+  return new FileDataWriter(fd, converter);
+}
+
+FileDataSaver::WriterHandle
+FileDataSaver::makeWriter(FileDataParams const &params)
+{
+  WriterHandle handle;
+  SampleConverter *converter =
+      new SampleConverter(params.format, params.fullScale);
+  Backend backend = params.backend;
+  RotatingFileDataWriter::Factory factory =
+      [converter, backend] (int fd) -> GenericDataWriter * {
+        if (backend == DIRECT_IO)
+          return new DirectFileDataWriter(fd, *converter);
+
+        return makeFileWriter(fd, *converter);
+      };
+
+  if (params.segmentSamples > 0) {
+    RotatingFileDataWriter::Params rotParams;
+
+    rotParams.stem           = params.stem;
+    rotParams.extension      = params.extension;
+    rotParams.companions     = params.companions;
+    rotParams.segmentSamples = params.segmentSamples;
+    rotParams.sampleSize     = converter->getSampleSize();
+    rotParams.retain         = params.retain;
+
+    // One index per segment, removed along with it
+    if (params.index)
+      rotParams.companions.push_back(SIGDIGGER_CAPTURE_INDEX_EXTENSION);
+
+    handle.writer = new RotatingFileDataWriter(params.fd, rotParams, factory);
+  } else {
+    handle.writer = factory(params.fd);
+  }
+
+  // Above rotation, so that positions in the index are global
+  if (params.index) {
+    CaptureIndexWriter::Params indexParams;
+
+    indexParams.stem           = params.stem;
+    indexParams.sampleRate     = params.sampleRate;
+    indexParams.segmentSamples = params.segmentSamples;
+    indexParams.recordSamples  = static_cast<quint64>(
+          params.sampleRate / SIGDIGGER_CAPTURE_INDEX_RECORDS_PER_SECOND);
+
+    handle.writer = new CaptureIndexWriter(handle.writer, indexParams);
+  }
+
+  handle.converter = converter;
+
+  return handle;
+}
+
+FileDataSaver::FileDataSaver(WriterHandle const &handle, QObject *parent) :
+  GenericDataSaver(handle.writer, parent),
+  writer(handle.writer),
+  converter(handle.converter)
 {
 }
 
+FileDataSaver::FileDataSaver(FileDataParams const &params, QObject *parent) :
+  FileDataSaver(makeWriter(params), parent)
+{
+  this->setHistory(params.history);
+}
+
+quint64
+FileDataSaver::getClipCount(void) const
+{
+  return this->converter->getClipCount();
+}
+
 FileDataSaver::~FileDataSaver(void)
 {
-  if (this->writer != nullptr)
-    delete this->writer;
+  // The worker may still be using the writer
+  this->finish();
+
+  delete this->writer;
+  delete this->converter;
 }
 
@@ -0,0 +1,91 @@
+//
+//    FrameGovernor.cpp: Decides which spectrum frames get drawn
+//    Copyright (C) 2020 Gonzalo José Carracedo Carballal
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as
+//    published by the Free Software Foundation, either version 3 of the
+//    License, or (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful, but
+//    WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public
+//    License along with this program.  If not, see
+//    <http://www.gnu.org/licenses/>
+//
+
+#include "FrameGovernor.h"
+#include <algorithm>
+
+using namespace SigDigger;
+
+void
+FrameGovernor::setMaxRate(qreal fps)
+{
+  this->period = fps > 0 ? static_cast<qint64>(1e6 / fps) : 0;
+  this->nextDraw = this->lastDraw + this->period;
+}
+
+bool
+FrameGovernor::shouldDraw(qint64 now, qint64 lag)
+{
+  if (now - this->lastDraw >= SIGDIGGER_FRAME_GOVERNOR_MAX_STALL)
+    return true;
+
+  if (now < this->nextDraw || lag > SIGDIGGER_FRAME_GOVERNOR_MAX_LAG) {
+    ++this->skipCount;
+    return false;
+  }
+
+  return true;
+}
+
+void
+FrameGovernor::drawn(qint64 start, qint64 end)
+{
+  qint64 elapsed = end - start;
+  qint64 budget, next;
+
+  // Smoothed over ~8 frames
+  if (this->cost == 0)
+    this->cost = elapsed;
+  else
+    this->cost += (elapsed - this->cost) / 8;
+
+  budget = static_cast<qint64>(
+        this->cost / SIGDIGGER_FRAME_GOVERNOR_GUI_SHARE);
+
+  // Deadlines follow the previous one, not the frame, so the rate holds
+  // on average even if frames do not arrive on the display period.
+  next = this->nextDraw + this->period;
+  if (next < start)
+    next = start + this->period; // After a gap
+
+  this->lastDraw = start;
+  this->nextDraw = std::max(next, start + budget);
+  ++this->drawCount;
+}
+
+bool
+FrameGovernor::updateStats(qint64 now)
+{
+  qint64 elapsed = now - this->windowStart;
+
+  if (elapsed < SIGDIGGER_FRAME_GOVERNOR_WINDOW)
+    return false;
+
+  // First call: just start measuring
+  if (this->windowStart != 0) {
+    this->fps = 1e6 * this->drawCount / elapsed;
+    this->skipRate = 1e6 * this->skipCount / elapsed;
+  }
+
+  this->windowStart = now;
+  this->drawCount = 0;
+  this->skipCount = 0;
+
+  return true;
+}
@@ -19,9 +19,21 @@
 
 #include "GenericDataSaver.h"
 #include <unistd.h>
+#include <cmath>
+#include <algorithm>
 
 using namespace SigDigger;
 
+void
+GenericDataWriter::setTimestamp(qint64)
+{
+}
+
+void
+GenericDataWriter::setStreamPosition(quint64)
+{
+}
+
 GenericDataWriter::~GenericDataWriter()
 {
   // ?
@@ -46,64 +58,255 @@ GenericDataWorker::onPrepare(void)
 }
 
 void
-GenericDataWorker::onCommit(void)
+GenericDataWorker::onResize(void)
 {
-  if (!this->writerPrepared) {
-    // Silently ignore this buffer
-    this->instance->bufferReady = true;
-  } else if (!this->failed) {
-    QMutexLocker locker(&this->instance->dataMutex);
-    struct timeval tv, otv, sub;
-    ssize_t dumped;
-    size_t allocation = this->instance->allocation;
-    std::vector<SUCOMPLEX> *thisBuf =
-        &this->instance->buffers[1 - this->instance->buffer];
-    SUCOMPLEX *buffer = thisBuf->data();
-    int remaining = static_cast<int>(this->instance->commitedSize);
-
-    locker.unlock();
-
-    gettimeofday(&otv, nullptr);
-
-    while (remaining > 0) {
-      dumped = this->instance->writer->write(
-            buffer,
-            static_cast<unsigned>(remaining));
-
-      if (dumped < 1) {
-        this->failed = true;
-        emit error(QString::fromStdString(this->instance->writer->getError()));
+  this->instance->provisionSlots();
+}
+
+bool
+GenericDataWorker::writeAll(const SUCOMPLEX *data, size_t len)
+{
+  ssize_t dumped;
+
+  while (len > 0) {
+    dumped = this->instance->writer->write(data, len);
+
+    if (dumped < 1) {
+      this->failed = true;
+      emit error(QString::fromStdString(this->instance->writer->getError()));
+      return false;
+    }
+
+    len  -= static_cast<size_t>(dumped);
+    data += dumped;
+  }
+
+  return true;
+}
+
+//
+// The history goes straight from the time machine to the writer. It must
+// be out before the first live slot, so this is checked before every one
+// of them: the producer raises historyPending before publishing any slot.
+//
+bool
+GenericDataWorker::dumpHistory(void)
+{
+  GenericDataSaver *instance = this->instance;
+  const SUCOMPLEX *data = nullptr;
+  size_t done = 0, chunk;
+  qint64 time = 0;
+  bool ok = true;
+
+  if (!instance->historyPending.exchange(false))
+    return true;
+
+  while (done < instance->historyLen) {
+    chunk = instance->history->peek(done, &data, &time);
+    if (chunk == 0)
+      break;
+
+    instance->writer->setTimestamp(time);
+
+    if (chunk > instance->historyLen - done)
+      chunk = instance->historyLen - done;
+
+    if (!(ok = this->writeAll(data, chunk)))
+      break;
+
+    done += chunk;
+    instance->size += chunk;
+  }
+
+  instance->history->thaw();
+
+  return ok;
+}
+
+// Same as the slot loop in onCommit, with blocks from the fanout
+void
+GenericDataWorker::drainInput(void)
+{
+  GenericDataSaver *instance = this->instance;
+  SampleBlock *block;
+  size_t len;
+  bool ok;
+
+  do {
+    for (;;) {
+      struct timeval tv, otv, sub;
+
+      if (!this->dumpHistory()) {
+        instance->draining = false;
         return;
       }
 
-      remaining -= dumped;
-      buffer += dumped;
-    }
+      if ((block = instance->input.pop()) == nullptr)
+        break;
+
+      len = block->len;
+
+      instance->writer->setStreamPosition(block->position);
+      instance->writer->setTimestamp(block->time);
+      gettimeofday(&otv, nullptr);
+      ok = this->writeAll(block->data.data(), len);
+      gettimeofday(&tv, nullptr);
 
-    gettimeofday(&tv, nullptr);
+      instance->input.release(block);
 
-    // Requested allocation does not match buffer size.
-    if (thisBuf->size() != allocation) {
-      try {
-        thisBuf->resize(allocation);
-      } catch (std::exception &) {
-        this->failed = true;
-        emit error("Memory allocation error");
+      if (!ok) {
+        instance->draining = false;
         return;
       }
+
+      timersub(&tv, &otv, &sub);
+
+      emit writeFinished(
+            static_cast<quint64>(sub.tv_usec + sub.tv_sec * 1000000l),
+            static_cast<quint64>(len));
     }
 
-    this->instance->bufferReady = true;
-    timersub(&tv, &otv, &sub);
+    instance->draining = false;
+  } while (instance->input.queued() > 0 && !instance->draining.exchange(true));
+}
 
-    emit writeFinished(static_cast<quint64>(
-          sub.tv_usec + sub.tv_sec * 1000000l));
+void
+GenericDataWorker::onCommit(void)
+{
+  GenericDataSaver *instance = this->instance;
+  unsigned int tail = instance->tail.load();
+
+  if (!this->writerPrepared || this->failed) {
+    // Silently ignore these slots
+    if (instance->historyPending.exchange(false))
+      instance->history->thaw();
+    instance->input.clear();
+    while (tail != instance->head.load()) {
+      instance->recycleSlot(instance->ring[tail % instance->maxSlots]);
+      instance->tail = ++tail;
+    }
+    instance->draining = false;
+    return;
+  }
+
+  if (instance->attached) {
+    this->drainInput();
+    return;
   }
+
+  do {
+    if (!this->dumpHistory()) {
+      instance->draining = false;
+      return;
+    }
+
+    while (tail != instance->head.load()) {
+      struct timeval tv, otv, sub;
+      GenericDataSaver::Slot *slot;
+      size_t len;
+
+      if (!this->dumpHistory()) {
+        instance->draining = false;
+        return;
+      }
+
+      slot = instance->ring[tail % instance->maxSlots];
+      len = slot->len;
+
+      instance->writer->setStreamPosition(slot->position);
+
+      gettimeofday(&otv, nullptr);
+
+      if (!this->writeAll(slot->data.data(), len)) {
+        instance->draining = false;
+        return;
+      }
+
+      gettimeofday(&tv, nullptr);
+      timersub(&tv, &otv, &sub);
+
+      // Hand the slot back to the producer. It is not ours anymore.
+      instance->tail = ++tail;
+      instance->recycleSlot(slot);
+
+      emit writeFinished(
+            static_cast<quint64>(sub.tv_usec + sub.tv_sec * 1000000l),
+            static_cast<quint64>(len));
+    }
+
+    // The producer may have published something right before we cleared
+    // the draining flag. In that case, nobody is going to kick us again.
+    instance->draining = false;
+  } while (tail != instance->head.load() && !instance->draining.exchange(true));
+
+  instance->provisionSlots();
+}
+
+/////////////////////////// GenericDataSaverInput ////////////////////////////
+GenericDataSaverInput::GenericDataSaverInput(GenericDataSaver *owner) :
+  SampleFanoutSink(SIGDIGGER_DATASAVER_MIN_SLOTS, OVERFLOW_DROP_NEWEST)
+{
+  this->owner = owner;
+}
+
+GenericDataSaverInput::~GenericDataSaverInput()
+{
+  this->detach();
+}
+
+bool
+GenericDataSaverInput::wants(const SampleBlock *)
+{
+  return this->owner->writer != nullptr && this->owner->writer->canWrite();
+}
+
+void
+GenericDataSaverInput::accept(const SampleBlock *block)
+{
+  GenericDataSaver *owner = this->owner;
+
+  owner->dataWritten = true;
+  owner->roomFound();
+  owner->takeHistory(block->position);
+
+  // The pool ran dry upstream and nobody got these samples
+  if (owner->streamStarted && block->position > owner->streamNext)
+    owner->overloaded(block->position - owner->streamNext);
+
+  owner->streamStarted = true;
+  owner->streamNext = block->position + block->len;
+  owner->position += block->len;
+  owner->size += block->len;
+}
+
+void
+GenericDataSaverInput::overflow(const SampleBlock *block)
+{
+  GenericDataSaver *owner = this->owner;
+
+  if (!owner->streamStarted)
+    return;
+
+  owner->streamNext = block->position + block->len;
+  owner->overloaded(block->len);
 }
 
+bool
+GenericDataSaverInput::stall(void)
+{
+  return this->owner->stall();
+}
+
+void
+GenericDataSaverInput::notify(void)
+{
+  this->owner->kick();
+}
+
+////////////////////////////// GenericDataSaver ////////////////////////////////
 GenericDataSaver::GenericDataSaver(
     GenericDataWriter *writer,
-    QObject *parent) : QObject(parent), workerObject(this)
+    QObject *parent) : QObject(parent), input(this), workerObject(this)
 {
   this->writer = writer;
   this->setSampleRate(1000000);
@@ -120,11 +323,25 @@ GenericDataSaver::GenericDataSaver(
         &this->workerObject,
         SLOT(onCommit()));
 
+  // Returns once the worker has written everything handed to it
+  QObject::connect(
+        this,
+        SIGNAL(flush()),
+        &this->workerObject,
+        SLOT(onCommit()),
+        Qt::BlockingQueuedConnection);
+
+  QObject::connect(
+        this,
+        SIGNAL(resize()),
+        &this->workerObject,
+        SLOT(onResize()));
+
   QObject::connect(
         &this->workerObject,
-        SIGNAL(writeFinished(quint64)),
+        SIGNAL(writeFinished(quint64, quint64)),
         this,
-        SLOT(onWriteFinished(quint64)));
+        SLOT(onWriteFinished(quint64, quint64)));
 
   QObject::connect(
         &this->workerObject,
@@ -145,93 +362,422 @@ GenericDataSaver::GenericDataSaver(
   emit prepare();
 }
 
+//
+// The producer must be gone by now: either detached, or no longer calling
+// write(). Every sample it got past write() is in size and position
+// already, so all of them reach the writer before it is closed.
+//
+void
+GenericDataSaver::finish(void)
+{
+  unsigned int head;
+
+  // No more blocks from the producer
+  this->detach();
+
+  if (this->workerThread.isRunning()) {
+    // The slot being filled goes out too, even if it is not full
+    if (this->current != nullptr && this->ptr > 0) {
+      head = this->head.load();
+      this->current->len = this->ptr;
+      this->ring[head % this->maxSlots] = this->current;
+      this->size += this->ptr;
+      this->current = nullptr;
+      this->ptr = 0;
+      this->head = ++head;
+    }
+
+    emit flush();
+
+    this->workerThread.quit();
+    this->workerThread.wait();
+  }
+
+  if (this->writer != nullptr) {
+    if (this->writer->canWrite()) {
+      QMutexLocker locker(&this->dataMutex);
+      this->writer->close();
+    }
+
+    this->writer = nullptr;
+  }
+
+  // Only left if the writer failed
+  this->input.clear();
+
+  // The history never made it to the writer. Let the producer refill it.
+  if (this->historyPending.exchange(false))
+    this->history->thaw();
+}
+
 GenericDataSaver::~GenericDataSaver()
 {
-  this->workerThread.quit();
-  this->workerThread.wait();
+  this->finish();
+  this->releaseSlots();
+}
 
-  if (this->writer->canWrite()) {
-    QMutexLocker locker(&this->dataMutex);
-    this->writer->close();
+// Nobody else may be touching the slots
+void
+GenericDataSaver::releaseSlots(void)
+{
+  unsigned int i;
+
+  for (i = this->tail; i != this->head; ++i)
+    delete this->ring[i % this->maxSlots];
+
+  for (i = this->spareTail; i != this->spareHead; ++i)
+    delete this->spares[i % this->maxSlots];
+
+  if (this->current != nullptr)
+    delete this->current;
+
+  this->current = nullptr;
+  this->ptr = 0;
+  this->head = this->tail = 0;
+  this->spareHead = this->spareTail = 0;
+  this->slotCount = 0;
+}
+
+//
+// Slot geometry follows from the sample rate and the memory budget. Slots
+// hold 1 / SLOTS_PER_SECOND seconds of data and there are never more of
+// them than what fits in the budget. Before the first write, the minimum
+// headroom is allocated right away. The rest comes later, as needed.
+//
+void
+GenericDataSaver::allocateSlots(void)
+{
+  quint64 count;
+
+  this->releaseSlots();
+
+  count = this->budget / (this->slotLen * sizeof(SUCOMPLEX));
+  if (count < SIGDIGGER_DATASAVER_MIN_SLOTS)
+    count = SIGDIGGER_DATASAVER_MIN_SLOTS;
+  if (count > 0xffff)
+    count = 0xffff;
+
+  this->maxSlots = static_cast<unsigned int>(count);
+  this->ring.resize(this->maxSlots);
+  this->spares.resize(this->maxSlots);
+  this->peakLatency = 0;
+
+  this->adaptSlots(0, 0);
+  this->provisionSlots();
+}
+
+// Called by the worker only, or by anyone before the first write
+void
+GenericDataSaver::provisionSlots(void)
+{
+  unsigned int spareHead = this->spareHead;
+
+  while (this->slotCount < this->slotTarget) {
+    this->spares[spareHead % this->maxSlots] = new Slot(this->slotLen);
+    this->spareHead = ++spareHead;
+    ++this->slotCount;
   }
 }
 
-// Protected by mutex
+// Called by the worker only, with a slot it just took from the ring
 void
-GenericDataSaver::doCommit(void)
-{
-  // It is okay if the worker thread is still dumping data. This is
-  // just a way to signal this situation. If it was not ready, we
-  // do not flip buffers and keep filling the current one.
-  if (this->bufferReady) {
-    struct timeval otv = this->lastCommit;
-    struct timeval sub;
-
-    gettimeofday(&this->lastCommit, nullptr);
-    timersub(&this->lastCommit, &otv, &sub);
-    this->writeTime = static_cast<quint64>(
-              sub.tv_usec + sub.tv_sec * 1000000l);
-
-    this->buffer = 1 - this->buffer;
-    this->commitedSize = this->ptr;
-    this->size += this->commitedSize;
-    this->ptr = 0;
-    this->bufferReady = false;
+GenericDataSaver::recycleSlot(Slot *slot)
+{
+  unsigned int spareHead = this->spareHead;
 
-    emit commit();
+  // Shrinking happens here, one slot at a time
+  if (this->slotCount > this->slotTarget) {
+    delete slot;
+    --this->slotCount;
+    return;
+  }
+
+  slot->len = 0;
+  this->spares[spareHead % this->maxSlots] = slot;
+  this->spareHead = ++spareHead;
+}
+
+//
+// Called from the owner's thread. A slot took usec microseconds to write
+// samples samples. Decide how many slots we want from now on.
+//
+void
+GenericDataSaver::adaptSlots(quint64 usec, quint64 samples)
+{
+  qreal seconds = SIGDIGGER_DATASAVER_MIN_HEADROOM;
+  qreal latency = 1e-6 * static_cast<qreal>(usec);
+  quint64 target;
+
+  this->peakLatency = std::max(
+        latency,
+        SIGDIGGER_DATASAVER_LATENCY_DECAY * this->peakLatency);
+
+  seconds = std::max(
+        seconds,
+        SIGDIGGER_DATASAVER_LATENCY_FACTOR * this->peakLatency);
+
+  // The sink is slower than the source. No amount of buffering is going
+  // to save us, but we can postpone the loss as much as possible.
+  if (samples > 0 && this->rateHint > 0
+      && usec * this->rateHint > samples * 1000000ull)
+    seconds = HUGE_VAL;
+
+  if (std::isinf(seconds))
+    target = this->maxSlots;
+  else
+    target = static_cast<quint64>(
+          std::ceil(seconds * this->rateHint / this->slotLen)) + 1;
+
+  if (target < SIGDIGGER_DATASAVER_MIN_SLOTS)
+    target = SIGDIGGER_DATASAVER_MIN_SLOTS;
+  if (target > this->maxSlots)
+    target = this->maxSlots;
+
+  if (this->attached) {
+    // The blocks belong to the fanout, we only limit how many we hold
+    this->slotTarget = static_cast<unsigned int>(target);
+    this->input.setLimit(this->slotTarget);
+  } else if (target != this->slotTarget) {
+    this->slotTarget = static_cast<unsigned int>(target);
+
+    // Before the first write, allocateSlots() provisions them itself
+    if (this->dataWritten && target > this->slotCount)
+      emit resize();
   }
 }
 
+// Called by the producer only
+void
+GenericDataSaver::kick(void)
+{
+  // If the worker is already draining the ring, it will find the new
+  // slot by itself. Otherwise, wake it up.
+  if (!this->draining.exchange(true))
+    emit commit();
+}
+
 void
 GenericDataSaver::setSampleRate(unsigned int rate)
 {
   if (this->rateHint != rate) {
-    QMutexLocker locker(&this->dataMutex);
-
     this->rateHint = rate;
-    this->allocation = 3 * rate; // Up to 3 sec of data
 
     // No data is being written, we can reallocate here
-    if (!this->dataWritten) {
-      this->buffers[0].resize(this->allocation);
-      this->buffers[1].resize(this->allocation);
+    if (!this->dataWritten && !this->attached) {
+      this->slotLen = std::max<size_t>(
+            rate / SIGDIGGER_DATASAVER_SLOTS_PER_SECOND,
+            SIGDIGGER_DATASAVER_MIN_SLOT_LEN);
+      this->allocateSlots();
     }
   }
 }
 
+// Must be called before the first write
 void
-GenericDataSaver::setBufferSize(unsigned int size)
+GenericDataSaver::setHistory(TimeMachine *history)
 {
-  this->buffers[0].resize(size);
-  this->buffers[1].resize(size);
+  if (!this->dataWritten)
+    this->history = history;
+}
+
+//
+// From now on, samples come from the fanout and write() does nothing. The
+// memory budget (set it first) limits the number of blocks we may hold.
+//
+bool
+GenericDataSaver::attach(std::shared_ptr<SampleFanout> const &fanout)
+{
+  quint64 depth;
+
+  if (this->dataWritten || this->attached || fanout.get() == nullptr)
+    return false;
+
+  this->releaseSlots();
+
+  this->slotLen = fanout->getBlockLen();
+  depth = this->budget / (this->slotLen * sizeof(SUCOMPLEX));
+  if (depth < SIGDIGGER_DATASAVER_MIN_SLOTS)
+    depth = SIGDIGGER_DATASAVER_MIN_SLOTS;
+  if (depth > fanout->getMaxBlocks())
+    depth = fanout->getMaxBlocks();
+
+  this->maxSlots = static_cast<unsigned int>(depth);
+  this->input.setDepth(this->maxSlots);
+  this->attached = true;
+  this->adaptSlots(0, 0);
+
+  if (!this->input.attach(fanout)) {
+    this->attached = false;
+    this->allocateSlots();
+    return false;
+  }
+
+  return true;
 }
 
 void
-GenericDataSaver::write(const SUCOMPLEX *data, size_t size)
+GenericDataSaver::detach(void)
 {
-  if (this->writer->canWrite()) {
-    QMutexLocker locker(&this->dataMutex);
-    size_t totalSize = this->buffers[this->buffer].size();
-    size_t avail = totalSize - this->ptr;
+  this->input.detach();
+}
 
-    this->dataWritten = true;
+void
+GenericDataSaver::setOverloadPolicy(OverloadPolicy policy, unsigned int ms)
+{
+  this->overload = policy;
+  this->stallMs = ms;
+}
 
-    if (size > avail) {
-      emit swamped();
-      return;
-    }
+GenericDataSaver::OverloadPolicy
+GenericDataSaver::getOverloadPolicy(void) const
+{
+  return this->overload;
+}
+
+// Called by the producer only. Waits a little and tells whether to look
+// for room again.
+bool
+GenericDataSaver::stall(void)
+{
+  struct timeval tv, wait;
+
+  if (this->overload != OVERLOAD_BLOCK || this->stallExpired)
+    return false;
+
+  gettimeofday(&tv, nullptr);
+
+  if (!this->stalling) {
+    wait.tv_sec  = this->stallMs / 1000;
+    wait.tv_usec = (this->stallMs % 1000) * 1000;
+    timeradd(&tv, &wait, &this->stallDeadline);
+    this->stalling = true;
+  } else if (timercmp(&tv, &this->stallDeadline, >=)) {
+    // Waited long enough. Drop until the sink catches up.
+    this->stalling = false;
+    this->stallExpired = true;
+    return false;
+  }
+
+  usleep(SIGDIGGER_DATASAVER_STALL_POLL_US);
+
+  return true;
+}
+
+// Called by the producer only
+void
+GenericDataSaver::roomFound(void)
+{
+  this->stalling = false;
+  this->stallExpired = false;
+}
 
-    // Copy data
-    memcpy(
-      this->buffers[this->buffer].data() + this->ptr,
-      data,
-      size * sizeof(SUCOMPLEX));
+// Called by the producer only. count samples never made it to the sink.
+void
+GenericDataSaver::overloaded(quint64 count)
+{
+  emit samplesDropped(this->position, count);
 
-    this->ptr += size;
+  if (this->overload == OVERLOAD_ABORT)
+    emit swamped();
+}
 
-    if (this->ptr > totalSize / 2) {
-      // Buffer starts to get filled up, issue commit request
-      this->doCommit();
+// Called by the producer only
+void
+GenericDataSaver::takeHistory(quint64 before)
+{
+  // The history ends right before these samples. Nothing else will be
+  // written into the time machine until the worker has dumped it.
+  if (this->history != nullptr && !this->historyTaken) {
+    this->historyTaken = true;
+    this->history->freeze();
+    this->historyLen = this->history->available(before);
+    this->position += this->historyLen;
+    this->historyPending = true;
+    this->kick();
+  }
+}
+
+// Samples per slot. Overrides the one derived from the sample rate.
+void
+GenericDataSaver::setBufferSize(unsigned int size)
+{
+  if (!this->dataWritten && !this->attached && size > 0) {
+    this->slotLen = size;
+    this->allocateSlots();
+  }
+}
+
+// Upper bound for the memory taken by all slots
+void
+GenericDataSaver::setMemoryBudget(quint64 bytes)
+{
+  if (!this->dataWritten && !this->attached && bytes != this->budget) {
+    this->budget = bytes;
+    this->allocateSlots();
+  }
+}
+
+void
+GenericDataSaver::write(const SUCOMPLEX *data, size_t size)
+{
+  if (this->attached)
+    return;
+
+  if (this->writer != nullptr && this->writer->canWrite()) {
+    unsigned int head = this->head.load();
+    unsigned int spareTail;
+    size_t chunk, avail;
+
+    this->dataWritten = true;
+    this->takeHistory(~0ull);
+
+    while (size > 0) {
+      if (this->current == nullptr) {
+        spareTail = this->spareTail.load();
+
+        // The worker still owns every slot: we cannot go on.
+        if (spareTail == this->spareHead.load()) {
+          if (this->stall())
+            continue;
+
+          this->overloaded(size);
+          this->streamPosition += size;
+          return;
+        }
+
+        this->roomFound();
+        this->current = this->spares[spareTail % this->maxSlots];
+        this->current->position = this->streamPosition;
+        this->spareTail = ++spareTail;
+        this->ptr = 0;
+      }
+
+      Slot &slot = *this->current;
+      avail = slot.data.size() - this->ptr;
+      chunk = size < avail ? size : avail;
+
+      // Copy data
+      memcpy(
+        slot.data.data() + this->ptr,
+        data,
+        chunk * sizeof(SUCOMPLEX));
+
+      this->ptr += chunk;
+      this->position += chunk;
+      this->streamPosition += chunk;
+      data += chunk;
+      size -= chunk;
+
+      if (this->ptr == slot.data.size()) {
+        // Slot is full, publish it
+        slot.len = this->ptr;
+        this->ring[head % this->maxSlots] = this->current;
+        this->current = nullptr;
+        this->ptr = 0;
+        this->size += slot.len;
+        this->head = ++head;
+        this->kick();
+      }
     }
   }
 }
@@ -242,6 +788,46 @@ GenericDataSaver::getSize(void) const
   return this->size;
 }
 
+// Samples accepted so far, i.e. the index of the next sample in the file
+quint64
+GenericDataSaver::getPosition(void) const
+{
+  return this->position;
+}
+
+// When attached, the memory we are allowed to hold in the fanout
+quint64
+GenericDataSaver::getMemoryUsage(void) const
+{
+  return static_cast<quint64>(
+        this->attached ? this->slotTarget : this->slotCount)
+      * this->slotLen
+      * sizeof(SUCOMPLEX);
+}
+
+// How long the sink could stall before we start dropping samples
+qreal
+GenericDataSaver::getHeadroom(void) const
+{
+  unsigned int busy = this->head - this->tail;
+  unsigned int count = this->slotCount;
+
+  if (this->attached) {
+    SampleFanout *fanout = this->input.getFanout();
+
+    busy  = this->input.queued();
+    count = this->slotTarget;
+
+    if (fanout != nullptr)
+      count = std::min(count, busy + fanout->getFreeBlocks());
+  }
+
+  if (this->rateHint == 0 || busy >= count)
+    return 0;
+
+  return static_cast<qreal>((count - busy) * this->slotLen) / this->rateHint;
+}
+
 QString
 GenericDataSaver::getLastError(void) const
 {
@@ -253,7 +839,7 @@ void
 GenericDataSaver::onError(QString error)
 {
   this->lastError = error;
-  if (this->writer->canWrite()) {
+  if (this->writer != nullptr && this->writer->canWrite()) {
     QMutexLocker locker(&this->dataMutex);
     this->writer->close();
   }
@@ -262,15 +848,22 @@ GenericDataSaver::onError(QString error)
 }
 
 void
-GenericDataSaver::onWriteFinished(quint64 usec)
+GenericDataSaver::onWriteFinished(quint64 usec, quint64 samples)
 {
   this->commitTime = usec;
 
+  if (this->rateHint > 0)
+    this->writeTime = samples * 1000000ull / this->rateHint;
+
   if (this->writeTime > 0) {
     emit dataRate(
           static_cast<qreal>(this->commitTime)
           / static_cast<qreal>(this->writeTime));
   }
+
+  this->adaptSlots(usec, samples);
+
+  emit headroom(this->getHeadroom());
 }
 
 void
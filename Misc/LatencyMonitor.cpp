@@ -0,0 +1,239 @@
+//
+//    LatencyMonitor.cpp: Per-stage latency histograms of the sample pipeline
+//    Copyright (C) 2020 Gonzalo José Carracedo Carballal
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as
+//    published by the Free Software Foundation, either version 3 of the
+//    License, or (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful, but
+//    WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public
+//    License along with this program.  If not, see
+//    <http://www.gnu.org/licenses/>
+//
+
+#include "LatencyMonitor.h"
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+
+using namespace SigDigger;
+
+LatencyMonitor::LatencyMonitor()
+{
+  this->reset();
+}
+
+LatencyMonitor *
+LatencyMonitor::instance(void)
+{
+  static LatencyMonitor monitor;
+
+  return &monitor;
+}
+
+qint64
+LatencyMonitor::now(void)
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+const char *
+LatencyMonitor::stageName(LatencyStage stage)
+{
+  switch (stage) {
+    case LATENCY_STAGE_PSD_QUEUE:
+      return "PSD delivery";
+
+    case LATENCY_STAGE_PSD_RENDER:
+      return "PSD rendering";
+
+    case LATENCY_STAGE_PSD_TOTAL:
+      return "PSD total";
+
+    case LATENCY_STAGE_INSPECTOR_QUEUE:
+      return "Inspector message delivery";
+
+    case LATENCY_STAGE_SAMPLES_QUEUE:
+      return "Inspector samples delivery";
+
+    case LATENCY_STAGE_SAMPLES_FEED:
+      return "Inspector samples feed";
+
+    case LATENCY_STAGE_AUDIO_DELIVERY:
+      return "Audio delivery";
+
+    case LATENCY_STAGE_AUDIO_QUEUE:
+      return "Audio buffer queue";
+
+    default:
+      break;
+  }
+
+  return "Unknown";
+}
+
+// Values below 8 usec get a bucket of their own. Above that, 8 buckets
+// per power of two.
+unsigned int
+LatencyMonitor::bucketOf(quint64 usec)
+{
+  unsigned int exp = 0;
+  unsigned int bucket;
+
+  if (usec < SIGDIGGER_LATENCY_SUB_BUCKETS)
+    return static_cast<unsigned int>(usec);
+
+  while ((usec >> exp) >= 2 * SIGDIGGER_LATENCY_SUB_BUCKETS)
+    ++exp;
+
+  bucket = (exp + 1) * SIGDIGGER_LATENCY_SUB_BUCKETS
+      + static_cast<unsigned int>(usec >> exp) - SIGDIGGER_LATENCY_SUB_BUCKETS;
+
+  if (bucket >= SIGDIGGER_LATENCY_BUCKETS)
+    bucket = SIGDIGGER_LATENCY_BUCKETS - 1;
+
+  return bucket;
+}
+
+qint64
+LatencyMonitor::bucketCenter(unsigned int bucket)
+{
+  unsigned int exp;
+  qint64 low;
+
+  if (bucket < SIGDIGGER_LATENCY_SUB_BUCKETS)
+    return bucket;
+
+  exp = bucket / SIGDIGGER_LATENCY_SUB_BUCKETS - 1;
+  low = static_cast<qint64>(
+        bucket % SIGDIGGER_LATENCY_SUB_BUCKETS + SIGDIGGER_LATENCY_SUB_BUCKETS)
+      << exp;
+
+  return low + ((1ll << exp) >> 1);
+}
+
+void
+LatencyMonitor::record(LatencyStage stage, qint64 usec)
+{
+  Histogram &h = this->histograms[stage];
+  qint64 max;
+
+  if (usec < 0)
+    usec = 0;
+
+  ++h.buckets[bucketOf(static_cast<quint64>(usec))];
+  h.sum += static_cast<quint64>(usec);
+  ++h.count;
+
+  max = h.max.load();
+  while (usec > max && !h.max.compare_exchange_weak(max, usec));
+}
+
+qint64
+LatencyMonitor::percentile(Histogram const &h, quint64 count, qreal p) const
+{
+  quint64 target = static_cast<quint64>(p * count);
+  quint64 accum = 0;
+  unsigned int i;
+
+  for (i = 0; i < SIGDIGGER_LATENCY_BUCKETS; ++i) {
+    accum += h.buckets[i];
+    if (accum > target)
+      return bucketCenter(i);
+  }
+
+  return h.max;
+}
+
+LatencyStats
+LatencyMonitor::getStats(LatencyStage stage) const
+{
+  Histogram const &h = this->histograms[stage];
+  LatencyStats stats;
+
+  stats.count = h.count;
+
+  if (stats.count > 0) {
+    stats.mean = static_cast<qreal>(h.sum) / stats.count;
+    stats.max  = h.max;
+    stats.p50  = this->percentile(h, stats.count, .5);
+    stats.p90  = this->percentile(h, stats.count, .9);
+    stats.p99  = this->percentile(h, stats.count, .99);
+  }
+
+  return stats;
+}
+
+// Not atomic with respect to record(): a sample or two may straddle it
+void
+LatencyMonitor::reset(void)
+{
+  unsigned int i, j;
+
+  for (i = 0; i < LATENCY_STAGE_COUNT; ++i) {
+    this->histograms[i].count = 0;
+    this->histograms[i].sum = 0;
+    this->histograms[i].max = 0;
+
+    for (j = 0; j < SIGDIGGER_LATENCY_BUCKETS; ++j)
+      this->histograms[i].buckets[j] = 0;
+  }
+}
+
+bool
+LatencyMonitor::dump(std::string const &path) const
+{
+  FILE *fp;
+  time_t t = time(nullptr);
+  char date[64];
+  unsigned int i, j;
+  quint64 count;
+  bool ok;
+
+  if ((fp = fopen(path.c_str(), "w")) == nullptr)
+    return false;
+
+  strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&t));
+
+  fprintf(fp, "# SigDigger pipeline latency, %s. Times in usec.\n", date);
+  fprintf(fp, "# stage,count,mean,p50,p90,p99,max\n");
+
+  for (i = 0; i < LATENCY_STAGE_COUNT; ++i) {
+    LatencyStage stage = static_cast<LatencyStage>(i);
+    LatencyStats stats = this->getStats(stage);
+
+    fprintf(
+          fp,
+          "%s,%llu,%.1f,%lld,%lld,%lld,%lld\n",
+          stageName(stage),
+          static_cast<unsigned long long>(stats.count),
+          stats.mean,
+          static_cast<long long>(stats.p50),
+          static_cast<long long>(stats.p90),
+          static_cast<long long>(stats.p99),
+          static_cast<long long>(stats.max));
+  }
+
+  fprintf(fp, "\n# stage,bucket center,count\n");
+
+  for (i = 0; i < LATENCY_STAGE_COUNT; ++i)
+    for (j = 0; j < SIGDIGGER_LATENCY_BUCKETS; ++j)
+      if ((count = this->histograms[i].buckets[j]) > 0)
+        fprintf(
+              fp,
+              "%s,%lld,%llu\n",
+              stageName(static_cast<LatencyStage>(i)),
+              static_cast<long long>(bucketCenter(j)),
+              static_cast<unsigned long long>(count));
+
+  ok = ferror(fp) == 0;
+
+  return fclose(fp) == 0 && ok;
+}
@@ -0,0 +1,128 @@
+//
+//    PSDPyramid.cpp: Min/max/mean decimations of a PSD frame
+//    Copyright (C) 2020 Gonzalo José Carracedo Carballal
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as
+//    published by the Free Software Foundation, either version 3 of the
+//    License, or (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful, but
+//    WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public
+//    License along with this program.  If not, see
+//    <http://www.gnu.org/licenses/>
+//
+
+#include "PSDPyramid.h"
+#include <algorithm>
+
+#if defined(__SSE2__)
+#  include <emmintrin.h>
+#  define SIGDIGGER_PSD_PYRAMID_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#  include <arm_neon.h>
+#  define SIGDIGGER_PSD_PYRAMID_NEON
+#endif
+
+using namespace SigDigger;
+
+//////////////////////////////// Kernels //////////////////////////////////////
+// Turns 2 * len bins of in into len bins. in may be unaligned (the first
+// level reads the frame), out is ours.
+static void
+decimateOne(const float *in, float *out, PSDDetector detector, size_t len)
+{
+  size_t i = 0;
+
+#if defined(SIGDIGGER_PSD_PYRAMID_SSE2)
+  const __m128 half = _mm_set1_ps(.5f);
+
+  for (; i + 4 <= len; i += 4) {
+    __m128 a = _mm_loadu_ps(in + 2 * i);
+    __m128 b = _mm_loadu_ps(in + 2 * i + 4);
+    __m128 even = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+    __m128 odd  = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+    __m128 y;
+
+    switch (detector) {
+      case PSD_DETECTOR_PEAK:
+        y = _mm_max_ps(even, odd);
+        break;
+
+      case PSD_DETECTOR_MIN:
+        y = _mm_min_ps(even, odd);
+        break;
+
+      default:
+        y = _mm_mul_ps(_mm_add_ps(even, odd), half);
+    }
+
+    _mm_store_ps(out + i, y);
+  }
+#elif defined(SIGDIGGER_PSD_PYRAMID_NEON)
+  for (; i + 4 <= len; i += 4) {
+    float32x4x2_t v = vld2q_f32(in + 2 * i);
+    float32x4_t y;
+
+    switch (detector) {
+      case PSD_DETECTOR_PEAK:
+        y = vmaxq_f32(v.val[0], v.val[1]);
+        break;
+
+      case PSD_DETECTOR_MIN:
+        y = vminq_f32(v.val[0], v.val[1]);
+        break;
+
+      default:
+        y = vmulq_n_f32(vaddq_f32(v.val[0], v.val[1]), .5f);
+    }
+
+    vst1q_f32(out + i, y);
+  }
+#endif
+
+  for (; i < len; ++i) {
+    switch (detector) {
+      case PSD_DETECTOR_PEAK:
+        out[i] = std::max(in[2 * i], in[2 * i + 1]);
+        break;
+
+      case PSD_DETECTOR_MIN:
+        out[i] = std::min(in[2 * i], in[2 * i + 1]);
+        break;
+
+      default:
+        out[i] = .5f * (in[2 * i] + in[2 * i + 1]);
+    }
+  }
+}
+
+/////////////////////////////// PSDPyramid ////////////////////////////////////
+const float *
+PSDPyramid::reduce(
+    const float *data,
+    size_t &size,
+    size_t bins,
+    PSDDetector detector)
+{
+  const float *in = data;
+  size_t len = size / 2;
+  unsigned int i = 0;
+
+  while (len >= SIGDIGGER_PSD_PYRAMID_MIN_BINS && len >= bins) {
+    // Never the buffer we are reading from
+    this->levels[i].reserve(len);
+    decimateOne(in, this->levels[i].get(), detector, len);
+
+    in  = this->levels[i].get();
+    i  ^= 1;
+    size = len;
+    len /= 2;
+  }
+
+  return in;
+}
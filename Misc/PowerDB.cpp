@@ -0,0 +1,271 @@
+//
+//    PowerDB.cpp: Fast power to decibel conversion of spectrum frames
+//    Copyright (C) 2020 Gonzalo José Carracedo Carballal
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as
+//    published by the Free Software Foundation, either version 3 of the
+//    License, or (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful, but
+//    WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public
+//    License along with this program.  If not, see
+//    <http://www.gnu.org/licenses/>
+//
+
+#include "PowerDB.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__)
+#  include <emmintrin.h>
+#  define SIGDIGGER_POWERDB_SSE2
+#  if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#    include <immintrin.h>
+#    define SIGDIGGER_POWERDB_AVX2
+#  endif
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#  include <arm_neon.h>
+#  define SIGDIGGER_POWERDB_NEON
+#endif
+
+// Bins converted at a time by fftShiftPowerDB. Small enough for L1.
+#define SIGDIGGER_POWERDB_CHUNK 512
+
+using namespace SigDigger;
+
+//
+// x = 2^e * m, with m in [sqrt(1/2), sqrt(2)). Then
+// log2(x) = e + f * P(f), f = m - 1, where P interpolates log2(1 + f) / f
+// at the Chebyshev nodes of that interval (max error 6.3e-7 in log2).
+//
+#define C0  1.442696523f
+#define C1 -7.213601786e-1f
+#define C2  4.806131255e-1f
+#define C3 -3.595244555e-1f
+#define C4  2.961195572e-1f
+#define C5 -2.679638705e-1f
+#define C6  1.681865911e-1f
+
+#define DB_PER_OCTAVE 3.0102999566f // 10 log10(2)
+#define SQRT2         1.4142135624f
+
+#define MANTISSA_MASK 0x007fffff
+#define EXPONENT_ONE  0x3f800000
+
+// Vector tails and plain builds. libm is both faster and more accurate
+// than the polynomial when done one bin at a time.
+static inline SUFLOAT
+powerDBScalar(SUFLOAT x)
+{
+  // Written this way, NaN is clamped too
+  if (!(x > SIGDIGGER_POWERDB_MIN_POWER))
+    x = SIGDIGGER_POWERDB_MIN_POWER;
+
+  return 10 * SU_LOG(x);
+}
+
+#if defined(SIGDIGGER_POWERDB_AVX2)
+__attribute__((target("avx2,fma")))
+static void
+powerDBAVX2(const SUFLOAT *in, SUFLOAT *out, size_t len)
+{
+  const __m256  floor = _mm256_set1_ps(SIGDIGGER_POWERDB_MIN_POWER);
+  const __m256i mask  = _mm256_set1_epi32(MANTISSA_MASK);
+  const __m256i one   = _mm256_set1_epi32(EXPONENT_ONE);
+  const __m256i bias  = _mm256_set1_epi32(127);
+  const __m256  sqrt2 = _mm256_set1_ps(SQRT2);
+  const __m256  half  = _mm256_set1_ps(.5f);
+  const __m256  unity = _mm256_set1_ps(1.f);
+  const __m256  k     = _mm256_set1_ps(DB_PER_OCTAVE);
+  size_t i;
+
+  for (i = 0; i + 8 <= len; i += 8) {
+    __m256  x = _mm256_max_ps(_mm256_loadu_ps(in + i), floor);
+    __m256i b = _mm256_castps_si256(x);
+    __m256i e = _mm256_sub_epi32(_mm256_srli_epi32(b, 23), bias);
+    __m256  m = _mm256_castsi256_ps(
+          _mm256_or_si256(_mm256_and_si256(b, mask), one));
+    __m256  big = _mm256_cmp_ps(m, sqrt2, _CMP_GT_OQ);
+    __m256  f, p;
+
+    m = _mm256_blendv_ps(m, _mm256_mul_ps(m, half), big);
+    e = _mm256_sub_epi32(e, _mm256_castps_si256(big)); // big is -1
+    f = _mm256_sub_ps(m, unity);
+
+    p = _mm256_fmadd_ps(_mm256_set1_ps(C6), f, _mm256_set1_ps(C5));
+    p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(C4));
+    p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(C3));
+    p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(C2));
+    p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(C1));
+    p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(C0));
+
+    _mm256_storeu_ps(
+          out + i,
+          _mm256_mul_ps(k, _mm256_fmadd_ps(f, p, _mm256_cvtepi32_ps(e))));
+  }
+
+  for (; i < len; ++i)
+    out[i] = powerDBScalar(in[i]);
+}
+
+static bool
+haveAVX2(void)
+{
+  static const bool avx2 =
+      __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+
+  return avx2;
+}
+#endif // SIGDIGGER_POWERDB_AVX2
+
+#if defined(SIGDIGGER_POWERDB_SSE2)
+static void
+powerDBSSE2(const SUFLOAT *in, SUFLOAT *out, size_t len)
+{
+  const __m128  floor = _mm_set1_ps(SIGDIGGER_POWERDB_MIN_POWER);
+  const __m128i mask  = _mm_set1_epi32(MANTISSA_MASK);
+  const __m128i one   = _mm_set1_epi32(EXPONENT_ONE);
+  const __m128i bias  = _mm_set1_epi32(127);
+  const __m128  sqrt2 = _mm_set1_ps(SQRT2);
+  const __m128  half  = _mm_set1_ps(.5f);
+  const __m128  unity = _mm_set1_ps(1.f);
+  const __m128  k     = _mm_set1_ps(DB_PER_OCTAVE);
+  size_t i;
+
+  for (i = 0; i + 4 <= len; i += 4) {
+    __m128  x = _mm_max_ps(_mm_loadu_ps(in + i), floor);
+    __m128i b = _mm_castps_si128(x);
+    __m128i e = _mm_sub_epi32(_mm_srli_epi32(b, 23), bias);
+    __m128  m = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(b, mask), one));
+    __m128  big = _mm_cmpgt_ps(m, sqrt2);
+    __m128  f, p;
+
+    m = _mm_or_ps(
+          _mm_and_ps(big, _mm_mul_ps(m, half)),
+          _mm_andnot_ps(big, m));
+    e = _mm_sub_epi32(e, _mm_castps_si128(big));
+    f = _mm_sub_ps(m, unity);
+
+    p = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(C6), f), _mm_set1_ps(C5));
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(C4));
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(C3));
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(C2));
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(C1));
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(C0));
+
+    _mm_storeu_ps(
+          out + i,
+          _mm_mul_ps(k, _mm_add_ps(_mm_cvtepi32_ps(e), _mm_mul_ps(f, p))));
+  }
+
+  for (; i < len; ++i)
+    out[i] = powerDBScalar(in[i]);
+}
+#endif // SIGDIGGER_POWERDB_SSE2
+
+#if defined(SIGDIGGER_POWERDB_NEON)
+static void
+powerDBNEON(const SUFLOAT *in, SUFLOAT *out, size_t len)
+{
+  const float32x4_t floor = vdupq_n_f32(SIGDIGGER_POWERDB_MIN_POWER);
+  const uint32x4_t  mask  = vdupq_n_u32(MANTISSA_MASK);
+  const uint32x4_t  one   = vdupq_n_u32(EXPONENT_ONE);
+  const int32x4_t   bias  = vdupq_n_s32(127);
+  const float32x4_t sqrt2 = vdupq_n_f32(SQRT2);
+  const float32x4_t unity = vdupq_n_f32(1.f);
+  size_t i;
+
+  for (i = 0; i + 4 <= len; i += 4) {
+    float32x4_t x = vmaxq_f32(vld1q_f32(in + i), floor);
+    uint32x4_t  b = vreinterpretq_u32_f32(x);
+    int32x4_t   e = vsubq_s32(vreinterpretq_s32_u32(vshrq_n_u32(b, 23)), bias);
+    float32x4_t m = vreinterpretq_f32_u32(vorrq_u32(vandq_u32(b, mask), one));
+    uint32x4_t  big = vcgtq_f32(m, sqrt2);
+    float32x4_t f, p;
+
+    m = vbslq_f32(big, vmulq_n_f32(m, .5f), m);
+    e = vsubq_s32(e, vreinterpretq_s32_u32(big));
+    f = vsubq_f32(m, unity);
+
+    p = vfmaq_f32(vdupq_n_f32(C5), vdupq_n_f32(C6), f);
+    p = vfmaq_f32(vdupq_n_f32(C4), p, f);
+    p = vfmaq_f32(vdupq_n_f32(C3), p, f);
+    p = vfmaq_f32(vdupq_n_f32(C2), p, f);
+    p = vfmaq_f32(vdupq_n_f32(C1), p, f);
+    p = vfmaq_f32(vdupq_n_f32(C0), p, f);
+
+    vst1q_f32(
+          out + i,
+          vmulq_n_f32(vfmaq_f32(vcvtq_f32_s32(e), f, p), DB_PER_OCTAVE));
+  }
+
+  for (; i < len; ++i)
+    out[i] = powerDBScalar(in[i]);
+}
+#endif // SIGDIGGER_POWERDB_NEON
+
+void
+SigDigger::powerDB(const SUFLOAT *in, SUFLOAT *out, size_t len)
+{
+#if defined(SIGDIGGER_POWERDB_AVX2)
+  if (haveAVX2()) {
+    powerDBAVX2(in, out, len);
+    return;
+  }
+#endif // SIGDIGGER_POWERDB_AVX2
+
+#if defined(SIGDIGGER_POWERDB_SSE2)
+  powerDBSSE2(in, out, len);
+#elif defined(SIGDIGGER_POWERDB_NEON)
+  powerDBNEON(in, out, len);
+#else
+  size_t i;
+
+  for (i = 0; i < len; ++i)
+    out[i] = powerDBScalar(in[i]);
+#endif
+}
+
+void
+SigDigger::fftShiftPowerDB(SUFLOAT *data, size_t len)
+{
+  SUFLOAT tmp[SIGDIGGER_POWERDB_CHUNK];
+  size_t half = len / 2;
+  size_t i, n;
+
+  for (i = 0; i < half; i += n) {
+    n = std::min<size_t>(SIGDIGGER_POWERDB_CHUNK, half - i);
+
+    powerDB(data + half + i, tmp, n);
+    powerDB(data + i, data + half + i, n);
+    memcpy(data + i, tmp, n * sizeof(SUFLOAT));
+  }
+
+  // Odd sizes: the last bin stays where it is
+  if (len & 1)
+    powerDB(data + len - 1, data + len - 1, 1);
+}
+
+const char *
+SigDigger::powerDBImplementation(void)
+{
+#if defined(SIGDIGGER_POWERDB_AVX2)
+  if (haveAVX2())
+    return "AVX2";
+#endif // SIGDIGGER_POWERDB_AVX2
+
+#if defined(SIGDIGGER_POWERDB_SSE2)
+  return "SSE2";
+#elif defined(SIGDIGGER_POWERDB_NEON)
+  return "NEON";
+#else
+  return "scalar";
+#endif
+}
@@ -0,0 +1,219 @@
+//
+//    Resampler.cpp: Rational polyphase resampler
+//    Copyright (C) 2020 Gonzalo José Carracedo Carballal
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as
+//    published by the Free Software Foundation, either version 3 of the
+//    License, or (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful, but
+//    WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public
+//    License along with this program.  If not, see
+//    <http://www.gnu.org/licenses/>
+//
+
+#include "Resampler.h"
+#include <cmath>
+#include <algorithm>
+
+#if defined(__SSE2__)
+#  include <emmintrin.h>
+#  define SIGDIGGER_RESAMPLER_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#  include <arm_neon.h>
+#  define SIGDIGGER_RESAMPLER_NEON
+#endif
+
+using namespace SigDigger;
+
+// count is a multiple of 4 floats (2 complex samples)
+static inline SUCOMPLEX
+dotInterleaved(const SUFLOAT *x, const SUFLOAT *h, size_t count)
+{
+  size_t i = 0;
+
+#if defined(SIGDIGGER_RESAMPLER_SSE2)
+  __m128 acc0 = _mm_setzero_ps();
+  __m128 acc1 = _mm_setzero_ps();
+  float sum[4];
+
+  for (; i + 8 <= count; i += 8) {
+    acc0 = _mm_add_ps(
+          acc0,
+          _mm_mul_ps(_mm_loadu_ps(x + i), _mm_loadu_ps(h + i)));
+    acc1 = _mm_add_ps(
+          acc1,
+          _mm_mul_ps(_mm_loadu_ps(x + i + 4), _mm_loadu_ps(h + i + 4)));
+  }
+
+  if (i < count)
+    acc0 = _mm_add_ps(
+          acc0,
+          _mm_mul_ps(_mm_loadu_ps(x + i), _mm_loadu_ps(h + i)));
+
+  _mm_storeu_ps(sum, _mm_add_ps(acc0, acc1));
+
+  return SUCOMPLEX(sum[0] + sum[2], sum[1] + sum[3]);
+#elif defined(SIGDIGGER_RESAMPLER_NEON)
+  float32x4_t acc0 = vdupq_n_f32(0);
+  float32x4_t acc1 = vdupq_n_f32(0);
+  float32x4_t acc;
+
+  for (; i + 8 <= count; i += 8) {
+    acc0 = vfmaq_f32(acc0, vld1q_f32(x + i),     vld1q_f32(h + i));
+    acc1 = vfmaq_f32(acc1, vld1q_f32(x + i + 4), vld1q_f32(h + i + 4));
+  }
+
+  if (i < count)
+    acc0 = vfmaq_f32(acc0, vld1q_f32(x + i), vld1q_f32(h + i));
+
+  acc = vaddq_f32(acc0, acc1);
+
+  return SUCOMPLEX(
+        vgetq_lane_f32(acc, 0) + vgetq_lane_f32(acc, 2),
+        vgetq_lane_f32(acc, 1) + vgetq_lane_f32(acc, 3));
+#else
+  SUFLOAT re = 0, im = 0;
+
+  for (; i < count; i += 2) {
+    re += x[i] * h[i];
+    im += x[i + 1] * h[i + 1];
+  }
+
+  return SUCOMPLEX(re, im);
+#endif
+}
+
+// Last continued fraction convergent that fits
+bool
+Resampler::approximate(qreal ratio, unsigned int &interp, unsigned int &decim)
+{
+  quint64 h1 = 1, h2 = 0, k1 = 0, k2 = 1, h, k, a;
+  qreal x = ratio, frac;
+  unsigned int i;
+
+  interp = 1;
+  decim  = 1;
+
+  if (!(ratio >= 1. / SIGDIGGER_RESAMPLER_MAX_DOWN)
+      || ratio > SIGDIGGER_RESAMPLER_MAX_INTERP)
+    return false;
+
+  for (i = 0; i < 64; ++i) {
+    a = static_cast<quint64>(std::floor(x));
+    h = a * h1 + h2;
+    k = a * k1 + k2;
+
+    if (h > SIGDIGGER_RESAMPLER_MAX_INTERP
+        || k > SIGDIGGER_RESAMPLER_MAX_DECIM
+        || (h > 0 && k > h * SIGDIGGER_RESAMPLER_MAX_DOWN))
+      break;
+
+    if (h > 0) {
+      interp = static_cast<unsigned int>(h);
+      decim  = static_cast<unsigned int>(k);
+    }
+
+    frac = x - static_cast<qreal>(a);
+    if (frac < 1e-9)
+      break;
+
+    x  = 1 / frac;
+    h2 = h1;
+    h1 = h;
+    k2 = k1;
+    k1 = k;
+  }
+
+  return true;
+}
+
+Resampler::Resampler(unsigned int interp, unsigned int decim)
+{
+  std::vector<qreal> proto;
+  unsigned int i, j, p, len, widest;
+  qreal fc, t, sum = 0;
+
+  this->interp = std::max(interp, 1u);
+  this->decim  = std::min(
+        std::max(decim, 1u),
+        this->interp * SIGDIGGER_RESAMPLER_MAX_DOWN);
+
+  // At most MAX_TAPS, thanks to the cap above. The window always spans
+  // the whole main lobe of the sinc.
+  widest = std::max(this->interp, this->decim);
+  this->taps = static_cast<unsigned int>(
+        std::ceil(
+          static_cast<qreal>(SIGDIGGER_RESAMPLER_TAPS * widest) / this->interp));
+  this->taps += this->taps & 1;
+
+  len = this->interp * this->taps;
+  fc  = SIGDIGGER_RESAMPLER_PASSBAND * .5 / widest;
+
+  proto.resize(len);
+  for (i = 0; i < len; ++i) {
+    t = i - .5 * (len - 1);
+    proto[i] = t == 0.
+        ? 2 * fc
+        : std::sin(2 * PI * fc * t) / (PI * t);
+    proto[i] *= .42
+        - .5 * std::cos(2 * PI * i / (len - 1))
+        + .08 * std::cos(4 * PI * i / (len - 1));
+    sum += proto[i];
+  }
+
+  // Unity gain on every branch
+  for (i = 0; i < len; ++i)
+    proto[i] *= this->interp / sum;
+
+  // Branch p, reversed, each tap twice
+  this->bank.resize(2 * len);
+  for (p = 0; p < this->interp; ++p)
+    for (j = 0; j < this->taps; ++j) {
+      SUFLOAT tap = static_cast<SUFLOAT>(
+            proto[p + (this->taps - 1 - j) * this->interp]);
+      this->bank[2 * (p * this->taps + j)]     = tap;
+      this->bank[2 * (p * this->taps + j) + 1] = tap;
+    }
+
+  this->buffer.resize(this->taps - 1);
+}
+
+size_t
+Resampler::maxOutput(size_t len) const
+{
+  return (this->buffer.size() + len) * this->interp / this->decim + 1;
+}
+
+size_t
+Resampler::feed(const SUCOMPLEX *in, size_t len, SUCOMPLEX *out)
+{
+  const SUFLOAT *x;
+  size_t start, drop, avail, count = 0;
+
+  this->buffer.insert(this->buffer.end(), in, in + len);
+  avail = this->buffer.size();
+  x = reinterpret_cast<const SUFLOAT *>(this->buffer.data());
+
+  while ((start = this->time / this->interp) + this->taps <= avail) {
+    out[count++] = dotInterleaved(
+          x + 2 * start,
+          this->bank.data() + 2 * (this->time % this->interp) * this->taps,
+          2 * this->taps);
+    this->time += this->decim;
+  }
+
+  // Keep what the next output still needs
+  drop = std::min<size_t>(this->time / this->interp, avail);
+  this->buffer.erase(
+        this->buffer.begin(),
+        this->buffer.begin() + static_cast<ssize_t>(drop));
+  this->time -= static_cast<quint64>(drop) * this->interp;
+
+  return count;
+}
@@ -0,0 +1,408 @@
+//
+//    RotatingFileDataWriter.cpp: Split captures in a series of files
+//    Copyright (C) 2020 Gonzalo José Carracedo Carballal
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as
+//    published by the Free Software Foundation, either version 3 of the
+//    License, or (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful, but
+//    WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public
+//    License along with this program.  If not, see
+//    <http://www.gnu.org/licenses/>
+//
+
+#include "RotatingFileDataWriter.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstring>
+#include <cerrno>
+
+using namespace SigDigger;
+
+std::string
+RotatingFileDataWriter::segmentStem(std::string const &stem, unsigned int index)
+{
+  char suffix[16];
+
+  snprintf(suffix, sizeof(suffix), "-%04u", index);
+
+  return stem + suffix;
+}
+
+RotatingFileDataWriter::RotatingFileDataWriter(
+    int fd,
+    Params const &params,
+    Factory factory)
+{
+  this->firstFd  = fd;
+  this->params   = params;
+  this->factory  = factory;
+  this->writable = fd != -1;
+}
+
+std::string
+RotatingFileDataWriter::segmentPath(unsigned int index) const
+{
+  return segmentStem(this->params.stem, index) + this->params.extension;
+}
+
+void
+RotatingFileDataWriter::preallocate(int fd) const
+{
+#ifdef FALLOC_FL_KEEP_SIZE
+  // Reserve the extents without changing the apparent file size. Some
+  // filesystems do not support this, and that is fine.
+  (void) fallocate(
+        fd,
+        FALLOC_FL_KEEP_SIZE,
+        0,
+        static_cast<off_t>(this->params.segmentSamples * this->params.sampleSize));
+#else
+  (void) fd;
+#endif // FALLOC_FL_KEEP_SIZE
+}
+
+void
+RotatingFileDataWriter::removeSegment(unsigned int index) const
+{
+  std::string stem = segmentStem(this->params.stem, index);
+
+  (void) unlink((stem + this->params.extension).c_str());
+
+  for (auto &p : this->params.companions)
+    (void) unlink((stem + p).c_str());
+}
+
+// Closes a finished segment and gives back whatever was preallocated and
+// not used.
+bool
+RotatingFileDataWriter::retire(
+    GenericDataWriter *writer,
+    unsigned int index,
+    quint64 samples,
+    std::string &error) const
+{
+  bool ok = writer->close();
+
+  if (!ok)
+    error = writer->getError();
+
+  delete writer;
+
+  if (truncate(
+        this->segmentPath(index).c_str(),
+        static_cast<off_t>(samples * this->params.sampleSize)) == -1) {
+    if (ok)
+      error = "Cannot truncate "
+          + this->segmentPath(index)
+          + ": "
+          + strerror(errno);
+    ok = false;
+  }
+
+  return ok;
+}
+
+// The factory and prepare() may be expensive (direct I/O allocates its
+// pool and starts its threads), which is why this runs in the helper.
+GenericDataWriter *
+RotatingFileDataWriter::openNext(unsigned int index, std::string &error)
+{
+  GenericDataWriter *writer;
+  int fd;
+
+  fd = open(
+        this->segmentPath(index).c_str(),
+        O_CREAT | O_TRUNC | O_WRONLY,
+        0600);
+
+  if (fd == -1) {
+    error = "Cannot open " + this->segmentPath(index) + ": " + strerror(errno);
+    return nullptr;
+  }
+
+  this->preallocate(fd);
+
+  writer = this->factory(fd);
+
+  if (!writer->prepare()) {
+    error = writer->getError();
+    delete writer;
+    (void) unlink(this->segmentPath(index).c_str());
+    return nullptr;
+  }
+
+  return writer;
+}
+
+void
+RotatingFileDataWriter::helperLoop(void)
+{
+  GenericDataWriter *writer;
+  GenericDataWriter *old;
+  quint64 samples;
+  unsigned int index;
+  std::string error, retireError;
+  bool exiting;
+
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(this->helperMutex);
+
+      this->requestCond.wait(
+            lock,
+            [this] () { return this->exiting || this->requested; });
+
+      // A pending request still has a segment to close
+      if (!this->requested)
+        return;
+
+      this->requested = false;
+      index    = this->requestIndex;
+      old      = this->retiring;
+      samples  = this->retiringSamples;
+      exiting  = this->exiting;
+      this->retiring = nullptr;
+    }
+
+    retireError.clear();
+    if (old != nullptr)
+      (void) this->retire(old, index - 1, samples, retireError);
+
+    if (index == 0)
+      this->preallocate(this->firstFd);
+
+    if (this->params.retain > 0 && index > this->params.retain)
+      this->removeSegment(index - this->params.retain - 1);
+
+    writer = nullptr;
+    error.clear();
+    if (!exiting)
+      writer = this->openNext(index + 1, error);
+
+    {
+      std::lock_guard<std::mutex> lock(this->helperMutex);
+      if (!retireError.empty() && this->retireError.empty())
+        this->retireError = retireError;
+      this->nextWriter = writer;
+      this->nextError  = error;
+      this->ready      = !exiting;
+    }
+
+    this->readyCond.notify_all();
+
+    if (exiting)
+      return;
+  }
+}
+
+void
+RotatingFileDataWriter::request(GenericDataWriter *retiring, quint64 samples)
+{
+  {
+    std::lock_guard<std::mutex> lock(this->helperMutex);
+    this->requestIndex = this->index;
+    this->retiring = retiring;
+    this->retiringSamples = samples;
+    this->requested = true;
+  }
+
+  this->requestCond.notify_one();
+}
+
+void
+RotatingFileDataWriter::setError(std::string const &error)
+{
+  this->lastError = error;
+  this->failed = true;
+  this->writable = false;
+}
+
+bool
+RotatingFileDataWriter::closeCurrent(void)
+{
+  std::string error;
+  bool ok;
+
+  if (this->current == nullptr)
+    return true;
+
+  ok = this->retire(this->current, this->index, this->written, error);
+  this->current = nullptr;
+
+  if (!ok)
+    this->setError(error);
+
+  return ok;
+}
+
+bool
+RotatingFileDataWriter::rotate(void)
+{
+  GenericDataWriter *writer;
+  std::string error;
+
+  {
+    std::unique_lock<std::mutex> lock(this->helperMutex);
+
+    // Normally, the helper finished long ago
+    this->readyCond.wait(lock, [this] () { return this->ready; });
+
+    writer = this->nextWriter;
+    error = this->retireError.empty() ? this->nextError : this->retireError;
+    this->nextWriter = nullptr;
+    this->ready = false;
+  }
+
+  if (!error.empty()) {
+    if (writer != nullptr) {
+      // Not used: leave nothing behind
+      delete writer;
+      (void) unlink(this->segmentPath(this->index + 1).c_str());
+    }
+
+    this->setError(error);
+    return false;
+  }
+
+  // The helper closes the finished segment, and then prepares the next one
+  ++this->index;
+  this->request(this->current, this->written);
+  this->current = writer;
+  this->written = 0;
+
+  return true;
+}
+
+bool
+RotatingFileDataWriter::prepare(void)
+{
+  if (this->current != nullptr)
+    return true;
+
+  if (this->firstFd == -1) {
+    this->setError("Invalid file descriptor");
+    return false;
+  }
+
+  if (this->params.segmentSamples == 0) {
+    this->setError("Invalid segment size");
+    return false;
+  }
+
+  this->current = this->factory(this->firstFd);
+
+  if (!this->current->prepare()) {
+    this->setError(this->current->getError());
+    return false;
+  }
+
+  this->helper = std::thread(&RotatingFileDataWriter::helperLoop, this);
+  this->request(nullptr, 0);
+
+  return true;
+}
+
+bool
+RotatingFileDataWriter::canWrite(void) const
+{
+  return this->writable;
+}
+
+std::string
+RotatingFileDataWriter::getError(void) const
+{
+  return this->lastError;
+}
+
+ssize_t
+RotatingFileDataWriter::write(const SUCOMPLEX *data, size_t len)
+{
+  size_t chunk;
+  quint64 avail;
+  ssize_t result;
+
+  if (this->failed || this->current == nullptr)
+    return -1;
+
+  // Rollover happens between two samples of the same call. Nothing
+  // is lost, and the worker only sees a slightly slower write.
+  for (size_t remaining = len; remaining > 0; ) {
+    if (this->written == this->params.segmentSamples && !this->rotate())
+      return -1;
+
+    avail = this->params.segmentSamples - this->written;
+    chunk = avail < remaining ? static_cast<size_t>(avail) : remaining;
+
+    result = this->current->write(data, chunk);
+
+    if (result < 1) {
+      this->setError(this->current->getError());
+      return -1;
+    }
+
+    this->written += static_cast<quint64>(result);
+    data      += result;
+    remaining -= static_cast<size_t>(result);
+  }
+
+  return static_cast<ssize_t>(len);
+}
+
+bool
+RotatingFileDataWriter::close(void)
+{
+  bool ok = true;
+
+  if (this->helper.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(this->helperMutex);
+      this->exiting = true;
+    }
+
+    // Waits for the previous segment to be closed
+    this->requestCond.notify_all();
+    this->helper.join();
+
+    // The last request may have been discarded
+    if (this->params.retain > 0 && this->index > this->params.retain)
+      this->removeSegment(this->index - this->params.retain - 1);
+
+    if (!this->retireError.empty()) {
+      this->setError(this->retireError);
+      ok = false;
+    }
+  }
+
+  // The segment after the last one was never used
+  if (this->nextWriter != nullptr) {
+    delete this->nextWriter;
+    (void) unlink(this->segmentPath(this->index + 1).c_str());
+    this->nextWriter = nullptr;
+  }
+
+  this->ready = false;
+
+  if (this->current == nullptr && this->firstFd != -1 && this->index == 0) {
+    // Never prepared
+    ok = ::close(this->firstFd) == 0 && ok;
+  } else {
+    ok = this->closeCurrent() && ok;
+  }
+
+  this->firstFd = -1;
+  this->writable = false;
+
+  return ok;
+}
+
+RotatingFileDataWriter::~RotatingFileDataWriter(void)
+{
+  this->close();
+}
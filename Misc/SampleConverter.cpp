@@ -0,0 +1,322 @@
+//
+//    SampleConverter.cpp: Convert complex float samples to recording formats
+//    Copyright (C) 2020 Gonzalo José Carracedo Carballal
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as
+//    published by the Free Software Foundation, either version 3 of the
+//    License, or (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful, but
+//    WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public
+//    License along with this program.  If not, see
+//    <http://www.gnu.org/licenses/>
+//
+
+#include "SampleConverter.h"
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__)
+#  include <emmintrin.h>
+#  define SIGDIGGER_CONVERTER_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#  include <arm_neon.h>
+#  define SIGDIGGER_CONVERTER_NEON
+#endif
+
+using namespace SigDigger;
+
+template <typename T>
+static inline uint64_t
+toIntScalar(
+    T *dest,
+    const SUFLOAT *src,
+    size_t count,
+    SUFLOAT scale,
+    SUFLOAT max,
+    SUFLOAT min)
+{
+  uint64_t clipped = 0;
+  SUFLOAT x;
+
+  for (size_t i = 0; i < count; ++i) {
+    x = src[i] * scale;
+
+    if (x > max) {
+      x = max;
+      ++clipped;
+    } else if (x < min) {
+      x = min;
+      ++clipped;
+    }
+
+    dest[i] = static_cast<T>(lrintf(x));
+  }
+
+  return clipped;
+}
+
+#if defined(SIGDIGGER_CONVERTER_SSE2)
+static inline __m128
+scaleAndClip(
+    const SUFLOAT *src,
+    __m128 scale,
+    __m128 max,
+    __m128 min,
+    int &mask)
+{
+  __m128 x = _mm_mul_ps(_mm_loadu_ps(src), scale);
+
+  mask |= _mm_movemask_ps(_mm_or_ps(_mm_cmpgt_ps(x, max), _mm_cmplt_ps(x, min)));
+
+  return _mm_min_ps(_mm_max_ps(x, min), max);
+}
+
+static inline unsigned int
+popCount4(int mask)
+{
+  return static_cast<unsigned int>(
+        (mask & 1) + ((mask >> 1) & 1) + ((mask >> 2) & 1) + ((mask >> 3) & 1));
+}
+#elif defined(SIGDIGGER_CONVERTER_NEON)
+static inline float32x4_t
+scaleAndClip(
+    const SUFLOAT *src,
+    float32x4_t scale,
+    float32x4_t max,
+    float32x4_t min,
+    uint32x4_t &clipped)
+{
+  float32x4_t x = vmulq_f32(vld1q_f32(src), scale);
+
+  // Comparisons yield all ones (-1) on true
+  clipped = vsubq_u32(clipped, vcgtq_f32(x, max));
+  clipped = vsubq_u32(clipped, vcltq_f32(x, min));
+
+  return vminq_f32(vmaxq_f32(x, min), max);
+}
+#endif
+
+uint64_t
+SampleConverter::toInt16(
+    int16_t *dest,
+    const SUFLOAT *src,
+    size_t len,
+    SUFLOAT scale)
+{
+  size_t count = 2 * len;
+  size_t i = 0;
+  uint64_t clipped = 0;
+
+#if defined(SIGDIGGER_CONVERTER_SSE2)
+  __m128 vScale = _mm_set1_ps(scale);
+  __m128 vMax   = _mm_set1_ps(32767.f);
+  __m128 vMin   = _mm_set1_ps(-32768.f);
+
+  for (; i + 8 <= count; i += 8) {
+    int maskA = 0, maskB = 0;
+    __m128 a = scaleAndClip(src + i,     vScale, vMax, vMin, maskA);
+    __m128 b = scaleAndClip(src + i + 4, vScale, vMax, vMin, maskB);
+
+    _mm_storeu_si128(
+          reinterpret_cast<__m128i *>(dest + i),
+          _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b)));
+
+    if (maskA | maskB)
+      clipped += popCount4(maskA) + popCount4(maskB);
+  }
+#elif defined(SIGDIGGER_CONVERTER_NEON)
+  float32x4_t vScale = vdupq_n_f32(scale);
+  float32x4_t vMax   = vdupq_n_f32(32767.f);
+  float32x4_t vMin   = vdupq_n_f32(-32768.f);
+  uint32x4_t vClipped = vdupq_n_u32(0);
+
+  for (; i + 8 <= count; i += 8) {
+    float32x4_t a = scaleAndClip(src + i,     vScale, vMax, vMin, vClipped);
+    float32x4_t b = scaleAndClip(src + i + 4, vScale, vMax, vMin, vClipped);
+
+    vst1q_s16(
+          dest + i,
+          vcombine_s16(
+            vqmovn_s32(vcvtnq_s32_f32(a)),
+            vqmovn_s32(vcvtnq_s32_f32(b))));
+  }
+
+  clipped = vaddvq_u32(vClipped);
+#endif
+
+  return clipped + toIntScalar<int16_t>(
+        dest + i,
+        src + i,
+        count - i,
+        scale,
+        32767.f,
+        -32768.f);
+}
+
+uint64_t
+SampleConverter::toInt8(
+    int8_t *dest,
+    const SUFLOAT *src,
+    size_t len,
+    SUFLOAT scale)
+{
+  size_t count = 2 * len;
+  size_t i = 0;
+  uint64_t clipped = 0;
+
+#if defined(SIGDIGGER_CONVERTER_SSE2)
+  __m128 vScale = _mm_set1_ps(scale);
+  __m128 vMax   = _mm_set1_ps(127.f);
+  __m128 vMin   = _mm_set1_ps(-128.f);
+
+  for (; i + 16 <= count; i += 16) {
+    int maskA = 0, maskB = 0, maskC = 0, maskD = 0;
+    __m128 a = scaleAndClip(src + i,      vScale, vMax, vMin, maskA);
+    __m128 b = scaleAndClip(src + i + 4,  vScale, vMax, vMin, maskB);
+    __m128 c = scaleAndClip(src + i + 8,  vScale, vMax, vMin, maskC);
+    __m128 d = scaleAndClip(src + i + 12, vScale, vMax, vMin, maskD);
+
+    _mm_storeu_si128(
+          reinterpret_cast<__m128i *>(dest + i),
+          _mm_packs_epi16(
+            _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b)),
+            _mm_packs_epi32(_mm_cvtps_epi32(c), _mm_cvtps_epi32(d))));
+
+    if (maskA | maskB | maskC | maskD)
+      clipped += popCount4(maskA) + popCount4(maskB)
+          + popCount4(maskC) + popCount4(maskD);
+  }
+#elif defined(SIGDIGGER_CONVERTER_NEON)
+  float32x4_t vScale = vdupq_n_f32(scale);
+  float32x4_t vMax   = vdupq_n_f32(127.f);
+  float32x4_t vMin   = vdupq_n_f32(-128.f);
+  uint32x4_t vClipped = vdupq_n_u32(0);
+
+  for (; i + 16 <= count; i += 16) {
+    float32x4_t a = scaleAndClip(src + i,      vScale, vMax, vMin, vClipped);
+    float32x4_t b = scaleAndClip(src + i + 4,  vScale, vMax, vMin, vClipped);
+    float32x4_t c = scaleAndClip(src + i + 8,  vScale, vMax, vMin, vClipped);
+    float32x4_t d = scaleAndClip(src + i + 12, vScale, vMax, vMin, vClipped);
+
+    int16x8_t lo = vcombine_s16(
+          vqmovn_s32(vcvtnq_s32_f32(a)),
+          vqmovn_s32(vcvtnq_s32_f32(b)));
+    int16x8_t hi = vcombine_s16(
+          vqmovn_s32(vcvtnq_s32_f32(c)),
+          vqmovn_s32(vcvtnq_s32_f32(d)));
+
+    vst1q_s8(dest + i, vcombine_s8(vqmovn_s16(lo), vqmovn_s16(hi)));
+  }
+
+  clipped = vaddvq_u32(vClipped);
+#endif
+
+  return clipped + toIntScalar<int8_t>(
+        dest + i,
+        src + i,
+        count - i,
+        scale,
+        127.f,
+        -128.f);
+}
+
+size_t
+SampleConverter::sampleSize(SampleFormat format)
+{
+  switch (format) {
+    case SAMPLE_FORMAT_CI16:
+      return 2 * sizeof(int16_t);
+
+    case SAMPLE_FORMAT_CI8:
+      return 2 * sizeof(int8_t);
+
+    default:
+      return sizeof(SUCOMPLEX);
+  }
+}
+
+std::string
+SampleConverter::formatName(SampleFormat format)
+{
+  switch (format) {
+    case SAMPLE_FORMAT_CI16:
+      return "int16";
+
+    case SAMPLE_FORMAT_CI8:
+      return "int8";
+
+    default:
+      return "float32";
+  }
+}
+
+SampleFormat
+SampleConverter::formatFromName(std::string const &name)
+{
+  if (name == "int16")
+    return SAMPLE_FORMAT_CI16;
+  else if (name == "int8")
+    return SAMPLE_FORMAT_CI8;
+
+  return SAMPLE_FORMAT_CF32;
+}
+
+SampleConverter::SampleConverter(SampleFormat format, SUFLOAT fullScale)
+{
+  this->setFormat(format, fullScale);
+}
+
+void
+SampleConverter::setFormat(SampleFormat format, SUFLOAT fullScale)
+{
+  SUFLOAT max;
+
+  if (fullScale <= 0)
+    fullScale = 1;
+
+  switch (format) {
+    case SAMPLE_FORMAT_CI16:
+      max = 32767;
+      break;
+
+    case SAMPLE_FORMAT_CI8:
+      max = 127;
+      break;
+
+    default:
+      max = 1;
+  }
+
+  this->format    = format;
+  this->fullScale = fullScale;
+  this->scale     = max / fullScale;
+}
+
+void
+SampleConverter::convert(void *dest, const SUCOMPLEX *src, size_t len)
+{
+  const SUFLOAT *floats = reinterpret_cast<const SUFLOAT *>(src);
+  uint64_t clipped = 0;
+
+  switch (this->format) {
+    case SAMPLE_FORMAT_CI16:
+      clipped = toInt16(static_cast<int16_t *>(dest), floats, len, this->scale);
+      break;
+
+    case SAMPLE_FORMAT_CI8:
+      clipped = toInt8(static_cast<int8_t *>(dest), floats, len, this->scale);
+      break;
+
+    default:
+      memcpy(dest, src, len * sizeof(SUCOMPLEX));
+  }
+
+  if (clipped > 0)
+    this->clipped += clipped;
+}
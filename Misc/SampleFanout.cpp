@@ -0,0 +1,485 @@
+//
+//    SampleFanout.cpp: Share a sample stream among several consumers
+//    Copyright (C) 2020 Gonzalo José Carracedo Carballal
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as
+//    published by the Free Software Foundation, either version 3 of the
+//    License, or (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful, but
+//    WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public
+//    License along with this program.  If not, see
+//    <http://www.gnu.org/licenses/>
+//
+
+#include "SampleFanout.h"
+#include <cstring>
+#include <sys/time.h>
+#include <new>
+#include <thread>
+#include <algorithm>
+
+using namespace SigDigger;
+
+////////////////////////////// SampleFanoutSink ////////////////////////////////
+SampleFanoutSink::SampleFanoutSink(unsigned int depth, OverflowPolicy policy)
+{
+  this->policy = policy;
+  this->setDepth(depth);
+}
+
+SampleFanoutSink::~SampleFanoutSink()
+{
+  this->detach();
+  this->clear();
+
+  // Our blocks are idle now
+  if (this->fanout.get() != nullptr)
+    this->fanout->maintain();
+}
+
+void
+SampleFanoutSink::setDepth(unsigned int depth)
+{
+  if (this->attached)
+    return;
+
+  this->clear();
+
+  if (depth < 1)
+    depth = 1;
+
+  this->queue = std::vector<std::atomic<SampleBlock *>>(depth);
+  this->depth = depth;
+  this->limit = depth;
+  this->head  = 0;
+  this->tail  = 0;
+}
+
+// Shrinks or grows the queue without reallocating it, up to its depth
+void
+SampleFanoutSink::setLimit(unsigned int limit)
+{
+  this->limit = std::max(1u, std::min(limit, this->depth));
+
+  if (this->attached)
+    this->fanout->maintain();
+}
+
+unsigned int
+SampleFanoutSink::getDepth(void) const
+{
+  return this->depth;
+}
+
+unsigned int
+SampleFanoutSink::queued(void) const
+{
+  return this->head.load() - this->tail.load();
+}
+
+quint64
+SampleFanoutSink::getDropped(void) const
+{
+  return this->dropped;
+}
+
+SampleFanout *
+SampleFanoutSink::getFanout(void) const
+{
+  return this->fanout.get();
+}
+
+bool
+SampleFanoutSink::wants(const SampleBlock *)
+{
+  return true;
+}
+
+void
+SampleFanoutSink::accept(const SampleBlock *)
+{
+}
+
+void
+SampleFanoutSink::overflow(const SampleBlock *)
+{
+}
+
+// The queue is full. Returning true makes the producer check again.
+bool
+SampleFanoutSink::stall(void)
+{
+  return false;
+}
+
+void
+SampleFanoutSink::notify(void)
+{
+}
+
+SampleBlock *
+SampleFanoutSink::at(unsigned int index) const
+{
+  return this->queue[(this->tail.load() + index) % this->depth].load();
+}
+
+bool
+SampleFanoutSink::attach(std::shared_ptr<SampleFanout> const &fanout)
+{
+  SampleFanoutSink *expected;
+
+  if (this->attached || fanout.get() == nullptr)
+    return false;
+
+  {
+    std::lock_guard<std::mutex> lock(fanout->poolMutex);
+
+    for (auto &p : fanout->sinks) {
+      expected = nullptr;
+      if (p.compare_exchange_strong(expected, this)) {
+        // Keep the pool alive as long as we may hold any of its blocks
+        this->fanout = fanout;
+        this->attached = true;
+        ++fanout->sinkCount;
+        break;
+      }
+    }
+  }
+
+  // Make room for our queue before the producer needs it
+  if (this->attached)
+    fanout->maintain();
+
+  return this->attached;
+}
+
+void
+SampleFanoutSink::detach(void)
+{
+  SampleFanoutSink *expected;
+
+  if (!this->attached)
+    return;
+
+  {
+    std::lock_guard<std::mutex> lock(this->fanout->poolMutex);
+
+    for (auto &p : this->fanout->sinks) {
+      expected = this;
+      if (p.compare_exchange_strong(expected, nullptr))
+        break;
+    }
+
+    --this->fanout->sinkCount;
+  }
+
+  // The producer may still be inside offer(). Wait for it to leave.
+  while (this->fanout->publishing.load())
+    std::this_thread::yield();
+
+  this->attached = false;
+}
+
+// Producer side
+bool
+SampleFanoutSink::discardOldest(void)
+{
+  unsigned int tail = this->tail.load();
+  SampleBlock *block;
+
+  if (tail == this->head.load())
+    return false;
+
+  block = this->queue[tail % this->depth].load();
+
+  // If the consumer took it first, there is room anyway
+  if (this->tail.compare_exchange_strong(tail, tail + 1)) {
+    this->dropped += block->len;
+    this->release(block);
+  }
+
+  return true;
+}
+
+void
+SampleFanoutSink::offer(SampleBlock *block)
+{
+  unsigned int head;
+
+  if (!this->wants(block))
+    return;
+
+  while (this->queued() >= this->limit) {
+    if (this->policy == OVERFLOW_DROP_OLDEST && this->discardOldest())
+      continue;
+
+    if (this->stall())
+      continue;
+
+    this->dropped += block->len;
+    this->overflow(block);
+    return;
+  }
+
+  this->accept(block);
+
+  block->refs.fetch_add(1);
+
+  head = this->head.load();
+  this->queue[head % this->depth] = block;
+  this->head = head + 1;
+
+  this->notify();
+}
+
+// Consumer side
+SampleBlock *
+SampleFanoutSink::pop(void)
+{
+  unsigned int tail = this->tail.load();
+  SampleBlock *block;
+
+  do {
+    if (tail == this->head.load())
+      return nullptr;
+
+    block = this->queue[tail % this->depth].load();
+  } while (!this->tail.compare_exchange_weak(tail, tail + 1));
+
+  return block;
+}
+
+void
+SampleFanoutSink::release(SampleBlock *block)
+{
+  block->refs.fetch_sub(1);
+}
+
+void
+SampleFanoutSink::clear(void)
+{
+  SampleBlock *block;
+
+  while ((block = this->pop()) != nullptr)
+    this->release(block);
+}
+
+//////////////////////////////// SampleFanout //////////////////////////////////
+size_t
+SampleFanout::blockLength(unsigned int rate)
+{
+  return std::max<size_t>(
+        rate / SIGDIGGER_FANOUT_BLOCKS_PER_SECOND,
+        SIGDIGGER_FANOUT_MIN_BLOCK_LEN);
+}
+
+SampleFanout::SampleFanout(size_t blockLen, unsigned int maxBlocks)
+{
+  this->blockLen = std::max<size_t>(blockLen, 1);
+  this->blocks.resize(std::max(maxBlocks, 1u));
+
+  for (auto &p : this->sinks)
+    p = nullptr;
+}
+
+SampleFanout::~SampleFanout()
+{
+  unsigned int i, allocated = this->allocated;
+
+  // Sinks keep us alive while they hold blocks. Nobody refers to them now.
+  for (i = 0; i < allocated; ++i)
+    delete this->blocks[i];
+}
+
+unsigned int
+SampleFanout::getMaxBlocks(void) const
+{
+  return static_cast<unsigned int>(this->blocks.size());
+}
+
+unsigned int
+SampleFanout::getFreeBlocks(void) const
+{
+  std::lock_guard<std::mutex> lock(this->poolMutex);
+  unsigned int i, allocated = this->allocated;
+  unsigned int free = this->getMaxBlocks() - allocated;
+
+  for (i = 0; i < allocated; ++i)
+    if (this->blocks[i]->refs.load() == 0)
+      ++free;
+
+  return free;
+}
+
+quint64
+SampleFanout::getMemoryUsage(void) const
+{
+  return static_cast<quint64>(this->allocated)
+      * this->blockLen
+      * sizeof(SUCOMPLEX);
+}
+
+quint64
+SampleFanout::getDropped(void) const
+{
+  return this->dropped;
+}
+
+//
+// Sum of what the sinks may hold, plus the block being filled and the one
+// being published. Blocks are allocated here, away from the producer. At
+// the end of the pool, idle blocks above that are freed: they are claimed
+// first, so that the producer cannot take them, and deleted once the
+// producer is out of acquire().
+//
+void
+SampleFanout::maintain(void)
+{
+  std::lock_guard<std::mutex> lock(this->poolMutex);
+  unsigned int allocated = this->allocated;
+  unsigned int expected;
+  quint64 wanted = SIGDIGGER_FANOUT_SPARE_BLOCKS;
+  SampleFanoutSink *sink;
+  SampleBlock *block;
+
+  for (auto &p : this->sinks)
+    if ((sink = p.load()) != nullptr)
+      wanted += sink->limit.load();
+
+  if (wanted > this->blocks.size())
+    wanted = this->blocks.size();
+
+  while (allocated < wanted) {
+    block = new (std::nothrow) SampleBlock();
+    if (block == nullptr)
+      break;
+
+    try {
+      block->data.resize(this->blockLen);
+    } catch (std::bad_alloc &) {
+      delete block;
+      break;
+    }
+
+    this->blocks[allocated] = block;
+    this->allocated = ++allocated;
+  }
+
+  while (allocated > wanted) {
+    block = this->blocks[allocated - 1];
+    expected = 0;
+    if (!block->refs.compare_exchange_strong(expected, 1))
+      break;
+
+    this->allocated = --allocated;
+
+    // The producer may have read the old count. Wait for it to leave.
+    while (this->acquiring.load())
+      std::this_thread::yield();
+
+    delete block;
+  }
+}
+
+//
+// Lowest free block first: this keeps the set of blocks in use small
+// and lets the ones at the end of the pool go idle, so maintain() can
+// free them.
+//
+SampleBlock *
+SampleFanout::acquire(void)
+{
+  unsigned int i, allocated, expected;
+  SampleBlock *found = nullptr;
+
+  this->acquiring = true;
+  allocated = this->allocated;
+
+  for (i = 0; i < allocated; ++i) {
+    expected = 0;
+    if (this->blocks[i]->refs.compare_exchange_strong(expected, 1)) {
+      found = this->blocks[i];
+      break;
+    }
+  }
+
+  this->acquiring = false;
+
+  return found;
+}
+
+void
+SampleFanout::publish(SampleBlock *block)
+{
+  SampleFanoutSink *sink;
+
+  this->publishing = true;
+
+  for (auto &p : this->sinks)
+    if ((sink = p.load()) != nullptr)
+      sink->offer(block);
+
+  this->publishing = false;
+
+  // Drop the producer's reference. If nobody queued it, it is free again.
+  block->refs.fetch_sub(1);
+}
+
+void
+SampleFanout::write(const SUCOMPLEX *data, size_t len)
+{
+  struct timeval tv;
+  size_t chunk, avail;
+
+  // Nobody is listening. Do not even copy.
+  if (this->sinkCount == 0) {
+    if (this->current != nullptr) {
+      this->current->refs = 0;
+      this->current = nullptr;
+    }
+
+    this->position += len;
+    return;
+  }
+
+  while (len > 0) {
+    if (this->current == nullptr) {
+      if ((this->current = this->acquire()) == nullptr) {
+        // Lost for everyone. Sinks will see the jump in block positions.
+        this->dropped += len;
+        this->position += len;
+        return;
+      }
+
+      gettimeofday(&tv, nullptr);
+      this->current->position = this->position;
+      this->current->time = tv.tv_sec * 1000000ll + tv.tv_usec;
+      this->ptr = 0;
+    }
+
+    avail = this->blockLen - this->ptr;
+    chunk = len < avail ? len : avail;
+
+    memcpy(
+          this->current->data.data() + this->ptr,
+          data,
+          chunk * sizeof(SUCOMPLEX));
+
+    this->ptr      += chunk;
+    this->position += chunk;
+    data += chunk;
+    len  -= chunk;
+
+    if (this->ptr == this->blockLen) {
+      this->current->len = this->ptr;
+      this->publish(this->current);
+      this->current = nullptr;
+    }
+  }
+}
@@ -0,0 +1,262 @@
+//
+//    SigMFMetadataWriter.cpp: Write SigMF metadata sidecars
+//    Copyright (C) 2020 Gonzalo José Carracedo Carballal
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as
+//    published by the Free Software Foundation, either version 3 of the
+//    License, or (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful, but
+//    WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public
+//    License along with this program.  If not, see
+//    <http://www.gnu.org/licenses/>
+//
+
+#include "SigMFMetadataWriter.h"
+#include <QJsonDocument>
+#include <QSaveFile>
+#include <QDateTime>
+
+using namespace SigDigger;
+
+static QString
+currentDateTime(void)
+{
+  return QDateTime::currentDateTimeUtc().toString(Qt::ISODateWithMs);
+}
+
+///////////////////////////// SigMFMetadataWorker //////////////////////////////
+SigMFMetadataWorker::SigMFMetadataWorker(QString const &path)
+{
+  this->path = path;
+}
+
+void
+SigMFMetadataWorker::onStore(QByteArray data)
+{
+  // Readers never see a half-written sidecar: QSaveFile writes to a
+  // temporary file and renames it on commit.
+  QSaveFile file(this->path);
+
+  if (!file.open(QIODevice::WriteOnly)
+      || file.write(data) != data.size()
+      || !file.commit())
+    emit error(file.errorString());
+}
+
+///////////////////////////// SigMFMetadataWriter //////////////////////////////
+std::string
+SigMFMetadataWriter::datatype(SampleFormat format)
+{
+  switch (format) {
+    case SAMPLE_FORMAT_CI16:
+      return "ci16_le";
+
+    case SAMPLE_FORMAT_CI8:
+      return "ci8";
+
+    default:
+      return "cf32_le";
+  }
+}
+
+SigMFMetadataWriter::SigMFMetadataWriter(QString const &path, QObject *parent) :
+  QObject(parent),
+  workerObject(path)
+{
+  QObject::connect(
+        this,
+        SIGNAL(store(QByteArray)),
+        &this->workerObject,
+        SLOT(onStore(QByteArray)));
+
+  QObject::connect(
+        &this->workerObject,
+        SIGNAL(error(QString)),
+        this,
+        SIGNAL(error(QString)));
+
+  QObject::connect(
+        &this->updateTimer,
+        SIGNAL(timeout(void)),
+        this,
+        SLOT(onUpdateTimeout(void)));
+
+  this->updateTimer.setSingleShot(true);
+  this->updateTimer.setInterval(SIGDIGGER_SIGMF_UPDATE_INTERVAL_MS);
+
+  this->global["core:version"] = SIGDIGGER_SIGMF_VERSION;
+  this->global["core:recorder"] = "SigDigger";
+
+  this->workerObject.moveToThread(&this->workerThread);
+  this->workerThread.start();
+}
+
+SigMFMetadataWriter::~SigMFMetadataWriter()
+{
+  this->workerThread.quit();
+  this->workerThread.wait();
+
+  // Updates still queued may have been discarded. The worker is idle now,
+  // store the final document from here.
+  this->workerObject.onStore(this->document());
+}
+
+QByteArray
+SigMFMetadataWriter::document(void) const
+{
+  QJsonObject root;
+
+  root["global"] = this->global;
+  root["captures"] = this->captures;
+  root["annotations"] = this->annotations;
+
+  return QJsonDocument(root).toJson();
+}
+
+// The first change is stored right away. Changes during the following
+// interval are stored together when it ends.
+void
+SigMFMetadataWriter::update(void)
+{
+  if (this->updateTimer.isActive()) {
+    this->dirty = true;
+    return;
+  }
+
+  emit store(this->document());
+  this->updateTimer.start();
+}
+
+void
+SigMFMetadataWriter::setGlobal(
+    SampleFormat format,
+    qreal sampleRate,
+    QString const &hw,
+    QString const &description)
+{
+  this->global["core:datatype"] = QString::fromStdString(datatype(format));
+  this->global["core:sample_rate"] = sampleRate;
+
+  if (!hw.isEmpty())
+    this->global["core:hw"] = hw;
+
+  if (!description.isEmpty())
+    this->global["core:description"] = description;
+
+  this->update();
+}
+
+//
+// globalIndex is the index of the sample in the original stream. It only
+// differs from the position in the file after samples have been dropped,
+// and it is what lets readers put them back in time.
+//
+void
+SigMFMetadataWriter::addCapture(
+    quint64 sample,
+    qreal frequency,
+    quint64 globalIndex)
+{
+  QJsonObject capture;
+
+  capture["core:sample_start"] = static_cast<qint64>(sample);
+  capture["core:global_index"] = static_cast<qint64>(globalIndex);
+  capture["core:frequency"] = frequency;
+  capture["core:datetime"] = currentDateTime();
+
+  // Segments must start at different samples. Several changes before the
+  // next sample collapse into the last one.
+  if (!this->captures.isEmpty()
+      && this->captures.last().toObject()["core:sample_start"].toVariant()
+        .toULongLong() == sample)
+    this->captures.removeLast();
+
+  this->captures.append(capture);
+
+  this->update();
+}
+
+void
+SigMFMetadataWriter::addAnnotation(
+    quint64 sample,
+    quint64 count,
+    QString const &label,
+    QString const &comment)
+{
+  QJsonObject annotation;
+
+  annotation["core:sample_start"] = static_cast<qint64>(sample);
+
+  if (count > 0)
+    annotation["core:sample_count"] = static_cast<qint64>(count);
+
+  annotation["core:label"] = label;
+  annotation["core:comment"] = comment;
+
+  this->annotations.append(annotation);
+
+  this->update();
+}
+
+//
+// A gap takes no room in the file, so it is a zero-length annotation
+// right before the first sample that came after it. How many samples
+// are missing goes in sigdigger:dropped_samples. Drops with no samples
+// in between make a single gap. Readers that want to put the samples
+// back in time use core:global_index in the capture segments instead.
+//
+void
+SigMFMetadataWriter::addGap(quint64 sample, quint64 dropped)
+{
+  QJsonObject annotation, extension;
+  QJsonArray extensions;
+  quint64 count = dropped;
+
+  if (!this->global.contains("core:extensions")) {
+    extension["name"] = SIGDIGGER_SIGMF_EXTENSION;
+    extension["version"] = SIGDIGGER_SIGMF_EXTENSION_VERSION;
+    extension["optional"] = true;
+    extensions.append(extension);
+    this->global["core:extensions"] = extensions;
+  }
+
+  if (!this->annotations.isEmpty()) {
+    annotation = this->annotations.last().toObject();
+
+    if (annotation["core:label"].toString() == "gap"
+        && annotation["core:sample_start"].toVariant().toULongLong()
+          == sample) {
+      count += annotation["sigdigger:dropped_samples"]
+          .toVariant().toULongLong();
+      this->annotations.removeLast();
+    } else {
+      annotation = QJsonObject();
+    }
+  }
+
+  annotation["core:sample_start"] = static_cast<qint64>(sample);
+  annotation["core:label"] = "gap";
+  annotation["core:comment"] = QString::number(count) + " samples dropped";
+  annotation["sigdigger:dropped_samples"] = static_cast<qint64>(count);
+
+  this->annotations.append(annotation);
+
+  this->update();
+}
+
+////////////////////////////////// Slots //////////////////////////////////////
+void
+SigMFMetadataWriter::onUpdateTimeout(void)
+{
+  if (this->dirty) {
+    this->dirty = false;
+    emit store(this->document());
+    this->updateTimer.start();
+  }
+}
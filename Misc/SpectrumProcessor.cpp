@@ -0,0 +1,260 @@
+//
+//    SpectrumProcessor.cpp: Averages and reduces PSD frames in its own thread
+//    Copyright (C) 2020 Gonzalo José Carracedo Carballal
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as
+//    published by the Free Software Foundation, either version 3 of the
+//    License, or (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful, but
+//    WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public
+//    License along with this program.  If not, see
+//    <http://www.gnu.org/licenses/>
+//
+#include "SpectrumProcessor.h"
+#include <algorithm>
+
+using namespace SigDigger;
+
+//////////////////////////// SpectrumProcessorWorker //////////////////////////
+SpectrumProcessorWorker::SpectrumProcessorWorker(SpectrumProcessor *owner)
+{
+  this->owner = owner;
+}
+
+void
+SpectrumProcessorWorker::applyParams(SpectrumParams const &params)
+{
+  unsigned int i;
+
+  this->averager.setAlpha(params.alpha);
+  this->averager.setWindowLength(params.windowLength);
+  this->averager.setPercentile(params.percentile);
+
+  for (i = 0; i < AVERAGER_TRACE_COUNT; ++i)
+    this->averager.setTraceEnabled(
+          static_cast<AveragerTrace>(i),
+          params.traces[i]);
+
+  this->detector = params.detector;
+}
+
+// Returns the size of out
+size_t
+SpectrumProcessorWorker::reduce(
+    const float *data,
+    size_t bins,
+    PSDDetector detector,
+    std::vector<float> &out)
+{
+  size_t size = this->averager.size();
+  const float *reduced = this->pyramid.reduce(data, size, bins, detector);
+
+  // Frames go round between us and the GUI thread. Once they have all
+  // grown to the frame size, this does not allocate.
+  out.resize(size);
+  std::copy(reduced, reduced + size, out.begin());
+
+  return size;
+}
+
+// Goes on until there are no frames left, so that frameReady is posted
+// once per burst of frames.
+void
+SpectrumProcessorWorker::process(void)
+{
+  SpectrumProcessor *owner = this->owner;
+  Suscan::PSDMessage msg;
+  PSDDetector detector;
+  const float *data;
+  size_t bins;
+  unsigned int i;
+  bool notify;
+
+  for (;;) {
+    {
+      std::lock_guard<std::mutex> guard(owner->mutex);
+
+      if (owner->paramsChanged) {
+        this->applyParams(owner->params);
+        owner->paramsChanged = false;
+      }
+
+      if (owner->resetRequested) {
+        this->averager.resetTraces();
+        owner->resetRequested = false;
+      }
+
+      if (owner->pending.empty()) {
+        owner->framePosted = false;
+        return;
+      }
+
+      msg  = owner->pending.front().message;
+      bins = owner->pending.front().bins;
+      owner->pending.pop_front();
+    }
+
+    try {
+      this->averager.feed(msg);
+    } catch (Suscan::Exception &) {
+      // Start over with the next one
+      this->averager.reset();
+    }
+
+    if (bins == 0)
+      continue;
+
+    this->frame.size = 0;
+    if (this->averager.size() > 0) {
+      this->frame.size = this->reduce(
+            this->averager.get(),
+            bins,
+            this->detector,
+            this->frame.average);
+
+      // Holds keep the extreme they follow. The rest, whatever the
+      // average uses.
+      for (i = 0; i < AVERAGER_TRACE_COUNT; ++i) {
+        data = this->averager.get(static_cast<AveragerTrace>(i));
+        this->frame.valid[i] = data != nullptr;
+
+        if (data == nullptr)
+          continue;
+
+        switch (i) {
+          case AVERAGER_TRACE_MAX_HOLD:
+            detector = PSD_DETECTOR_PEAK;
+            break;
+
+          case AVERAGER_TRACE_MIN_HOLD:
+          case AVERAGER_TRACE_PERCENTILE:
+            detector = PSD_DETECTOR_MIN;
+            break;
+
+          default:
+            detector = this->detector;
+        }
+
+        (void) this->reduce(data, bins, detector, this->frame.traces[i]);
+      }
+    }
+
+    this->frame.readTime = msg.getReadTime();
+    this->frame.dispatchTime = msg.getDispatchTime();
+
+    // Let go of the buffer before waiting for the next one
+    msg = Suscan::PSDMessage();
+
+    {
+      std::lock_guard<std::mutex> guard(owner->mutex);
+
+      std::swap(owner->result, this->frame);
+      notify = !owner->resultPosted;
+      owner->resultPosted = true;
+    }
+
+    if (notify)
+      emit resultReady();
+  }
+}
+
+/////////////////////////////// SpectrumProcessor /////////////////////////////
+SpectrumProcessor::SpectrumProcessor(QObject *parent) : QObject(parent)
+{
+  this->worker = new SpectrumProcessorWorker(this);
+  this->workerThread = new QThread();
+
+  this->worker->moveToThread(this->workerThread);
+
+  connect(
+        this,
+        SIGNAL(frameReady(void)),
+        this->worker,
+        SLOT(process(void)));
+
+  connect(
+        this->worker,
+        SIGNAL(resultReady(void)),
+        this,
+        SLOT(onResultReady(void)));
+
+  this->workerThread->start();
+}
+
+SpectrumProcessor::~SpectrumProcessor()
+{
+  this->workerThread->quit();
+  this->workerThread->wait();
+
+  delete this->workerThread;
+  delete this->worker;
+}
+
+void
+SpectrumProcessor::setParams(SpectrumParams const &params)
+{
+  std::lock_guard<std::mutex> guard(this->mutex);
+
+  this->params = params;
+  this->paramsChanged = true;
+}
+
+void
+SpectrumProcessor::resetTraces(void)
+{
+  std::lock_guard<std::mutex> guard(this->mutex);
+
+  this->resetRequested = true;
+}
+
+void
+SpectrumProcessor::feed(Suscan::PSDMessage const &msg, size_t bins)
+{
+  bool post;
+
+  {
+    std::lock_guard<std::mutex> guard(this->mutex);
+
+    // The newest frame inherits the draw request of the one skipped
+    if (this->pending.size() >= SIGDIGGER_SPECTRUM_PROCESSOR_BACKLOG) {
+      bins = std::max(bins, this->pending.front().bins);
+      this->pending.pop_front();
+      ++this->dropped;
+    }
+
+    this->pending.push_back({msg, bins});
+
+    post = !this->framePosted;
+    this->framePosted = true;
+  }
+
+  if (post)
+    emit frameReady();
+}
+
+quint64
+SpectrumProcessor::getDroppedCount(void)
+{
+  std::lock_guard<std::mutex> guard(this->mutex);
+
+  return this->dropped;
+}
+
+void
+SpectrumProcessor::onResultReady(void)
+{
+  {
+    std::lock_guard<std::mutex> guard(this->mutex);
+
+    std::swap(this->frame, this->result);
+    this->resultPosted = false;
+  }
+
+  emit spectrumChanged();
+}
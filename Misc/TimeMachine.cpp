@@ -0,0 +1,155 @@
+//
+//    TimeMachine.cpp: Keep the last seconds of baseband in memory
+//    Copyright (C) 2020 Gonzalo José Carracedo Carballal
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as
+//    published by the Free Software Foundation, either version 3 of the
+//    License, or (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful, but
+//    WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public
+//    License along with this program.  If not, see
+//    <http://www.gnu.org/licenses/>
+//
+
+#include "TimeMachine.h"
+#include <unistd.h>
+#include <cstdlib>
+#include <cstdio>
+#include <cstdint>
+
+using namespace SigDigger;
+
+static uint64_t
+availableMemory(void)
+{
+  FILE *fp;
+  char line[128];
+  unsigned long long kib;
+  uint64_t mem = 0;
+
+  // MemAvailable accounts for reclaimable cache, which is what we want
+  if ((fp = fopen("/proc/meminfo", "r")) != nullptr) {
+    while (fgets(line, sizeof(line), fp) != nullptr)
+      if (sscanf(line, "MemAvailable: %llu kB", &kib) == 1) {
+        mem = static_cast<uint64_t>(kib) << 10;
+        break;
+      }
+
+    fclose(fp);
+  }
+
+#ifdef _SC_AVPHYS_PAGES
+  if (mem == 0) {
+    long pages = sysconf(_SC_AVPHYS_PAGES);
+    long size  = sysconf(_SC_PAGESIZE);
+
+    if (pages > 0 && size > 0)
+      mem = static_cast<uint64_t>(pages) * static_cast<uint64_t>(size);
+  }
+#endif // _SC_AVPHYS_PAGES
+
+  // No way to know. Assume something modest.
+  if (mem == 0)
+    mem = 1ull << 30;
+
+  return mem;
+}
+
+size_t
+TimeMachine::maxSamples(void)
+{
+  return static_cast<size_t>(
+        SIGDIGGER_TIME_MACHINE_MEMORY_FRACTION
+        * static_cast<double>(availableMemory())
+        / sizeof(SUCOMPLEX));
+}
+
+TimeMachine::TimeMachine(size_t samples, size_t blockLen) :
+  SampleFanoutSink(
+    static_cast<unsigned int>((samples + blockLen - 1) / blockLen),
+    OVERFLOW_DROP_OLDEST)
+{
+}
+
+TimeMachine::~TimeMachine()
+{
+  this->detach();
+}
+
+// In samples, once it is full
+size_t
+TimeMachine::getCapacity(void) const
+{
+  SampleFanout *fanout = this->getFanout();
+
+  if (fanout == nullptr)
+    return 0;
+
+  return this->getDepth() * fanout->getBlockLen();
+}
+
+bool
+TimeMachine::wants(const SampleBlock *)
+{
+  return !this->frozen.load();
+}
+
+void
+TimeMachine::freeze(void)
+{
+  this->frozen = true;
+}
+
+size_t
+TimeMachine::available(quint64 before) const
+{
+  unsigned int i, count = this->queued();
+  const SampleBlock *block;
+  size_t total = 0;
+
+  for (i = 0; i < count; ++i) {
+    block = this->at(i);
+    if (block->position >= before)
+      break;
+    total += block->len;
+  }
+
+  return total;
+}
+
+// Returns the number of contiguous samples from offset and points data to
+// the first of them. If offset is the start of a block, time is the wall
+// clock of that sample.
+size_t
+TimeMachine::peek(size_t offset, const SUCOMPLEX **data, qint64 *time) const
+{
+  unsigned int i, count = this->queued();
+  const SampleBlock *block;
+
+  for (i = 0; i < count; ++i) {
+    block = this->at(i);
+    if (offset < block->len) {
+      *data = block->data.data() + offset;
+      if (time != nullptr)
+        *time = block->time;
+      return block->len - offset;
+    }
+
+    offset -= block->len;
+  }
+
+  return 0;
+}
+
+void
+TimeMachine::thaw(void)
+{
+  this->clear();
+  this->frozen = false;
+}
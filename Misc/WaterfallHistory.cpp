@@ -0,0 +1,531 @@
+//
+//    WaterfallHistory.cpp: On-disk scrollback of the main waterfall
+//    Copyright (C) 2020 Gonzalo José Carracedo Carballal
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as
+//    published by the Free Software Foundation, either version 3 of the
+//    License, or (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful, but
+//    WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public
+//    License along with this program.  If not, see
+//    <http://www.gnu.org/licenses/>
+//
+
+#include "WaterfallHistory.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace SigDigger;
+
+static inline quint64
+blockSize(quint64 payload)
+{
+  return (sizeof(WaterfallHistoryBlock) + payload + 7) & ~7ull;
+}
+
+static inline size_t
+payloadSize(unsigned int rows, unsigned int bins)
+{
+  return rows * (sizeof(qint64) + sizeof(float) + bins);
+}
+
+WaterfallHistory::WaterfallHistory()
+{
+  memset(&this->pending, 0, sizeof(WaterfallHistoryBlock));
+  memset(&this->cachedBlock, 0, sizeof(WaterfallHistoryBlock));
+}
+
+WaterfallHistory::~WaterfallHistory()
+{
+  this->close();
+}
+
+WaterfallHistoryHeader *
+WaterfallHistory::header(void) const
+{
+  return reinterpret_cast<WaterfallHistoryHeader *>(this->map);
+}
+
+void
+WaterfallHistory::reset(void)
+{
+  this->index.clear();
+  this->head = SIGDIGGER_WF_HISTORY_HEADER_SIZE;
+  this->sequence = 0;
+  this->used = 0;
+  this->nextRow = 0;
+  this->cacheValid = false;
+
+  this->pending.rows = 0;
+  this->pendingTimes.clear();
+  this->pendingPeaks.clear();
+  this->pendingCodes.clear();
+}
+
+// Walks the blocks from the tail as long as the sequence numbers follow.
+// Whatever comes after a broken block is given up and overwritten.
+void
+WaterfallHistory::recover(void)
+{
+  WaterfallHistoryHeader *hdr = this->header();
+  const WaterfallHistoryBlock *block;
+  quint64 offset = hdr->tail;
+  quint64 seq = hdr->tailSequence;
+  quint64 maxBlocks = this->capacity / sizeof(WaterfallHistoryBlock);
+  quint64 size, n;
+  Entry entry;
+
+  for (n = 0; seq != hdr->sequence && n < maxBlocks; ++n) {
+    if (offset < SIGDIGGER_WF_HISTORY_HEADER_SIZE)
+      break;
+
+    if (offset + sizeof(WaterfallHistoryBlock) > this->capacity) {
+      offset = SIGDIGGER_WF_HISTORY_HEADER_SIZE;
+      continue;
+    }
+
+    block = reinterpret_cast<const WaterfallHistoryBlock *>(this->map + offset);
+    if (block->magic != SIGDIGGER_WF_HISTORY_BLOCK_MAGIC
+        || block->sequence != seq)
+      break;
+
+    if (block->rows == 0) {
+      offset = SIGDIGGER_WF_HISTORY_HEADER_SIZE;
+      continue;
+    }
+
+    size = blockSize(block->size);
+    if (block->rows > SIGDIGGER_WF_HISTORY_BLOCK_ROWS
+        || block->bins > SIGDIGGER_WF_HISTORY_MAX_BINS
+        || offset + size > this->capacity)
+      break;
+
+    entry.offset    = offset;
+    entry.size      = size;
+    entry.sequence  = seq;
+    entry.firstRow  = this->nextRow;
+    entry.rows      = block->rows;
+    entry.firstTime = block->firstTime;
+    entry.lastTime  = block->lastTime;
+
+    this->index.push_back(entry);
+    this->nextRow += block->rows;
+    this->used += size;
+
+    offset += size;
+    ++seq;
+  }
+
+  this->head = offset;
+  this->sequence = seq;
+}
+
+bool
+WaterfallHistory::open(std::string const &path, quint64 capacity)
+{
+  WaterfallHistoryHeader *hdr;
+  struct stat sbuf;
+  bool fresh;
+  void *map;
+  int error;
+
+  this->close();
+
+  if (capacity < 2 * SIGDIGGER_WF_HISTORY_HEADER_SIZE)
+    return false;
+
+  if ((this->fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0600)) == -1)
+    return false;
+
+  if (fstat(this->fd, &sbuf) == -1)
+    goto fail;
+
+  fresh = static_cast<quint64>(sbuf.st_size) != capacity;
+  if (fresh && ftruncate(this->fd, static_cast<off_t>(capacity)) == -1)
+    goto fail;
+
+  // Every block must exist before we write through the mapping: a full
+  // disk would otherwise show up as SIGBUS in the middle of a push.
+  error = posix_fallocate(this->fd, 0, static_cast<off_t>(capacity));
+  if (error != 0) {
+    if (fresh)
+      (void) ftruncate(this->fd, 0);
+    errno = error;
+    goto fail;
+  }
+
+  map = mmap(
+        nullptr,
+        capacity,
+        PROT_READ | PROT_WRITE,
+        MAP_SHARED,
+        this->fd,
+        0);
+  if (map == MAP_FAILED)
+    goto fail;
+
+  this->map = static_cast<uint8_t *>(map);
+  this->capacity = capacity;
+  this->reset();
+
+  hdr = this->header();
+
+  if (!fresh)
+    fresh = memcmp(hdr->magic, SIGDIGGER_WF_HISTORY_MAGIC, 8) != 0
+        || hdr->version != SIGDIGGER_WF_HISTORY_VERSION
+        || hdr->capacity != capacity;
+
+  if (fresh) {
+    memset(hdr, 0, sizeof(WaterfallHistoryHeader));
+    memcpy(hdr->magic, SIGDIGGER_WF_HISTORY_MAGIC, 8);
+    hdr->version  = SIGDIGGER_WF_HISTORY_VERSION;
+    hdr->capacity = capacity;
+    hdr->head     = SIGDIGGER_WF_HISTORY_HEADER_SIZE;
+    hdr->tail     = SIGDIGGER_WF_HISTORY_HEADER_SIZE;
+  } else {
+    this->recover();
+  }
+
+  return true;
+
+fail:
+  error = errno;
+  ::close(this->fd);
+  this->fd = -1;
+  errno = error;
+  return false;
+}
+
+void
+WaterfallHistory::close(void)
+{
+  if (this->map != nullptr) {
+    this->flush();
+    msync(this->map, this->capacity, MS_SYNC);
+    munmap(this->map, this->capacity);
+    this->map = nullptr;
+    this->capacity = 0;
+  }
+
+  if (this->fd != -1) {
+    ::close(this->fd);
+    this->fd = -1;
+  }
+
+  this->reset();
+}
+
+// Drops the oldest blocks for as long as they overlap [start, end)
+void
+WaterfallHistory::evict(quint64 start, quint64 end)
+{
+  while (!this->index.empty()) {
+    Entry const &e = this->index.front();
+
+    if (e.offset >= end || e.offset + e.size <= start)
+      break;
+
+    this->used -= e.size;
+    this->index.pop_front();
+  }
+}
+
+void
+WaterfallHistory::push(
+    const float *data,
+    unsigned int bins,
+    qint64 time,
+    qreal frequency,
+    qreal sampleRate)
+{
+  unsigned int factor, i, j;
+  const float *row = data;
+  float peak, value, code;
+  uint8_t *codes;
+
+  if (this->map == nullptr || bins == 0)
+    return;
+
+  // Wider rows keep the strongest of every few bins
+  factor = (bins + SIGDIGGER_WF_HISTORY_MAX_BINS - 1)
+      / SIGDIGGER_WF_HISTORY_MAX_BINS;
+
+  if (factor > 1) {
+    bins /= factor;
+    this->scratch.resize(bins);
+
+    for (i = 0; i < bins; ++i) {
+      value = data[i * factor];
+      for (j = 1; j < factor; ++j)
+        value = std::max(value, data[i * factor + j]);
+      this->scratch[i] = value;
+    }
+
+    row = this->scratch.data();
+  }
+
+  if (this->pending.rows > 0
+      && (this->pending.bins != bins
+          || this->pending.frequency != frequency
+          || this->pending.sampleRate != sampleRate))
+    this->flush();
+
+  if (this->pending.rows == 0) {
+    this->pending.bins       = bins;
+    this->pending.frequency  = frequency;
+    this->pending.sampleRate = sampleRate;
+    this->pending.firstTime  = time;
+  }
+
+  peak = row[0];
+  for (i = 1; i < bins; ++i)
+    peak = std::max(peak, row[i]);
+
+  this->pendingCodes.resize((this->pending.rows + 1) * bins);
+  codes = this->pendingCodes.data() + this->pending.rows * bins;
+
+  // NaNs end up as 255, the weakest code
+  for (i = 0; i < bins; ++i) {
+    code = (peak - row[i]) * (1.f / SIGDIGGER_WF_HISTORY_DB_STEP) + .5f;
+    codes[i] = code < 255.f ? static_cast<uint8_t>(code) : 255;
+  }
+
+  this->pendingTimes.push_back(time);
+  this->pendingPeaks.push_back(peak);
+  this->pending.lastTime = time;
+
+  if (++this->pending.rows == SIGDIGGER_WF_HISTORY_BLOCK_ROWS)
+    this->flush();
+}
+
+void
+WaterfallHistory::flush(void)
+{
+  WaterfallHistoryHeader *hdr;
+  WaterfallHistoryBlock *wrap;
+  unsigned int rows = this->pending.rows;
+  QByteArray raw, compressed;
+  quint64 size;
+  Entry entry;
+  char *p;
+
+  if (this->map == nullptr || rows == 0)
+    return;
+
+  raw.resize(static_cast<int>(payloadSize(rows, this->pending.bins)));
+  p = raw.data();
+  memcpy(p, this->pendingTimes.data(), rows * sizeof(qint64));
+  p += rows * sizeof(qint64);
+  memcpy(p, this->pendingPeaks.data(), rows * sizeof(float));
+  p += rows * sizeof(float);
+  memcpy(p, this->pendingCodes.data(), rows * this->pending.bins);
+
+  // Fastest level: this is the GUI thread
+  compressed = qCompress(raw, 1);
+  size = blockSize(static_cast<quint64>(compressed.size()));
+
+  this->pending.rows = 0;
+  this->pendingTimes.clear();
+  this->pendingPeaks.clear();
+  this->pendingCodes.clear();
+
+  if (size > this->capacity - SIGDIGGER_WF_HISTORY_HEADER_SIZE)
+    return;
+
+  // Does not fit before the end. Mark the wrap and start over.
+  if (this->head + size > this->capacity) {
+    if (this->head + sizeof(WaterfallHistoryBlock) <= this->capacity) {
+      wrap = reinterpret_cast<WaterfallHistoryBlock *>(this->map + this->head);
+      memset(wrap, 0, sizeof(WaterfallHistoryBlock));
+      wrap->magic    = SIGDIGGER_WF_HISTORY_BLOCK_MAGIC;
+      wrap->sequence = this->sequence;
+    }
+
+    this->evict(this->head, this->capacity);
+    this->head = SIGDIGGER_WF_HISTORY_HEADER_SIZE;
+  }
+
+  this->evict(this->head, this->head + size);
+
+  this->pending.magic    = SIGDIGGER_WF_HISTORY_BLOCK_MAGIC;
+  this->pending.rows     = rows;
+  this->pending.size     = static_cast<uint32_t>(compressed.size());
+  this->pending.sequence = this->sequence;
+
+  memcpy(
+        this->map + this->head,
+        &this->pending,
+        sizeof(WaterfallHistoryBlock));
+  memcpy(
+        this->map + this->head + sizeof(WaterfallHistoryBlock),
+        compressed.constData(),
+        static_cast<size_t>(compressed.size()));
+
+  entry.offset    = this->head;
+  entry.size      = size;
+  entry.sequence  = this->sequence;
+  entry.firstRow  = this->nextRow;
+  entry.rows      = rows;
+  entry.firstTime = this->pending.firstTime;
+  entry.lastTime  = this->pending.lastTime;
+
+  this->index.push_back(entry);
+  this->used += size;
+  this->nextRow += rows;
+  this->head += size;
+  ++this->sequence;
+  this->pending.rows = 0;
+
+  hdr = this->header();
+  hdr->head         = this->head;
+  hdr->tail         = this->index.front().offset;
+  hdr->tailSequence = this->index.front().sequence;
+  hdr->sequence     = this->sequence;
+}
+
+quint64
+WaterfallHistory::getFirstRow(void) const
+{
+  return this->index.empty() ? this->nextRow : this->index.front().firstRow;
+}
+
+quint64
+WaterfallHistory::getEndRow(void) const
+{
+  return this->nextRow + this->pending.rows;
+}
+
+qint64
+WaterfallHistory::getFirstTime(void) const
+{
+  if (!this->index.empty())
+    return this->index.front().firstTime;
+
+  return this->pending.rows > 0 ? this->pending.firstTime : 0;
+}
+
+quint64
+WaterfallHistory::getDiskUsage(void) const
+{
+  return this->used;
+}
+
+bool
+WaterfallHistory::loadBlock(Entry const &e)
+{
+  const WaterfallHistoryBlock *block;
+
+  if (this->cacheValid && this->cachedBlock.sequence == e.sequence)
+    return true;
+
+  this->cacheValid = false;
+
+  block = reinterpret_cast<const WaterfallHistoryBlock *>(this->map + e.offset);
+  if (block->magic != SIGDIGGER_WF_HISTORY_BLOCK_MAGIC
+      || block->sequence != e.sequence)
+    return false;
+
+  this->cache = qUncompress(
+        reinterpret_cast<const uchar *>(block + 1),
+        static_cast<int>(block->size));
+
+  if (static_cast<size_t>(this->cache.size())
+      != payloadSize(block->rows, block->bins))
+    return false;
+
+  this->cachedBlock = *block;
+  this->cacheValid = true;
+
+  return true;
+}
+
+quint64
+WaterfallHistory::findRow(qint64 time)
+{
+  std::deque<Entry>::const_iterator it;
+  WaterfallHistoryRow row;
+  quint64 i, end;
+
+  it = std::lower_bound(
+        this->index.cbegin(),
+        this->index.cend(),
+        time,
+        [] (Entry const &e, qint64 t) { return e.lastTime < t; });
+
+  if (it == this->index.cend()) {
+    i = this->nextRow;
+    end = this->getEndRow();
+  } else {
+    i = it->firstRow;
+    end = it->firstRow + it->rows;
+  }
+
+  for (; i < end; ++i)
+    if (this->getRow(i, row) && row.time >= time)
+      return i;
+
+  return this->getEndRow();
+}
+
+bool
+WaterfallHistory::getRow(quint64 row, WaterfallHistoryRow &out)
+{
+  std::deque<Entry>::const_iterator it;
+  const WaterfallHistoryBlock *block;
+  const char *payload;
+  unsigned int n;
+
+  if (row >= this->nextRow) {
+    if (row >= this->getEndRow())
+      return false;
+
+    n = static_cast<unsigned int>(row - this->nextRow);
+    out.time       = this->pendingTimes[n];
+    out.frequency  = this->pending.frequency;
+    out.sampleRate = this->pending.sampleRate;
+    out.bins       = this->pending.bins;
+    out.peak       = this->pendingPeaks[n];
+    out.codes      = this->pendingCodes.data() + n * this->pending.bins;
+
+    return true;
+  }
+
+  if (this->index.empty() || row < this->index.front().firstRow)
+    return false;
+
+  it = std::upper_bound(
+        this->index.cbegin(),
+        this->index.cend(),
+        row,
+        [] (quint64 r, Entry const &e) { return r < e.firstRow; });
+
+  if (!this->loadBlock(*--it))
+    return false;
+
+  block = &this->cachedBlock;
+  payload = this->cache.constData();
+  n = static_cast<unsigned int>(row - it->firstRow);
+
+  memcpy(&out.time, payload + n * sizeof(qint64), sizeof(qint64));
+  payload += block->rows * sizeof(qint64);
+  memcpy(&out.peak, payload + n * sizeof(float), sizeof(float));
+  payload += block->rows * sizeof(float);
+
+  out.frequency  = block->frequency;
+  out.sampleRate = block->sampleRate;
+  out.bins       = block->bins;
+  out.codes      = reinterpret_cast<const uint8_t *>(payload) + n * block->bins;
+
+  return true;
+}
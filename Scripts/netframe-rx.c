@@ -0,0 +1,501 @@
+/*
+  netframe-rx.c: Reference receiver for framed network forwarder streams
+
+  Copyright (C) 2020 Gonzalo José Carracedo Carballal
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this program.  If not, see
+  <http://www.gnu.org/licenses/>
+
+*/
+
+/*
+ * Receives what the network forwarder of an inspector sends with "Frame
+ * headers" enabled, checks every frame and prints link statistics:
+ *
+ *   lost      frames missing from the sequence
+ *   late      frames arriving after a later one (reordering)
+ *   gaps      samples the sender itself skipped (position jumps)
+ *   bad       frames that cannot be parsed
+ *   jitter    RFC 3550 interarrival jitter, from the frame timestamps
+ *   latency   arrival time minus frame timestamp. Only meaningful when
+ *             both ends share a clock (same host, or NTP/PTP synced).
+ *
+ * Build with:
+ *
+ *   cc -O2 -Iinclude -o netframe-rx Scripts/netframe-rx.c
+ *
+ * and run it before starting the forwarder. TCP mode accepts one
+ * connection at a time. Optionally, the samples of every frame are
+ * appended to a file for further checks.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+
+#include "NetFrame.h"
+
+#define NETFRAME_RX_MAX_FRAME 65536
+#define NETFRAME_RX_DEFAULT_RCVBUF (4 << 20)
+#define NETFRAME_RX_JITTER_GAIN (1. / 16)
+
+struct netframe_stats {
+  uint64_t frames;
+  uint64_t samples;
+  uint64_t bytes;
+  uint64_t lost;
+  uint64_t late;
+  uint64_t gaps;
+  uint64_t bad;
+
+  int      primed;
+  uint32_t next_seq;
+  uint64_t next_pos;
+
+  double   jitter;
+  double   last_transit;
+  double   latency_sum;
+  double   latency_min;
+  double   latency_max;
+  uint64_t latency_count;
+
+  double   rate;
+  double   frequency;
+  uint8_t  format;
+};
+
+static volatile sig_atomic_t g_stop = 0;
+
+static void
+on_signal(int sig)
+{
+  (void) sig;
+  g_stop = 1;
+}
+
+static int64_t
+now_usec(void)
+{
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+
+  return (int64_t) tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static void
+stats_reset_interval(struct netframe_stats *stats)
+{
+  stats->latency_sum   = 0;
+  stats->latency_count = 0;
+  stats->latency_min   = 0;
+  stats->latency_max   = 0;
+}
+
+static const char *
+format_name(uint8_t format)
+{
+  switch (format) {
+    case SIGDIGGER_NETFRAME_FORMAT_CF32:
+      return "cf32";
+
+    case SIGDIGGER_NETFRAME_FORMAT_CI16:
+      return "ci16";
+
+    case SIGDIGGER_NETFRAME_FORMAT_CI8:
+      return "ci8";
+  }
+
+  return "?";
+}
+
+static void
+stats_print(
+    const struct netframe_stats *stats,
+    const struct netframe_stats *prev,
+    double elapsed)
+{
+  double sps = elapsed > 0 ? (stats->samples - prev->samples) / elapsed : 0;
+  double mbps = elapsed > 0
+      ? 8e-6 * (stats->bytes - prev->bytes) / elapsed
+      : 0;
+
+  printf(
+      "%10llu frames  %8.0f sps (%.0f declared, %s)  %7.2f Mbps  "
+      "lost %llu  late %llu  gaps %llu  bad %llu  jitter %.1f us",
+      (unsigned long long) stats->frames,
+      sps,
+      stats->rate,
+      format_name(stats->format),
+      mbps,
+      (unsigned long long) stats->lost,
+      (unsigned long long) stats->late,
+      (unsigned long long) stats->gaps,
+      (unsigned long long) stats->bad,
+      stats->jitter);
+
+  if (stats->latency_count > 0)
+    printf(
+        "  latency %.1f/%.1f/%.1f us",
+        stats->latency_min,
+        stats->latency_sum / stats->latency_count,
+        stats->latency_max);
+
+  putchar('\n');
+  fflush(stdout);
+}
+
+/* Returns the payload size, or -1 if the frame is malformed */
+static ssize_t
+frame_check(
+    const struct NetFrameHeader *header,
+    size_t available)
+{
+  unsigned int sample_size;
+
+  if (available < sizeof(struct NetFrameHeader))
+    return -1;
+
+  if (memcmp(header->magic, SIGDIGGER_NETFRAME_MAGIC, 4) != 0)
+    return -1;
+
+  if (header->version != SIGDIGGER_NETFRAME_VERSION)
+    return -1;
+
+  if (header->headerSize < sizeof(struct NetFrameHeader))
+    return -1;
+
+  if ((sample_size = netframe_sample_size(header->format)) == 0)
+    return -1;
+
+  return (ssize_t) header->samples * sample_size;
+}
+
+static void
+frame_account(
+    struct netframe_stats *stats,
+    const struct NetFrameHeader *header,
+    int64_t arrival)
+{
+  int32_t delta;
+  double transit, d;
+
+  stats->rate      = header->sampleRate;
+  stats->frequency = header->frequency;
+  stats->format    = header->format;
+
+  if (!stats->primed) {
+    stats->primed       = 1;
+    stats->last_transit = (double) (arrival - header->time);
+  } else {
+    delta = (int32_t) (header->sequence - stats->next_seq);
+
+    if (delta < 0) {
+      /* Late: already counted as lost, take it back */
+      ++stats->late;
+      if (stats->lost > 0)
+        --stats->lost;
+      return;
+    }
+
+    stats->lost += (uint64_t) delta;
+
+    if (delta == 0 && header->position != stats->next_pos)
+      stats->gaps += header->position - stats->next_pos;
+  }
+
+  stats->next_seq = header->sequence + 1;
+  stats->next_pos = header->position + header->samples;
+
+  transit = (double) (arrival - header->time);
+  d = transit - stats->last_transit;
+  if (d < 0)
+    d = -d;
+  stats->jitter += NETFRAME_RX_JITTER_GAIN * (d - stats->jitter);
+  stats->last_transit = transit;
+
+  if (stats->latency_count == 0 || transit < stats->latency_min)
+    stats->latency_min = transit;
+  if (stats->latency_count == 0 || transit > stats->latency_max)
+    stats->latency_max = transit;
+  stats->latency_sum += transit;
+  ++stats->latency_count;
+}
+
+static int
+read_full(int fd, void *buf, size_t size)
+{
+  uint8_t *bytes = (uint8_t *) buf;
+  ssize_t got;
+
+  while (size > 0) {
+    got = recv(fd, bytes, size, 0);
+
+    if (got == -1 && errno == EINTR) {
+      if (g_stop)
+        return 0;
+      continue;
+    }
+
+    if (got < 1)
+      return 0;
+
+    bytes += got;
+    size  -= (size_t) got;
+  }
+
+  return 1;
+}
+
+/*
+ * Frames over TCP come back to back. After a malformed header there is
+ * no way to find the next one reliably, so the connection is dropped.
+ */
+static int
+receive_stream(
+    int fd,
+    uint8_t *buffer,
+    struct netframe_stats *stats,
+    FILE *dump,
+    int64_t *last_print,
+    struct netframe_stats *prev,
+    double interval)
+{
+  struct NetFrameHeader *header = (struct NetFrameHeader *) buffer;
+  ssize_t payload;
+  size_t extra;
+  int64_t now;
+
+  while (!g_stop) {
+    if (!read_full(fd, buffer, sizeof(struct NetFrameHeader)))
+      return 0;
+
+    if ((payload = frame_check(header, sizeof(struct NetFrameHeader))) < 0
+        || header->headerSize + payload > NETFRAME_RX_MAX_FRAME) {
+      ++stats->bad;
+      fprintf(stderr, "netframe-rx: lost sync, dropping connection\n");
+      return 0;
+    }
+
+    extra = header->headerSize - sizeof(struct NetFrameHeader);
+    if (!read_full(
+          fd,
+          buffer + sizeof(struct NetFrameHeader),
+          extra + (size_t) payload))
+      return 0;
+
+    now = now_usec();
+    frame_account(stats, header, now);
+
+    ++stats->frames;
+    stats->samples += header->samples;
+    stats->bytes   += header->headerSize + (size_t) payload;
+
+    if (dump != NULL)
+      fwrite(buffer + header->headerSize, (size_t) payload, 1, dump);
+
+    if (now - *last_print >= interval * 1e6) {
+      stats_print(stats, prev, (now - *last_print) * 1e-6);
+      stats_reset_interval(stats);
+      *prev = *stats;
+      *last_print = now;
+    }
+  }
+
+  return 1;
+}
+
+static void
+usage(const char *argv0)
+{
+  fprintf(stderr, "Usage:\n");
+  fprintf(
+      stderr,
+      "  %s [-t] [-p port] [-i seconds] [-b bytes] [-o file]\n\n",
+      argv0);
+  fprintf(stderr, "  -t          Listen for TCP connections instead of UDP\n");
+  fprintf(stderr, "  -p port     Port to listen on (default: 40404)\n");
+  fprintf(stderr, "  -i seconds  Statistics interval (default: 1)\n");
+  fprintf(stderr, "  -b bytes    Socket receive buffer (default: 4 MiB)\n");
+  fprintf(stderr, "  -o file     Append the received samples to file\n");
+}
+
+int
+main(int argc, char **argv)
+{
+  struct netframe_stats stats, prev;
+  struct sockaddr_in addr;
+  struct NetFrameHeader *header;
+  struct sigaction sa;
+  uint8_t *buffer = NULL;
+  uint16_t port = 40404;
+  double interval = 1;
+  int tcp = 0;
+  int sfd = -1, cfd;
+  int opt, one = 1;
+  int rcvbuf = NETFRAME_RX_DEFAULT_RCVBUF;
+  FILE *dump = NULL;
+  ssize_t got, payload;
+  int64_t now, last_print;
+
+  while ((opt = getopt(argc, argv, "tp:i:o:b:h")) != -1) {
+    switch (opt) {
+      case 't':
+        tcp = 1;
+        break;
+
+      case 'p':
+        port = (uint16_t) atoi(optarg);
+        break;
+
+      case 'i':
+        interval = atof(optarg);
+        break;
+
+      case 'b':
+        rcvbuf = atoi(optarg);
+        break;
+
+      case 'o':
+        if ((dump = fopen(optarg, "ab")) == NULL) {
+          fprintf(stderr, "%s: %s: %s\n", argv[0], optarg, strerror(errno));
+          exit(EXIT_FAILURE);
+        }
+        break;
+
+      default:
+        usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+  }
+
+  memset(&sa, 0, sizeof(struct sigaction));
+  sa.sa_handler = on_signal;
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+
+  if ((buffer = malloc(NETFRAME_RX_MAX_FRAME)) == NULL) {
+    fprintf(stderr, "%s: out of memory\n", argv[0]);
+    exit(EXIT_FAILURE);
+  }
+
+  header = (struct NetFrameHeader *) buffer;
+
+  if ((sfd = socket(AF_INET, tcp ? SOCK_STREAM : SOCK_DGRAM, 0)) == -1) {
+    fprintf(stderr, "%s: socket: %s\n", argv[0], strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+
+  setsockopt(sfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(int));
+
+  /* Small buffers show up as loss at high rates. The kernel may cap it. */
+  setsockopt(sfd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(int));
+
+  memset(&addr, 0, sizeof(struct sockaddr_in));
+  addr.sin_family      = AF_INET;
+  addr.sin_port        = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+
+  if (bind(sfd, (struct sockaddr *) &addr, sizeof(struct sockaddr_in)) == -1) {
+    fprintf(stderr, "%s: bind: %s\n", argv[0], strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+
+  if (tcp && listen(sfd, 1) == -1) {
+    fprintf(stderr, "%s: listen: %s\n", argv[0], strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+
+  fprintf(
+      stderr,
+      "netframe-rx: waiting for %s frames on port %u\n",
+      tcp ? "TCP" : "UDP",
+      port);
+
+  memset(&stats, 0, sizeof(struct netframe_stats));
+  prev = stats;
+  last_print = now_usec();
+
+  while (!g_stop) {
+    if (tcp) {
+      if ((cfd = accept(sfd, NULL, NULL)) == -1)
+        continue;
+
+      fprintf(stderr, "netframe-rx: connection accepted\n");
+
+      /* Sequence numbers start over with every connection */
+      stats.primed = 0;
+      (void) receive_stream(
+            cfd,
+            buffer,
+            &stats,
+            dump,
+            &last_print,
+            &prev,
+            interval);
+      close(cfd);
+
+      fprintf(stderr, "netframe-rx: connection closed\n");
+      continue;
+    }
+
+    if ((got = recv(sfd, buffer, NETFRAME_RX_MAX_FRAME, 0)) < 1)
+      continue;
+
+    now = now_usec();
+
+    payload = frame_check(header, (size_t) got);
+    if (payload < 0 || header->headerSize + payload != got) {
+      ++stats.bad;
+    } else {
+      frame_account(&stats, header, now);
+
+      ++stats.frames;
+      stats.samples += header->samples;
+
+      if (dump != NULL)
+        fwrite(buffer + header->headerSize, (size_t) payload, 1, dump);
+    }
+
+    stats.bytes += (uint64_t) got;
+
+    if (now - last_print >= interval * 1e6) {
+      stats_print(&stats, &prev, (now - last_print) * 1e-6);
+      stats_reset_interval(&stats);
+      prev = stats;
+      last_print = now;
+    }
+  }
+
+  printf("\nTotal: ");
+  stats_print(&stats, &prev, (now_usec() - last_print) * 1e-6);
+  printf("Last frequency: %.0f Hz\n", stats.frequency);
+
+  if (dump != NULL)
+    fclose(dump);
+
+  close(sfd);
+  free(buffer);
+
+  return 0;
+}
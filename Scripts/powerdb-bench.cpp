@@ -0,0 +1,120 @@
+//
+//    powerdb-bench.cpp: Benchmark of the PSD frame dB conversion
+//    Copyright (C) 2020 Gonzalo José Carracedo Carballal
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as
+//    published by the Free Software Foundation, either version 3 of the
+//    License, or (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful, but
+//    WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public
+//    License along with this program.  If not, see
+//    <http://www.gnu.org/licenses/>
+//
+
+//
+// Compares the per-bin SU_POWER_DB loop that PSDMessage used to run with
+// fftShiftPowerDB, on frames of 64k to 1M bins with powers spread over
+// 150 dB, and checks the error against double precision. Build with:
+//
+//   c++ -O2 -std=c++14 -Iinclude `pkg-config --cflags sigutils`
+//       -o powerdb-bench Scripts/powerdb-bench.cpp Misc/PowerDB.cpp
+//
+// (one line)
+//
+
+#include <PowerDB.h>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace SigDigger;
+
+static void
+referenceShiftPowerDB(SUFLOAT *data, size_t len)
+{
+  size_t half = len / 2;
+  SUFLOAT tmp;
+
+  for (size_t i = 0; i < half; ++i) {
+    tmp = data[i + half];
+    data[i + half] = SU_POWER_DB(data[i]);
+    data[i] = SU_POWER_DB(tmp);
+  }
+}
+
+template <typename F>
+static double
+nsPerBin(F func, std::vector<SUFLOAT> const &input, unsigned int reps)
+{
+  std::vector<SUFLOAT> work(input.size());
+  double best = INFINITY;
+
+  for (unsigned int i = 0; i < reps; ++i) {
+    memcpy(work.data(), input.data(), input.size() * sizeof(SUFLOAT));
+
+    auto start = std::chrono::steady_clock::now();
+    func(work.data(), work.size());
+    auto end = std::chrono::steady_clock::now();
+
+    best = std::min(
+          best,
+          std::chrono::duration<double, std::nano>(end - start).count());
+  }
+
+  return best / input.size();
+}
+
+int
+main(void)
+{
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<double> exponent(-12, 3);
+  size_t sizes[] = {1 << 16, 1 << 18, 1 << 20};
+  double maxError = 0;
+
+  printf("Code path: %s\n\n", powerDBImplementation());
+  printf("%9s  %12s  %12s  %8s\n", "bins", "ref ns/bin", "fast ns/bin", "speedup");
+
+  for (auto size : sizes) {
+    std::vector<SUFLOAT> input(size);
+    std::vector<SUFLOAT> output(size);
+    unsigned int reps = static_cast<unsigned int>((1 << 24) / size) + 5;
+    double ref, fast;
+
+    for (auto &x : input)
+      x = static_cast<SUFLOAT>(std::pow(10., exponent(rng)));
+
+    input[0] = 0; // Must clamp, not return -inf
+
+    ref  = nsPerBin(referenceShiftPowerDB, input, reps);
+    fast = nsPerBin(fftShiftPowerDB, input, reps);
+
+    output = input;
+    fftShiftPowerDB(output.data(), size);
+
+    for (size_t i = 0; i < size; ++i) {
+      double x = std::max<double>(
+            input[(i + size / 2) % size],
+            SIGDIGGER_POWERDB_MIN_POWER);
+      maxError = std::max(maxError, std::fabs(output[i] - 10 * std::log10(x)));
+    }
+
+    printf("%9zu  %12.3f  %12.3f  %7.1fx\n", size, ref, fast, ref / fast);
+  }
+
+  printf(
+        "\nMax error: %g dB (bound: %g dB)\n",
+        maxError,
+        static_cast<double>(SIGDIGGER_POWERDB_MAX_ERROR));
+
+  return maxError <= SIGDIGGER_POWERDB_MAX_ERROR ? 0 : 1;
+}
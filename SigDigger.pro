@@ -127,12 +127,37 @@ SOURCES += \
     Components/EstimatorControl.cpp \
     Misc/GenericDataSaver.cpp \
     Misc/FileDataSaver.cpp \
+    Misc/DirectFileDataWriter.cpp \
+    Misc/SampleConverter.cpp \
+    Misc/Resampler.cpp \
+    Misc/SigMFMetadataWriter.cpp \
+    Misc/RotatingFileDataWriter.cpp \
+    Misc/TimeMachine.cpp \
+    Misc/SampleFanout.cpp \
+    Misc/Channelizer.cpp \
+    Misc/CaptureIndexWriter.cpp \
     UDP/SocketForwarder.cpp \
+    UDP/NetFrameWriter.cpp \
+    UDP/StreamServerWriter.cpp \
     Components/NetForwarderUI.cpp \
     Components/WaitingSpinnerWidget.cpp \
     Components/DeviceDialog.cpp \
     UIMediator/DeviceDialogMediator.cpp \
     Components/PanoramicDialog.cpp \
+    Components/LatencyDialog.cpp \
+    Components/SpectrumOverlay.cpp \
+    Misc/LatencyMonitor.cpp \
+    Misc/PowerDB.cpp \
+    Misc/AlignedBuffer.cpp \
+    Misc/PSDPyramid.cpp \
+    Misc/WaterfallHistory.cpp \
+    Components/WaterfallHistoryView.cpp \
+    Components/WaterfallHistoryDialog.cpp \
+    Misc/CFARDetector.cpp \
+    Misc/ChannelDetector.cpp \
+    Misc/SpectrumProcessor.cpp \
+    Components/ChannelListDialog.cpp \
+    Misc/FrameGovernor.cpp \
     Panoramic/Scanner.cpp
 
 
@@ -211,11 +236,37 @@ HEADERS += \
     include/EstimatorControl.h \
     include/GenericDataSaver.h \
     include/FileDataSaver.h \
+    include/DirectFileDataWriter.h \
+    include/SampleConverter.h \
+    include/Resampler.h \
+    include/SigMFMetadataWriter.h \
+    include/RotatingFileDataWriter.h \
+    include/TimeMachine.h \
+    include/SampleFanout.h \
+    include/Channelizer.h \
+    include/CaptureIndexWriter.h \
     include/SocketForwarder.h \
+    include/NetFrame.h \
+    include/NetFrameWriter.h \
+    include/StreamServerWriter.h \
     include/NetForwarderUI.h \
     include/WaitingSpinnerWidget.h \
     include/DeviceDialog.h \
     include/PanoramicDialog.h \
+    include/LatencyDialog.h \
+    include/SpectrumOverlay.h \
+    include/LatencyMonitor.h \
+    include/PowerDB.h \
+    include/AlignedBuffer.h \
+    include/PSDPyramid.h \
+    include/WaterfallHistory.h \
+    include/WaterfallHistoryView.h \
+    include/WaterfallHistoryDialog.h \
+    include/CFARDetector.h \
+    include/ChannelDetector.h \
+    include/SpectrumProcessor.h \
+    include/ChannelListDialog.h \
+    include/FrameGovernor.h \
     include/Scanner.h \
     include/WaveSampler.h
 
@@ -248,7 +299,10 @@ FORMS += \
     ui/EstimatorControl.ui \
     ui/NetForwarderUI.ui \
     ui/DeviceDialog.ui \
-    ui/PanoramicDialog.ui
+    ui/PanoramicDialog.ui \
+    ui/LatencyDialog.ui \
+    ui/WaterfallHistoryDialog.ui \
+    ui/ChannelListDialog.ui
 
 !isEmpty(target.path): INSTALLS += target
 
@@ -261,6 +315,13 @@ unix: PKGCONFIG += suscan
 packagesExist(volk) {
   PKGCONFIG += volk
 }
+
+# Direct I/O capture writer. Without liburing, it falls back to a pool
+# of threads issuing pwrite() calls.
+packagesExist(liburing) {
+  PKGCONFIG += liburing
+  DEFINES += SIGDIGGER_HAVE_IO_URING
+}
   
 # Sound API detection. We first check for system-specific audio libraries,
 # which tend to be the faster ones. If they are not available, fallback
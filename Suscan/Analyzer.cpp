@@ -21,6 +21,7 @@
 
 #include <QMetaType>
 #include <Suscan/Analyzer.h>
+#include <LatencyMonitor.h>
 
 Q_DECLARE_METATYPE(Suscan::Message);
 Q_DECLARE_METATYPE(Suscan::ChannelMessage);
@@ -32,42 +33,72 @@ Q_DECLARE_METATYPE(Suscan::EstimatorId);
 
 using namespace Suscan;
 
-// Async thread
+// Async thread. Everything already in the MQ is taken at once and handed
+// to the GUI thread as a single event, instead of one event per message.
 void
 Analyzer::AsyncThread::run()
 {
+  std::vector<PendingMessage> messages;
   void *data = nullptr;
   uint32_t type;
+  qint64 time;
   bool running = true;
 
+  messages.reserve(SUSCAN_ANALYZER_ASYNC_BATCH_MAX);
+
   // FIXME: Capture allocation exceptions!
   do {
+    messages.clear();
     data = this->owner->read(type);
 
-    switch (type) {
-      case SUSCAN_ANALYZER_MESSAGE_TYPE_INSPECTOR:
-      case SUSCAN_ANALYZER_MESSAGE_TYPE_PSD:
-      case SUSCAN_ANALYZER_MESSAGE_TYPE_SAMPLES:
-        emit message(type, data);
-        break;
-
-      // Exit conditions
-      case SUSCAN_WORKER_MSG_TYPE_HALT:
-      case SUSCAN_ANALYZER_MESSAGE_TYPE_EOS:
-      case SUSCAN_ANALYZER_MESSAGE_TYPE_READ_ERROR:
-        running = false;
-        suscan_analyzer_dispose_message(type, data);
+    for (;;) {
+      time = SigDigger::LatencyMonitor::now();
+
+      switch (type) {
+        case SUSCAN_ANALYZER_MESSAGE_TYPE_INSPECTOR:
+          messages.push_back({type, data, time});
+          break;
+
+        // Ready to draw by the time it reaches the GUI thread
+        case SUSCAN_ANALYZER_MESSAGE_TYPE_PSD:
+          PSDMessage::toDecibels(
+                static_cast<struct suscan_analyzer_psd_msg *>(data));
+          messages.push_back({type, data, time});
+          break;
+
+        // Subscribers get these here, without waiting for the GUI thread
+        case SUSCAN_ANALYZER_MESSAGE_TYPE_SAMPLES:
+          if (this->owner->deliverSamples(
+                static_cast<struct suscan_analyzer_sample_batch_msg *>(data),
+                time))
+            suscan_analyzer_dispose_message(type, data);
+          else
+            messages.push_back({type, data, time});
+          break;
+
+        // Exit conditions. Always the last message of the batch.
+        case SUSCAN_WORKER_MSG_TYPE_HALT:
+        case SUSCAN_ANALYZER_MESSAGE_TYPE_EOS:
+        case SUSCAN_ANALYZER_MESSAGE_TYPE_READ_ERROR:
+          running = false;
+          suscan_analyzer_dispose_message(type, data);
+          messages.push_back({type, nullptr, time});
+          break;
+
+        default:
+          // Everything else is disposed
+          suscan_analyzer_dispose_message(type, data);
+      }
+
+      if (!running
+          || messages.size() >= SUSCAN_ANALYZER_ASYNC_BATCH_MAX
+          || !this->owner->poll(type, data))
         break;
-
-      default:
-        // Everything else is disposed
-        suscan_analyzer_dispose_message(type, data);
-        data = nullptr;
     }
-  } while (running);
 
-  // Emit exit reason
-  emit message(type, data);
+    if (this->owner->enqueue(messages))
+      emit batchReady();
+  } while (running);
 }
 
 Analyzer::AsyncThread::AsyncThread(Analyzer *owner)
@@ -82,6 +113,144 @@ Analyzer::read(uint32_t &type)
   return suscan_analyzer_read(this->instance, &type);
 }
 
+bool
+Analyzer::poll(uint32_t &type, void *&data)
+{
+  return this->mq.poll(type, data);
+}
+
+// Called from the async thread
+bool
+Analyzer::deliverSamples(
+    const struct suscan_analyzer_sample_batch_msg *msg,
+    qint64 readTime)
+{
+  std::lock_guard<std::mutex> guard(this->subscriptionMutex);
+  InspectorId inspector = static_cast<InspectorId>(msg->inspector_id);
+  bool delivered = false;
+
+  for (auto &sub : this->subscriptions) {
+    if (sub.inspector == inspector) {
+      sub.callback(inspector, msg->samples, msg->sample_count, readTime);
+      delivered = true;
+    }
+  }
+
+  return delivered;
+}
+
+Analyzer::SubscriptionId
+Analyzer::subscribeSamples(InspectorId inspector, SampleCallback cb)
+{
+  std::lock_guard<std::mutex> guard(this->subscriptionMutex);
+  SampleSubscription sub;
+
+  sub.id        = ++this->lastSubscription;
+  sub.inspector = inspector;
+  sub.callback  = std::move(cb);
+
+  this->subscriptions.push_back(std::move(sub));
+
+  return this->lastSubscription;
+}
+
+void
+Analyzer::unsubscribeSamples(SubscriptionId id)
+{
+  std::lock_guard<std::mutex> guard(this->subscriptionMutex);
+
+  for (auto p = this->subscriptions.begin(); p != this->subscriptions.end(); ++p)
+    if (p->id == id) {
+      this->subscriptions.erase(p);
+      break;
+    }
+}
+
+// Same channel, same FFT: the pending frame is stale
+bool
+Analyzer::supersedes(const void *psd, const void *pending) const
+{
+  const struct suscan_analyzer_psd_msg *newer =
+      static_cast<const struct suscan_analyzer_psd_msg *>(psd);
+  const struct suscan_analyzer_psd_msg *older =
+      static_cast<const struct suscan_analyzer_psd_msg *>(pending);
+
+  return newer->fc == older->fc && newer->psd_size == older->psd_size;
+}
+
+// Called from the async thread. Returns true if the GUI thread has no
+// batchReady event on its way and must be sent one.
+bool
+Analyzer::enqueue(std::vector<PendingMessage> const &messages)
+{
+  std::lock_guard<std::mutex> guard(this->batchMutex);
+  std::vector<size_t>::iterator oldest;
+  unsigned int count;
+  bool notify;
+
+  for (auto &msg : messages) {
+    if (msg.type == SUSCAN_ANALYZER_MESSAGE_TYPE_PSD && this->coalescePSD) {
+      // Every frame is analyzed, so only a GUI that fell far behind loses
+      // some. The oldest one goes.
+      count = 0;
+      oldest = this->pendingPSD.end();
+      for (auto p = this->pendingPSD.begin(); p != this->pendingPSD.end(); ++p)
+        if (this->supersedes(msg.data, this->batch[*p].data)) {
+          if (count == 0)
+            oldest = p;
+          ++count;
+        }
+
+      if (count >= SUSCAN_ANALYZER_PSD_BACKLOG) {
+        PendingMessage &old = this->batch[*oldest];
+
+        suscan_analyzer_dispose_message(old.type, old.data);
+        old.data = nullptr;
+        this->pendingPSD.erase(oldest);
+        ++this->droppedPSD;
+      }
+
+      this->pendingPSD.push_back(this->batch.size());
+    }
+
+    this->batch.push_back(msg);
+  }
+
+  notify = !this->batchPosted && !this->batch.empty();
+  if (notify)
+    this->batchPosted = true;
+
+  return notify;
+}
+
+void
+Analyzer::disposePending(void)
+{
+  std::lock_guard<std::mutex> guard(this->batchMutex);
+
+  for (auto &msg : this->batch)
+    if (msg.data != nullptr)
+      suscan_analyzer_dispose_message(msg.type, msg.data);
+
+  this->batch.clear();
+  this->pendingPSD.clear();
+}
+
+quint64
+Analyzer::getDroppedPSDCount(void) const
+{
+  return this->droppedPSD;
+}
+
+void
+Analyzer::setPSDCoalescing(bool enabled)
+{
+  std::lock_guard<std::mutex> guard(this->batchMutex);
+
+  this->coalescePSD = enabled;
+  this->pendingPSD.clear();
+}
+
 void
 Analyzer::setThrottle(unsigned int throttle)
 {
@@ -205,23 +374,40 @@ Analyzer::halt(void)
   suscan_analyzer_req_halt(this->instance);
 }
 
-// Signal slots
+// Stamps the message so that consumers can tell how long it took to get
+// here (readTime to dispatch) and how long they took themselves.
 void
-Analyzer::captureMessage(quint32 type, void *data)
+Analyzer::dispatch(PendingMessage const &pending)
 {
+  qint64 dispatchTime = SigDigger::LatencyMonitor::now();
+  qint64 readTime = pending.time;
+  quint32 type = pending.type;
+  void *data = pending.data;
+
   switch (type) {
     // Data messages
-    case SUSCAN_ANALYZER_MESSAGE_TYPE_INSPECTOR:
-      emit inspector_message(InspectorMessage(static_cast<struct suscan_analyzer_inspector_msg *>(data)));
+    case SUSCAN_ANALYZER_MESSAGE_TYPE_INSPECTOR: {
+      InspectorMessage msg(
+            static_cast<struct suscan_analyzer_inspector_msg *>(data));
+      msg.setTimes(readTime, dispatchTime);
+      emit inspector_message(msg);
       break;
+    }
 
-    case SUSCAN_ANALYZER_MESSAGE_TYPE_PSD:
-      emit psd_message(PSDMessage(static_cast<struct suscan_analyzer_psd_msg *>(data)));
+    case SUSCAN_ANALYZER_MESSAGE_TYPE_PSD: {
+      PSDMessage msg(static_cast<struct suscan_analyzer_psd_msg *>(data));
+      msg.setTimes(readTime, dispatchTime);
+      emit psd_message(msg);
       break;
+    }
 
-    case SUSCAN_ANALYZER_MESSAGE_TYPE_SAMPLES:
-      emit samples_message(SamplesMessage(static_cast<struct suscan_analyzer_sample_batch_msg *>(data)));
+    case SUSCAN_ANALYZER_MESSAGE_TYPE_SAMPLES: {
+      SamplesMessage msg(
+            static_cast<struct suscan_analyzer_sample_batch_msg *>(data));
+      msg.setTimes(readTime, dispatchTime);
+      emit samples_message(msg);
       break;
+    }
 
     // Exit conditions. These have no data.
     case SUSCAN_WORKER_MSG_TYPE_HALT:
@@ -242,6 +428,53 @@ Analyzer::captureMessage(quint32 type, void *data)
   }
 }
 
+// Signal slots
+void
+Analyzer::captureMessage(quint32 type, void *data)
+{
+  PendingMessage msg = {type, data, SigDigger::LatencyMonitor::now()};
+
+  // Straight from the MQ, unlike what captureBatch gets
+  if (type == SUSCAN_ANALYZER_MESSAGE_TYPE_PSD)
+    PSDMessage::toDecibels(
+          static_cast<struct suscan_analyzer_psd_msg *>(data));
+
+  this->dispatch(msg);
+}
+
+void
+Analyzer::captureBatch(void)
+{
+  std::vector<PendingMessage> messages;
+
+  {
+    std::lock_guard<std::mutex> guard(this->batchMutex);
+
+    messages.swap(this->batch);
+    this->pendingPSD.clear();
+    this->batchPosted = false;
+  }
+
+  for (auto &msg : messages) {
+    switch (msg.type) {
+      case SUSCAN_ANALYZER_MESSAGE_TYPE_PSD:
+        if (msg.data != nullptr)
+          this->dispatch(msg);
+        break;
+
+      // Whoever handles these may delete us. Nothing comes after them.
+      case SUSCAN_WORKER_MSG_TYPE_HALT:
+      case SUSCAN_ANALYZER_MESSAGE_TYPE_EOS:
+      case SUSCAN_ANALYZER_MESSAGE_TYPE_READ_ERROR:
+        this->dispatch(msg);
+        return;
+
+      default:
+        this->dispatch(msg);
+    }
+  }
+}
+
 bool Analyzer::registered = false; // Yes, C++!
 
 void
@@ -405,9 +638,9 @@ Analyzer::Analyzer(AnalyzerParams &params, Source::Config const &config)
 
   connect(
         this->asyncThread,
-        SIGNAL(message(quint32, void *)),
+        SIGNAL(batchReady(void)),
         this,
-        SLOT(captureMessage(quint32, void *)),
+        SLOT(captureBatch(void)),
         Qt::QueuedConnection);
 
   this->asyncThread->start();
@@ -423,6 +656,8 @@ Analyzer::~Analyzer()
       delete this->asyncThread;
       this->asyncThread = nullptr;
     }
+    // Whatever the GUI thread did not get to
+    this->disposePending();
     // Async thread is safely destroyed, proceed to destroy instance
     suscan_analyzer_destroy(this->instance);
     this->instance = nullptr;
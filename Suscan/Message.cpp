@@ -18,15 +18,140 @@
 //
 
 #include <Suscan/Message.h>
+#include <mutex>
+#include <vector>
 
 using namespace Suscan;
 
+// Every message that reaches the GUI thread needs a shared_ptr control
+// block, and they all have the same size. Freed blocks are kept here and
+// handed out again instead of going back to the heap each time.
+namespace {
+  class ControlBlockPool {
+    std::mutex mutex;
+    std::vector<void *> blocks;
+    size_t blockSize = 0;
+
+  public:
+    static ControlBlockPool &
+    get(void)
+    {
+      // Never destroyed: messages may outlive static destructors
+      static ControlBlockPool *pool = new ControlBlockPool();
+
+      return *pool;
+    }
+
+    void *
+    alloc(size_t size)
+    {
+      {
+        std::lock_guard<std::mutex> guard(this->mutex);
+
+        if (this->blockSize == 0)
+          this->blockSize = size;
+
+        if (size == this->blockSize && !this->blocks.empty()) {
+          void *block = this->blocks.back();
+          this->blocks.pop_back();
+          return block;
+        }
+      }
+
+      return ::operator new(size);
+    }
+
+    void
+    release(void *block, size_t size)
+    {
+      {
+        std::lock_guard<std::mutex> guard(this->mutex);
+
+        if (size == this->blockSize
+            && this->blocks.size() < SUSCAN_MESSAGE_POOL_SIZE) {
+          this->blocks.push_back(block);
+          return;
+        }
+      }
+
+      ::operator delete(block);
+    }
+  };
+
+  template <class T>
+  struct PoolAllocator {
+    typedef T value_type;
+
+    PoolAllocator() = default;
+
+    template <class U>
+    PoolAllocator(PoolAllocator<U> const &)
+    {
+    }
+
+    T *
+    allocate(size_t n)
+    {
+      return static_cast<T *>(ControlBlockPool::get().alloc(n * sizeof(T)));
+    }
+
+    void
+    deallocate(T *p, size_t n)
+    {
+      ControlBlockPool::get().release(p, n * sizeof(T));
+    }
+  };
+
+  template <class T, class U>
+  bool
+  operator==(PoolAllocator<T> const &, PoolAllocator<U> const &)
+  {
+    return true;
+  }
+
+  template <class T, class U>
+  bool
+  operator!=(PoolAllocator<T> const &, PoolAllocator<U> const &)
+  {
+    return false;
+  }
+
+  struct MessageDeleter {
+    uint32_t type;
+
+    void
+    operator()(void *ptr) const
+    {
+      suscan_analyzer_dispose_message(this->type, ptr);
+    }
+  };
+}
+
 uint32_t
 Message::getType(void) const
 {
   return this->type;
 }
 
+qint64
+Message::getReadTime(void) const
+{
+  return this->readTime;
+}
+
+qint64
+Message::getDispatchTime(void) const
+{
+  return this->dispatchTime;
+}
+
+void
+Message::setTimes(qint64 read, qint64 dispatch)
+{
+  this->readTime = read;
+  this->dispatchTime = dispatch;
+}
+
 Message::Message()
 {
   this->type = 0;
@@ -43,14 +168,18 @@ Message::Message()
 Message::Message(uint32_t type, void *c_message)
 {
   this->type = type;
-  auto deleter = [=](void *ptr) { suscan_analyzer_dispose_message(type, ptr); };
-  this->c_message = std::shared_ptr<void>(c_message, deleter);
+  this->c_message = std::shared_ptr<void>(
+        c_message,
+        MessageDeleter{type},
+        PoolAllocator<void>());
 }
 
 // Move constructor
 Message::Message(Message &&rv)
 {
   std::swap(this->type, rv.type);
+  std::swap(this->readTime, rv.readTime);
+  std::swap(this->dispatchTime, rv.dispatchTime);
   this->c_message.swap(rv.c_message);
 }
 
@@ -59,6 +188,8 @@ Message &
 Message::operator=(Message &&rv)
 {
   std::swap(this->type, rv.type);
+  std::swap(this->readTime, rv.readTime);
+  std::swap(this->dispatchTime, rv.dispatchTime);
   this->c_message.swap(rv.c_message);
 
   return *this;
@@ -68,6 +199,8 @@ Message::operator=(Message &&rv)
 Message::Message(const Message &rv)
 {
   this->type = rv.type;
+  this->readTime = rv.readTime;
+  this->dispatchTime = rv.dispatchTime;
   this->c_message = rv.c_message;
 }
 
@@ -76,6 +209,8 @@ Message &
 Message::operator=(const Message &rv)
 {
   this->type = rv.type;
+  this->readTime = rv.readTime;
+  this->dispatchTime = rv.dispatchTime;
   this->c_message = rv.c_message;
 
   return *this;
@@ -33,9 +33,32 @@ InspectorMessage::InspectorMessage(struct suscan_analyzer_inspector_msg *msg) :
          ? msg->config
          : nullptr)
 {
+  this->message = msg;
+}
+
+void
+InspectorMessage::buildLists(void) const
+{
+  const struct suscan_analyzer_inspector_msg *msg = this->message;
   unsigned int i;
 
-  this->message = msg;
+  if (this->listsBuilt)
+    return;
+
+  this->listsBuilt = true;
+
+  if (msg == nullptr)
+    return;
+
+  switch (msg->kind) {
+    case SUSCAN_ANALYZER_INSPECTOR_MSGKIND_OPEN:
+    case SUSCAN_ANALYZER_INSPECTOR_MSGKIND_GET_CONFIG:
+    case SUSCAN_ANALYZER_INSPECTOR_MSGKIND_SET_CONFIG:
+      break;
+
+    default:
+      return;
+  }
 
   this->sources.resize(static_cast<unsigned>(msg->spectsrc_count));
   for (i = 0; i < static_cast<unsigned>(msg->spectsrc_count); ++i) {
@@ -170,12 +193,16 @@ InspectorMessage::getClass(void) const
 std::vector<SpectrumSource> const &
 InspectorMessage::getSpectrumSources(void) const
 {
+  this->buildLists();
+
   return this->sources;
 }
 
 std::vector<Estimator> const &
 InspectorMessage::getEstimators(void) const
 {
+  this->buildLists();
+
   return this->estimators;
 }
 
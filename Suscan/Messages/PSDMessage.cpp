@@ -18,6 +18,7 @@
 //
 
 #include <Suscan/Messages/PSDMessage.h>
+#include <PowerDB.h>
 
 using namespace Suscan;
 
@@ -26,16 +27,13 @@ PSDMessage::PSDMessage() : Message() { }
 PSDMessage::PSDMessage(struct suscan_analyzer_psd_msg *msg) :
   Message(SUSCAN_ANALYZER_MESSAGE_TYPE_PSD, msg)
 {
-  unsigned int i;
-  SUSCOUNT half_size{msg->psd_size / 2};
-  SUFLOAT tmp;
   this->message = msg;
+}
 
-  for (i = 0; i < half_size; ++i) {
-    tmp = msg->psd_data[i + half_size];
-    msg->psd_data[i + half_size] = SU_POWER_DB(msg->psd_data[i]);
-    msg->psd_data[i] = SU_POWER_DB(tmp);
-  }
+void
+PSDMessage::toDecibels(struct suscan_analyzer_psd_msg *msg)
+{
+  SigDigger::fftShiftPowerDB(msg->psd_data, msg->psd_size);
 }
 
 SUSCOUNT
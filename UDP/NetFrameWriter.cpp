@@ -0,0 +1,154 @@
+//
+//    NetFrameWriter.cpp: Base of the network forwarder writers
+//    Copyright (C) 2020 Gonzalo José Carracedo Carballal
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as
+//    published by the Free Software Foundation, either version 3 of the
+//    License, or (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful, but
+//    WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public
+//    License along with this program.  If not, see
+//    <http://www.gnu.org/licenses/>
+//
+
+#include <NetFrameWriter.h>
+#include <sys/time.h>
+#include <cstring>
+#include <algorithm>
+
+using namespace SigDigger;
+
+NetFrameWriter::NetFrameWriter(NetStreamParams const &params) :
+  converter(params.format, params.fullScale)
+{
+  unsigned int frameLen = params.frameLen;
+  unsigned int interp, decim;
+  struct timeval tv;
+
+  this->framed = params.framed;
+  this->rate = params.sampleRate;
+  this->sampleBytes =
+      static_cast<unsigned int>(this->converter.getSampleSize());
+
+  // Ratios the filter bank cannot realize keep the input rate
+  if (params.sampleRate > 0 && params.outputRate > 0
+      && Resampler::approximate(
+        params.outputRate / params.sampleRate,
+        interp,
+        decim)
+      && interp != decim) {
+    this->resampler = std::make_unique<Resampler>(interp, decim);
+    this->interp = this->resampler->getInterpolation();
+    this->decim = this->resampler->getDecimation();
+    this->rate = params.sampleRate * this->interp / this->decim;
+  }
+
+  if (this->framed)
+    frameLen = frameLen > sizeof(NetFrameHeader)
+        ? frameLen - static_cast<unsigned int>(sizeof(NetFrameHeader))
+        : 0;
+
+  this->size = std::max(frameLen / this->sampleBytes, 1u);
+
+  // Until the first block timestamp comes
+  gettimeofday(&tv, nullptr);
+  this->refTime = tv.tv_sec * 1000000ll + tv.tv_usec;
+}
+
+unsigned int
+NetFrameWriter::frameBytes(void) const
+{
+  unsigned int bytes = this->size * this->sampleBytes;
+
+  if (this->framed)
+    bytes += static_cast<unsigned int>(sizeof(NetFrameHeader));
+
+  return bytes;
+}
+
+void
+NetFrameWriter::fillHeader(
+    NetFrameHeader *header,
+    unsigned int frame,
+    size_t offset,
+    size_t samples) const
+{
+  quint64 position = this->position + offset;
+
+  memcpy(header->magic, SIGDIGGER_NETFRAME_MAGIC, sizeof(header->magic));
+  header->version    = SIGDIGGER_NETFRAME_VERSION;
+  header->format     = static_cast<uint8_t>(this->converter.getFormat());
+  header->headerSize = sizeof(NetFrameHeader);
+  header->sequence   = this->sequence + frame;
+  header->samples    = static_cast<uint32_t>(samples);
+  header->position   = position;
+  header->time       = this->refTime;
+  header->sampleRate = this->rate;
+  header->frequency  = this->frequency;
+  header->fullScale  = this->converter.getFullScale();
+  header->reserved   = 0;
+
+  if (this->rate > 0)
+    header->time += static_cast<qint64>(
+          1e6 * static_cast<qreal>(position - this->refPosition) / this->rate);
+}
+
+void
+NetFrameWriter::advance(unsigned int frames, size_t samples)
+{
+  this->sequence += frames;
+  this->position += samples;
+}
+
+size_t
+NetFrameWriter::condition(
+    const SUCOMPLEX *data,
+    size_t len,
+    const uint8_t *&out)
+{
+  this->inputPosition += len;
+
+  if (this->resampler) {
+    this->resampled.resize(this->resampler->maxOutput(len));
+    len  = this->resampler->feed(data, len, this->resampled.data());
+    data = this->resampled.data();
+  }
+
+  if (this->converter.getFormat() == SAMPLE_FORMAT_CF32) {
+    out = reinterpret_cast<const uint8_t *>(data);
+  } else {
+    this->packed.resize(len * this->sampleBytes);
+    this->converter.convert(this->packed.data(), data, len);
+    out = this->packed.data();
+  }
+
+  return len;
+}
+
+// Block timestamps come in input samples, but the resampler only delays
+// them by a few output samples. Close enough for frame timestamps.
+void
+NetFrameWriter::setTimestamp(qint64 usec)
+{
+  this->refPosition = this->position;
+  this->refTime = usec;
+}
+
+// Only forward jumps are gaps. Before the first block, or when a history
+// dump overlaps it, there is nothing to skip.
+void
+NetFrameWriter::setStreamPosition(quint64 position)
+{
+  if (this->inputStarted && position > this->inputPosition)
+    this->position +=
+        (position - this->inputPosition) * this->interp / this->decim;
+
+  this->inputPosition = position;
+  this->inputStarted = true;
+}
@@ -18,19 +18,44 @@
 //
 
 #include <SocketForwarder.h>
+#include <StreamServerWriter.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
 #include <netdb.h>
+#include <poll.h>
 #include <stdexcept>
+#include <algorithm>
+#include <vector>
 
 #ifndef MSG_NOSIGNAL
 #  define MSG_NOSIGNAL 0
 #endif // MSG_NOSIGNAL
 
+#ifdef __linux__
+#  include <netinet/udp.h>
+#  define SIGDIGGER_HAVE_SENDMMSG
+#  ifdef UDP_SEGMENT
+#    define SIGDIGGER_HAVE_UDP_GSO
+#  endif // UDP_SEGMENT
+#endif // __linux__
+
 using namespace SigDigger;
 
 namespace SigDigger {
-  class SocketDataWriter : public GenericDataWriter {
+  //
+  // Datagrams carry `size' samples each, the last one of a write may be
+  // shorter. Where the platform has sendmmsg, every write goes out as a
+  // batch of up to SIGDIGGER_SOCKETFORWARDER_BATCH messages in a single
+  // call. If the kernel supports UDP GSO, each of those messages is a
+  // train of datagrams that is segmented further down the stack.
+  //
+  // With framing, every datagram (or every run of `size' samples over
+  // TCP) starts with a NetFrameHeader. Headers and samples are gathered
+  // with iovecs, so the samples are never copied.
+  //
+  class SocketDataWriter : public NetFrameWriter {
     std::string host;
     uint16_t port;
     char pad[2];
@@ -39,15 +64,40 @@ namespace SigDigger {
     bool solved = false;
     bool tcp = false;
     char pad2[2];
-    unsigned int size = 0;
+    unsigned int segments = 1; // Datagrams per message (GSO)
     std::string lastError;
 
+    // Frames of the current write
+    std::vector<NetFrameHeader> headers;
+    std::vector<struct iovec> iovs;
+    unsigned int iovPtr = 0;
+    unsigned int pendingFrames = 0;
+    size_t pendingSamples = 0;
+
+#ifdef SIGDIGGER_HAVE_SENDMMSG
+    std::vector<struct mmsghdr> msgs;
+    std::vector<unsigned int> msgFrames;
+    std::vector<size_t> msgSamples;
+#endif // SIGDIGGER_HAVE_SENDMMSG
+
+    void setupBatch(void);
+    void enableGso(void);
+    void disableGso(void);
+    bool retry(unsigned int &attempts);
+
+    void resetFrames(void);
+    size_t pushFrames(const uint8_t *data, size_t len, unsigned int count);
+
+    // In samples of the output format
+    ssize_t sendStream(const uint8_t *data, size_t len);
+    ssize_t sendDatagrams(const uint8_t *data, size_t len);
+
   public:
     SocketDataWriter(
         std::string const &host,
         uint16_t port,
-        unsigned int size,
-        bool tcp);
+        bool tcp,
+        NetStreamParams const &params);
 
     bool prepare(void) override;
     std::string getError(void) const override;
@@ -61,13 +111,70 @@ namespace SigDigger {
 SocketDataWriter::SocketDataWriter(
     std::string const &host,
     uint16_t port,
-    unsigned int size,
-    bool tcp) :
-  host(host), port(port), tcp(tcp), size(size / sizeof(SUCOMPLEX))
+    bool tcp,
+    NetStreamParams const &params) :
+  NetFrameWriter(params), host(host), port(port), tcp(tcp)
 {
   this->pad[0] = this->pad2[0] = 0; // Shut up
 }
 
+// The headers point into iovs, which do not move from now on
+void
+SocketDataWriter::setupBatch(void)
+{
+  unsigned int frames = SIGDIGGER_SOCKETFORWARDER_BATCH * this->segments;
+
+  this->headers.resize(frames);
+  this->iovs.resize(2 * frames);
+
+#ifdef SIGDIGGER_HAVE_SENDMMSG
+  unsigned int i;
+
+  this->msgs.resize(SIGDIGGER_SOCKETFORWARDER_BATCH);
+  this->msgFrames.resize(SIGDIGGER_SOCKETFORWARDER_BATCH);
+  this->msgSamples.resize(SIGDIGGER_SOCKETFORWARDER_BATCH);
+
+  memset(this->msgs.data(), 0, this->msgs.size() * sizeof(struct mmsghdr));
+
+  for (i = 0; i < SIGDIGGER_SOCKETFORWARDER_BATCH; ++i) {
+    this->msgs[i].msg_hdr.msg_name    = &this->addr;
+    this->msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+  }
+#endif // SIGDIGGER_HAVE_SENDMMSG
+}
+
+void
+SocketDataWriter::enableGso(void)
+{
+#ifdef SIGDIGGER_HAVE_UDP_GSO
+  int payload = static_cast<int>(this->frameBytes());
+  unsigned int segments = std::min<unsigned int>(
+        SIGDIGGER_SOCKETFORWARDER_GSO_SEGMENTS,
+        SIGDIGGER_SOCKETFORWARDER_GSO_MAX_BYTES / static_cast<unsigned>(payload));
+
+  // Older kernels reject the option. Plain batches are fine then.
+  if (segments > 1
+      && setsockopt(
+        this->fd,
+        SOL_UDP,
+        UDP_SEGMENT,
+        &payload,
+        sizeof(int)) == 0)
+    this->segments = segments;
+#endif // SIGDIGGER_HAVE_UDP_GSO
+}
+
+void
+SocketDataWriter::disableGso(void)
+{
+#ifdef SIGDIGGER_HAVE_UDP_GSO
+  int payload = 0;
+
+  (void) setsockopt(this->fd, SOL_UDP, UDP_SEGMENT, &payload, sizeof(int));
+#endif // SIGDIGGER_HAVE_UDP_GSO
+  this->segments = 1;
+}
+
 bool
 SocketDataWriter::prepare(void)
 {
@@ -100,7 +207,11 @@ SocketDataWriter::prepare(void)
         this->lastError = "Cannot connect to host: " + std::string(strerror(errno));
         return false;
       }
+    } else {
+      this->enableGso();
     }
+
+    this->setupBatch();
     this->solved = true;
   }
 
@@ -119,30 +230,227 @@ SocketDataWriter::canWrite(void) const
   return !this->solved || this->fd != -1;
 }
 
+// Transient errors: a signal, or a full socket buffer or device queue
+bool
+SocketDataWriter::retry(unsigned int &attempts)
+{
+  struct pollfd pfd;
+
+  if (errno == EINTR)
+    return true;
+
+  if (errno != EAGAIN && errno != EWOULDBLOCK && errno != ENOBUFS)
+    return false;
+
+  if (++attempts > SIGDIGGER_SOCKETFORWARDER_RETRIES)
+    return false;
+
+  pfd.fd = this->fd;
+  pfd.events = POLLOUT;
+  pfd.revents = 0;
+
+  (void) poll(&pfd, 1, SIGDIGGER_SOCKETFORWARDER_RETRY_MS);
+
+  return true;
+}
+
+void
+SocketDataWriter::resetFrames(void)
+{
+  this->iovPtr = 0;
+  this->pendingFrames = 0;
+  this->pendingSamples = 0;
+}
+
+// Appends up to count frames to iovs. Returns the samples they take.
+size_t
+SocketDataWriter::pushFrames(
+    const uint8_t *data,
+    size_t len,
+    unsigned int count)
+{
+  NetFrameHeader *header;
+  size_t chunk, done = 0;
+
+  while (count-- > 0 && done < len) {
+    chunk = std::min<size_t>(this->size, len - done);
+
+    if (this->framed) {
+      header = &this->headers[this->pendingFrames];
+      this->fillHeader(
+            header,
+            this->pendingFrames,
+            this->pendingSamples,
+            chunk);
+
+      this->iovs[this->iovPtr].iov_base = header;
+      this->iovs[this->iovPtr].iov_len  = sizeof(NetFrameHeader);
+      ++this->iovPtr;
+    }
+
+    this->iovs[this->iovPtr].iov_base =
+        const_cast<uint8_t *>(data + done * this->sampleBytes);
+    this->iovs[this->iovPtr].iov_len  = chunk * this->sampleBytes;
+    ++this->iovPtr;
+
+    ++this->pendingFrames;
+    this->pendingSamples += chunk;
+    done += chunk;
+  }
+
+  return done;
+}
+
+// Frames never go out halfway: the receiver would lose sync
 ssize_t
-SocketDataWriter::write(const SUCOMPLEX *data, size_t len)
+SocketDataWriter::sendStream(const uint8_t *data, size_t len)
 {
+  struct msghdr msg;
+  struct iovec *iov;
+  unsigned int attempts = 0;
   ssize_t sent;
 
-  if (len > this->size)
-    len = this->size;
+  this->resetFrames();
+  (void) this->pushFrames(data, len, SIGDIGGER_SOCKETFORWARDER_BATCH);
+
+  memset(&msg, 0, sizeof(struct msghdr));
+  msg.msg_iov = iov = this->iovs.data();
+  msg.msg_iovlen = this->iovPtr;
+
+  while (msg.msg_iovlen > 0) {
+    sent = sendmsg(this->fd, &msg, MSG_NOSIGNAL);
+
+    if (sent < 1) {
+      if (sent == -1 && this->retry(attempts))
+        continue;
 
-  sent = sendto(
-          this->fd,
-          data,
-          static_cast<size_t>(len) * sizeof(SUCOMPLEX),
-          MSG_NOSIGNAL,
-          reinterpret_cast<struct sockaddr *>(&this->addr),
-          sizeof(struct sockaddr_in));
+      this->lastError = std::string(strerror(errno));
+      return -1;
+    }
+
+    while (msg.msg_iovlen > 0 && static_cast<size_t>(sent) >= iov->iov_len) {
+      sent -= static_cast<ssize_t>(iov->iov_len);
+      ++iov;
+      --msg.msg_iovlen;
+    }
+
+    if (msg.msg_iovlen > 0) {
+      iov->iov_base = static_cast<char *>(iov->iov_base) + sent;
+      iov->iov_len -= static_cast<size_t>(sent);
+    }
+
+    msg.msg_iov = iov;
+  }
+
+  this->advance(this->pendingFrames, this->pendingSamples);
+
+  return static_cast<ssize_t>(this->pendingSamples);
+}
+
+ssize_t
+SocketDataWriter::sendDatagrams(const uint8_t *data, size_t len)
+{
+  unsigned int attempts = 0;
+
+  this->resetFrames();
+
+#ifdef SIGDIGGER_HAVE_SENDMMSG
+  unsigned int i, first, frames, count = 0;
+  size_t done = 0;
+  int sent;
+
+  // One message per datagram, or per GSO train of datagrams
+  while (count < SIGDIGGER_SOCKETFORWARDER_BATCH && done < len) {
+    first  = this->iovPtr;
+    frames = this->pendingFrames;
+
+    this->msgSamples[count] =
+        this->pushFrames(
+          data + done * this->sampleBytes,
+          len - done,
+          this->segments);
+    this->msgFrames[count] = this->pendingFrames - frames;
+    this->msgs[count].msg_hdr.msg_iov    = &this->iovs[first];
+    this->msgs[count].msg_hdr.msg_iovlen = this->iovPtr - first;
+
+    done += this->msgSamples[count++];
+  }
+
+  do
+    sent = sendmmsg(this->fd, this->msgs.data(), count, MSG_NOSIGNAL);
+  while (sent == -1 && this->retry(attempts));
+
+  if (sent < 1) {
+    // Some devices cannot take GSO trains. Fall back to single datagrams.
+    if (sent == -1 && errno == EIO && this->segments > 1) {
+      this->disableGso();
+      return this->sendDatagrams(data, len);
+    }
 
-  if (sent < 1)
     this->lastError = std::string(strerror(errno));
+    return -1;
+  }
+
+  for (i = 0, done = 0, frames = 0; i < static_cast<unsigned int>(sent); ++i) {
+    frames += this->msgFrames[i];
+    done   += this->msgSamples[i];
+  }
+
+  this->advance(frames, done);
 
+  return static_cast<ssize_t>(done);
+#else
+  struct msghdr msg;
+  ssize_t sent;
+
+  (void) this->pushFrames(data, len, 1);
 
-  sent /= static_cast<ssize_t>(sizeof(SUCOMPLEX));
+  memset(&msg, 0, sizeof(struct msghdr));
+  msg.msg_name    = &this->addr;
+  msg.msg_namelen = sizeof(struct sockaddr_in);
+  msg.msg_iov     = this->iovs.data();
+  msg.msg_iovlen  = this->iovPtr;
 
+  do
+    sent = sendmsg(this->fd, &msg, MSG_NOSIGNAL);
+  while (sent == -1 && this->retry(attempts));
 
-  return sent;
+  if (sent < 1) {
+    this->lastError = std::string(strerror(errno));
+    return -1;
+  }
+
+  this->advance(this->pendingFrames, this->pendingSamples);
+
+  return static_cast<ssize_t>(this->pendingSamples);
+#endif // SIGDIGGER_HAVE_SENDMMSG
+}
+
+// The resampler keeps state, so everything conditioned must go out here
+ssize_t
+SocketDataWriter::write(const SUCOMPLEX *data, size_t len)
+{
+  const uint8_t *samples;
+  size_t count, done = 0;
+  ssize_t sent;
+
+  count = this->condition(data, len, samples);
+
+  while (done < count) {
+    if (this->tcp)
+      sent = this->sendStream(samples + done * this->sampleBytes, count - done);
+    else
+      sent = this->sendDatagrams(
+            samples + done * this->sampleBytes,
+            count - done);
+
+    if (sent < 1)
+      return -1;
+
+    done += static_cast<size_t>(sent);
+  }
+
+  return static_cast<ssize_t>(len);
 }
 
 bool
@@ -163,15 +471,58 @@ SocketDataWriter::~SocketDataWriter(void)
   this->close();
 }
 
+NetFrameWriter *
+SocketForwarder::makeWriter(
+    std::string const &host,
+    uint16_t port,
+    Mode mode,
+    NetStreamParams const &params)
+{
+  if (mode == MODE_TCP_SERVER)
+    return new StreamServerWriter(host, port, params);
+
+  return new SocketDataWriter(host, port, mode == MODE_TCP, params);
+}
+
+SocketForwarder::SocketForwarder(NetFrameWriter *writer, QObject *parent) :
+  GenericDataSaver(writer, parent),
+  writer(writer),
+  server(dynamic_cast<StreamServerWriter *>(writer))
+{
+}
+
 SocketForwarder::SocketForwarder(
     std::string const &host,
     uint16_t port,
-    unsigned int size,
-    bool tcp,
+    Mode mode,
+    NetStreamParams const &params,
     QObject *parent) :
-  GenericDataSaver(
-    this->writer = new SocketDataWriter(host, port, size, tcp),
-    parent)
+  SocketForwarder(makeWriter(host, port, mode, params), parent)
+{
+}
+
+unsigned int
+SocketForwarder::getClientCount(void) const
+{
+  return this->server != nullptr ? this->server->getClientCount() : 0;
+}
+
+qreal
+SocketForwarder::getOutputRate(void) const
+{
+  return this->writer->getOutputRate();
+}
+
+void
+SocketForwarder::setFrequency(qreal frequency)
+{
+  this->writer->frequency = frequency;
+}
+
+SocketForwarder::~SocketForwarder(void)
 {
+  // The worker may still be using the writer
+  this->finish();
 
+  delete this->writer;
 }
@@ -0,0 +1,485 @@
+//
+//    StreamServerWriter.cpp: Serve a sample stream to many TCP clients
+//    Copyright (C) 2020 Gonzalo José Carracedo Carballal
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as
+//    published by the Free Software Foundation, either version 3 of the
+//    License, or (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful, but
+//    WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public
+//    License along with this program.  If not, see
+//    <http://www.gnu.org/licenses/>
+//
+
+#include <StreamServerWriter.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+
+#ifdef __linux__
+#  include <sys/epoll.h>
+#  include <sys/eventfd.h>
+#  define SIGDIGGER_HAVE_EPOLL
+#endif // __linux__
+
+#ifndef MSG_NOSIGNAL
+#  define MSG_NOSIGNAL 0
+#endif // MSG_NOSIGNAL
+
+#define SIGDIGGER_STREAMSERVER_EVENTS 16
+
+using namespace SigDigger;
+
+StreamServerWriter::StreamServerWriter(
+    std::string const &address,
+    uint16_t port,
+    NetStreamParams const &params,
+    SlowClientPolicy policy,
+    size_t queueBytes) :
+  NetFrameWriter(params),
+  address(address),
+  port(port),
+  policy(policy),
+  queueBytes(queueBytes)
+{
+}
+
+unsigned int
+StreamServerWriter::getClientCount(void) const
+{
+  std::lock_guard<std::mutex> guard(this->clientMutex);
+
+  return static_cast<unsigned int>(this->clients.size());
+}
+
+quint64
+StreamServerWriter::getSkipped(void) const
+{
+  return this->skipped;
+}
+
+quint64
+StreamServerWriter::getDisconnected(void) const
+{
+  return this->disconnected;
+}
+
+void
+StreamServerWriter::wake(void)
+{
+  uint64_t one = 1;
+
+  if (this->wakeFd != -1)
+    (void) ::write(this->wakeFd, &one, sizeof(uint64_t));
+}
+
+#ifdef SIGDIGGER_HAVE_EPOLL
+void
+StreamServerWriter::acceptClients(void)
+{
+  struct sockaddr_in peer;
+  struct epoll_event ev;
+  socklen_t len;
+  int fd;
+
+  for (;;) {
+    len = sizeof(struct sockaddr_in);
+    fd = accept4(
+          this->listenFd,
+          reinterpret_cast<struct sockaddr *>(&peer),
+          &len,
+          SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+    if (fd == -1) {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+
+    std::lock_guard<std::mutex> guard(this->clientMutex);
+
+    if (this->clients.size() >= SIGDIGGER_STREAMSERVER_MAX_CLIENTS) {
+      ::close(fd);
+      continue;
+    }
+
+    // Clients are not expected to talk. Errors and hangups come anyway.
+    memset(&ev, 0, sizeof(struct epoll_event));
+    ev.events  = EPOLLOUT | EPOLLET;
+    ev.data.fd = fd;
+
+    if (epoll_ctl(this->epollFd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+      ::close(fd);
+      continue;
+    }
+
+    auto client = std::make_unique<Client>();
+    client->fd = fd;
+    client->name =
+        std::string(inet_ntoa(peer.sin_addr))
+        + ":"
+        + std::to_string(ntohs(peer.sin_port));
+
+    this->clients[fd] = std::move(client);
+  }
+}
+
+// With clientMutex held
+void
+StreamServerWriter::dropClient(int fd)
+{
+  (void) epoll_ctl(this->epollFd, EPOLL_CTL_DEL, fd, nullptr);
+  ::close(fd);
+
+  this->clients.erase(fd);
+}
+#endif // SIGDIGGER_HAVE_EPOLL
+
+// With clientMutex held. Returns false if the client is gone.
+bool
+StreamServerWriter::flushClient(Client *client)
+{
+  struct iovec iov[SIGDIGGER_STREAMSERVER_IOV_MAX];
+  struct msghdr msg;
+  unsigned int count;
+  size_t left;
+  ssize_t sent;
+
+  while (!client->queue.empty()) {
+    count = 0;
+    for (auto &chunk : client->queue) {
+      if (count == SIGDIGGER_STREAMSERVER_IOV_MAX)
+        break;
+
+      iov[count].iov_base = const_cast<uint8_t *>(chunk->data());
+      iov[count].iov_len  = chunk->size();
+      ++count;
+    }
+
+    iov[0].iov_base = static_cast<uint8_t *>(iov[0].iov_base) + client->offset;
+    iov[0].iov_len -= client->offset;
+
+    memset(&msg, 0, sizeof(struct msghdr));
+    msg.msg_iov    = iov;
+    msg.msg_iovlen = count;
+
+    sent = sendmsg(client->fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+
+    if (sent == -1) {
+      if (errno == EINTR)
+        continue;
+
+      // Full socket buffer. epoll tells when there is room again.
+      return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+
+    client->queued -= static_cast<size_t>(sent);
+
+    while (sent > 0) {
+      left = client->queue.front()->size() - client->offset;
+
+      if (static_cast<size_t>(sent) >= left) {
+        sent -= static_cast<ssize_t>(left);
+        client->queue.pop_front();
+        client->offset = 0;
+      } else {
+        client->offset += static_cast<size_t>(sent);
+        sent = 0;
+      }
+    }
+  }
+
+  return true;
+}
+
+void
+StreamServerWriter::flushAll(void)
+{
+#ifdef SIGDIGGER_HAVE_EPOLL
+  std::lock_guard<std::mutex> guard(this->clientMutex);
+  auto p = this->clients.begin();
+  Client *client;
+
+  while (p != this->clients.end()) {
+    client = p->second.get();
+    ++p; // dropClient invalidates it
+
+    if (client->closing || !this->flushClient(client))
+      this->dropClient(client->fd);
+  }
+#endif // SIGDIGGER_HAVE_EPOLL
+}
+
+void
+StreamServerWriter::senderLoop(void)
+{
+#ifdef SIGDIGGER_HAVE_EPOLL
+  struct epoll_event events[SIGDIGGER_STREAMSERVER_EVENTS];
+  uint64_t count;
+  int i, n, fd;
+
+  while (this->running) {
+    n = epoll_wait(this->epollFd, events, SIGDIGGER_STREAMSERVER_EVENTS, -1);
+
+    if (n == -1) {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+
+    for (i = 0; i < n; ++i) {
+      fd = events[i].data.fd;
+
+      if (fd == this->listenFd) {
+        this->acceptClients();
+      } else if (fd == this->wakeFd) {
+        (void) ::read(this->wakeFd, &count, sizeof(uint64_t));
+      } else if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+        std::lock_guard<std::mutex> guard(this->clientMutex);
+
+        if (this->clients.find(fd) != this->clients.end())
+          this->dropClient(fd);
+      }
+    }
+
+    // New chunks, room in some socket, or both
+    this->flushAll();
+  }
+#endif // SIGDIGGER_HAVE_EPOLL
+}
+
+void
+StreamServerWriter::shutdown(void)
+{
+  this->running = false;
+  this->wake();
+
+  if (this->sender.joinable())
+    this->sender.join();
+
+  for (auto &p : this->clients)
+    ::close(p.first);
+  this->clients.clear();
+
+  if (this->listenFd != -1)
+    ::close(this->listenFd);
+
+  if (this->epollFd != -1)
+    ::close(this->epollFd);
+
+  if (this->wakeFd != -1)
+    ::close(this->wakeFd);
+
+  this->listenFd = this->epollFd = this->wakeFd = -1;
+  this->listening = false;
+}
+
+bool
+StreamServerWriter::prepare(void)
+{
+  if (this->listening)
+    return true;
+
+#ifdef SIGDIGGER_HAVE_EPOLL
+  struct sockaddr_in addr;
+  struct epoll_event ev;
+  struct hostent *ent;
+  int one = 1;
+
+  memset(&addr, 0, sizeof(struct sockaddr_in));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(this->port);
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+
+  if (!this->address.empty() && this->address != "0.0.0.0") {
+    if ((ent = gethostbyname(this->address.c_str())) == nullptr) {
+      this->lastError = "Failed to resolve hostname " + this->address;
+      return false;
+    }
+
+    addr.sin_addr = *reinterpret_cast<struct in_addr *>(ent->h_addr);
+  }
+
+  if ((this->listenFd = socket(
+         AF_INET,
+         SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+         0)) == -1) {
+    this->lastError = "Failed to open socket: " + std::string(strerror(errno));
+    goto fail;
+  }
+
+  (void) setsockopt(
+        this->listenFd,
+        SOL_SOCKET,
+        SO_REUSEADDR,
+        &one,
+        sizeof(int));
+
+  if (bind(
+        this->listenFd,
+        reinterpret_cast<struct sockaddr *>(&addr),
+        sizeof(struct sockaddr_in)) == -1) {
+    this->lastError =
+        "Cannot bind to port "
+        + std::to_string(this->port)
+        + ": "
+        + std::string(strerror(errno));
+    goto fail;
+  }
+
+  if (listen(this->listenFd, SIGDIGGER_STREAMSERVER_BACKLOG) == -1) {
+    this->lastError = "Cannot listen: " + std::string(strerror(errno));
+    goto fail;
+  }
+
+  if ((this->epollFd = epoll_create1(EPOLL_CLOEXEC)) == -1
+      || (this->wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) == -1) {
+    this->lastError =
+        "Failed to set up the sender: " + std::string(strerror(errno));
+    goto fail;
+  }
+
+  memset(&ev, 0, sizeof(struct epoll_event));
+  ev.events = EPOLLIN;
+
+  ev.data.fd = this->listenFd;
+  if (epoll_ctl(this->epollFd, EPOLL_CTL_ADD, this->listenFd, &ev) == -1)
+    goto epoll_fail;
+
+  ev.data.fd = this->wakeFd;
+  if (epoll_ctl(this->epollFd, EPOLL_CTL_ADD, this->wakeFd, &ev) == -1)
+    goto epoll_fail;
+
+  this->running = true;
+  this->sender = std::thread(&StreamServerWriter::senderLoop, this);
+  this->listening = true;
+
+  return true;
+
+epoll_fail:
+  this->lastError =
+      "Failed to set up the sender: " + std::string(strerror(errno));
+
+fail:
+  this->shutdown();
+  return false;
+#else
+  this->lastError = "TCP server mode is not available on this platform";
+  return false;
+#endif // SIGDIGGER_HAVE_EPOLL
+}
+
+std::string
+StreamServerWriter::getError(void) const
+{
+  return this->lastError;
+}
+
+bool
+StreamServerWriter::canWrite(void) const
+{
+  return !this->listening || this->listenFd != -1;
+}
+
+//
+// Packs the write once for everybody. Clients with an empty queue always
+// take the chunk, so a write larger than the budget does not starve them.
+//
+ssize_t
+StreamServerWriter::write(const SUCOMPLEX *data, size_t len)
+{
+  std::shared_ptr<std::vector<uint8_t>> buffer;
+  NetFrameHeader header;
+  unsigned int i, frames = 0;
+  size_t chunk, done = 0, bytes, count;
+  const uint8_t *samples;
+  uint8_t *p;
+  bool listeners;
+
+  count = this->condition(data, len, samples);
+  if (count == 0)
+    return static_cast<ssize_t>(len);
+
+  if (this->framed)
+    frames = static_cast<unsigned int>((count + this->size - 1) / this->size);
+
+  bytes = count * this->sampleBytes + frames * sizeof(NetFrameHeader);
+  buffer = std::make_shared<std::vector<uint8_t>>(bytes);
+  p = buffer->data();
+
+  if (this->framed) {
+    for (i = 0; i < frames; ++i) {
+      chunk = std::min<size_t>(this->size, count - done);
+      this->fillHeader(&header, i, done, chunk);
+      memcpy(p, &header, sizeof(NetFrameHeader));
+      memcpy(
+            p + sizeof(NetFrameHeader),
+            samples + done * this->sampleBytes,
+            chunk * this->sampleBytes);
+      p    += sizeof(NetFrameHeader) + chunk * this->sampleBytes;
+      done += chunk;
+    }
+  } else {
+    memcpy(p, samples, bytes);
+  }
+
+  this->advance(frames, count);
+
+  {
+    std::lock_guard<std::mutex> guard(this->clientMutex);
+    Chunk shared = buffer;
+
+    for (auto &c : this->clients) {
+      Client *client = c.second.get();
+
+      if (client->closing)
+        continue;
+
+      if (client->queued > 0 && client->queued + bytes > this->queueBytes) {
+        if (this->policy == SLOW_CLIENT_DISCONNECT) {
+          client->closing = true;
+          ++this->disconnected;
+        } else {
+          ++this->skipped;
+        }
+        continue;
+      }
+
+      client->queue.push_back(shared);
+      client->queued += bytes;
+    }
+
+    listeners = !this->clients.empty();
+  }
+
+  if (listeners)
+    this->wake();
+
+  return static_cast<ssize_t>(len);
+}
+
+bool
+StreamServerWriter::close(void)
+{
+  this->shutdown();
+
+  return true;
+}
+
+StreamServerWriter::~StreamServerWriter()
+{
+  this->shutdown();
+}
@@ -42,6 +42,18 @@ UIMediator::connectFftPanel(void)
         this,
         SLOT(onAveragerChanged(void)));
 
+  connect(
+        this->ui->fftPanel,
+        SIGNAL(tracesReset(void)),
+        this,
+        SLOT(onTracesReset(void)));
+
+  connect(
+        this->spectrumProcessor,
+        SIGNAL(spectrumChanged(void)),
+        this,
+        SLOT(onSpectrumChanged(void)));
+
   connect(
         this->ui->fftPanel,
         SIGNAL(fftSizeChanged(void)),
@@ -54,6 +66,12 @@ UIMediator::connectFftPanel(void)
         this,
         SLOT(onRefreshRateChanged(void)));
 
+  connect(
+        this->ui->fftPanel,
+        SIGNAL(displayRateChanged(void)),
+        this,
+        SLOT(onDisplayRateChanged(void)));
+
   connect(
         this->ui->fftPanel,
         SIGNAL(timeSpanChanged(void)),
@@ -72,6 +90,8 @@ UIMediator::onPaletteChanged(void)
 {
   this->ui->spectrum->setPaletteGradient(
         this->ui->fftPanel->getPaletteGradient());
+  this->ui->historyDialog->setPaletteGradient(
+        this->ui->fftPanel->getPaletteGradient());
 }
 
 void
@@ -86,6 +106,9 @@ UIMediator::onRangesChanged(void)
     this->ui->spectrum->setWfRange(
           this->ui->fftPanel->getWfRangeMin(),
           this->ui->fftPanel->getWfRangeMax());
+    this->ui->historyDialog->setRange(
+          this->ui->fftPanel->getWfRangeMin(),
+          this->ui->fftPanel->getWfRangeMax());
 
     this->ui->spectrum->setPanWfRatio(this->ui->fftPanel->getPanWfRatio());
     this->ui->spectrum->setZoom(this->ui->fftPanel->getFreqZoom());
@@ -99,7 +122,32 @@ UIMediator::onRangesChanged(void)
 void
 UIMediator::onAveragerChanged(void)
 {
-  this->averager.setAlpha(this->ui->fftPanel->getAveraging());
+  FftPanel *panel = this->ui->fftPanel;
+  SpectrumParams params;
+
+  // Holds taken with another detector are not comparable
+  if (panel->getDetector() != this->detector) {
+    this->detector = panel->getDetector();
+    this->spectrumProcessor->resetTraces();
+  }
+
+  params.alpha        = panel->getAveraging();
+  params.windowLength = panel->getMeanWindow();
+  params.percentile   = panel->getFloorPercentile();
+  params.detector     = this->detector;
+
+  params.traces[AVERAGER_TRACE_MAX_HOLD]    = panel->getMaxHoldTrace();
+  params.traces[AVERAGER_TRACE_MIN_HOLD]    = panel->getMinHoldTrace();
+  params.traces[AVERAGER_TRACE_WINDOW_MEAN] = panel->getMeanTrace();
+  params.traces[AVERAGER_TRACE_PERCENTILE]  = panel->getFloorTrace();
+
+  this->spectrumProcessor->setParams(params);
+}
+
+void
+UIMediator::onTracesReset(void)
+{
+  this->spectrumProcessor->resetTraces();
 }
 
 void
@@ -113,11 +161,16 @@ void
 UIMediator::onRefreshRateChanged(void)
 {
   this->appConfig->analyzerParams.psdUpdateInterval = 1.f / this->ui->fftPanel->getRefreshRate();
-  this->ui->spectrum->setExpectedRate(
-        static_cast<int>(this->ui->fftPanel->getRefreshRate()));
+  this->applyDisplayRate();
   emit analyzerParamsChanged();
 }
 
+void
+UIMediator::onDisplayRateChanged(void)
+{
+  this->applyDisplayRate();
+}
+
 void
 UIMediator::onTimeSpanChanged(void)
 {
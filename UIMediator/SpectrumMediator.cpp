@@ -66,6 +66,12 @@ UIMediator::connectSpectrum(void)
         SIGNAL(newBandPlan(QString)),
         this,
         SLOT(onNewBandPlan(QString)));
+
+  connect(
+        this->ui->spectrum,
+        SIGNAL(detectedChannelClicked(quint32)),
+        this,
+        SLOT(onOpenDetectedChannel(quint32)));
 }
 
 void
@@ -112,6 +118,7 @@ UIMediator::onRangeChanged(float min, float max)
 
     if (this->ui->fftPanel->getRangeLock()) {
       this->ui->spectrum->setWfRange(min, max);
+      this->ui->historyDialog->setRange(min, max);
       this->ui->fftPanel->setWfRangeMin(static_cast<int>(std::floor(min)));
       this->ui->fftPanel->setWfRangeMax(static_cast<int>(std::floor(max)));
     }
@@ -23,12 +23,19 @@
 #include <SuWidgetsHelpers.h>
 
 #include "UIMediator.h"
+#include "LatencyMonitor.h"
 
 #include <QGuiApplication>
+#include <QDir>
 #include <QDockWidget>
 #include <QMessageBox>
 #include <QScreen>
+#include <QStandardPaths>
+#include <sys/time.h>
 
+#include <cerrno>
+#include <cmath>
+#include <cstring>
 #include <fstream>
 
 using namespace SigDigger;
@@ -248,6 +255,48 @@ UIMediator::connectMainWindow(void)
         SIGNAL(triggered(bool)),
         this,
         SLOT(onTriggerPanoramicSpectrum(bool)));
+
+  connect(
+        this->ui->main->actionLatency,
+        SIGNAL(triggered(bool)),
+        this,
+        SLOT(onTriggerLatency(bool)));
+
+  connect(
+        this->ui->main->actionWaterfallHistory,
+        SIGNAL(triggered(bool)),
+        this,
+        SLOT(onTriggerWaterfallHistory(bool)));
+
+  connect(
+        this->ui->historyDialog,
+        SIGNAL(configChanged(void)),
+        this,
+        SLOT(onHistoryConfigChanged(void)));
+
+  connect(
+        this->ui->main->actionChannelDetector,
+        SIGNAL(triggered(bool)),
+        this,
+        SLOT(onTriggerChannelDetector(bool)));
+
+  connect(
+        this->ui->channelDialog,
+        SIGNAL(configChanged(void)),
+        this,
+        SLOT(onChannelDetectorConfigChanged(void)));
+
+  connect(
+        this->ui->channelDialog,
+        SIGNAL(openChannel(quint32)),
+        this,
+        SLOT(onOpenDetectedChannel(quint32)));
+
+  connect(
+        this->channelDetector,
+        SIGNAL(channelsChanged(void)),
+        this,
+        SLOT(onDetectedChannelsChanged(void)));
 }
 
 UIMediator::UIMediator(QMainWindow *owner, AppUI *ui)
@@ -255,6 +304,9 @@ UIMediator::UIMediator(QMainWindow *owner, AppUI *ui)
   this->owner = owner;
   this->ui = ui;
 
+  this->channelDetector = new ChannelDetector(this);
+  this->spectrumProcessor = new SpectrumProcessor(this);
+
   // Configure audio preview
   this->audioPanelDock = new QDockWidget("Audio preview", owner);
   this->audioPanelDock->setWidget(this->ui->audioPanel);
@@ -356,6 +408,11 @@ void
 UIMediator::setState(State state)
 {
   this->state = state;
+
+  // Channels from a previous run are of no use in the next one
+  if (state == HALTED)
+    this->channelDetector->reset();
+
   this->refreshUI();
 }
 
@@ -452,11 +509,152 @@ UIMediator::shouldReduceRate(
 void
 UIMediator::feedPSD(const Suscan::PSDMessage &msg)
 {
+  LatencyMonitor *monitor = LatencyMonitor::instance();
+  size_t bins = 0;
+  qint64 now;
+  struct timeval tv;
+
+  monitor->record(
+        LATENCY_STAGE_PSD_QUEUE,
+        msg.getDispatchTime() - msg.getReadTime());
+
   this->setSampleRate(msg.getSampleRate());
-  this->averager.feed(msg);
+
+  if (this->history.isOpen())
+    this->pushHistory(msg);
+
+  // Full resolution: the detector shares the buffer, it does not copy it
+  if (this->appConfig->detectChannels) {
+    gettimeofday(&tv, nullptr);
+    this->channelDetector->feed(msg, tv.tv_sec * 1000000ll + tv.tv_usec);
+    this->detectorFrequency = msg.getFrequency();
+  }
+
+  // Every frame goes through the averager and the history. Only some of
+  // them make it to the screen, one at a time: the next one is not asked
+  // for until the processor has handed back the previous one.
+  now = LatencyMonitor::now();
+  if (!this->drawPending
+      && this->governor.shouldDraw(now, now - msg.getReadTime())) {
+    bins = this->ui->spectrum->getDisplayBins();
+    if (bins == 0)
+      bins = msg.size(); // Full resolution
+    this->drawPending = true;
+  }
+
+  // Averaging and traces run on the whole frame, in the processor thread.
+  // Its size only changes with the FFT size, so zooming or resizing keeps
+  // them.
+  this->spectrumProcessor->feed(msg, bins);
+
+  if (this->governor.updateStats(now))
+    this->ui->fftPanel->setDisplayStats(
+          this->governor.getFPS(),
+          this->governor.getSkipRate());
+}
+
+// Already reduced to what the current zoom can show
+void
+UIMediator::drawPSD(void)
+{
+  SpectrumFrame const &frame = this->spectrumProcessor->getFrame();
+  AveragerTrace trace;
+  int i;
+
+  if (frame.size == 0)
+    return;
+
   this->ui->spectrum->feed(
-        this->averager.get(),
-        static_cast<int>(this->averager.size()));
+        const_cast<float *>(frame.average.data()),
+        static_cast<int>(frame.size));
+
+  for (i = 0; i < AVERAGER_TRACE_COUNT; ++i) {
+    trace = static_cast<AveragerTrace>(i);
+    this->ui->spectrum->feedTrace(
+          trace,
+          frame.valid[i] ? frame.traces[i].data() : nullptr,
+          static_cast<int>(frame.size));
+  }
+}
+
+void
+UIMediator::onSpectrumChanged(void)
+{
+  LatencyMonitor *monitor = LatencyMonitor::instance();
+  SpectrumFrame const &frame = this->spectrumProcessor->getFrame();
+  qint64 start, end;
+
+  this->drawPending = false;
+
+  start = LatencyMonitor::now();
+  this->drawPSD();
+  end = LatencyMonitor::now();
+  this->governor.drawn(start, end);
+
+  monitor->recordSince(LATENCY_STAGE_PSD_RENDER, frame.dispatchTime);
+  monitor->recordSince(LATENCY_STAGE_PSD_TOTAL, frame.readTime);
+}
+
+// The waterfall scrolls at whatever ends up being drawn
+void
+UIMediator::applyDisplayRate(void)
+{
+  unsigned int analysisRate = this->ui->fftPanel->getRefreshRate();
+  unsigned int displayRate = this->ui->fftPanel->getDisplayRate();
+  qreal maxRate = displayRate;
+  QScreen *screen;
+
+  if (displayRate == 0) {
+    screen = QGuiApplication::primaryScreen();
+    maxRate = screen != nullptr ? screen->refreshRate() : 0;
+  }
+
+  this->governor.setMaxRate(maxRate);
+
+  if (maxRate > 0 && maxRate < analysisRate)
+    this->ui->spectrum->setExpectedRate(static_cast<int>(maxRate));
+  else
+    this->ui->spectrum->setExpectedRate(static_cast<int>(analysisRate));
+}
+
+CFARParams
+UIMediator::getChannelDetectorParams(void) const
+{
+  CFARParams params;
+
+  params.method = this->appConfig->cfarMethod == CFAR_ORDERED_STATISTIC
+      ? CFAR_ORDERED_STATISTIC
+      : CFAR_CELL_AVERAGING;
+  params.threshold = this->appConfig->cfarThreshold;
+  params.hysteresis = this->appConfig->cfarHysteresis;
+  params.referenceCells = this->appConfig->cfarWindow;
+
+  return params;
+}
+
+// Peak detector, a few thousand bins: it is about spotting bursts later.
+// Only the levels of that detector, down to that size, are computed.
+void
+UIMediator::pushHistory(const Suscan::PSDMessage &msg)
+{
+  size_t size = msg.size();
+  const float *data;
+  struct timeval tv;
+
+  gettimeofday(&tv, nullptr);
+
+  data = this->historyPyramid.reduce(
+        msg.get(),
+        size,
+        SIGDIGGER_WF_HISTORY_MAX_BINS / 2,
+        PSD_DETECTOR_PEAK);
+
+  this->history.push(
+        data,
+        static_cast<unsigned int>(size),
+        tv.tv_sec * 1000000ll + tv.tv_usec,
+        msg.getFrequency(),
+        msg.getSampleRate());
 }
 
 void
@@ -465,6 +663,24 @@ UIMediator::setCaptureSize(quint64 size)
   this->ui->sourcePanel->setCaptureSize(size);
 }
 
+void
+UIMediator::setClipCount(quint64 count)
+{
+  this->ui->sourcePanel->setClipCount(count);
+}
+
+void
+UIMediator::setHistoryMemory(quint64 bytes)
+{
+  this->ui->sourcePanel->setHistoryMemory(bytes);
+}
+
+void
+UIMediator::setCaptureHeadroom(qreal seconds, quint64 memory)
+{
+  this->ui->sourcePanel->setCaptureHeadroom(seconds, memory);
+}
+
 Inspector *
 UIMediator::lookupInspector(Suscan::InspectorId handle) const
 {
@@ -709,8 +925,6 @@ UIMediator::applyConfig(void)
   this->ui->configDialog->setColors(this->appConfig->colors);
   this->ui->panoramicDialog->setColors(this->appConfig->colors);
   this->ui->spectrum->setColorConfig(this->appConfig->colors);
-  this->ui->spectrum->setExpectedRate(
-        static_cast<int>(1.f / this->appConfig->analyzerParams.psdUpdateInterval));
   this->ui->inspectorPanel->setColorConfig(this->appConfig->colors);
   this->ui->fftPanel->setWindowFunction(this->appConfig->analyzerParams.windowFunction);
   this->ui->fftPanel->setFftSize(this->appConfig->analyzerParams.windowSize);  
@@ -718,6 +932,10 @@ UIMediator::applyConfig(void)
         static_cast<unsigned int>(1.f / this->appConfig->analyzerParams.psdUpdateInterval));
   this->ui->fftPanel->setDefaultFftSize(SIGDIGGER_FFT_WINDOW_SIZE);
   this->ui->fftPanel->setDefaultRefreshRate(SIGDIGGER_FFT_REFRESH_RATE);
+  this->ui->historyDialog->setRecording(this->appConfig->wfHistory);
+  this->ui->historyDialog->setHistorySize(this->appConfig->wfHistorySize);
+  this->ui->channelDialog->setDetecting(this->appConfig->detectChannels);
+  this->ui->channelDialog->setParams(this->getChannelDetectorParams());
 
   // Apply enabled bandplans
   for (auto p : this->appConfig->enabledBandPlans)
@@ -736,6 +954,7 @@ UIMediator::applyConfig(void)
   this->ui->inspectorPanel->applyConfig();
   this->ui->audioPanel->applyConfig();
   this->ui->panoramicDialog->applyConfig();
+  this->applyDisplayRate();
 
   this->refreshProfile();
 
@@ -750,6 +969,8 @@ UIMediator::applyConfig(void)
   this->onAveragerChanged();
   this->onThrottleConfigChanged();
   this->onTimeSpanChanged();
+  this->onHistoryConfigChanged();
+  this->onChannelDetectorConfigChanged();
 }
 
 UIMediator::~UIMediator()
@@ -986,6 +1207,117 @@ UIMediator::onTriggerDevices(bool)
   this->ui->deviceDialog->run();
 }
 
+void
+UIMediator::onTriggerLatency(bool)
+{
+  this->ui->latencyDialog->show();
+  this->ui->latencyDialog->raise();
+}
+
+void
+UIMediator::onTriggerWaterfallHistory(bool)
+{
+  this->ui->historyDialog->show();
+  this->ui->historyDialog->raise();
+}
+
+void
+UIMediator::onHistoryConfigChanged(void)
+{
+  WaterfallHistoryDialog *dialog = this->ui->historyDialog;
+  QString dir = QStandardPaths::writableLocation(
+        QStandardPaths::CacheLocation);
+  QString path = dir + "/" SIGDIGGER_WF_HISTORY_FILE_NAME;
+  quint64 size;
+
+  this->appConfig->wfHistory = dialog->getRecording();
+  this->appConfig->wfHistorySize = dialog->getHistorySize();
+  size = static_cast<quint64>(this->appConfig->wfHistorySize) << 20;
+
+  if (!this->appConfig->wfHistory) {
+    this->history.close();
+  } else if (this->history.getCapacity() != size) {
+    // A new size starts the history over
+    if (!QDir().mkpath(dir) || !this->history.open(path.toStdString(), size)) {
+      this->appConfig->wfHistory = false;
+      dialog->setRecording(false);
+      QMessageBox::warning(
+            this->owner,
+            "Waterfall history",
+            "Cannot allocate the history file " + path + ": "
+            + QString(strerror(errno)),
+            QMessageBox::Ok);
+    }
+  }
+
+  dialog->setHistory(&this->history);
+}
+
+void
+UIMediator::onTriggerChannelDetector(bool)
+{
+  this->ui->channelDialog->show();
+  this->ui->channelDialog->raise();
+}
+
+void
+UIMediator::onChannelDetectorConfigChanged(void)
+{
+  ChannelListDialog *dialog = this->ui->channelDialog;
+  CFARParams params = dialog->getParams();
+
+  this->appConfig->detectChannels = dialog->getDetecting();
+  this->appConfig->cfarMethod = static_cast<int>(params.method);
+  this->appConfig->cfarThreshold = params.threshold;
+  this->appConfig->cfarHysteresis = params.hysteresis;
+  this->appConfig->cfarWindow = params.referenceCells;
+
+  this->channelDetector->setParams(params);
+
+  // Clears the overlay too
+  if (!this->appConfig->detectChannels)
+    this->channelDetector->reset();
+}
+
+void
+UIMediator::onDetectedChannelsChanged(void)
+{
+  std::vector<DetectedChannel> const &channels =
+      this->channelDetector->getChannels();
+
+  this->ui->spectrum->setDetectedChannels(channels, this->detectorFrequency);
+  this->ui->channelDialog->setChannels(
+        channels,
+        this->ui->spectrum->getCenterFreq() - this->detectorFrequency);
+  this->ui->channelDialog->setStats(
+        this->channelDetector->getCost(),
+        this->channelDetector->getProcessedCount(),
+        this->channelDetector->getDroppedCount());
+}
+
+// Tune the filter to the channel and open an inspector on it
+void
+UIMediator::onOpenDetectedChannel(quint32 id)
+{
+  DetectedChannel channel;
+  qreal bw;
+
+  if (!this->channelDetector->findChannel(id, channel))
+    return;
+
+  bw = std::ceil(channel.bandwidth * SIGDIGGER_UI_MEDIATOR_CHANNEL_MARGIN);
+  if (this->rate > 0 && bw > this->rate)
+    bw = this->rate;
+
+  this->ui->spectrum->setLoFreq(
+        static_cast<qint64>(
+          std::round(channel.frequency - this->detectorFrequency)));
+  this->ui->spectrum->setFilterBandwidth(static_cast<unsigned int>(bw));
+  this->onSpectrumBandwidthChanged();
+
+  emit requestOpenInspector();
+}
+
 void
 UIMediator::onTriggerClear(bool)
 {
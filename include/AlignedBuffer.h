@@ -0,0 +1,50 @@
+//
+//    AlignedBuffer.h: Reusable SIMD-aligned float buffer
+//    Copyright (C) 2020 Gonzalo José Carracedo Carballal
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as
+//    published by the Free Software Foundation, either version 3 of the
+//    License, or (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful, but
+//    WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public
+//    License along with this program.  If not, see
+//    <http://www.gnu.org/licenses/>
+//
+
+#ifndef ALIGNEDBUFFER_H
+#define ALIGNEDBUFFER_H
+
+#include <cstddef>
+#include <memory>
+
+#define SIGDIGGER_ALIGNED_BUFFER_ALIGNMENT 32
+
+namespace SigDigger {
+  // Float array aligned to SIGDIGGER_ALIGNED_BUFFER_ALIGNMENT. Only grows.
+  class AlignedBuffer {
+    std::unique_ptr<char[]> storage;
+    float *data = nullptr;
+    size_t capacity = 0;
+
+  public:
+    // Floats to skip so that the next array starts aligned too
+    static size_t stride(size_t size);
+
+    void reserve(size_t size);
+    void release(void);
+
+    float *
+    get(void) const
+    {
+      return this->data;
+    }
+  };
+}
+
+#endif // ALIGNEDBUFFER_H
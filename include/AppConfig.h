@@ -64,6 +64,15 @@ namespace SigDigger {
       int loFreq = 0;
       unsigned int bandwidth = 0;
 
+      bool wfHistory = false;
+      unsigned int wfHistorySize = SIGDIGGER_WF_HISTORY_DEFAULT_SIZE; // MiB
+
+      bool detectChannels = false;
+      int cfarMethod = 0; // CFARMethod
+      float cfarThreshold = 8; // dB
+      float cfarHysteresis = 3; // dB
+      unsigned int cfarWindow = 64; // bins
+
       std::vector<std::string> enabledBandPlans;
 
       // Methods
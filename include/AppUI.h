@@ -34,6 +34,9 @@
 #include "ui_MainWindow.h"
 #include "ConfigDialog.h"
 #include "DeviceDialog.h"
+#include "LatencyDialog.h"
+#include "WaterfallHistoryDialog.h"
+#include "ChannelListDialog.h"
 #include "PanoramicDialog.h"
 
 namespace SigDigger {
@@ -42,6 +45,9 @@ namespace SigDigger {
     ConfigDialog *configDialog = nullptr;
     DeviceDialog *deviceDialog = nullptr;
     PanoramicDialog *panoramicDialog = nullptr;
+    LatencyDialog *latencyDialog = nullptr;
+    WaterfallHistoryDialog *historyDialog = nullptr;
+    ChannelListDialog *channelDialog = nullptr;
     MainSpectrum *spectrum = nullptr;
     SourcePanel *sourcePanel = nullptr;
     InspectorPanel *inspectorPanel = nullptr;
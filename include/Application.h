@@ -20,6 +20,7 @@
 #ifndef APPLICATION_H
 #define APPLICATION_H
 
+#include <mutex>
 #include <Suscan/Source.h>
 #include <Suscan/Analyzer.h>
 
@@ -28,6 +29,9 @@
 #include "UIMediator.h"
 #include "AudioPlayback.h"
 #include "FileDataSaver.h"
+#include "TimeMachine.h"
+#include "Channelizer.h"
+#include "SigMFMetadataWriter.h"
 #include "AudioFileSaver.h"
 #include "Scanner.h"
 
@@ -55,7 +59,20 @@ namespace SigDigger {
 
     // Suscan core object
     std::unique_ptr<Suscan::Analyzer> analyzer = nullptr;
+    std::shared_ptr<SampleFanout> fanout = nullptr;
+    std::unique_ptr<TimeMachine> timeMachine = nullptr;
     std::unique_ptr<FileDataSaver> dataSaver = nullptr;
+    std::unique_ptr<SigMFMetadataWriter> metadataWriter = nullptr;
+    std::string capturePath;
+    SampleFormat captureFormat = SAMPLE_FORMAT_CF32;
+    quint64 segmentSamples = 0;
+    unsigned int metadataSegment = 0;
+    quint64 droppedSamples = 0;
+    std::unique_ptr<SampleConverter> channelConverter = nullptr;
+    std::unique_ptr<Channelizer> channelizer = nullptr;
+    std::vector<std::unique_ptr<SigMFMetadataWriter>> channelMetadata;
+    std::vector<qreal> channelOffsets;
+    quint64 channelDropped = 0;
     std::unique_ptr<AudioFileSaver> audioFileSaver = nullptr;
 
     bool profileSelected = false;
@@ -66,7 +83,9 @@ namespace SigDigger {
     AppUI ui;
     UIMediator *mediator = nullptr;
 
-    // Audio
+    // Audio. Sample batches are written from the analyzer async thread:
+    // replace playBack and audioFileSaver under audioMutex only.
+    std::mutex audioMutex;
     std::unique_ptr<AudioPlayback> playBack = nullptr;
     Suscan::Handle audioInspHandle = 0;
     unsigned int audioSampleRate = 0;
@@ -100,15 +119,28 @@ namespace SigDigger {
     void connectUI(void);
     void connectAnalyzer(void);
     void connectDataSaver(void);
+    void connectChannelizer(void);
     void connectAudioFileSaver(void);
     void connectDeviceDetect(void);
     void connectScanner(void);
 
     int  openCaptureFile(void);
     void installDataSaver(int fd);
+    void installMetadataWriter(unsigned int segment);
+    std::string captureStem(unsigned int segment) const;
+    quint64 getSegmentSamples(void) const;
+    quint64 metadataPosition(quint64 position);
     void uninstallDataSaver(void);
+    bool installChannelizer(std::vector<qreal> const &freqs);
+    void uninstallChannelizer(void);
+    void installBaseBandFilter(void);
+    void installFanout(void);
+    void uninstallFanout(void);
     bool openAudioFileSaver(void);
     void closeAudioFileSaver(void);
+    void setAudioFileSaver(std::unique_ptr<AudioFileSaver> saver);
+    void setPlayBack(std::unique_ptr<AudioPlayback> playBack);
+    void feedAudio(const SUCOMPLEX *samples, SUSCOUNT count, qint64 readTime);
     void setAudioInspectorParams(
         unsigned int rate,
         SUFLOAT cutOff,
@@ -132,7 +164,7 @@ namespace SigDigger {
     bool openAudio(unsigned int rate);
     void closeAudio(void);
 
-    FileDataSaver *getSaver(void) const;
+    SampleFanout *getFanout(void) const;
 
     explicit Application(QWidget *parent = nullptr);
     ~Application();
@@ -183,7 +215,16 @@ namespace SigDigger {
     void onSaveError(void);
     void onSaveSwamped(void);
     void onSaveRate(qreal rate);
+    void onSaveHeadroom(qreal seconds);
     void onCommit(void);
+    void onSaveDropped(quint64 position, quint64 count);
+    void onMetadataError(QString);
+
+    // Channelizer slots
+    void onChannelizerError(void);
+    void onChannelizerCommit(void);
+    void onChannelizerDropped(quint64 position, quint64 count);
+    void onChannelMetadataError(QString);
 
     // AudioFileSaver slots
     void onAudioSaveError(void);
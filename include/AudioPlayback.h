@@ -24,6 +24,7 @@
 #include <QMutex>
 #include <QThread>
 #include <string>
+#include <atomic>
 #include <Suscan/Library.h>
 #include <unistd.h>
 
@@ -65,6 +66,7 @@ namespace SigDigger {
     AudioBuffer *next = nullptr;
     AudioBuffer *prev = nullptr;
     float *data = nullptr;
+    qint64 time = 0; // When committed, see LatencyMonitor::now()
 
     AudioBuffer();
     ~AudioBuffer();
@@ -131,12 +133,19 @@ namespace SigDigger {
     QThread *workerThread  = nullptr;
     PlaybackWorker *worker = nullptr;
 
+    // Shared by write() (analyzer async thread) and onError()
+    std::atomic<bool> failed{false};
+
+    // buffering and completed change together, under stateMutex. Buffers
+    // are committed under it too, so onStarving() (GUI thread) sees the
+    // play list and the counter in agreement.
+    QMutex stateMutex;
     bool buffering = true;
-    bool failed = false;
+    unsigned int completed = 0;
+
     float *current_buffer = nullptr;
     GenericAudioPlayer *player = nullptr;
 
-    unsigned int completed = 0;
     unsigned int ptr = 0;
     unsigned int sampRate;
 
@@ -1,5 +1,5 @@
 //
-//    Averager.h: Simple PSD averager
+//    Averager.h: PSD averager and spectrum traces
 //    Copyright (C) 2018 Gonzalo José Carracedo Carballal
 //
 //    This program is free software: you can redistribute it and/or modify
@@ -20,22 +20,78 @@
 #define AVERAGER_H
 
 #include <Suscan/Messages/PSDMessage.h>
+#include "AlignedBuffer.h"
+
+#define SIGDIGGER_AVERAGER_DEFAULT_WINDOW   16
+#define SIGDIGGER_AVERAGER_MAX_WINDOW       256
+#define SIGDIGGER_AVERAGER_MAX_WINDOW_BINS  (16 << 20) // 64 MiB of history
+#define SIGDIGGER_AVERAGER_PERCENTILE_STEP  .5f        // dB per frame
 
 namespace SigDigger {
+  // Traces computed next to the exponential average, on demand
+  enum AveragerTrace {
+    AVERAGER_TRACE_MAX_HOLD,    // Highest level since reset
+    AVERAGER_TRACE_MIN_HOLD,    // Lowest level since reset
+    AVERAGER_TRACE_WINDOW_MEAN, // Mean of the last N frames
+    AVERAGER_TRACE_PERCENTILE,  // Running percentile (noise floor)
+    AVERAGER_TRACE_COUNT
+  };
+
+  //
+  // Everything is done on dB values, as they come from PSDMessage. The
+  // window mean is therefore a mean of logs, same as the exponential
+  // average always was. Every trace is a single pass over the frame,
+  // 4 bins at a time with SSE2 or NEON. Buffers are kept across size
+  // changes and only reallocated when they need to grow.
+  //
   class Averager {
-    float *last = nullptr;
+    AlignedBuffer average;
+    AlignedBuffer traces[AVERAGER_TRACE_COUNT];
+    AlignedBuffer history; // windowLength frames, for the window mean
+    AlignedBuffer windowSum;
     unsigned long bufsiz = 0;
     float alpha = 1.;
 
+    bool enabled[AVERAGER_TRACE_COUNT] = {false, false, false, false};
+    bool valid[AVERAGER_TRACE_COUNT] = {false, false, false, false};
+
+    unsigned int windowLength = SIGDIGGER_AVERAGER_DEFAULT_WINDOW;
+    unsigned int windowFill = 0;   // Frames in history, up to windowLength
+    unsigned int windowPos = 0;    // Next slot of history to replace
+    float percentile = .1f;
+
+    unsigned int effectiveWindow(void) const;
+    void resetWindow(void);
+    void feedTrace(AveragerTrace trace, const float *data);
+
   public:
     void feed(Suscan::PSDMessage const &m);
+    void feed(const float *data, unsigned long size);
     void setAlpha(float alpha);
-    ~Averager(void);
 
+    void setTraceEnabled(AveragerTrace trace, bool enabled);
+    void setWindowLength(unsigned int frames);
+    void setPercentile(float percentile); // In (0, 1)
+    void resetTraces(void);
+
+    // Exponential average
     float *
     get(void) const
     {
-      return this->last;
+      return this->bufsiz > 0 ? this->average.get() : nullptr;
+    }
+
+    // nullptr if the trace is disabled or has no data yet
+    const float *
+    get(AveragerTrace trace) const
+    {
+      return this->valid[trace] ? this->traces[trace].get() : nullptr;
+    }
+
+    bool
+    isTraceEnabled(AveragerTrace trace) const
+    {
+      return this->enabled[trace];
     }
 
     unsigned long
@@ -44,13 +100,12 @@ namespace SigDigger {
       return this->bufsiz;
     }
 
+    // Starts over with the next frame. Memory is kept.
     void
     reset(void)
     {
-      if (this->last != nullptr) {
-        delete [] this->last;
-        this->bufsiz = 0;
-      }
+      this->bufsiz = 0;
+      this->resetTraces();
     }
   };
 }
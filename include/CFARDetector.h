@@ -0,0 +1,135 @@
+//
+//    CFARDetector.h: Finds and tracks carriers in PSD frames
+//    Copyright (C) 2020 Gonzalo José Carracedo Carballal
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as
+//    published by the Free Software Foundation, either version 3 of the
+//    License, or (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful, but
+//    WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public
+//    License along with this program.  If not, see
+//    <http://www.gnu.org/licenses/>
+//
+
+#ifndef CFARDETECTOR_H
+#define CFARDETECTOR_H
+
+#include <QtGlobal>
+#include <cstdint>
+#include <vector>
+#include "AlignedBuffer.h"
+
+#define SIGDIGGER_CFAR_MAX_DETECTIONS 1024 // Per frame, the rest is noise
+#define SIGDIGGER_CFAR_OS_QUANTUM      .1f  // dB, ordered statistic
+#define SIGDIGGER_CFAR_OS_HISTOGRAM    4096 // Cells, wider ranges get coarser
+
+namespace SigDigger {
+  enum CFARMethod {
+    CFAR_CELL_AVERAGING,
+    CFAR_ORDERED_STATISTIC
+  };
+
+  struct CFARParams {
+    CFARMethod method = CFAR_CELL_AVERAGING;
+    unsigned int guardCells = 4;      // Each side
+    unsigned int referenceCells = 64; // Each side
+    float rank = .75f;                // Ordered statistic, of the reference
+    float threshold = 8;              // dB over the noise to start
+    float hysteresis = 3;             // dB below threshold to keep going
+    float integration = .1f;          // Per bin, across frames. 1: none.
+    unsigned int mergeGap = 2;        // Bins between parts of one carrier
+    unsigned int confirm = 3;         // Frames before it is reported
+    qint64 holdTime = 1000000;        // usec unseen before it is dropped
+  };
+
+  struct DetectedChannel {
+    quint32 id = 0;
+    qreal frequency = 0; // Hz, center, as the frames' frequency
+    qreal bandwidth = 0; // Hz
+    float snr = 0;       // dB, mean in-band power over the noise
+    float peak = 0;      // dB
+    qint64 firstSeen = 0; // usec, as the frame times
+    qint64 lastSeen = 0;
+    unsigned int hits = 0;
+    bool present = false; // In the last frame
+  };
+
+  //
+  // Cell-averaging or ordered-statistic CFAR over PSD frames in dB (DC in
+  // the middle). Bins are integrated across frames first. A bin is a
+  // candidate if it stands above the noise of its reference cells by
+  // threshold - hysteresis dB. Runs of candidates become a detection if
+  // one of their bins goes over threshold, or if they overlap what was
+  // detected in the previous frame: the same hysteresis holds in
+  // frequency and in time. Nothing is detected until about 1 /
+  // params.integration frames have been integrated.
+  //
+  // Both noise estimates are O(n) whatever the window. Cell averaging (in
+  // dB, so the noise is a geometric mean) works on prefix sums. Ordered
+  // statistic keeps a histogram of the window, quantized to
+  // SIGDIGGER_CFAR_OS_QUANTUM dB, and copes better with nearby carriers.
+  // Integration, cell averaging and quantization do 4 to 8 bins at a
+  // time with SSE2 or NEON, classification 16.
+  //
+  // Detections are matched to tracks by frequency overlap. Tracks are
+  // reported after params.confirm frames and dropped params.holdTime
+  // after they were last seen. Not thread safe.
+  //
+  class CFARDetector {
+    CFARParams params;
+
+    size_t size = 0;
+    unsigned int frames = 0; // Since the integration started
+    qreal frequency = 0;
+    qreal sampleRate = 0;
+
+    AlignedBuffer level; // Integrated frame, dB
+    AlignedBuffer noise; // dB
+    std::vector<double> prefix;
+    std::vector<uint16_t> quantized;
+    std::vector<unsigned int> histogram;
+    std::vector<uint8_t> codes;  // 0: below, 1: candidate, 2: detection
+    std::vector<uint8_t> active; // Bins detected in the previous frame
+
+    std::vector<DetectedChannel> detections;
+    std::vector<DetectedChannel> tracks; // By frequency
+    std::vector<DetectedChannel> merged;
+    quint32 lastId = 0;
+
+    void estimateCellAveraging(void);
+    void estimateOrderedStatistic(void);
+    void findRegions(void);
+    void measure(size_t start, size_t end);
+    void track(qint64 time);
+
+  public:
+    void setParams(CFARParams const &);
+
+    CFARParams const &
+    getParams(void) const
+    {
+      return this->params;
+    }
+
+    // Forgets the integrated frame and every track
+    void reset(void);
+
+    void feed(
+        const float *data,
+        size_t size,
+        qreal frequency,
+        qreal sampleRate,
+        qint64 time);
+
+    // Confirmed tracks, by frequency
+    void getChannels(std::vector<DetectedChannel> &) const;
+  };
+}
+
+#endif // CFARDETECTOR_H
@@ -0,0 +1,148 @@
+//
+//    CaptureIndexWriter.h: Seek index and power summary of a capture
+//    Copyright (C) 2020 Gonzalo José Carracedo Carballal
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as
+//    published by the Free Software Foundation, either version 3 of the
+//    License, or (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful, but
+//    WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public
+//    License along with this program.  If not, see
+//    <http://www.gnu.org/licenses/>
+//
+
+#ifndef CAPTUREINDEXWRITER_H
+#define CAPTUREINDEXWRITER_H
+
+#include "GenericDataSaver.h"
+#include <cstdint>
+
+#define SIGDIGGER_CAPTURE_INDEX_EXTENSION     ".sigdigger-index"
+#define SIGDIGGER_CAPTURE_INDEX_MAGIC         "SDINDEX"
+#define SIGDIGGER_CAPTURE_INDEX_VERSION       1
+#define SIGDIGGER_CAPTURE_INDEX_DEFAULT_BINS  64
+#define SIGDIGGER_CAPTURE_INDEX_RECORDS_PER_SECOND 8
+#define SIGDIGGER_CAPTURE_INDEX_MAX_SPECTRA   256 // FFTs per record
+#define SIGDIGGER_CAPTURE_INDEX_FLOOR_DB      -127.5
+
+namespace SigDigger {
+  //
+  // Sidecar layout, little endian. A header, then one record every
+  // recordSamples samples (the last one may be shorter):
+  //
+  //   Header                         Record
+  //   char     magic[8]              uint64_t position   (sample offset)
+  //   uint32_t version               int64_t  time       (usec, UTC)
+  //   uint32_t bins                  uint32_t count      (samples)
+  //   uint64_t recordSamples         float    minPower   (dBFS)
+  //   double   sampleRate            float    meanPower  (dBFS)
+  //   uint64_t segmentSamples        float    maxPower   (dBFS)
+  //   int64_t  startTime (usec, UTC) uint8_t  spectrum[bins]
+  //   uint32_t recordSize
+  //   uint32_t reserved
+  //
+  // Positions count samples from the start of the capture. If the capture
+  // rolls over, each segment gets its own sidecar (named after it, see
+  // RotatingFileDataWriter::segmentStem) and records do not cross segment
+  // boundaries, so sidecars can be removed along with their segments. The
+  // segment of a record is position / segmentSamples. Min and max are
+  // taken over windows of `bins' samples. The spectrum is an average of
+  // Hann-windowed FFTs with negative frequencies first, in steps of 0.5 dB
+  // above -127.5 dBFS.
+  //
+  struct CaptureIndexHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t bins;
+    uint64_t recordSamples;
+    double sampleRate;
+    uint64_t segmentSamples;
+    int64_t startTime;
+    uint32_t recordSize;
+    uint32_t reserved;
+  };
+
+  struct CaptureIndexRecord {
+    uint64_t position;
+    int64_t time;
+    uint32_t count;
+    float minPower;
+    float meanPower;
+    float maxPower;
+  };
+
+  //
+  // Wraps the writer of a capture and summarizes whatever goes through
+  // it, in the writer thread. The index is best effort: if the sidecar
+  // cannot be written, indexing stops and the capture goes on.
+  //
+  class CaptureIndexWriter : public GenericDataWriter {
+  public:
+    struct Params {
+      std::string stem; // Of the capture
+      qreal sampleRate = 0;
+      quint64 recordSamples = 0; // Rounded up to a multiple of bins
+      quint64 segmentSamples = 0;
+      unsigned int bins = SIGDIGGER_CAPTURE_INDEX_DEFAULT_BINS;
+    };
+
+  private:
+    GenericDataWriter *writer;
+    Params params;
+    int fd = -1;
+    unsigned int segment = 0;
+    bool prepared = false;
+    bool stopped = false;
+
+    quint64 position = 0;
+    quint64 refPosition = 0;
+    qint64 refTime = 0;
+
+    // Current record
+    quint64 recordStart = 0;
+    quint64 recordCount = 0;
+    qreal powerSum = 0;
+    SUFLOAT minPower = 0;
+    SUFLOAT maxPower = 0;
+    unsigned int windows = 0;
+    unsigned int spectra = 0;
+    unsigned int stride = 1;
+
+    std::vector<SUCOMPLEX> window;
+    size_t windowPtr = 0;
+    std::vector<SUFLOAT> taper;
+    std::vector<SUFLOAT> psd;
+    std::vector<uint8_t> record;
+    SU_FFTW(_complex) *fftBuffer = nullptr;
+    SU_FFTW(_plan) plan = nullptr;
+
+    std::string indexPath(void) const;
+    bool openIndex(void);
+    qint64 timeAt(quint64 position) const;
+    void processWindow(size_t len);
+    void flushRecord(void);
+    void feed(const SUCOMPLEX *data, size_t len);
+    void disable(void);
+
+  public:
+    // Takes ownership of the writer
+    CaptureIndexWriter(GenericDataWriter *writer, Params const &params);
+
+    bool prepare(void) override;
+    bool canWrite(void) const override;
+    std::string getError(void) const override;
+    ssize_t write(const SUCOMPLEX *data, size_t len) override;
+    bool close(void) override;
+    void setTimestamp(qint64 usec) override;
+    void setStreamPosition(quint64 position) override;
+    ~CaptureIndexWriter() override;
+  };
+}
+
+#endif // CAPTUREINDEXWRITER_H
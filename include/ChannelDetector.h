@@ -0,0 +1,115 @@
+//
+//    ChannelDetector.h: Runs the CFAR detector in its own thread
+//    Copyright (C) 2020 Gonzalo José Carracedo Carballal
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as
+//    published by the Free Software Foundation, either version 3 of the
+//    License, or (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful, but
+//    WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public
+//    License along with this program.  If not, see
+//    <http://www.gnu.org/licenses/>
+//
+
+#ifndef CHANNELDETECTOR_H
+#define CHANNELDETECTOR_H
+
+#include <QObject>
+#include <QThread>
+#include <mutex>
+#include <vector>
+#include <Suscan/Messages/PSDMessage.h>
+#include "CFARDetector.h"
+
+namespace SigDigger {
+  class ChannelDetector;
+
+  class ChannelDetectorWorker : public QObject {
+      Q_OBJECT
+
+      ChannelDetector *owner; // Weak
+      CFARDetector detector;
+      std::vector<DetectedChannel> channels;
+
+    public:
+      ChannelDetectorWorker(ChannelDetector *owner);
+
+    public slots:
+      void process(void);
+
+    signals:
+      void resultsReady(void);
+  };
+
+  //
+  // Takes PSD frames in the GUI thread and hands them to a worker thread,
+  // without copies (messages share their buffer). If the worker is still
+  // busy when a new frame comes, the frame waiting for it is replaced.
+  // Results come back the same way: at most one resultsReady is on its
+  // way to the GUI thread, which picks the latest list when it gets it.
+  //
+  class ChannelDetector : public QObject {
+    Q_OBJECT
+
+    friend class ChannelDetectorWorker;
+
+    QThread *workerThread = nullptr;
+    ChannelDetectorWorker *worker = nullptr;
+
+    // Shared with the worker
+    std::mutex mutex;
+    Suscan::PSDMessage pending;
+    qint64 pendingTime = 0;
+    bool havePending = false;
+    bool framePosted = false;
+    CFARParams params;
+    bool paramsChanged = false;
+    bool resetRequested = false;
+    std::vector<DetectedChannel> results;
+    bool resultsPosted = false;
+    qreal cost = 0; // usec per frame, smoothed
+    quint64 processed = 0;
+    quint64 dropped = 0;
+
+    // GUI thread
+    std::vector<DetectedChannel> channels;
+
+  public:
+    explicit ChannelDetector(QObject *parent = nullptr);
+    ~ChannelDetector() override;
+
+    void setParams(CFARParams const &);
+    void reset(void);
+
+    // time: usec, UTC
+    void feed(Suscan::PSDMessage const &, qint64 time);
+
+    // As of the last channelsChanged
+    std::vector<DetectedChannel> const &
+    getChannels(void) const
+    {
+      return this->channels;
+    }
+
+    bool findChannel(quint32 id, DetectedChannel &) const;
+
+    qreal getCost(void);
+    quint64 getProcessedCount(void);
+    quint64 getDroppedCount(void);
+
+  signals:
+    void frameReady(void);
+    void channelsChanged(void);
+
+  public slots:
+    void onResultsReady(void);
+  };
+}
+
+#endif // CHANNELDETECTOR_H
@@ -0,0 +1,80 @@
+//
+//    ChannelListDialog.h: Channels found by the CFAR detector
+//    Copyright (C) 2020 Gonzalo José Carracedo Carballal
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as
+//    published by the Free Software Foundation, either version 3 of the
+//    License, or (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful, but
+//    WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public
+//    License along with this program.  If not, see
+//    <http://www.gnu.org/licenses/>
+//
+
+#ifndef CHANNELLISTDIALOG_H
+#define CHANNELLISTDIALOG_H
+
+#include <QDialog>
+#include <QTimer>
+#include "CFARDetector.h"
+
+#define SIGDIGGER_CHANNEL_LIST_REFRESH_MS 500
+
+namespace Ui {
+  class ChannelListDialog;
+}
+
+namespace SigDigger {
+  class ChannelListDialog : public QDialog
+  {
+      Q_OBJECT
+
+      QTimer timer;
+      CFARParams params;
+      std::vector<DetectedChannel> channels;
+      qreal shift = 0;
+      QString stats;
+
+      void connectAll(void);
+
+    protected:
+      void showEvent(QShowEvent *) override;
+      void hideEvent(QHideEvent *) override;
+
+    public:
+      explicit ChannelListDialog(QWidget *parent = nullptr);
+      ~ChannelListDialog() override;
+
+      void setDetecting(bool);
+      void setParams(CFARParams const &);
+
+      // shift: from the frames' frequency to the one on display
+      void setChannels(std::vector<DetectedChannel> const &, qreal shift);
+      void setStats(qreal cost, quint64 processed, quint64 dropped);
+
+      bool getDetecting(void) const;
+      CFARParams getParams(void) const;
+
+      void refresh(void);
+
+    signals:
+      void configChanged(void);
+      void openChannel(quint32 id);
+
+    public slots:
+      void onTimeout(void);
+      void onConfigChanged(void);
+      void onInspect(void);
+
+    private:
+      Ui::ChannelListDialog *ui;
+  };
+}
+
+#endif // CHANNELLISTDIALOG_H
@@ -0,0 +1,159 @@
+//
+//    Channelizer.h: Record many narrowband channels of the baseband
+//    Copyright (C) 2020 Gonzalo José Carracedo Carballal
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as
+//    published by the Free Software Foundation, either version 3 of the
+//    License, or (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful, but
+//    WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public
+//    License along with this program.  If not, see
+//    <http://www.gnu.org/licenses/>
+//
+
+#ifndef CHANNELIZER_H
+#define CHANNELIZER_H
+
+#include <QObject>
+#include "SampleFanout.h"
+#include "GenericDataSaver.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#define SIGDIGGER_CHANNELIZER_TAPS_PER_BRANCH 12
+#define SIGDIGGER_CHANNELIZER_PASSBAND        .75 // Fraction of the bin
+#define SIGDIGGER_CHANNELIZER_MAX_BRANCHES    65536
+#define SIGDIGGER_CHANNELIZER_MAX_CHANNELS    1024
+#define SIGDIGGER_CHANNELIZER_MAX_THREADS     8
+#define SIGDIGGER_CHANNELIZER_QUEUE_BLOCKS    16
+
+namespace SigDigger {
+  //
+  // Splits the baseband in M equally spaced bins with a polyphase filter
+  // bank (a prototype lowpass of M * 12 taps and one M-point FFT every
+  // M / 2 samples) and writes the selected bins to their own files. Bins
+  // are twice oversampled, so a channel whose band stays within 3/4 of
+  // its bin from the bin center comes out free of aliases. M is chosen
+  // so that every requested channel does. A per-channel oscillator
+  // moves the center of the channel to DC.
+  //
+  // Blocks come from a SampleFanout. The dispatcher thread pops them and
+  // splits each block among the worker threads twice: first by frames
+  // (filter and FFT), then by channels (file writes). A full queue drops
+  // the block and the gap is reported through samplesDropped().
+  //
+  class Channelizer : public QObject, public SampleFanoutSink {
+    Q_OBJECT
+
+    struct Channel {
+      unsigned int bin = 0;
+      qreal cycles = 0; // Residual offset, in cycles per output sample
+      SUCOMPLEX step = 1;
+      GenericDataWriter *writer = nullptr;
+    };
+
+    struct Lane {
+      SU_FFTW(_complex) *fold = nullptr;
+      SU_FFTW(_complex) *spectrum = nullptr;
+      std::vector<SUCOMPLEX> phasor;
+    };
+
+    enum Stage {
+      STAGE_ANALYZE,
+      STAGE_STORE,
+      STAGE_EXIT
+    };
+
+    qreal sampleRate;
+    unsigned int branches;
+    unsigned int hop;
+    unsigned int taps = SIGDIGGER_CHANNELIZER_TAPS_PER_BRANCH;
+    unsigned int threads;
+    std::vector<SUFLOAT> prototype;
+    std::vector<Channel> channels;
+    std::vector<Lane> lanes;
+    SU_FFTW(_plan) plan = nullptr;
+
+    // Dispatcher state
+    std::vector<SUCOMPLEX> input;  // Unused samples of the previous block
+    std::vector<SUCOMPLEX> output; // frames samples per channel
+    size_t frames = 0;
+    quint64 frameCount = 0;
+    quint64 next = 0;
+    size_t skip = 0;               // Samples to skip to be back on the grid
+    bool primed = false;
+    bool reported = false;
+    std::atomic<quint64> produced{0};
+    std::atomic<bool> failed{false};
+    std::string lastError;
+
+    std::thread dispatcher;
+    std::mutex blockMutex;
+    std::condition_variable blockCond;
+    bool pending = false;
+    bool exiting = false;
+
+    std::vector<std::thread> helpers;
+    mutable std::mutex stageMutex;
+    std::condition_variable startCond;
+    std::condition_variable doneCond;
+    Stage stage = STAGE_ANALYZE;
+    unsigned int generation = 0;
+    unsigned int busy = 0;
+
+    void designPrototype(void);
+    void analyze(unsigned int lane, size_t first, size_t last);
+    void store(unsigned int lane);
+    void runStage(unsigned int lane, Stage stage);
+    void parallel(Stage stage);
+    void process(const SampleBlock *block);
+    void dispatcherLoop(void);
+    void helperLoop(unsigned int lane);
+    void setError(std::string const &);
+
+  protected:
+    void notify(void) override;
+
+  public:
+    static unsigned int branchesFor(
+        qreal sampleRate,
+        qreal spacing,
+        std::vector<qreal> const &offsets);
+
+    // Offsets are relative to the center of the baseband
+    Channelizer(
+        qreal sampleRate,
+        qreal spacing,
+        std::vector<qreal> const &offsets,
+        unsigned int threads = 0,
+        QObject *parent = nullptr);
+    ~Channelizer() override;
+
+    qreal getChannelRate(void) const;
+    unsigned int getChannelCount(void) const;
+    unsigned int getBranches(void) const;
+    quint64 getSize(void) const;
+    std::string getError(void) const;
+
+    // Before start(). The channelizer owns the writer from now on.
+    void setWriter(unsigned int channel, GenericDataWriter *writer);
+
+    bool start(std::shared_ptr<SampleFanout> const &fanout);
+    void finish(void);
+
+  signals:
+    void commit(void);
+    void stopped(void);
+    void samplesDropped(quint64 position, quint64 count);
+  };
+}
+
+#endif // CHANNELIZER_H
@@ -21,6 +21,7 @@
 #define DATASAVERUI_H
 
 #include <GenericDataSaverUI.h>
+#include <FileDataSaver.h>
 
 namespace Ui {
   class DataSaverUI;
@@ -30,6 +31,18 @@ namespace SigDigger {
   class DataSaverConfig : public Suscan::Serializable {
   public:
     std::string path;
+    bool directIO = false;
+    std::string format = "float32";
+    SUFLOAT fullScale = 1;
+    std::string rollover = "never";
+    unsigned int rolloverSize = 1024; // MiB
+    unsigned int rolloverTime = 600;  // Seconds
+    unsigned int retain = 0;
+    unsigned int historyLength = 0;   // Seconds
+    unsigned int bufferBudget = 512;  // MiB
+    std::string overload = "abort";
+    std::string channels;             // Empty records the full baseband
+    double channelSpacing = 12500;    // Hz
 
     // Overriden methods
     void deserialize(Suscan::Object const &conf) override;
@@ -40,12 +53,32 @@ namespace SigDigger {
   {
       Q_OBJECT
     DataSaverConfig *config = nullptr;
+    unsigned int rolloverSize = 1024;
+    unsigned int rolloverTime = 600;
       void connectAll(void);
+      void refreshRolloverUi(void);
+      void refreshChannelsUi(void);
 
   protected:
       void setDiskUsage(qreal) override;
 
   public:
+      enum Rollover {
+        ROLLOVER_NEVER,
+        ROLLOVER_SIZE,
+        ROLLOVER_TIME
+      };
+
+      static std::string rolloverToStr(Rollover);
+      static Rollover strToRollover(std::string const &);
+      static std::string overloadToStr(GenericDataSaver::OverloadPolicy);
+      static GenericDataSaver::OverloadPolicy strToOverload(
+          std::string const &);
+      static bool parseChannelPlan(
+          std::string const &plan,
+          qreal spacing,
+          std::vector<qreal> &freqs);
+
       // Setters
       void setRecordSavePath(std::string const &) override;
       void setSaveEnabled(bool enabled) override;
@@ -53,9 +86,41 @@ namespace SigDigger {
       void setIORate(qreal) override;
       void setRecordState(bool state) override;
 
+      void setBackend(FileDataSaver::Backend);
+      void setFormat(SampleFormat);
+      void setFullScale(SUFLOAT);
+      void setClipCount(quint64);
+      void setRollover(Rollover);
+      void setRolloverSize(unsigned int);
+      void setRolloverTime(unsigned int);
+      void setRetention(unsigned int);
+      void setRolloverAvailable(bool);
+      void setHistoryLength(unsigned int);
+      void setHistoryMemory(quint64);
+      void setHistoryAvailable(bool);
+      void setBufferBudget(unsigned int);
+      void setOverloadPolicy(GenericDataSaver::OverloadPolicy);
+      void setHeadroom(qreal seconds, quint64 memory);
+      void setChannelPlan(std::string const &);
+      void setChannelSpacing(qreal);
+      void setChannelsAvailable(bool);
+
       // Getters
       bool getRecordState(void) const override;
       std::string getRecordSavePath(void) const override;
+      FileDataSaver::Backend getBackend(void) const;
+      SampleFormat getFormat(void) const;
+      SUFLOAT getFullScale(void) const;
+      Rollover getRollover(void) const;
+      unsigned int getRolloverSize(void) const;
+      unsigned int getRolloverTime(void) const;
+      unsigned int getRetention(void) const;
+      unsigned int getHistoryLength(void) const;
+      quint64 getMemoryBudget(void) const;
+      GenericDataSaver::OverloadPolicy getOverloadPolicy(void) const;
+      std::string getChannelPlan(void) const;
+      qreal getChannelSpacing(void) const;
+      bool getChannels(std::vector<qreal> &) const;
 
       // Other overriden methods
       Suscan::Serializable *allocConfig(void) override;
@@ -67,6 +132,16 @@ namespace SigDigger {
   public slots:
       void onChangeSavePath(void);
       void onRecordStartStop(void);
+      void onBackendChanged(void);
+      void onFormatChanged(void);
+      void onFullScaleChanged(void);
+      void onRolloverChanged(void);
+      void onRolloverValueChanged(void);
+      void onRetentionChanged(void);
+      void onHistoryLengthChanged(void);
+      void onBufferBudgetChanged(void);
+      void onOverloadChanged(void);
+      void onChannelsChanged(void);
 
   private:
       Ui::DataSaverUI *ui;
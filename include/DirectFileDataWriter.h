@@ -0,0 +1,107 @@
+//
+//    DirectFileDataWriter.h: O_DIRECT file writer with deep async queues
+//    Copyright (C) 2020 Gonzalo José Carracedo Carballal
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as
+//    published by the Free Software Foundation, either version 3 of the
+//    License, or (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful, but
+//    WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public
+//    License along with this program.  If not, see
+//    <http://www.gnu.org/licenses/>
+//
+
+#ifndef DIRECTFILEDATAWRITER_H
+#define DIRECTFILEDATAWRITER_H
+
+#include "GenericDataSaver.h"
+#include "SampleConverter.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+
+#ifdef SIGDIGGER_HAVE_IO_URING
+#  include <liburing.h>
+#endif // SIGDIGGER_HAVE_IO_URING
+
+#define SIGDIGGER_DIRECTIO_ALIGNMENT    4096
+#define SIGDIGGER_DIRECTIO_BUFFER_SIZE  (4 << 20)
+#define SIGDIGGER_DIRECTIO_QUEUE_DEPTH  8
+
+namespace SigDigger {
+  //
+  // Bypasses the page cache and keeps several aligned buffers in flight.
+  // If SigDigger was built against liburing, writes are queued in an
+  // io_uring. Otherwise, a small pool of threads issues the pwrite() calls.
+  //
+  class DirectFileDataWriter : public GenericDataWriter {
+    struct Buffer {
+      uint8_t *data = nullptr;
+      size_t   size = 0;
+      off_t    offset = 0;
+    };
+
+    int fd = -1;
+    bool prepared = false;
+    bool direct = false;
+    bool failed = false;
+    std::string lastError;
+    SampleConverter &converter;
+
+    std::vector<Buffer> buffers;
+    std::vector<unsigned int> freeList;
+    unsigned int inFlight = 0;
+    unsigned int depth;
+    size_t bufferSize;
+
+    unsigned int current = 0;
+    bool haveCurrent = false;
+    off_t offset = 0;
+
+#ifdef SIGDIGGER_HAVE_IO_URING
+    struct io_uring ring;
+    bool ringInit = false;
+#else
+    std::vector<std::thread> pool;
+    std::deque<unsigned int> pending;
+    std::mutex queueMutex;
+    std::condition_variable queueCond;
+    std::condition_variable doneCond;
+    std::string poolError;
+    bool poolFailed = false;
+    bool exiting = false;
+
+    void poolWorker(void);
+#endif // SIGDIGGER_HAVE_IO_URING
+
+    bool submit(unsigned int index);
+    bool reap(bool wait);
+    bool acquire(void);
+    bool drain(void);
+    void setError(std::string const &);
+
+  public:
+    DirectFileDataWriter(
+        int fd,
+        SampleConverter &converter,
+        unsigned int depth = SIGDIGGER_DIRECTIO_QUEUE_DEPTH,
+        size_t bufferSize = SIGDIGGER_DIRECTIO_BUFFER_SIZE);
+
+    bool prepare(void) override;
+    bool canWrite(void) const override;
+    std::string getError(void) const override;
+    ssize_t write(const SUCOMPLEX *data, size_t len) override;
+    bool close(void) override;
+    ~DirectFileDataWriter() override;
+  };
+}
+
+#endif // DIRECTFILEDATAWRITER_H
@@ -24,6 +24,7 @@
 #include <QListWidgetItem>
 
 #include "Palette.h"
+#include "PSDPyramid.h"
 
 namespace Ui {
   class FftPanel;
@@ -37,6 +38,15 @@ namespace SigDigger {
     bool peakDetect = false;
     bool peakHold = false;
 
+    bool maxHoldTrace = false;
+    bool minHoldTrace = false;
+    bool meanTrace = false;
+    bool floorTrace = false;
+    unsigned int meanWindow = 16;
+    float floorPercentile = .1f;
+    int detector = PSD_DETECTOR_PEAK;
+    unsigned int displayRate = 0; // 0: screen refresh rate
+
     float panRangeMin = -60;
     float panRangeMax = -10;
 
@@ -76,6 +86,7 @@ namespace SigDigger {
     std::vector<unsigned int> sizes;
     std::vector<unsigned int> refreshRates;
     std::vector<unsigned int> timeSpans;
+    std::vector<unsigned int> displayRates;
 
     const Palette *selected = nullptr;
 
@@ -83,6 +94,7 @@ namespace SigDigger {
     void addFftSize(unsigned int sz);
     void addTimeSpan(unsigned int timeSpan);
     void addRefreshRate(unsigned int rate);
+    void addDisplayRate(unsigned int rate);
     void updateRefreshRates(void);
     void updateFftSizes(void);
     void updateTimeSpans(void);
@@ -108,15 +120,30 @@ namespace SigDigger {
     unsigned int getFftSize(void) const;
     unsigned int getTimeSpan(void) const;
     unsigned int getRefreshRate(void) const;
+    unsigned int getDisplayRate(void) const;
     bool getPeakHold(void) const;
     bool getPeakDetect(void) const;
     bool getRangeLock(void) const;
+    bool getMaxHoldTrace(void) const;
+    bool getMinHoldTrace(void) const;
+    bool getMeanTrace(void) const;
+    bool getFloorTrace(void) const;
+    unsigned int getMeanWindow(void) const;
+    float getFloorPercentile(void) const;
+    PSDDetector getDetector(void) const;
     enum Suscan::AnalyzerParams::WindowFunction getWindowFunction(void) const;
 
     // Setters
     void setPeakHold(bool);
     void setPeakDetect(bool);
     void setRangeLock(bool);
+    void setMaxHoldTrace(bool);
+    void setMinHoldTrace(bool);
+    void setMeanTrace(bool);
+    void setFloorTrace(bool);
+    void setMeanWindow(unsigned int);
+    void setFloorPercentile(float);
+    void setDetector(PSDDetector);
     bool setPalette(std::string const &);
     void setPandRangeMin(float);
     void setPandRangeMax(float);
@@ -129,6 +156,8 @@ namespace SigDigger {
     void setFftSize(unsigned int);
     void setDefaultRefreshRate(unsigned int);
     void setRefreshRate(unsigned int);
+    void setDisplayRate(unsigned int);
+    void setDisplayStats(qreal fps, qreal skipped);
     void setTimeSpan(unsigned int);
     void setSampleRate(unsigned int);
     void setWindowFunction(enum Suscan::AnalyzerParams::WindowFunction func);
@@ -147,17 +176,23 @@ namespace SigDigger {
     void onFftSizeChanged(void);
     void onTimeSpanChanged(void);
     void onRefreshRateChanged(void);
+    void onDisplayRateChanged(void);
     void onRangeLockChanged(void);
     void onPeakChanged(void);
     void onWindowFunctionChanged(void);
+    void onTracesChanged(void);
+    void onResetTraces(void);
+    void onDetectorChanged(void);
 
   signals:
     void paletteChanged(void);
     void rangesChanged(void);
     void averagerChanged(void);
+    void tracesReset(void);
     void fftSizeChanged(void);
     void windowFunctionChanged(void);
     void refreshRateChanged(void);
+    void displayRateChanged(void);
     void timeSpanChanged(void);
   };
 }
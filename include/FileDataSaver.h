@@ -21,18 +21,64 @@
 #define ASYNCDATASAVER_H
 
 #include "GenericDataSaver.h"
+#include "SampleConverter.h"
 
 namespace SigDigger {
-  class FileDataWriter;
-
   class FileDataSaver : public GenericDataSaver {
     Q_OBJECT
 
-    FileDataWriter *writer = nullptr;
+  public:
+    enum Backend {
+      BUFFERED,
+      DIRECT_IO
+    };
+
+    struct FileDataParams {
+      int fd = -1;
+      Backend backend = BUFFERED;
+      SampleFormat format = SAMPLE_FORMAT_CF32;
+      SUFLOAT fullScale = 1;
+
+      // Rotation. If segmentSamples is not zero, fd is the first segment
+      // and the rest are created next to it (see segmentStem).
+      quint64 segmentSamples = 0;
+      unsigned int retain = 0;
+      std::string stem;
+      std::string extension;
+      std::vector<std::string> companions;
+
+      // If set, the capture starts with the contents of this buffer
+      TimeMachine *history = nullptr;
+
+      // If set, a seek index and power summary is written next to the
+      // capture (or next to each segment), see CaptureIndexWriter
+      bool index = false;
+      qreal sampleRate = 0;
+    };
+
+  private:
+    struct WriterHandle {
+      GenericDataWriter *writer = nullptr;
+      SampleConverter *converter = nullptr;
+    };
+
+    GenericDataWriter *writer = nullptr;
+    SampleConverter *converter = nullptr;
+
+    static WriterHandle makeWriter(FileDataParams const &);
+
+    FileDataSaver(WriterHandle const &handle, QObject *parent);
 
   public:
-    FileDataSaver(int fd, QObject *parent = nullptr);
+    static std::string segmentStem(std::string const &stem, unsigned int);
+
+    // Plain buffered writer, for consumers that manage their own files
+    static GenericDataWriter *makeFileWriter(int fd, SampleConverter &);
+
+    FileDataSaver(FileDataParams const &params, QObject *parent = nullptr);
     ~FileDataSaver();
+
+    quint64 getClipCount(void) const;
   };
 }
 #endif // ASYNCDATASAVER_H
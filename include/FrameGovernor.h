@@ -0,0 +1,78 @@
+//
+//    FrameGovernor.h: Decides which spectrum frames get drawn
+//    Copyright (C) 2020 Gonzalo José Carracedo Carballal
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as
+//    published by the Free Software Foundation, either version 3 of the
+//    License, or (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful, but
+//    WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public
+//    License along with this program.  If not, see
+//    <http://www.gnu.org/licenses/>
+//
+
+#ifndef FRAMEGOVERNOR_H
+#define FRAMEGOVERNOR_H
+
+#include <QtGlobal>
+
+// All times in usec
+#define SIGDIGGER_FRAME_GOVERNOR_MAX_LAG    100000  // Older frames: GUI behind
+#define SIGDIGGER_FRAME_GOVERNOR_MAX_STALL  250000  // Draw at least this often
+#define SIGDIGGER_FRAME_GOVERNOR_GUI_SHARE  .5      // Of the time, for drawing
+#define SIGDIGGER_FRAME_GOVERNOR_WINDOW     1000000 // FPS measurement
+
+namespace SigDigger {
+  //
+  // Every PSD frame is analyzed, but only some are drawn. A frame is
+  // drawn if the last one was drawn at least a display period ago, and
+  // drawing does not take more than SIGDIGGER_FRAME_GOVERNOR_GUI_SHARE
+  // of the GUI thread. Frames that waited in the queue for too long mean
+  // that the GUI is falling behind, and are not drawn either: newer ones
+  // are right behind them. Whatever happens, something is drawn every
+  // SIGDIGGER_FRAME_GOVERNOR_MAX_STALL.
+  //
+  class FrameGovernor {
+    qint64 period = 0; // From the max rate
+    qint64 cost = 0;   // Drawing time, smoothed
+    qint64 lastDraw = 0;
+    qint64 nextDraw = 0;
+
+    qint64 windowStart = 0;
+    unsigned int drawCount = 0;
+    unsigned int skipCount = 0;
+    qreal fps = 0;
+    qreal skipRate = 0;
+
+  public:
+    // fps == 0: no limit
+    void setMaxRate(qreal fps);
+
+    // lag: how long ago the frame left the analyzer
+    bool shouldDraw(qint64 now, qint64 lag);
+    void drawn(qint64 start, qint64 end);
+
+    // True once per measurement window, when the rates below change
+    bool updateStats(qint64 now);
+
+    qreal
+    getFPS(void) const
+    {
+      return this->fps;
+    }
+
+    qreal
+    getSkipRate(void) const
+    {
+      return this->skipRate;
+    }
+  };
+}
+
+#endif // FRAMEGOVERNOR_H
@@ -25,8 +25,27 @@
 #include <QThread>
 #include <QMutex>
 #include <vector>
+#include <atomic>
 #include <sigutils/types.h>
 #include <sys/time.h>
+#include "TimeMachine.h"
+#include "SampleFanout.h"
+
+#define SIGDIGGER_DATASAVER_MIN_SLOTS          2
+#define SIGDIGGER_DATASAVER_SLOTS_PER_SECOND   8
+#define SIGDIGGER_DATASAVER_MIN_SLOT_LEN       4096
+#define SIGDIGGER_DATASAVER_DEFAULT_BUDGET     (512ull << 20) // Bytes
+
+// Buffering policy: keep at least MIN_HEADROOM seconds of free buffer, or
+// LATENCY_FACTOR times the worst write latency seen lately, whichever is
+// larger. The worst latency decays by LATENCY_DECAY per written slot.
+#define SIGDIGGER_DATASAVER_MIN_HEADROOM       .5
+#define SIGDIGGER_DATASAVER_LATENCY_FACTOR     4
+#define SIGDIGGER_DATASAVER_LATENCY_DECAY      .995
+
+// How long the producer may wait for room under OVERLOAD_BLOCK
+#define SIGDIGGER_DATASAVER_DEFAULT_STALL_MS   250
+#define SIGDIGGER_DATASAVER_STALL_POLL_US      500
 
 namespace SigDigger {
   class GenericDataSaver;
@@ -39,6 +58,15 @@ namespace SigDigger {
     virtual ssize_t write(const SUCOMPLEX *data, size_t len) = 0;
     virtual bool close(void) = 0;
     virtual std::string getError(void) const = 0;
+
+    // Wall clock of the first sample of the next write(), in usec since
+    // the epoch. Writers that do not care about time ignore it.
+    virtual void setTimestamp(qint64 usec);
+
+    // Stream index of the first sample of the next write(). It jumps
+    // forward when samples were dropped before reaching the writer.
+    virtual void setStreamPosition(quint64 position);
+
     virtual ~GenericDataWriter();
   };
 
@@ -49,47 +77,151 @@ namespace SigDigger {
       bool writerPrepared = false;
       GenericDataSaver *instance;
 
+      bool writeAll(const SUCOMPLEX *data, size_t len);
+      bool dumpHistory(void);
+      void drainInput(void);
+
     private slots:
       void onCommit(void);
       void onPrepare(void);
+      void onResize(void);
 
     public:
       GenericDataWorker(GenericDataSaver *intance);
 
     signals:
       void prepared(void);
-      void writeFinished(quint64 usec);
+      void writeFinished(quint64 usec, quint64 samples);
       void error(QString);
   };
 
+  //
+  // Feeds a saver from a SampleFanout. The producer hands over shared
+  // blocks and the worker writes them as they are, with no copy.
+  //
+  class GenericDataSaverInput : public SampleFanoutSink {
+      GenericDataSaver *owner;
+
+    protected:
+      bool wants(const SampleBlock *) override;
+      void accept(const SampleBlock *) override;
+      void overflow(const SampleBlock *) override;
+      bool stall(void) override;
+      void notify(void) override;
+
+    public:
+      explicit GenericDataSaverInput(GenericDataSaver *owner);
+      ~GenericDataSaverInput() override;
+  };
+
   class GenericDataSaver : public QObject
   {
       Q_OBJECT
 
-      std::vector<SUCOMPLEX>buffers[2];
+    public:
+      //
+      // What to do when the sink does not keep up. ABORT reports the
+      // loss and emits swamped(), which normally ends the recording.
+      // DROP_AND_MARK only reports the loss through samplesDropped().
+      // BLOCK holds the producer for a while before dropping like
+      // DROP_AND_MARK, and does not hold it again until there is room.
+      //
+      enum OverloadPolicy {
+        OVERLOAD_ABORT,
+        OVERLOAD_DROP_AND_MARK,
+        OVERLOAD_BLOCK
+      };
+
+    private:
+
+      //
+      // Samples travel from the producer (the thread calling write()) to
+      // the worker through two single-producer single-consumer rings of
+      // slot pointers. Full slots go from the producer to the worker
+      // through ring, in [tail, head). Empty slots go back through spares,
+      // in [spareTail, spareHead). The producer also owns the slot it is
+      // filling (current). Neither side takes a lock.
+      //
+      // Only the worker creates and destroys slots, so the amount of
+      // buffering can follow the sink without ever allocating memory in
+      // the producer thread.
+      //
+      struct Slot {
+        std::vector<SUCOMPLEX> data;
+        size_t len = 0;
+        quint64 position = 0; // Stream index of data[0]
+
+        explicit Slot(size_t len) : data(len) { }
+      };
+
+      std::vector<Slot *> ring;
+      std::vector<Slot *> spares;
+      Slot *current = nullptr;
       QString lastError;
 
-      unsigned int rateHint;
-      size_t allocation;
+      unsigned int rateHint = 0;
+      quint64 budget = SIGDIGGER_DATASAVER_DEFAULT_BUDGET;
+      size_t slotLen = SIGDIGGER_DATASAVER_MIN_SLOT_LEN;
+      unsigned int maxSlots = SIGDIGGER_DATASAVER_MIN_SLOTS;
+      std::atomic<unsigned int> slotCount{0};
+      std::atomic<unsigned int> slotTarget{SIGDIGGER_DATASAVER_MIN_SLOTS};
+
+      size_t ptr = 0;
+      std::atomic<unsigned int> head{0};
+      std::atomic<unsigned int> tail{0};
+      std::atomic<unsigned int> spareHead{0};
+      std::atomic<unsigned int> spareTail{0};
+      std::atomic<bool> draining{false};
+      std::atomic<bool> dataWritten{false};
+      std::atomic<quint64> size{0};
+      std::atomic<quint64> position{0};
+      quint64 streamPosition = 0; // Given to write(), dropped or not
+
+      // Attached to a SampleFanout instead of being fed by write()
+      GenericDataSaverInput input;
+      bool attached = false;
+      bool streamStarted = false;
+      quint64 streamNext = 0;
+
+      // Overload handling, producer side
+      OverloadPolicy overload = OVERLOAD_ABORT;
+      unsigned int stallMs = SIGDIGGER_DATASAVER_DEFAULT_STALL_MS;
+      bool stalling = false;
+      bool stallExpired = false;
+      struct timeval stallDeadline;
+
+      // Samples preceding the first write, if any
+      TimeMachine *history = nullptr;
+      bool historyTaken = false;
+      size_t historyLen = 0;
+      std::atomic<bool> historyPending{false};
 
-      unsigned int buffer = 0;
-      unsigned int commitedSize;
-      unsigned int ptr = 0;
       GenericDataWriter *writer = nullptr;
-      bool bufferReady = true;
-      bool dataWritten = false;
       QThread workerThread;
       GenericDataWorker workerObject;
 
       QMutex dataMutex;
 
-      struct timeval lastCommit;
       quint64 commitTime = 0;
       quint64 writeTime = 0;
-      quint64 size = 0;
+      qreal peakLatency = 0;
 
       // Private methods
-      void doCommit(void);
+      void allocateSlots(void);
+      void releaseSlots(void);
+      void provisionSlots(void);
+      void recycleSlot(Slot *);
+      void adaptSlots(quint64 usec, quint64 samples);
+      void takeHistory(quint64 before);
+      bool stall(void);
+      void roomFound(void);
+      void overloaded(quint64 count);
+      void kick(void);
+
+    protected:
+      // Writes what is left, stops the worker and closes the writer.
+      // Subclasses owning the writer must call this before destroying it.
+      void finish(void);
 
     public:
       explicit GenericDataSaver(
@@ -99,27 +231,43 @@ namespace SigDigger {
 
       // Public methods
       void setBufferSize(unsigned int size);
+      void setMemoryBudget(quint64 bytes);
       void setSampleRate(unsigned int i);
+      void setHistory(TimeMachine *history);
+      void setOverloadPolicy(
+          OverloadPolicy policy,
+          unsigned int stallMs = SIGDIGGER_DATASAVER_DEFAULT_STALL_MS);
+      OverloadPolicy getOverloadPolicy(void) const;
+      bool attach(std::shared_ptr<SampleFanout> const &fanout);
+      void detach(void);
       void write(const SUCOMPLEX *data, size_t size);
       QString getLastError(void) const;
       quint64 getSize(void) const;
+      quint64 getPosition(void) const;
+      quint64 getMemoryUsage(void) const;
+      qreal getHeadroom(void) const;
 
       // Friend classes
       friend class GenericDataWorker;
+      friend class GenericDataSaverInput;
 
     signals:
       void prepare(void);
       void commit(void);
+      void flush(void);
+      void resize(void);
 
       void ready(void);
       void stopped(void);
       void swamped(void);
+      void samplesDropped(quint64 position, quint64 count);
       void dataRate(qreal);
+      void headroom(qreal seconds);
 
     public slots:
       void onPrepared(void);
       void onError(QString);
-      void onWriteFinished(quint64 usec);
+      void onWriteFinished(quint64 usec, quint64 samples);
   };
 }
 
@@ -59,6 +59,7 @@ namespace SigDigger {
 
     unsigned int basebandSampleRate;
     float sampleRate;
+    qreal frequency = 0; // Of the channel, without the LO
 
     bool scrolling = false;
     bool demodulating = false;
@@ -91,6 +92,7 @@ namespace SigDigger {
     NetForwarderUI *netForwarderUI = nullptr;
     FileDataSaver *dataSaver = nullptr;
     SocketForwarder *socketForwarder = nullptr;
+    std::shared_ptr<SampleFanout> fanout = nullptr;
 
     State state = DETACHED;
     SUSCOUNT lastLen = 0;
@@ -130,6 +132,7 @@ namespace SigDigger {
       void addSpectrumSource(Suscan::SpectrumSource const &src);
       void addEstimator(Suscan::Estimator const &estimator);
       void setAppConfig(AppConfig const &cfg);
+      void assertFanout(void);
       bool installDataSaver(void);
       void uninstallDataSaver(void);
       bool installNetForwarder(void);
@@ -138,9 +141,11 @@ namespace SigDigger {
       void setSampleRate(float rate);
       void setBandwidth(unsigned int bw);
       void setLo(int lo);
+      void setFrequency(qreal frequency);
       void refreshInspectorCtls(void);
       unsigned int getBandwidth(void) const;
       int getLo(void) const;
+      qreal getFrequency(void) const;
       void adjustSizes(void);
 
       enum State getState(void) const;
@@ -179,6 +184,7 @@ namespace SigDigger {
       void onSaveError(void);
       void onSaveSwamped(void);
       void onSaveRate(qreal rate);
+      void onSaveHeadroom(qreal seconds);
       void onCommit(void);
 
       // Net Forwarder slots
@@ -0,0 +1,63 @@
+//
+//    LatencyDialog.h: Pipeline latency statistics
+//    Copyright (C) 2020 Gonzalo José Carracedo Carballal
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as
+//    published by the Free Software Foundation, either version 3 of the
+//    License, or (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful, but
+//    WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public
+//    License along with this program.  If not, see
+//    <http://www.gnu.org/licenses/>
+//
+
+#ifndef LATENCYDIALOG_H
+#define LATENCYDIALOG_H
+
+#include <QDialog>
+#include <QTimer>
+
+#define SIGDIGGER_LATENCY_DIALOG_REFRESH_MS 500
+
+namespace Ui {
+  class LatencyDialog;
+}
+
+namespace SigDigger {
+  class LatencyDialog : public QDialog
+  {
+      Q_OBJECT
+
+      QTimer timer;
+      quint64 droppedPSD = 0;
+
+      void connectAll(void);
+
+    protected:
+      void showEvent(QShowEvent *) override;
+      void hideEvent(QHideEvent *) override;
+
+    public:
+      explicit LatencyDialog(QWidget *parent = nullptr);
+      ~LatencyDialog() override;
+
+      void setDroppedPSD(quint64);
+      void refresh(void);
+
+    public slots:
+      void onTimeout(void);
+      void onReset(void);
+      void onSave(void);
+
+    private:
+      Ui::LatencyDialog *ui;
+  };
+}
+
+#endif // LATENCYDIALOG_H
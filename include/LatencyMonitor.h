@@ -0,0 +1,100 @@
+//
+//    LatencyMonitor.h: Per-stage latency histograms of the sample pipeline
+//    Copyright (C) 2020 Gonzalo José Carracedo Carballal
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as
+//    published by the Free Software Foundation, either version 3 of the
+//    License, or (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful, but
+//    WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public
+//    License along with this program.  If not, see
+//    <http://www.gnu.org/licenses/>
+//
+
+#ifndef LATENCYMONITOR_H
+#define LATENCYMONITOR_H
+
+#include <QtGlobal>
+#include <atomic>
+#include <string>
+
+// Log-linear buckets: 8 per power of two of usec, about 12% wide
+#define SIGDIGGER_LATENCY_SUB_BUCKETS  8
+#define SIGDIGGER_LATENCY_MAX_EXPONENT 32 // Up to ~70 minutes
+#define SIGDIGGER_LATENCY_BUCKETS \
+  ((SIGDIGGER_LATENCY_MAX_EXPONENT - 2) * SIGDIGGER_LATENCY_SUB_BUCKETS)
+
+namespace SigDigger {
+  enum LatencyStage {
+    LATENCY_STAGE_PSD_QUEUE,       // Out of the analyzer MQ, to the GUI thread
+    LATENCY_STAGE_PSD_RENDER,      // GUI thread, to the spectrum widget
+    LATENCY_STAGE_PSD_TOTAL,       // Out of the analyzer MQ, to the widget
+    LATENCY_STAGE_INSPECTOR_QUEUE, // Inspector messages, to the GUI thread
+    LATENCY_STAGE_SAMPLES_QUEUE,   // Inspector samples, to the GUI thread
+    LATENCY_STAGE_SAMPLES_FEED,    // GUI thread, through InspectorUI::feed
+    LATENCY_STAGE_AUDIO_DELIVERY,  // Out of the analyzer MQ, into the player
+    LATENCY_STAGE_AUDIO_QUEUE,     // Full audio buffer, to the sound device
+    LATENCY_STAGE_COUNT
+  };
+
+  // In usec. Percentiles are bucket centers.
+  struct LatencyStats {
+    quint64 count = 0;
+    qreal mean = 0;
+    qint64 max = 0;
+    qint64 p50 = 0;
+    qint64 p90 = 0;
+    qint64 p99 = 0;
+  };
+
+  //
+  // Every stage of the pipeline records how long it took into its own
+  // histogram. Recording is lock-free and may happen in any thread.
+  // Every timestamp in the pipeline, Suscan::Message ones included, comes
+  // from now(), so they can be taken in one thread and compared in
+  // another.
+  //
+  class LatencyMonitor {
+    struct Histogram {
+      std::atomic<quint64> count{0};
+      std::atomic<quint64> sum{0};
+      std::atomic<qint64> max{0};
+      std::atomic<quint64> buckets[SIGDIGGER_LATENCY_BUCKETS];
+    };
+
+    Histogram histograms[LATENCY_STAGE_COUNT];
+
+    static unsigned int bucketOf(quint64 usec);
+    static qint64 bucketCenter(unsigned int bucket);
+    qint64 percentile(Histogram const &, quint64 count, qreal p) const;
+
+    LatencyMonitor();
+
+  public:
+    static LatencyMonitor *instance(void);
+    static qint64 now(void); // Monotonic usec
+    static const char *stageName(LatencyStage stage);
+
+    void record(LatencyStage stage, qint64 usec);
+
+    void
+    recordSince(LatencyStage stage, qint64 start)
+    {
+      this->record(stage, now() - start);
+    }
+
+    LatencyStats getStats(LatencyStage stage) const;
+    void reset(void);
+
+    // Summary and non-empty buckets of every stage, as text
+    bool dump(std::string const &path) const;
+  };
+}
+
+#endif // LATENCYMONITOR_H
@@ -24,6 +24,11 @@
 #include <ColorConfig.h>
 #include <Waterfall.h>
 #include <Palette.h>
+#include "SpectrumOverlay.h"
+#include "CFARDetector.h"
+
+// Bins per pixel the display is fed with, so peaks land on some pixel
+#define SIGDIGGER_MAIN_SPECTRUM_OVERSAMPLING 2
 
 namespace Ui {
   class MainSpectrum;
@@ -52,6 +57,7 @@ namespace SigDigger {
     // UI Objects
     Ui::MainSpectrum *ui = nullptr;
     std::vector<FrequencyAllocationTable *> FATs;
+    SpectrumOverlay *overlay = nullptr;
 
     // UI State
     CaptureMode mode = UNAVAILABLE;
@@ -61,6 +67,7 @@ namespace SigDigger {
     qint64 maxFreq = 6000000000;
 
     // Cached members (for UI update, etc)
+    std::vector<ChannelMarker> markers;
     unsigned int cachedRate = 0;
     unsigned int bandwidth = 0;
     unsigned int zoom = 1;
@@ -79,6 +86,12 @@ namespace SigDigger {
 
     // Actions
     void feed(float *data, int size);
+    void feedTrace(AveragerTrace trace, const float *data, int size);
+
+    // frequency: where the PSD frames are centered
+    void setDetectedChannels(
+        std::vector<DetectedChannel> const &,
+        qreal frequency);
     void deserializeFATs(void);
 
     // Setters
@@ -117,6 +130,7 @@ namespace SigDigger {
     qint64 getLnbFreq(void) const;
     unsigned int getBandwidth(void) const;
     unsigned int getZoom(void) const;
+    size_t getDisplayBins(void) const;
     FrequencyAllocationTable *getFAT(QString const &) const;
 
     static int getFrequencyUnits(qint64 frew);
@@ -130,6 +144,7 @@ namespace SigDigger {
     void rangeChanged(float, float);
     void zoomChanged(float);
     void newBandPlan(QString);
+    void detectedChannelClicked(quint32);
 
   public slots:
     void onRangeChanged(float, float);
@@ -140,6 +155,7 @@ namespace SigDigger {
     void onLoChanged(void);
     void onNewZoomLevel(float);
     void onLnbFrequencyChanged(void);
+    void onChannelClicked(quint32);
   };
 }
 
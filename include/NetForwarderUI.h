@@ -22,6 +22,7 @@
 
 #include <QWidget>
 #include <WaitingSpinnerWidget.h>
+#include <SocketForwarder.h>
 
 namespace Ui {
   class UDPForwarderUI;
@@ -33,6 +34,10 @@ namespace SigDigger {
     Q_OBJECT
 
     WaitingSpinnerWidget *spinner = nullptr;
+    quint64 captureSize = 0;
+    int clients = -1;
+
+    void refreshCaptureSize(void);
 
     void connectAll(void);
 
@@ -49,17 +54,27 @@ namespace SigDigger {
     void setForwardState(bool state);
     void setForwardEnabled(bool enabled);
     void setCaptureSize(quint64 size);
-    void setTcp(bool);
+    void setClientCount(int clients); // -1 when not serving
+    void setMode(SocketForwarder::Mode mode);
+    void setFraming(bool);
+    void setFormat(SampleFormat format);
+    void setFullScale(SUFLOAT fullScale);
+    void setOutputRate(qreal rate); // 0 to keep the channel rate
 
     // Getters
     std::string getHost(void) const;
     uint16_t getPort(void) const;
     unsigned int getFrameLen(void) const;
     bool getForwardState(void) const;
-    bool getTcp(void) const;
+    SocketForwarder::Mode getMode(void) const;
+    bool getFraming(void) const;
+    SampleFormat getFormat(void) const;
+    SUFLOAT getFullScale(void) const;
+    qreal getOutputRate(void) const;
 
   public slots:
     void onForwardStartStop(void);
+    void onFormatChanged(void);
 
   signals:
     void forwardStateChanged(bool state);
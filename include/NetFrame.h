@@ -0,0 +1,94 @@
+//
+//    NetFrame.h: Framing of the network forwarder stream
+//    Copyright (C) 2020 Gonzalo José Carracedo Carballal
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as
+//    published by the Free Software Foundation, either version 3 of the
+//    License, or (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful, but
+//    WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public
+//    License along with this program.  If not, see
+//    <http://www.gnu.org/licenses/>
+//
+
+#ifndef NETFRAME_H
+#define NETFRAME_H
+
+//
+// Plain C on purpose: receivers (see Scripts/netframe-rx.c) include it
+// without pulling anything else from SigDigger.
+//
+// When framing is enabled, every UDP datagram is exactly one frame. Over
+// TCP, frames follow each other back to back. A frame is a header and
+// `samples' samples right after it, in the format given by `format'.
+// Everything is in the byte order of the sender, which is little endian
+// on every platform SigDigger runs on.
+//
+//   char     magic[4]    "SDNF"
+//   uint8_t  version     SIGDIGGER_NETFRAME_VERSION
+//   uint8_t  format      SIGDIGGER_NETFRAME_FORMAT_*
+//   uint16_t headerSize  Bytes from the start of the frame to the samples
+//   uint32_t sequence    Frame counter, wraps around
+//   uint32_t samples     Samples in this frame
+//   uint64_t position    Stream index of the first sample
+//   int64_t  time        Wall clock of the first sample (usec, UTC)
+//   double   sampleRate  Hz
+//   double   frequency   Center frequency of the channel, Hz
+//   float    fullScale   Amplitude of the largest integer (integer formats)
+//   uint32_t reserved
+//
+// Receivers must skip headerSize bytes and not sizeof(NetFrameHeader):
+// later versions may append fields. A gap in `sequence' is a lost frame,
+// a gap in `position' with consecutive sequence numbers means the
+// sender itself dropped samples.
+//
+
+#include <stdint.h>
+
+#define SIGDIGGER_NETFRAME_MAGIC      "SDNF"
+#define SIGDIGGER_NETFRAME_VERSION    1
+
+// Same values as SigDigger::SampleFormat
+#define SIGDIGGER_NETFRAME_FORMAT_CF32 0 // Complex float32, I first
+#define SIGDIGGER_NETFRAME_FORMAT_CI16 1 // Complex int16, I first
+#define SIGDIGGER_NETFRAME_FORMAT_CI8  2 // Complex int8, I first
+
+struct NetFrameHeader {
+  char     magic[4];
+  uint8_t  version;
+  uint8_t  format;
+  uint16_t headerSize;
+  uint32_t sequence;
+  uint32_t samples;
+  uint64_t position;
+  int64_t  time;
+  double   sampleRate;
+  double   frequency;
+  float    fullScale;
+  uint32_t reserved;
+};
+
+static inline unsigned int
+netframe_sample_size(uint8_t format)
+{
+  switch (format) {
+    case SIGDIGGER_NETFRAME_FORMAT_CF32:
+      return 8;
+
+    case SIGDIGGER_NETFRAME_FORMAT_CI16:
+      return 4;
+
+    case SIGDIGGER_NETFRAME_FORMAT_CI8:
+      return 2;
+  }
+
+  return 0;
+}
+
+#endif // NETFRAME_H
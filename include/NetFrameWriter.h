@@ -0,0 +1,114 @@
+//
+//    NetFrameWriter.h: Base of the network forwarder writers
+//    Copyright (C) 2020 Gonzalo José Carracedo Carballal
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as
+//    published by the Free Software Foundation, either version 3 of the
+//    License, or (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful, but
+//    WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public
+//    License along with this program.  If not, see
+//    <http://www.gnu.org/licenses/>
+//
+
+#ifndef NETFRAMEWRITER_H
+#define NETFRAMEWRITER_H
+
+#include "GenericDataSaver.h"
+#include "SampleConverter.h"
+#include "Resampler.h"
+#include "NetFrame.h"
+
+#include <memory>
+
+#define SIGDIGGER_NETFRAME_DEFAULT_FRAME_LEN 1472
+
+namespace SigDigger {
+  struct NetStreamParams {
+    unsigned int frameLen = SIGDIGGER_NETFRAME_DEFAULT_FRAME_LEN; // Bytes
+    bool framed = false;
+
+    // Optional conditioning, in the writer thread
+    qreal sampleRate = 0; // Of the input
+    qreal outputRate = 0; // Zero to keep the input rate
+    SampleFormat format = SAMPLE_FORMAT_CF32;
+    SUFLOAT fullScale = 1;
+  };
+
+  //
+  // Splits the stream in frames of `size' samples and keeps what their
+  // headers need: the sequence counter, the stream position and the
+  // timestamps. Subclasses fill headers for the frames of a write and
+  // advance() past the ones that went out. The frequency may be changed
+  // from any thread.
+  //
+  // Before framing, condition() resamples the input to the output rate
+  // and packs it in the output format. Positions, rates and frame sizes
+  // refer to the output. Without conditioning, the input goes out as is.
+  // Samples dropped before reaching the writer leave the same gap (in
+  // output samples) in the frame positions.
+  //
+  class NetFrameWriter : public GenericDataWriter {
+    uint32_t sequence = 0;
+    quint64 position = 0;
+    quint64 refPosition = 0;
+    qint64 refTime = 0;
+    quint64 inputPosition = 0; // Stream index of the next input sample
+    bool inputStarted = false;
+    unsigned int interp = 1;
+    unsigned int decim = 1;
+
+    SampleConverter converter;
+    std::unique_ptr<Resampler> resampler;
+    std::vector<SUCOMPLEX> resampled;
+    std::vector<uint8_t> packed;
+
+  protected:
+    bool framed = false;
+    qreal rate = 0;            // Output rate
+    unsigned int size = 0;     // Samples per frame
+    unsigned int sampleBytes = sizeof(SUCOMPLEX);
+
+    // Frame `frame' of the current write, `offset' samples into it
+    void fillHeader(
+        NetFrameHeader *header,
+        unsigned int frame,
+        size_t offset,
+        size_t samples) const;
+    void advance(unsigned int frames, size_t samples);
+
+    unsigned int frameBytes(void) const;
+
+    // Returns the number of output samples, found at out
+    size_t condition(const SUCOMPLEX *data, size_t len, const uint8_t *&out);
+
+  public:
+    std::atomic<qreal> frequency{0};
+
+    // With framing, frameLen includes the header
+    explicit NetFrameWriter(NetStreamParams const &params);
+
+    qreal
+    getOutputRate(void) const
+    {
+      return this->rate;
+    }
+
+    quint64
+    getClipCount(void) const
+    {
+      return this->converter.getClipCount();
+    }
+
+    void setTimestamp(qint64 usec) override;
+    void setStreamPosition(quint64 position) override;
+  };
+}
+
+#endif // NETFRAMEWRITER_H
@@ -0,0 +1,62 @@
+//
+//    PSDPyramid.h: Min/max/mean decimations of a PSD frame
+//    Copyright (C) 2020 Gonzalo José Carracedo Carballal
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as
+//    published by the Free Software Foundation, either version 3 of the
+//    License, or (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful, but
+//    WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public
+//    License along with this program.  If not, see
+//    <http://www.gnu.org/licenses/>
+//
+
+#ifndef PSDPYRAMID_H
+#define PSDPYRAMID_H
+
+#include <cstddef>
+#include "AlignedBuffer.h"
+
+#define SIGDIGGER_PSD_PYRAMID_MIN_BINS 512 // Coarsest level, at least
+
+namespace SigDigger {
+  // How bins that share a pixel are reduced to one
+  enum PSDDetector {
+    PSD_DETECTOR_PEAK,
+    PSD_DETECTOR_AVERAGE,
+    PSD_DETECTOR_MIN,
+    PSD_DETECTOR_COUNT
+  };
+
+  //
+  // Level n + 1 halves level n, keeping the max, min or mean of every
+  // pair of bins (mean of dB values, as everything else in the display
+  // path). Only the levels of one detector are computed, and only down
+  // to the one that is asked for, 4 bin pairs at a time with SSE2 or
+  // NEON. Reducing a frame reads about as much as the frame itself.
+  //
+  // Not thread-safe: each thread reducing frames keeps its own.
+  //
+  class PSDPyramid {
+    AlignedBuffer levels[2]; // Every other level goes to the same one
+
+  public:
+    // Coarsest level of data that still has at least bins bins (and
+    // SIGDIGGER_PSD_PYRAMID_MIN_BINS). size is updated to its size. That
+    // is data itself if it cannot be halved. Otherwise, it is ours and
+    // valid until the next call.
+    const float *reduce(
+        const float *data,
+        size_t &size,
+        size_t bins,
+        PSDDetector detector);
+  };
+}
+
+#endif // PSDPYRAMID_H
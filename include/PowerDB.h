@@ -0,0 +1,52 @@
+//
+//    PowerDB.h: Fast power to decibel conversion of spectrum frames
+//    Copyright (C) 2020 Gonzalo José Carracedo Carballal
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as
+//    published by the Free Software Foundation, either version 3 of the
+//    License, or (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful, but
+//    WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public
+//    License along with this program.  If not, see
+//    <http://www.gnu.org/licenses/>
+//
+
+#ifndef POWERDB_H
+#define POWERDB_H
+
+#include <sigutils/types.h>
+#include <cstddef>
+
+// Powers below this (-200 dB) are clamped to it, zero included
+#define SIGDIGGER_POWERDB_MIN_POWER 1e-20f
+
+// Bound of |powerDB(x) - 10 log10(x)| for finite x above the minimum,
+// in dB. The polynomial alone is good to 2e-6 dB, the rest is float
+// rounding of large exponents.
+#define SIGDIGGER_POWERDB_MAX_ERROR 1e-4f
+
+namespace SigDigger {
+  //
+  // 10 log10(x) as exponent + degree 6 polynomial of the mantissa, 8
+  // bins at a time with AVX2 (picked at run time on x86) and 4 with SSE2
+  // or NEON. Elsewhere, bins go one at a time through libm. in and out
+  // may be the same array.
+  //
+  void powerDB(const SUFLOAT *in, SUFLOAT *out, size_t len);
+
+  // In place: swaps both halves of an FFT frame so that DC lands in the
+  // middle, and converts it to dB. Same result as SU_POWER_DB on every
+  // bin followed by the swap, in one pass.
+  void fftShiftPowerDB(SUFLOAT *data, size_t len);
+
+  // Name of the code path powerDB uses on this machine
+  const char *powerDBImplementation(void);
+}
+
+#endif // POWERDB_H
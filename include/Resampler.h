@@ -0,0 +1,90 @@
+//
+//    Resampler.h: Rational polyphase resampler
+//    Copyright (C) 2020 Gonzalo José Carracedo Carballal
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as
+//    published by the Free Software Foundation, either version 3 of the
+//    License, or (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful, but
+//    WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public
+//    License along with this program.  If not, see
+//    <http://www.gnu.org/licenses/>
+//
+
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <sigutils/types.h>
+#include <QtGlobal>
+#include <vector>
+
+#define SIGDIGGER_RESAMPLER_MAX_INTERP   256
+#define SIGDIGGER_RESAMPLER_MAX_DECIM    65536
+#define SIGDIGGER_RESAMPLER_TAPS         16    // Per output, per unit ratio
+#define SIGDIGGER_RESAMPLER_MAX_TAPS     4096  // Per phase
+
+// Narrowest ratio the bank can realize: past this, a branch would need
+// more than MAX_TAPS taps to span the sinc main lobe
+#define SIGDIGGER_RESAMPLER_MAX_DOWN \
+  (SIGDIGGER_RESAMPLER_MAX_TAPS / SIGDIGGER_RESAMPLER_TAPS)
+#define SIGDIGGER_RESAMPLER_PASSBAND     .9    // Of the narrower Nyquist
+
+namespace SigDigger {
+  //
+  // Resamples by interp / decim: upsample by interp, lowpass, keep one
+  // sample out of decim. Only the branch of the filter bank that lands
+  // on an output sample is computed, so the cost is taps per output
+  // sample, whatever the ratio. The lowpass is a Blackman-windowed sinc
+  // with SIGDIGGER_RESAMPLER_TAPS * max(interp, decim) taps in total.
+  //
+  // Branch taps are stored twice in a row (h0 h0 h1 h1 ...) so that
+  // filtering interleaved I/Q is a plain dot product of two float
+  // arrays, done 4 floats at a time where SSE2 or NEON are available.
+  //
+  class Resampler {
+    unsigned int interp;
+    unsigned int decim;
+    unsigned int taps; // Per branch, even
+    std::vector<SUFLOAT> bank;
+    std::vector<SUCOMPLEX> buffer; // taps - 1 samples of history, then input
+    quint64 time = 0; // Next output, in upsampled samples since buffer[0]
+
+  public:
+    // Closest interp / decim to ratio within the limits above. If ratio
+    // is not in [1 / MAX_DOWN, MAX_INTERP], returns false with interp and
+    // decim set to 1 (no resampling).
+    static bool approximate(
+        qreal ratio,
+        unsigned int &interp,
+        unsigned int &decim);
+
+    // decim is capped to interp * MAX_DOWN
+    Resampler(unsigned int interp, unsigned int decim);
+
+    unsigned int
+    getInterpolation(void) const
+    {
+      return this->interp;
+    }
+
+    unsigned int
+    getDecimation(void) const
+    {
+      return this->decim;
+    }
+
+    // Upper bound of what feed() returns for len input samples
+    size_t maxOutput(size_t len) const;
+
+    // Returns the number of samples written to out
+    size_t feed(const SUCOMPLEX *in, size_t len, SUCOMPLEX *out);
+  };
+}
+
+#endif // RESAMPLER_H
@@ -0,0 +1,108 @@
+//
+//    RotatingFileDataWriter.h: Split captures in a series of files
+//    Copyright (C) 2020 Gonzalo José Carracedo Carballal
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as
+//    published by the Free Software Foundation, either version 3 of the
+//    License, or (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful, but
+//    WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public
+//    License along with this program.  If not, see
+//    <http://www.gnu.org/licenses/>
+//
+
+#ifndef ROTATINGFILEDATAWRITER_H
+#define ROTATINGFILEDATAWRITER_H
+
+#include "GenericDataSaver.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+
+namespace SigDigger {
+  //
+  // Writes segments of segmentSamples samples each, named after a common
+  // stem followed by a 4-digit index. The writer of the next segment is
+  // opened, preallocated and prepared by a helper thread while the current
+  // one is being written, and the finished one is closed there too, so
+  // switching files is just a matter of swapping two pointers. The helper
+  // thread also removes segments older than the retention limit.
+  //
+  class RotatingFileDataWriter : public GenericDataWriter {
+  public:
+    typedef std::function<GenericDataWriter *(int fd)> Factory;
+
+    struct Params {
+      std::string stem;
+      std::string extension;
+      std::vector<std::string> companions; // Removed along with segments
+      quint64 segmentSamples = 0;
+      size_t sampleSize = sizeof(SUCOMPLEX);
+      unsigned int retain = 0; // Finished segments to keep, 0 keeps all
+    };
+
+  private:
+    Params params;
+    Factory factory;
+    GenericDataWriter *current = nullptr;
+    unsigned int index = 0;
+    quint64 written = 0;
+    bool failed = false;
+    std::atomic<bool> writable{false};
+    std::string lastError;
+
+    // Helper thread state
+    std::thread helper;
+    std::mutex helperMutex;
+    std::condition_variable requestCond;
+    std::condition_variable readyCond;
+    int firstFd;
+    GenericDataWriter *nextWriter = nullptr;
+    std::string nextError;
+    GenericDataWriter *retiring = nullptr;
+    quint64 retiringSamples = 0;
+    std::string retireError;
+    unsigned int requestIndex = 0;
+    bool requested = false;
+    bool ready = false;
+    bool exiting = false;
+
+    std::string segmentPath(unsigned int) const;
+    void preallocate(int fd) const;
+    void removeSegment(unsigned int) const;
+    bool retire(
+        GenericDataWriter *,
+        unsigned int index,
+        quint64 samples,
+        std::string &error) const;
+    GenericDataWriter *openNext(unsigned int index, std::string &error);
+    void helperLoop(void);
+    void request(GenericDataWriter *retiring, quint64 samples);
+    bool rotate(void);
+    bool closeCurrent(void);
+    void setError(std::string const &);
+
+  public:
+    static std::string segmentStem(std::string const &stem, unsigned int);
+
+    RotatingFileDataWriter(int fd, Params const &params, Factory factory);
+
+    bool prepare(void) override;
+    bool canWrite(void) const override;
+    std::string getError(void) const override;
+    ssize_t write(const SUCOMPLEX *data, size_t len) override;
+    bool close(void) override;
+    ~RotatingFileDataWriter() override;
+  };
+}
+
+#endif // ROTATINGFILEDATAWRITER_H
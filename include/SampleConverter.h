@@ -0,0 +1,99 @@
+//
+//    SampleConverter.h: Convert complex float samples to recording formats
+//    Copyright (C) 2020 Gonzalo José Carracedo Carballal
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as
+//    published by the Free Software Foundation, either version 3 of the
+//    License, or (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful, but
+//    WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public
+//    License along with this program.  If not, see
+//    <http://www.gnu.org/licenses/>
+//
+
+#ifndef SAMPLECONVERTER_H
+#define SAMPLECONVERTER_H
+
+#include <sigutils/types.h>
+#include <atomic>
+#include <string>
+#include <cstdint>
+
+namespace SigDigger {
+  enum SampleFormat {
+    SAMPLE_FORMAT_CF32,
+    SAMPLE_FORMAT_CI16,
+    SAMPLE_FORMAT_CI8
+  };
+
+  //
+  // Converts SUCOMPLEX samples to interleaved I/Q in the requested format.
+  // Integer formats map an amplitude of fullScale to the largest integer
+  // and saturate beyond that. Saturated components are counted so that
+  // the operator can trim the gain.
+  //
+  class SampleConverter {
+    SampleFormat format = SAMPLE_FORMAT_CF32;
+    SUFLOAT fullScale = 1;
+    SUFLOAT scale = 1;
+    std::atomic<uint64_t> clipped{0};
+
+  public:
+    static size_t sampleSize(SampleFormat);
+    static std::string formatName(SampleFormat);
+    static SampleFormat formatFromName(std::string const &);
+
+    // Convert 2 * len floats. Return the number of clipped components.
+    static uint64_t toInt16(
+        int16_t *dest,
+        const SUFLOAT *src,
+        size_t len,
+        SUFLOAT scale);
+    static uint64_t toInt8(
+        int8_t *dest,
+        const SUFLOAT *src,
+        size_t len,
+        SUFLOAT scale);
+
+    SampleConverter(
+        SampleFormat format = SAMPLE_FORMAT_CF32,
+        SUFLOAT fullScale = 1);
+
+    void setFormat(SampleFormat format, SUFLOAT fullScale = 1);
+
+    // dest must be able to hold len * getSampleSize() bytes
+    void convert(void *dest, const SUCOMPLEX *src, size_t len);
+
+    SampleFormat
+    getFormat(void) const
+    {
+      return this->format;
+    }
+
+    SUFLOAT
+    getFullScale(void) const
+    {
+      return this->fullScale;
+    }
+
+    size_t
+    getSampleSize(void) const
+    {
+      return sampleSize(this->format);
+    }
+
+    uint64_t
+    getClipCount(void) const
+    {
+      return this->clipped;
+    }
+  };
+}
+
+#endif // SAMPLECONVERTER_H
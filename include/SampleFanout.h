@@ -0,0 +1,177 @@
+//
+//    SampleFanout.h: Share a sample stream among several consumers
+//    Copyright (C) 2020 Gonzalo José Carracedo Carballal
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as
+//    published by the Free Software Foundation, either version 3 of the
+//    License, or (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful, but
+//    WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public
+//    License along with this program.  If not, see
+//    <http://www.gnu.org/licenses/>
+//
+
+#ifndef SAMPLEFANOUT_H
+#define SAMPLEFANOUT_H
+
+#include <sigutils/types.h>
+#include <QtGlobal>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+
+#define SIGDIGGER_FANOUT_BLOCKS_PER_SECOND 8
+#define SIGDIGGER_FANOUT_MIN_BLOCK_LEN     4096
+#define SIGDIGGER_FANOUT_MAX_BLOCKS        4096
+#define SIGDIGGER_FANOUT_MAX_SINKS         8
+#define SIGDIGGER_FANOUT_SPARE_BLOCKS      2
+
+namespace SigDigger {
+  class SampleFanout;
+
+  //
+  // A block of the stream. Blocks are shared by every sink that queued
+  // them and go back to the pool once the last reference is released.
+  //
+  struct SampleBlock {
+    std::vector<SUCOMPLEX> data;
+    size_t len = 0;
+    quint64 position = 0; // Stream index of data[0]
+    qint64 time = 0;      // Wall clock when data[0] arrived, in usec
+    std::atomic<unsigned int> refs{0};
+  };
+
+  //
+  // A consumer of the stream. Each sink has its own queue of blocks (its
+  // cursor into the stream) and decides what to do when it is full. The
+  // producer pushes at head, the consumer pops at tail. Dropping the
+  // oldest block also happens in the producer, so both sides move the
+  // tail with compare-and-swap. Subclasses overriding the producer-side
+  // hooks must detach() in their destructors.
+  //
+  class SampleFanoutSink {
+  public:
+    enum OverflowPolicy {
+      OVERFLOW_DROP_NEWEST,
+      OVERFLOW_DROP_OLDEST
+    };
+
+  private:
+    std::shared_ptr<SampleFanout> fanout;
+    std::vector<std::atomic<SampleBlock *>> queue;
+    OverflowPolicy policy;
+    unsigned int depth = 0;
+    std::atomic<unsigned int> limit{0};
+    std::atomic<unsigned int> head{0};
+    std::atomic<unsigned int> tail{0};
+    std::atomic<quint64> dropped{0};
+    bool attached = false;
+
+    bool discardOldest(void);
+    void offer(SampleBlock *block);
+
+    friend class SampleFanout;
+
+  protected:
+    // Called from the producer thread
+    virtual bool wants(const SampleBlock *block);
+    virtual void accept(const SampleBlock *block);
+    virtual void overflow(const SampleBlock *block);
+    virtual bool stall(void);
+    virtual void notify(void);
+
+    // Consumer side, only while the producer cannot push (see wants)
+    SampleBlock *at(unsigned int index) const;
+
+  public:
+    SampleFanoutSink(unsigned int depth, OverflowPolicy policy);
+    virtual ~SampleFanoutSink();
+
+    // Not while attached
+    void setDepth(unsigned int depth);
+
+    void setLimit(unsigned int limit);
+    unsigned int getDepth(void) const;
+    unsigned int queued(void) const;
+    quint64 getDropped(void) const;
+    SampleFanout *getFanout(void) const;
+
+    bool attach(std::shared_ptr<SampleFanout> const &fanout);
+    void detach(void);
+
+    // Consumer side
+    SampleBlock *pop(void);
+    void release(SampleBlock *block);
+    void clear(void);
+  };
+
+  //
+  // The producer copies the stream once into pooled blocks and hands a
+  // reference to every attached sink when a block is full. The producer
+  // never allocates: the pool is sized by maintain() to what the sinks
+  // may hold (the sum of their limits), from whatever thread attaches
+  // them or changes their limits. Idle blocks above that are freed there
+  // too, so the pool shrinks along with the sinks' budgets.
+  //
+  class SampleFanout {
+    std::vector<SampleBlock *> blocks;
+    std::atomic<unsigned int> allocated{0};
+    std::atomic<bool> acquiring{false};
+    mutable std::mutex poolMutex; // Anyone but the producer
+    size_t blockLen;
+
+    SampleBlock *current = nullptr;
+    size_t ptr = 0;
+    quint64 position = 0;
+
+    std::atomic<SampleFanoutSink *> sinks[SIGDIGGER_FANOUT_MAX_SINKS];
+    std::atomic<unsigned int> sinkCount{0};
+    std::atomic<bool> publishing{false};
+    std::atomic<quint64> dropped{0};
+
+    SampleBlock *acquire(void);
+    void publish(SampleBlock *block);
+
+    friend class SampleFanoutSink;
+
+  public:
+    static size_t blockLength(unsigned int rate);
+
+    explicit SampleFanout(
+        size_t blockLen,
+        unsigned int maxBlocks = SIGDIGGER_FANOUT_MAX_BLOCKS);
+    ~SampleFanout();
+
+    size_t
+    getBlockLen(void) const
+    {
+      return this->blockLen;
+    }
+
+    unsigned int
+    getSinkCount(void) const
+    {
+      return this->sinkCount;
+    }
+
+    unsigned int getMaxBlocks(void) const;
+    unsigned int getFreeBlocks(void) const;
+    quint64 getMemoryUsage(void) const;
+    quint64 getDropped(void) const;
+
+    // Grows or trims the pool. Never from the producer thread.
+    void maintain(void);
+
+    // Producer side
+    void write(const SUCOMPLEX *data, size_t len);
+  };
+}
+
+#endif // SAMPLEFANOUT_H
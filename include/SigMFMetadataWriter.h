@@ -0,0 +1,104 @@
+//
+//    SigMFMetadataWriter.h: Write SigMF metadata sidecars
+//    Copyright (C) 2020 Gonzalo José Carracedo Carballal
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as
+//    published by the Free Software Foundation, either version 3 of the
+//    License, or (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful, but
+//    WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public
+//    License along with this program.  If not, see
+//    <http://www.gnu.org/licenses/>
+//
+
+#ifndef SIGMFMETADATAWRITER_H
+#define SIGMFMETADATAWRITER_H
+
+#include <QObject>
+#include <QThread>
+#include <QTimer>
+#include <QJsonObject>
+#include <QJsonArray>
+#include "SampleConverter.h"
+
+#define SIGDIGGER_SIGMF_VERSION        "1.0.0"
+#define SIGDIGGER_SIGMF_DATA_EXTENSION ".sigmf-data"
+#define SIGDIGGER_SIGMF_META_EXTENSION ".sigmf-meta"
+#define SIGDIGGER_SIGMF_UPDATE_INTERVAL_MS 1000
+
+// Our own annotation keys, declared in core:extensions
+#define SIGDIGGER_SIGMF_EXTENSION         "sigdigger"
+#define SIGDIGGER_SIGMF_EXTENSION_VERSION "1.0.0"
+
+namespace SigDigger {
+  class SigMFMetadataWorker : public QObject {
+    Q_OBJECT
+
+    QString path;
+
+  public:
+    SigMFMetadataWorker(QString const &path);
+
+  public slots:
+    void onStore(QByteArray);
+
+  signals:
+    void error(QString);
+  };
+
+  //
+  // Keeps the metadata of a capture in memory and replaces the sidecar
+  // file when it changes, at most once per update interval. Replacing
+  // happens in a separate thread, so neither the GUI nor the capture
+  // worker wait for the disk. The destructor stores the final version.
+  //
+  class SigMFMetadataWriter : public QObject {
+    Q_OBJECT
+
+    QJsonObject global;
+    QJsonArray captures;
+    QJsonArray annotations;
+
+    QThread workerThread;
+    SigMFMetadataWorker workerObject;
+    QTimer updateTimer;
+    bool dirty = false;
+
+    QByteArray document(void) const;
+    void update(void);
+
+  public:
+    static std::string datatype(SampleFormat);
+
+    SigMFMetadataWriter(QString const &path, QObject *parent = nullptr);
+    ~SigMFMetadataWriter();
+
+    void setGlobal(
+        SampleFormat format,
+        qreal sampleRate,
+        QString const &hw,
+        QString const &description);
+    void addCapture(quint64 sample, qreal frequency, quint64 globalIndex);
+    void addAnnotation(
+        quint64 sample,
+        quint64 count,
+        QString const &label,
+        QString const &comment);
+    void addGap(quint64 sample, quint64 dropped);
+
+  signals:
+    void store(QByteArray);
+    void error(QString);
+
+  public slots:
+    void onUpdateTimeout(void);
+  };
+}
+
+#endif // SIGMFMETADATAWRITER_H
@@ -19,27 +19,60 @@
 #ifndef UDPFORWARDER_H
 #define UDPFORWARDER_H
 
-#include "GenericDataSaver.h"
+#include "NetFrameWriter.h"
 
 #define SIGDIGGER_UDPFORWARDER_MAX_UDP_PAYLOAD_SIZE 508
 #define SIGDIGGER_UDPFORWARDER_MAX_UDP_SAMPLES \
   (SIGDIGGER_UDPFORWARDER_MAX_UDP_PAYLOAD_SIZE / static_cast<ssize_t>(sizeof(float _Complex)))
 
+#define SIGDIGGER_SOCKETFORWARDER_BATCH        64    // Messages per sendmmsg
+#define SIGDIGGER_SOCKETFORWARDER_GSO_SEGMENTS 64    // Datagrams per message
+#define SIGDIGGER_SOCKETFORWARDER_GSO_MAX_BYTES 65000
+#define SIGDIGGER_SOCKETFORWARDER_RETRIES      100
+#define SIGDIGGER_SOCKETFORWARDER_RETRY_MS     10
+
 namespace SigDigger {
-  class SocketDataWriter;
+  class StreamServerWriter;
 
   class SocketForwarder : public GenericDataSaver {
     Q_OBJECT
 
-    SocketDataWriter *writer = nullptr;
+  public:
+    enum Mode {
+      MODE_UDP,
+      MODE_TCP,        // Connect to host
+      MODE_TCP_SERVER  // Listen on host (bind address) for many clients
+    };
+
+  private:
+    NetFrameWriter *writer = nullptr;
+    StreamServerWriter *server = nullptr;
+
+    static NetFrameWriter *makeWriter(
+        std::string const &host,
+        uint16_t port,
+        Mode mode,
+        NetStreamParams const &params);
+
+    SocketForwarder(NetFrameWriter *writer, QObject *parent);
 
   public:
     SocketForwarder(
         std::string const &host,
         uint16_t port,
-        unsigned int size,
-        bool tcp,
+        Mode mode,
+        NetStreamParams const &params,
         QObject *parent = nullptr);
+    ~SocketForwarder() override;
+
+    // Always 0 unless serving
+    unsigned int getClientCount(void) const;
+
+    // After resampling
+    qreal getOutputRate(void) const;
+
+    // What the frame headers say. Can change while forwarding.
+    void setFrequency(qreal frequency);
   };
 }
 
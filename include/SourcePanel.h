@@ -106,6 +106,78 @@ namespace SigDigger {
         return this->saverUI->getRecordSavePath();
       }
 
+      FileDataSaver::Backend
+      getRecordBackend(void) const
+      {
+        return this->saverUI->getBackend();
+      }
+
+      SampleFormat
+      getRecordFormat(void) const
+      {
+        return this->saverUI->getFormat();
+      }
+
+      SUFLOAT
+      getRecordFullScale(void) const
+      {
+        return this->saverUI->getFullScale();
+      }
+
+      DataSaverUI::Rollover
+      getRecordRollover(void) const
+      {
+        return this->saverUI->getRollover();
+      }
+
+      unsigned int
+      getRecordRolloverSize(void) const
+      {
+        return this->saverUI->getRolloverSize();
+      }
+
+      unsigned int
+      getRecordRolloverTime(void) const
+      {
+        return this->saverUI->getRolloverTime();
+      }
+
+      unsigned int
+      getRecordRetention(void) const
+      {
+        return this->saverUI->getRetention();
+      }
+
+      unsigned int
+      getRecordHistoryLength(void) const
+      {
+        return this->saverUI->getHistoryLength();
+      }
+
+      quint64
+      getRecordMemoryBudget(void) const
+      {
+        return this->saverUI->getMemoryBudget();
+      }
+
+      GenericDataSaver::OverloadPolicy
+      getRecordOverloadPolicy(void) const
+      {
+        return this->saverUI->getOverloadPolicy();
+      }
+
+      bool
+      getRecordChannels(std::vector<qreal> &freqs) const
+      {
+        return this->saverUI->getChannels(freqs);
+      }
+
+      qreal
+      getRecordChannelSpacing(void) const
+      {
+        return this->saverUI->getChannelSpacing();
+      }
+
       bool
       isThrottleEnabled(void) const
       {
@@ -158,6 +230,9 @@ namespace SigDigger {
       void setGain(std::string const &name, SUFLOAT val);
 
       void setCaptureSize(quint64);
+      void setClipCount(quint64);
+      void setHistoryMemory(quint64);
+      void setCaptureHeadroom(qreal, quint64);
       void setDiskUsage(qreal);
       void setIORate(qreal);
       void setRecordState(bool state);
@@ -0,0 +1,90 @@
+//
+//    SpectrumOverlay.h: Extra traces drawn over the main spectrum
+//    Copyright (C) 2020 Gonzalo José Carracedo Carballal
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as
+//    published by the Free Software Foundation, either version 3 of the
+//    License, or (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful, but
+//    WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public
+//    License along with this program.  If not, see
+//    <http://www.gnu.org/licenses/>
+//
+
+#ifndef SPECTRUMOVERLAY_H
+#define SPECTRUMOVERLAY_H
+
+#include <QWidget>
+#include <QColor>
+#include <vector>
+#include "Averager.h"
+
+namespace SigDigger {
+  struct ChannelMarker {
+    quint32 id;
+    qreal left;  // Pixels
+    qreal right;
+    float snr;   // dB
+    bool present;
+  };
+
+  //
+  // Transparent child of the waterfall widget, covering its pandapter
+  // (the top panWfRatio of it). Traces are reduced to one value per pixel
+  // column when they are set, so painting does not depend on the FFT
+  // size and the overlay keeps no pointer to the averager buffers.
+  //
+  // Detected channels are boxes under the traces. Ctrl+click on one
+  // emits channelClicked, every other click goes to the plotter.
+  //
+  class SpectrumOverlay : public QWidget
+  {
+    Q_OBJECT
+
+    struct Trace {
+      std::vector<float> columns; // dB, NaN where there is no data
+      QColor color;
+    };
+
+    Trace traces[AVERAGER_TRACE_COUNT];
+    std::vector<ChannelMarker> channels;
+    QColor channelColor = QColor(255, 160, 64);
+    float panMin = -60;
+    float panMax = -10;
+    int percent2D = 30;
+
+  protected:
+    bool eventFilter(QObject *, QEvent *) override;
+    void paintEvent(QPaintEvent *) override;
+
+  public:
+    explicit SpectrumOverlay(QWidget *plotter);
+
+    void setPandapterRange(float min, float max);
+    void setPercent2DScreen(int percent);
+    void setTraceColor(AveragerTrace trace, QColor const &color);
+
+    // Bin firstBin lands on the left edge, binsPerPixel may be below 1
+    void setTrace(
+        AveragerTrace trace,
+        const float *data,
+        int size,
+        qreal firstBin,
+        qreal binsPerPixel);
+    void clearTrace(AveragerTrace trace);
+
+    void setChannels(std::vector<ChannelMarker> const &);
+    void setChannelColor(QColor const &);
+
+  signals:
+    void channelClicked(quint32 id);
+  };
+}
+
+#endif // SPECTRUMOVERLAY_H
@@ -0,0 +1,147 @@
+//
+//    SpectrumProcessor.h: Averages and reduces PSD frames in its own thread
+//    Copyright (C) 2020 Gonzalo José Carracedo Carballal
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as
+//    published by the Free Software Foundation, either version 3 of the
+//    License, or (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful, but
+//    WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public
+//    License along with this program.  If not, see
+//    <http://www.gnu.org/licenses/>
+//
+#ifndef SPECTRUMPROCESSOR_H
+#define SPECTRUMPROCESSOR_H
+
+#include <QObject>
+#include <QThread>
+#include <mutex>
+#include <deque>
+#include <vector>
+#include <Suscan/Messages/PSDMessage.h>
+#include "Averager.h"
+#include "PSDPyramid.h"
+
+// Frames waiting for the worker. Past this, the oldest one is skipped.
+#define SIGDIGGER_SPECTRUM_PROCESSOR_BACKLOG 8
+
+namespace SigDigger {
+  class SpectrumProcessor;
+
+  struct SpectrumParams {
+    float alpha = 1.f;
+    unsigned int windowLength = SIGDIGGER_AVERAGER_DEFAULT_WINDOW;
+    float percentile = .1f;
+    bool traces[AVERAGER_TRACE_COUNT] = {false, false, false, false};
+    PSDDetector detector = PSD_DETECTOR_PEAK;
+  };
+
+  // The average and the traces, reduced for the display
+  struct SpectrumFrame {
+    std::vector<float> average;
+    std::vector<float> traces[AVERAGER_TRACE_COUNT];
+    bool valid[AVERAGER_TRACE_COUNT] = {false, false, false, false};
+    size_t size = 0;
+    qint64 readTime = 0;     // Of the last frame averaged, see Message
+    qint64 dispatchTime = 0;
+  };
+
+  class SpectrumProcessorWorker : public QObject {
+      Q_OBJECT
+
+      SpectrumProcessor *owner; // Weak
+      Averager averager;
+      PSDPyramid pyramid;
+      PSDDetector detector = PSD_DETECTOR_PEAK;
+      SpectrumFrame frame;
+
+      void applyParams(SpectrumParams const &);
+      size_t reduce(
+          const float *data,
+          size_t bins,
+          PSDDetector detector,
+          std::vector<float> &out);
+
+    public:
+      SpectrumProcessorWorker(SpectrumProcessor *owner);
+
+    public slots:
+      void process(void);
+
+    signals:
+      void resultReady(void);
+  };
+
+  //
+  // Every PSD frame goes through the averager, in a worker thread. The
+  // averager always sees the whole frame, so its state does not depend
+  // on the zoom. Frames the GUI thread wants to draw come with the
+  // number of bins it can show. After averaging them, the worker reduces
+  // the average and the traces to that with a PSDPyramid and hands them
+  // back. Frames travel without copies (messages share their buffer).
+  // At most one resultReady is on its way to the GUI thread, which picks
+  // the latest result when it gets it.
+  //
+  class SpectrumProcessor : public QObject {
+    Q_OBJECT
+
+    friend class SpectrumProcessorWorker;
+
+    QThread *workerThread = nullptr;
+    SpectrumProcessorWorker *worker = nullptr;
+
+    struct PendingFrame {
+      Suscan::PSDMessage message;
+      size_t bins; // 0: not to be drawn
+    };
+
+    // Shared with the worker
+    std::mutex mutex;
+    std::deque<PendingFrame> pending;
+    bool framePosted = false;
+    SpectrumParams params;
+    bool paramsChanged = false;
+    bool resetRequested = false;
+    SpectrumFrame result;
+    bool resultPosted = false;
+    quint64 dropped = 0;
+
+    // GUI thread
+    SpectrumFrame frame;
+
+  public:
+    explicit SpectrumProcessor(QObject *parent = nullptr);
+    ~SpectrumProcessor() override;
+
+    void setParams(SpectrumParams const &);
+    void resetTraces(void);
+
+    // bins > 0: this one is to be drawn, reduced to at least bins bins.
+    // A spectrumChanged follows, even if the frame is skipped.
+    void feed(Suscan::PSDMessage const &, size_t bins);
+
+    // As of the last spectrumChanged
+    SpectrumFrame const &
+    getFrame(void) const
+    {
+      return this->frame;
+    }
+
+    quint64 getDroppedCount(void);
+
+  signals:
+    void frameReady(void);
+    void spectrumChanged(void);
+
+  public slots:
+    void onResultReady(void);
+  };
+}
+
+#endif // SPECTRUMPROCESSOR_H
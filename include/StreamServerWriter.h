@@ -0,0 +1,118 @@
+//
+//    StreamServerWriter.h: Serve a sample stream to many TCP clients
+//    Copyright (C) 2020 Gonzalo José Carracedo Carballal
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as
+//    published by the Free Software Foundation, either version 3 of the
+//    License, or (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful, but
+//    WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public
+//    License along with this program.  If not, see
+//    <http://www.gnu.org/licenses/>
+//
+
+#ifndef STREAMSERVERWRITER_H
+#define STREAMSERVERWRITER_H
+
+#include "NetFrameWriter.h"
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#define SIGDIGGER_STREAMSERVER_MAX_CLIENTS 16
+#define SIGDIGGER_STREAMSERVER_QUEUE_BYTES (16 << 20) // Per client
+#define SIGDIGGER_STREAMSERVER_BACKLOG     4
+#define SIGDIGGER_STREAMSERVER_IOV_MAX     64
+
+namespace SigDigger {
+  //
+  // Listens on a TCP port and sends the stream to every client that
+  // connects. write() never waits for the network: it conditions the
+  // samples and packs them (and their frame headers) once into a chunk
+  // shared by all clients and queues a reference to it in each of them.
+  // A sender thread moves the queues to the sockets with non-blocking
+  // writes, woken by epoll when a socket drains or when new chunks are
+  // queued.
+  //
+  // A client whose queue would exceed its budget is a slow client. With
+  // SLOW_CLIENT_SKIP, it misses whole chunks until it catches up (with
+  // framing, the gap shows in the sequence numbers). With
+  // SLOW_CLIENT_DISCONNECT it is dropped. Either way, the rest of the
+  // clients and the producer are not held back.
+  //
+  class StreamServerWriter : public NetFrameWriter {
+  public:
+    enum SlowClientPolicy {
+      SLOW_CLIENT_SKIP,
+      SLOW_CLIENT_DISCONNECT
+    };
+
+  private:
+    typedef std::shared_ptr<const std::vector<uint8_t>> Chunk;
+
+    struct Client {
+      int fd = -1;
+      std::string name;
+      std::deque<Chunk> queue;
+      size_t queued = 0; // Bytes, minus what went out of the front chunk
+      size_t offset = 0; // Into the front chunk
+      bool closing = false;
+    };
+
+    std::string address;
+    uint16_t port;
+    SlowClientPolicy policy;
+    size_t queueBytes;
+    std::string lastError;
+
+    int listenFd = -1;
+    int epollFd = -1;
+    int wakeFd = -1;
+    bool listening = false;
+    std::thread sender;
+    std::atomic<bool> running{false};
+
+    mutable std::mutex clientMutex;
+    std::map<int, std::unique_ptr<Client>> clients;
+    std::atomic<quint64> skipped{0};     // Chunks, all clients
+    std::atomic<quint64> disconnected{0};
+
+    void wake(void);
+    void acceptClients(void);
+    void dropClient(int fd);
+    bool flushClient(Client *client);
+    void flushAll(void);
+    void senderLoop(void);
+    void shutdown(void);
+
+  public:
+    StreamServerWriter(
+        std::string const &address,
+        uint16_t port,
+        NetStreamParams const &params,
+        SlowClientPolicy policy = SLOW_CLIENT_SKIP,
+        size_t queueBytes = SIGDIGGER_STREAMSERVER_QUEUE_BYTES);
+
+    unsigned int getClientCount(void) const;
+    quint64 getSkipped(void) const;
+    quint64 getDisconnected(void) const;
+
+    bool prepare(void) override;
+    std::string getError(void) const override;
+    bool canWrite(void) const override;
+    ssize_t write(const SUCOMPLEX *data, size_t len) override;
+    bool close(void) override;
+    ~StreamServerWriter() override;
+  };
+}
+
+#endif // STREAMSERVERWRITER_H
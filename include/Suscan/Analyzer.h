@@ -23,6 +23,12 @@
 #include <QObject>
 #include <QThread>
 
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
 #include <Suscan/Compat.h>
 #include <Suscan/Source.h>
 #include <Suscan/MQ.h>
@@ -38,6 +44,12 @@
 
 #include <analyzer/analyzer.h>
 
+// Messages taken from the MQ in one go by the async thread
+#define SUSCAN_ANALYZER_ASYNC_BATCH_MAX 256
+
+// Pending PSD frames of the same frequency and size before dropping any
+#define SUSCAN_ANALYZER_PSD_BACKLOG     32
+
 namespace Suscan {
   class Analyzer: public QObject
   {
@@ -56,11 +68,56 @@ namespace Suscan {
       CONTINUOUS = SUSCAN_ANALYZER_SPECTRUM_PARTITIONING_CONTINUOUS
     };
 
+    // Runs in the async thread, never in the GUI thread. It must return
+    // quickly (hand the samples to a worker if there is real work to do)
+    // and must not subscribe or unsubscribe. The last argument is when
+    // the batch left the MQ, see LatencyMonitor::now().
+    typedef std::function<
+      void (InspectorId, const SUCOMPLEX *, SUSCOUNT, qint64)>
+      SampleCallback;
+    typedef unsigned int SubscriptionId;
+
   private:
+    struct PendingMessage {
+      quint32 type;
+      void *data; // nullptr if superseded
+      qint64 time; // When it left the MQ, see LatencyMonitor::now()
+    };
+
     suscan_analyzer_t *instance = nullptr;
     AsyncThread *asyncThread = nullptr;
     MQ mq;
 
+    // Messages waiting for the GUI thread. At most one batchReady is in
+    // the event queue at any time. Once SUSCAN_ANALYZER_PSD_BACKLOG PSD
+    // frames of the same frequency and size are pending, newer ones
+    // replace the oldest.
+    std::mutex batchMutex;
+    std::vector<PendingMessage> batch;
+    std::vector<size_t> pendingPSD; // Indices into batch
+    bool batchPosted = false;
+    bool coalescePSD = true;
+    std::atomic<quint64> droppedPSD{0};
+
+    struct SampleSubscription {
+      SubscriptionId id;
+      InspectorId inspector;
+      SampleCallback callback;
+    };
+
+    std::mutex subscriptionMutex;
+    std::vector<SampleSubscription> subscriptions;
+    SubscriptionId lastSubscription = 0;
+
+    bool deliverSamples(
+        const struct suscan_analyzer_sample_batch_msg *msg,
+        qint64 readTime);
+    void dispatch(PendingMessage const &);
+
+    bool supersedes(const void *psd, const void *pending) const;
+    bool enqueue(std::vector<PendingMessage> const &);
+    void disposePending(void);
+
     static bool registered;
     static void assertTypeRegistration(void);
 
@@ -74,12 +131,25 @@ namespace Suscan {
 
   public slots:
     void captureMessage(quint32 type, void *data);
+    void captureBatch(void);
 
   public:
     SUSCOUNT getSampleRate(void) const;
     SUSCOUNT getMeasuredSampleRate(void) const;
 
+    // PSD frames dropped because a newer one came before delivery
+    quint64 getDroppedPSDCount(void) const;
+    void setPSDCoalescing(bool enabled);
+
     void *read(uint32_t &type);
+    bool poll(uint32_t &type, void *&data);
+
+    // Sample batches of a subscribed inspector go to its callbacks right
+    // away and no samples_message is emitted for them. Once
+    // unsubscribeSamples() returns, the callback is not running and will
+    // not run again.
+    SubscriptionId subscribeSamples(InspectorId inspector, SampleCallback cb);
+    void unsubscribeSamples(SubscriptionId id);
     void registerBaseBandFilter(suscan_analyzer_baseband_filter_func_t, void *);
     void setFrequency(SUFREQ freq, SUFREQ lnbFreq = 0);
     void setGain(std::string const &name, SUFLOAT val);
@@ -127,7 +197,7 @@ namespace Suscan {
     AsyncThread(Analyzer *);
 
   signals:
-    void message(quint32 type, void *data);
+    void batchReady(void);
   };
 
 };
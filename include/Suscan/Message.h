@@ -21,11 +21,15 @@
 
 #include <QObject>
 #include <functional>
+#include <memory>
 
 #include <Suscan/Compat.h>
 
 #include <analyzer/msg.h>
 
+// Freed shared_ptr control blocks kept for reuse
+#define SUSCAN_MESSAGE_POOL_SIZE 1024
+
 namespace Suscan {
   typedef uint32_t RequestId;
   typedef uint32_t InspectorId;
@@ -35,6 +39,10 @@ namespace Suscan {
   private:
     uint32_t type;
 
+    // Monotonic usec, see SigDigger::LatencyMonitor::now()
+    qint64 readTime = 0;     // Taken from the MQ by the async thread
+    qint64 dispatchTime = 0; // Handed to the slots in the GUI thread
+
     // These constructors are to be called by derivate classes
   protected:
     std::shared_ptr<void> c_message;
@@ -42,6 +50,9 @@ namespace Suscan {
 
   public:
     uint32_t getType(void) const;
+    qint64 getReadTime(void) const;
+    qint64 getDispatchTime(void) const;
+    void setTimes(qint64 read, qint64 dispatch);
 
     Message(const Message &);
     Message(Message &&);
@@ -33,11 +33,16 @@ namespace Suscan {
   class InspectorMessage: public Message {
   private:
     struct suscan_analyzer_inspector_msg *message = nullptr; // Convenience reference
-    std::vector<SpectrumSource> sources;
-    std::vector<Estimator> estimators;
+
+    // Only OPEN and config messages carry these. Built on first use.
+    mutable std::vector<SpectrumSource> sources;
+    mutable std::vector<Estimator> estimators;
+    mutable bool listsBuilt = false;
 
     Config config;
 
+    void buildLists(void) const;
+
   public:
     enum suscan_analyzer_inspector_msgkind getKind(void) const;
     suscan_config_t const *getCConfig(void) const;
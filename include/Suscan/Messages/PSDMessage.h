@@ -35,6 +35,10 @@ namespace Suscan {
     unsigned int getSampleRate(void) const;
     const SUFLOAT *get(void) const;
 
+    // Swaps halves and converts to dB, in place. The analyzer does this
+    // in its async thread, before the message reaches any slot.
+    static void toDecibels(struct suscan_analyzer_psd_msg *msg);
+
     PSDMessage();
     PSDMessage(struct suscan_analyzer_psd_msg *msg);
   };
@@ -0,0 +1,66 @@
+//
+//    TimeMachine.h: Keep the last seconds of baseband in memory
+//    Copyright (C) 2020 Gonzalo José Carracedo Carballal
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as
+//    published by the Free Software Foundation, either version 3 of the
+//    License, or (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful, but
+//    WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public
+//    License along with this program.  If not, see
+//    <http://www.gnu.org/licenses/>
+//
+
+#ifndef TIMEMACHINE_H
+#define TIMEMACHINE_H
+
+#include "SampleFanout.h"
+
+// Never take more than this fraction of the available memory
+#define SIGDIGGER_TIME_MACHINE_MEMORY_FRACTION 0.5
+
+namespace SigDigger {
+  //
+  // The most recent blocks of a shared stream. The time machine holds
+  // references to the blocks of a SampleFanout instead of copying them,
+  // dropping the oldest one as new ones arrive. A recording that starts
+  // from it freezes it (from the producer thread, so that the history
+  // ends exactly where the recording starts) and reads it from its own
+  // thread. Once the history is out, the consumer thaws the time machine,
+  // which releases the blocks and starts over.
+  //
+  class TimeMachine : public SampleFanoutSink {
+    std::atomic<bool> frozen{false};
+
+  protected:
+    bool wants(const SampleBlock *) override;
+
+  public:
+    static size_t maxSamples(void);
+
+    TimeMachine(size_t samples, size_t blockLen);
+    ~TimeMachine() override;
+
+    size_t getCapacity(void) const;
+
+    // Producer side
+    void freeze(void);
+
+    // Consumer side, only while frozen. Samples are counted from the
+    // oldest one, and only those before the given stream position.
+    size_t available(quint64 before) const;
+    size_t peek(
+        size_t offset,
+        const SUCOMPLEX **data,
+        qint64 *time = nullptr) const;
+    void thaw(void);
+  };
+}
+
+#endif // TIMEMACHINE_H
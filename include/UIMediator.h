@@ -23,11 +23,17 @@
 #include <Suscan/Messages/PSDMessage.h>
 #include <map>
 #include <AppConfig.h>
+#include "FrameGovernor.h"
+#include "ChannelDetector.h"
+#include "SpectrumProcessor.h"
 #include <QMessageBox>
 
 #define SIGDIGGER_UI_MEDIATOR_DEFAULT_MIN_FREQ 0
 #define SIGDIGGER_UI_MEDIATOR_DEFAULT_MAX_FREQ 6000000000
 
+// Filter bandwidth over the detected one when opening a detected channel
+#define SIGDIGGER_UI_MEDIATOR_CHANNEL_MARGIN 1.2
+
 namespace SigDigger {
 
   class UIMediator : public PersistentWidget {
@@ -56,7 +62,14 @@ namespace SigDigger {
     std::map<std::string, QAction *> bandPlanMap;
 
     // UI Data
-    Averager averager;
+    SpectrumProcessor *spectrumProcessor = nullptr;
+    bool drawPending = false; // Asked the processor for a frame to draw
+    PSDPyramid historyPyramid;
+    WaterfallHistory history;
+    FrameGovernor governor;
+    ChannelDetector *channelDetector = nullptr;
+    qreal detectorFrequency = 0; // Of the frames fed to the detector
+    PSDDetector detector = PSD_DETECTOR_PEAK;
     unsigned int rate = 0;
     unsigned int recentCount = 0;
 
@@ -78,6 +91,10 @@ namespace SigDigger {
 
     // Behavioral methods
     void setSampleRate(unsigned int rate);
+    void pushHistory(const Suscan::PSDMessage &);
+    void drawPSD(void);
+    void applyDisplayRate(void);
+    CFARParams getChannelDetectorParams(void) const;
     void setBandwidth(unsigned int bandwidth);
     void refreshProfile(void);
 
@@ -107,6 +124,9 @@ namespace SigDigger {
         float *data,
         size_t size);
     void setCaptureSize(quint64 size);
+    void setClipCount(quint64 count);
+    void setHistoryMemory(quint64 bytes);
+    void setCaptureHeadroom(qreal seconds, quint64 memory);
     void refreshDevicesDone(void);
 
     QMessageBox::StandardButton shouldReduceRate(
@@ -219,6 +239,13 @@ namespace SigDigger {
     void onTriggerClear(bool);
     void onTriggerRecent(bool);
     void onTriggerPanoramicSpectrum(bool);
+    void onTriggerLatency(bool);
+    void onTriggerWaterfallHistory(bool);
+    void onHistoryConfigChanged(void);
+    void onTriggerChannelDetector(bool);
+    void onChannelDetectorConfigChanged(void);
+    void onDetectedChannelsChanged(void);
+    void onOpenDetectedChannel(quint32);
     void onTriggerBandPlan(void);
 
     // Spectrum slots
@@ -243,10 +270,13 @@ namespace SigDigger {
     void onPaletteChanged(void);
     void onRangesChanged(void);
     void onAveragerChanged(void);
+    void onTracesReset(void);
     void onFftSizeChanged(void);
     void onWindowFunctionChanged(void);
     void onRefreshRateChanged(void);
+    void onDisplayRateChanged(void);
     void onTimeSpanChanged(void);
+    void onSpectrumChanged(void);
 
     // Audio panel
     void onAudioChanged(void);
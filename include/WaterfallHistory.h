@@ -0,0 +1,187 @@
+//
+//    WaterfallHistory.h: On-disk scrollback of the main waterfall
+//    Copyright (C) 2020 Gonzalo José Carracedo Carballal
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as
+//    published by the Free Software Foundation, either version 3 of the
+//    License, or (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful, but
+//    WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public
+//    License along with this program.  If not, see
+//    <http://www.gnu.org/licenses/>
+//
+
+#ifndef WATERFALLHISTORY_H
+#define WATERFALLHISTORY_H
+
+#include <QtGlobal>
+#include <QByteArray>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+#define SIGDIGGER_WF_HISTORY_FILE_NAME     "waterfall.history"
+#define SIGDIGGER_WF_HISTORY_MAGIC         "SDWFHIST"
+#define SIGDIGGER_WF_HISTORY_VERSION       1
+#define SIGDIGGER_WF_HISTORY_BLOCK_MAGIC   0x42574453 // "SDWB"
+#define SIGDIGGER_WF_HISTORY_HEADER_SIZE   4096
+#define SIGDIGGER_WF_HISTORY_BLOCK_ROWS    64
+#define SIGDIGGER_WF_HISTORY_MAX_BINS      8192  // Wider rows are decimated
+#define SIGDIGGER_WF_HISTORY_DB_STEP       .5f   // 255 steps below the peak
+#define SIGDIGGER_WF_HISTORY_DEFAULT_SIZE  512   // MiB
+#define SIGDIGGER_WF_HISTORY_MIN_SIZE      16    // MiB
+#define SIGDIGGER_WF_HISTORY_MAX_SIZE      65536 // MiB
+
+namespace SigDigger {
+  //
+  // File layout, in host byte order:
+  //
+  //   Header (4 KiB)                Block header, then payload (8-aligned)
+  //   char     magic[8]             uint32_t magic
+  //   uint32_t version              uint32_t rows      (0: wrap to start)
+  //   uint32_t reserved             uint32_t bins
+  //   uint64_t capacity (bytes)     uint32_t size      (payload bytes)
+  //   uint64_t head                 uint64_t sequence
+  //   uint64_t tail                 int64_t  firstTime (usec, UTC)
+  //   uint64_t tailSequence         int64_t  lastTime  (usec, UTC)
+  //   uint64_t sequence             double   frequency (center, Hz)
+  //                                 double   sampleRate
+  //
+  // Blocks go one after another from tail to head, wrapping around to the
+  // end of the header when the next one does not fit. Sequence numbers
+  // tell live blocks from stale ones. The payload is qCompress() of the
+  // row times (int64), the row peaks (float, dB) and the rows, one code
+  // per bin: the bin is peak - code * SIGDIGGER_WF_HISTORY_DB_STEP dB.
+  //
+  struct WaterfallHistoryHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t capacity;
+    uint64_t head;
+    uint64_t tail;
+    uint64_t tailSequence;
+    uint64_t sequence;
+  };
+
+  struct WaterfallHistoryBlock {
+    uint32_t magic;
+    uint32_t rows;
+    uint32_t bins;
+    uint32_t size;
+    uint64_t sequence;
+    int64_t  firstTime;
+    int64_t  lastTime;
+    double   frequency;
+    double   sampleRate;
+  };
+
+  struct WaterfallHistoryRow {
+    qint64 time = 0;
+    qreal frequency = 0;
+    qreal sampleRate = 0;
+    unsigned int bins = 0;
+    float peak = 0;
+    const uint8_t *codes = nullptr; // Until the next call to getRow()
+  };
+
+  //
+  // The main waterfall, kept in a ring file of fixed size that is mapped
+  // in memory. Rows are quantized to 8 bits and compressed in blocks of
+  // SIGDIGGER_WF_HISTORY_BLOCK_ROWS. Only the block being filled, the
+  // last block read and an index entry per block stay in memory, so
+  // reading back decompresses just the blocks of the rows asked for.
+  //
+  // Rows are numbered from the oldest one in the file when it was opened.
+  // Opening an existing file with the same capacity picks up its history.
+  // Everything happens in the GUI thread.
+  //
+  class WaterfallHistory {
+    struct Entry {
+      quint64 offset;
+      quint64 size; // Header and payload, padded
+      quint64 sequence;
+      quint64 firstRow;
+      unsigned int rows;
+      qint64 firstTime;
+      qint64 lastTime;
+    };
+
+    int fd = -1;
+    uint8_t *map = nullptr;
+    quint64 capacity = 0;
+    quint64 head = SIGDIGGER_WF_HISTORY_HEADER_SIZE;
+    quint64 sequence = 0;
+    quint64 used = 0;
+
+    std::deque<Entry> index;
+    quint64 nextRow = 0; // First row of the pending block
+
+    // Block being filled
+    WaterfallHistoryBlock pending;
+    std::vector<qint64> pendingTimes;
+    std::vector<float> pendingPeaks;
+    std::vector<uint8_t> pendingCodes;
+    std::vector<float> scratch;
+
+    // Last block read
+    bool cacheValid = false;
+    WaterfallHistoryBlock cachedBlock;
+    QByteArray cache;
+
+    WaterfallHistoryHeader *header(void) const;
+    void reset(void);
+    void recover(void);
+    void evict(quint64 start, quint64 end);
+    bool loadBlock(Entry const &);
+
+  public:
+    WaterfallHistory();
+    ~WaterfallHistory();
+
+    // Capacity in bytes. The whole file is reserved on disk first.
+    // Returns false, with errno set, if it cannot be reserved or mapped.
+    bool open(std::string const &path, quint64 capacity);
+    void close(void);
+
+    bool
+    isOpen(void) const
+    {
+      return this->map != nullptr;
+    }
+
+    quint64
+    getCapacity(void) const
+    {
+      return this->capacity;
+    }
+
+    // bins of data, in dB, negative frequencies first
+    void push(
+        const float *data,
+        unsigned int bins,
+        qint64 time,
+        qreal frequency,
+        qreal sampleRate);
+    void flush(void);
+
+    quint64 getFirstRow(void) const;
+    quint64 getEndRow(void) const; // One past the newest row
+    qint64 getFirstTime(void) const;
+    quint64 getDiskUsage(void) const;
+
+    // First row at or after time, getEndRow() if none
+    quint64 findRow(qint64 time);
+
+    bool getRow(quint64 row, WaterfallHistoryRow &);
+  };
+}
+
+#endif // WATERFALLHISTORY_H
@@ -0,0 +1,81 @@
+//
+//    WaterfallHistoryDialog.h: Scroll back through the waterfall history
+//    Copyright (C) 2020 Gonzalo José Carracedo Carballal
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as
+//    published by the Free Software Foundation, either version 3 of the
+//    License, or (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful, but
+//    WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public
+//    License along with this program.  If not, see
+//    <http://www.gnu.org/licenses/>
+//
+
+#ifndef WATERFALLHISTORYDIALOG_H
+#define WATERFALLHISTORYDIALOG_H
+
+#include <QDialog>
+#include <QTimer>
+#include "WaterfallHistoryView.h"
+
+#define SIGDIGGER_WF_HISTORY_DIALOG_REFRESH_MS 200
+
+namespace Ui {
+  class WaterfallHistoryDialog;
+}
+
+namespace SigDigger {
+  class WaterfallHistoryDialog : public QDialog
+  {
+      Q_OBJECT
+
+      QTimer timer;
+      WaterfallHistory *history = nullptr;
+      WaterfallHistoryView *view = nullptr;
+      quint64 lastEnd = 0;
+
+      void connectAll(void);
+
+    protected:
+      void showEvent(QShowEvent *) override;
+      void hideEvent(QHideEvent *) override;
+
+    public:
+      explicit WaterfallHistoryDialog(QWidget *parent = nullptr);
+      ~WaterfallHistoryDialog() override;
+
+      void setHistory(WaterfallHistory *);
+      void setPaletteGradient(const QColor *gradient);
+      void setRange(float min, float max);
+      void setRecording(bool);
+      void setHistorySize(unsigned int); // MiB
+
+      bool getRecording(void) const;
+      unsigned int getHistorySize(void) const;
+
+      void refresh(void);
+
+    signals:
+      void configChanged(void);
+
+    public slots:
+      void onTimeout(void);
+      void onScroll(int);
+      void onWheel(int);
+      void onHover(quint64, qreal);
+      void onGoToTime(void);
+      void onLatest(void);
+      void onConfigChanged(void);
+
+    private:
+      Ui::WaterfallHistoryDialog *ui;
+  };
+}
+
+#endif // WATERFALLHISTORYDIALOG_H
@@ -0,0 +1,66 @@
+//
+//    WaterfallHistoryView.h: Paints rows of the waterfall history
+//    Copyright (C) 2020 Gonzalo José Carracedo Carballal
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as
+//    published by the Free Software Foundation, either version 3 of the
+//    License, or (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful, but
+//    WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public
+//    License along with this program.  If not, see
+//    <http://www.gnu.org/licenses/>
+//
+
+#ifndef WATERFALLHISTORYVIEW_H
+#define WATERFALLHISTORYVIEW_H
+
+#include <QWidget>
+#include <QColor>
+#include "WaterfallHistory.h"
+
+namespace SigDigger {
+  //
+  // One history row per line, the newest `offset' rows back on top and
+  // older ones below, like the main waterfall. Only the rows on screen
+  // are read, and every row is squeezed into the width keeping the
+  // strongest bin of each pixel.
+  //
+  class WaterfallHistoryView : public QWidget
+  {
+    Q_OBJECT
+
+    WaterfallHistory *history = nullptr;
+    quint64 offset = 0;
+    QRgb colors[256];
+    float wfMin = -60;
+    float wfMax = -10;
+
+  protected:
+    void paintEvent(QPaintEvent *) override;
+    void mouseMoveEvent(QMouseEvent *) override;
+    void wheelEvent(QWheelEvent *) override;
+
+  public:
+    explicit WaterfallHistoryView(QWidget *parent = nullptr);
+
+    void setHistory(WaterfallHistory *);
+    void setOffset(quint64 offset);
+    void setPaletteGradient(const QColor *gradient);
+    void setRange(float min, float max);
+
+    // Row under line y, getEndRow() if none
+    quint64 rowAt(int y) const;
+
+  signals:
+    void hovered(quint64 row, qreal position); // Position in [0, 1)
+    void scrolled(int rows);
+  };
+}
+
+#endif // WATERFALLHISTORYVIEW_H